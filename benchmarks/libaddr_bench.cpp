@@ -0,0 +1,666 @@
+// Network Address -- benchmark the hot paths of the library
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/** \file
+ * \brief A tool to measure the speed of the library.
+ *
+ * This tool runs a set of micro-benchmarks against the functions that are
+ * most often found in hot paths: parsing, converting to string, matching
+ * and comparing addresses, optimizing vectors and gathering the list of
+ * local interfaces.
+ *
+ * Each benchmark is run over generated data sets of 1, 10, 100, ... up to
+ * 10 million entries (see `--min` and `--max`). Each data set is processed
+ * `--repeat` times and the minimum, median and maximum times are saved.
+ * The results are printed in JSON so they can be compared between
+ * versions of the library.
+ *
+ * Some benchmarks are slow or call the system (DNS lookups, netlink) so
+ * they are limited to smaller data sets by default. Use `--no-limit` to
+ * run them against all the sizes.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr_parser.h>
+#include    <libaddr/addr_range.h>
+#include    <libaddr/iface.h>
+#include    <libaddr/version.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <chrono>
+#include    <fstream>
+#include    <functional>
+#include    <iostream>
+#include    <random>
+
+
+// C
+//
+#include    <string.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+
+/** \brief Result of one benchmark run over one data set size.
+ */
+struct result_t
+{
+    std::string         f_name = std::string();
+    std::size_t         f_size = 0;
+    std::size_t         f_items = 0;
+    std::vector<double> f_ns = std::vector<double>();
+};
+
+
+/** \brief Description of one benchmark.
+ *
+ * The \p f_prepare function is called once per data set size and returns
+ * the function to time. That function returns the number of items it
+ * processed and it gets called once per repetition.
+ */
+struct benchmark_t
+{
+    char const *        f_name = nullptr;
+    char const *        f_description = nullptr;
+    std::size_t         f_limit = 0;
+    std::function<std::function<std::size_t()>(std::size_t)>
+                        f_prepare = std::function<std::function<std::size_t()>(std::size_t)>();
+};
+
+
+std::size_t     g_min = 1;
+std::size_t     g_max = 10'000'000;
+std::size_t     g_repeat = 5;
+bool            g_no_limit = false;
+std::string     g_filter = std::string();
+std::string     g_output = std::string();
+
+std::mt19937_64 g_random(0x6c696261646472ULL);    // fixed seed so all runs use the same data
+
+std::size_t volatile g_sink = 0;        // prevent the compiler from optimizing our loops away
+
+
+
+addr::addr random_address(bool ipv4)
+{
+    sockaddr_in6 in6 = sockaddr_in6();
+    in6.sin6_family = AF_INET6;
+    std::uint64_t const hi(g_random());
+    std::uint64_t const lo(g_random());
+    memcpy(in6.sin6_addr.s6_addr, &hi, sizeof(hi));
+    memcpy(in6.sin6_addr.s6_addr + 8, &lo, sizeof(lo));
+    if(ipv4)
+    {
+        in6.sin6_addr.s6_addr32[0] = 0;
+        in6.sin6_addr.s6_addr32[1] = 0;
+        in6.sin6_addr.s6_addr16[4] = 0;
+        in6.sin6_addr.s6_addr16[5] = 0xFFFF;
+    }
+    in6.sin6_port = htons(static_cast<std::uint16_t>(g_random()));
+    return addr::addr(in6);
+}
+
+
+addr::addr::vector_t random_addresses(std::size_t size)
+{
+    addr::addr::vector_t result;
+    result.reserve(size);
+    for(std::size_t idx(0); idx < size; ++idx)
+    {
+        result.push_back(random_address(idx % 2 == 0));
+    }
+    return result;
+}
+
+
+addr::addr random_cidr(bool ipv4)
+{
+    addr::addr a(random_address(ipv4));
+    a.set_mask_count(ipv4
+            ? 96 + 8 + static_cast<int>(g_random() % 25)
+            : 16 + static_cast<int>(g_random() % 113));
+    a.apply_mask();
+    return a;
+}
+
+
+addr::addr_range::vector_t random_ranges(std::size_t size)
+{
+    addr::addr_range::vector_t result;
+    result.reserve(size);
+    for(std::size_t idx(0); idx < size; ++idx)
+    {
+        addr::addr_range r;
+        r.from_cidr(random_cidr(idx % 2 == 0));
+        result.push_back(r);
+    }
+    return result;
+}
+
+
+std::string addresses_to_string(addr::addr::vector_t const & addresses)
+{
+    std::string result;
+    result.reserve(addresses.size() * 48);
+    for(auto const & a : addresses)
+    {
+        if(!result.empty())
+        {
+            result += ',';
+        }
+        result += a.to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS | addr::STRING_IP_PORT);
+    }
+    return result;
+}
+
+
+std::function<std::size_t()> prepare_parse(std::size_t size, bool lookup, std::size_t threads = 1)
+{
+    std::string const input(addresses_to_string(random_addresses(size)));
+    return [input, size, lookup, threads]()
+        {
+            addr::addr_parser p;
+            p.set_thread_count(threads);
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, lookup);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_protocol("tcp");
+            addr::addr_range::vector_t const result(p.parse(input));
+            g_sink = g_sink + result.size();
+            return size;
+        };
+}
+
+
+std::function<std::size_t()> prepare_parse_invalid(std::size_t size, addr::error_mode_t mode)
+{
+    std::string input;
+    input.reserve(size * 16);
+    for(std::size_t idx(0); idx < size; ++idx)
+    {
+        input += "10.0.0." + std::to_string(256 + idx % 1000) + ",";
+    }
+    return [input, size, mode]()
+        {
+            addr::addr_parser p;
+            p.set_error_mode(mode);
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            addr::addr_range::vector_t const result(p.parse(input));
+            g_sink = g_sink + result.size() + p.error_count();
+            return size;
+        };
+}
+
+
+benchmark_t const g_benchmarks[] =
+{
+    {
+        "parse_numeric",
+        "addr_parser::parse() of a list of numeric addresses without lookup",
+        0,
+        [](std::size_t size)
+        {
+            return prepare_parse(size, false);
+        }
+    },
+    {
+        "parse_numeric_parallel",
+        "addr_parser::parse() of a list of numeric addresses using all the processors",
+        0,
+        [](std::size_t size)
+        {
+            return prepare_parse(size, false, 0);
+        }
+    },
+    {
+        "plan_parse_single",
+        "addr_parser::plan::parse() of one numeric address at a time",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr::vector_t const addresses(random_addresses(size));
+            std::vector<std::string> inputs;
+            inputs.reserve(addresses.size());
+            for(auto const & a : addresses)
+            {
+                inputs.push_back(a.to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS | addr::STRING_IP_PORT));
+            }
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_protocol("tcp");
+            addr::addr_parser::plan const plan(p.freeze());
+            return std::function<std::size_t()>([inputs, plan]()
+                {
+                    addr::addr_range::vector_t result;
+                    for(auto const & in : inputs)
+                    {
+                        result.clear();
+                        plan.parse(in, result);
+                        g_sink = g_sink + result.size();
+                    }
+                    return inputs.size();
+                });
+        }
+    },
+    {
+        "parse_invalid_messages",
+        "addr_parser::parse() of invalid addresses generating error messages",
+        0,
+        [](std::size_t size)
+        {
+            return prepare_parse_invalid(size, addr::error_mode_t::ERROR_MODE_MESSAGES);
+        }
+    },
+    {
+        "parse_invalid_codes",
+        "addr_parser::parse() of invalid addresses only saving error codes",
+        0,
+        [](std::size_t size)
+        {
+            return prepare_parse_invalid(size, addr::error_mode_t::ERROR_MODE_CODES);
+        }
+    },
+    {
+        "parse_lookup",
+        "addr_parser::parse() of a list of numeric addresses with lookup",
+        100'000,
+        [](std::size_t size)
+        {
+            return prepare_parse(size, true);
+        }
+    },
+    {
+        "to_ipv4or6_string",
+        "addr::to_ipv4or6_string() with STRING_IP_ALL",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr::vector_t const addresses(random_addresses(size));
+            return std::function<std::size_t()>([addresses]()
+                {
+                    std::size_t total(0);
+                    for(auto const & a : addresses)
+                    {
+                        total += a.to_ipv4or6_string(addr::STRING_IP_ALL).length();
+                    }
+                    g_sink = g_sink + total;
+                    return addresses.size();
+                });
+        }
+    },
+    {
+        "match",
+        "addr::match() of addresses against one CIDR",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr::vector_t const addresses(random_addresses(size));
+            addr::addr const cidr(random_cidr(false));
+            return std::function<std::size_t()>([addresses, cidr]()
+                {
+                    std::size_t found(0);
+                    for(auto const & a : addresses)
+                    {
+                        found += cidr.match(a);
+                    }
+                    g_sink = g_sink + found;
+                    return addresses.size();
+                });
+        }
+    },
+    {
+        "range_compare",
+        "addr_range::compare() of pairs of ranges",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr_range::vector_t const ranges(random_ranges(size + 1));
+            return std::function<std::size_t()>([ranges, size]()
+                {
+                    std::size_t total(0);
+                    for(std::size_t idx(0); idx < size; ++idx)
+                    {
+                        total += static_cast<std::size_t>(ranges[idx].compare(ranges[idx + 1], true));
+                    }
+                    g_sink = g_sink + total;
+                    return size;
+                });
+        }
+    },
+    {
+        "address_match_ranges",
+        "address_match_ranges() of 1,000 addresses against a list of ranges",
+        1'000'000,
+        [](std::size_t size)
+        {
+            addr::addr_range::vector_t const ranges(random_ranges(size));
+            addr::addr::vector_t const addresses(random_addresses(1'000));
+            return std::function<std::size_t()>([ranges, addresses]()
+                {
+                    std::size_t found(0);
+                    for(auto const & a : addresses)
+                    {
+                        found += addr::address_match_ranges(ranges, a);
+                    }
+                    g_sink = g_sink + found;
+                    return addresses.size() * ranges.size();
+                });
+        }
+    },
+    {
+        "optimize_vector",
+        "optimize_vector() of a list of CIDRs",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr::vector_t cidrs;
+            cidrs.reserve(size);
+            for(std::size_t idx(0); idx < size; ++idx)
+            {
+                cidrs.push_back(random_cidr(idx % 2 == 0));
+            }
+            return std::function<std::size_t()>([cidrs]()
+                {
+                    addr::addr::vector_t v(cidrs);
+                    addr::optimize_vector(v);
+                    g_sink = g_sink + v.size();
+                    return cidrs.size();
+                });
+        }
+    },
+    {
+        "aggregate_cidrs",
+        "aggregate_cidrs() of a list of CIDRs with AGGREGATE_ALL",
+        0,
+        [](std::size_t size)
+        {
+            addr::addr::vector_t cidrs;
+            cidrs.reserve(size);
+            for(std::size_t idx(0); idx < size; ++idx)
+            {
+                cidrs.push_back(random_cidr(idx % 2 == 0));
+            }
+            return std::function<std::size_t()>([cidrs]()
+                {
+                    g_sink = g_sink + addr::aggregate_cidrs(cidrs).size();
+                    return cidrs.size();
+                });
+        }
+    },
+    {
+        "iface_cold",
+        "iface::get_local_addresses() after a cache reset (size is the number of calls)",
+        1'000,
+        [](std::size_t size)
+        {
+            return std::function<std::size_t()>([size]()
+                {
+                    for(std::size_t idx(0); idx < size; ++idx)
+                    {
+                        addr::iface::reset_local_addresses_cache();
+                        g_sink = g_sink + addr::iface::get_local_addresses()->size();
+                    }
+                    return size;
+                });
+        }
+    },
+    {
+        "iface_warm",
+        "iface::get_local_addresses() with a warm cache (size is the number of calls)",
+        0,
+        [](std::size_t size)
+        {
+            addr::iface::reset_local_addresses_cache();
+            addr::iface::get_local_addresses();
+            return std::function<std::size_t()>([size]()
+                {
+                    for(std::size_t idx(0); idx < size; ++idx)
+                    {
+                        g_sink = g_sink + addr::iface::get_local_addresses()->size();
+                    }
+                    return size;
+                });
+        }
+    },
+};
+
+
+result_t run(benchmark_t const & b, std::size_t size)
+{
+    result_t result;
+    result.f_name = b.f_name;
+    result.f_size = size;
+
+    std::function<std::size_t()> f(b.f_prepare(size));
+    for(std::size_t r(0); r < g_repeat; ++r)
+    {
+        auto const start(std::chrono::steady_clock::now());
+        result.f_items = f();
+        auto const end(std::chrono::steady_clock::now());
+        result.f_ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    std::sort(result.f_ns.begin(), result.f_ns.end());
+
+    return result;
+}
+
+
+void print_json(std::ostream & out, std::vector<result_t> const & results)
+{
+    out << "{\n"
+           "  \"library\": \"libaddr\",\n"
+           "  \"version\": \"" << LIBADDR_VERSION_STRING << "\",\n"
+           "  \"repeat\": " << g_repeat << ",\n"
+           "  \"benchmarks\": [";
+    char const * sep("\n");
+    for(auto const & r : results)
+    {
+        double const min(r.f_ns.front());
+        double const median(r.f_ns[r.f_ns.size() / 2]);
+        double const max(r.f_ns.back());
+        double const items(static_cast<double>(std::max(r.f_items, static_cast<std::size_t>(1))));
+        out << sep
+            << "    {\"name\": \"" << r.f_name << "\""
+            << ", \"size\": " << r.f_size
+            << ", \"items\": " << r.f_items
+            << ", \"min_ns\": " << static_cast<std::uint64_t>(min)
+            << ", \"median_ns\": " << static_cast<std::uint64_t>(median)
+            << ", \"max_ns\": " << static_cast<std::uint64_t>(max)
+            << ", \"ns_per_item\": " << median / items
+            << ", \"items_per_second\": " << (median > 0.0 ? items * 1e9 / median : 0.0)
+            << "}";
+        sep = ",\n";
+    }
+    out << "\n  ]\n"
+           "}\n";
+}
+
+
+bool parse_size(char const * value, std::size_t & size)
+{
+    char * end(nullptr);
+    unsigned long long const v(strtoull(value, &end, 10));
+    if(end == value
+    || *end != '\0'
+    || v == 0)
+    {
+        std::cerr << "error: invalid size \"" << value << "\".\n";
+        return false;
+    }
+    size = v;
+    return true;
+}
+
+
+
+}
+// no name namespace
+
+
+
+int main(int argc, char * argv[])
+{
+    for(int idx(1); idx < argc; ++idx)
+    {
+        if(strcmp(argv[idx], "-h") == 0
+        || strcmp(argv[idx], "--help") == 0)
+        {
+            std::cout
+                << "Usage: " << argv[0] << " [-opts]\n"
+                   "where -opts is one or more of:\n"
+                   "  --help | -h        print out this help screen.\n"
+                   "  --list             list the available benchmarks.\n"
+                   "  --filter <name>    only run benchmarks which name includes <name>.\n"
+                   "  --min <size>       smallest data set (default 1).\n"
+                   "  --max <size>       largest data set (default 10,000,000).\n"
+                   "  --repeat <count>   number of runs per data set (default 5).\n"
+                   "  --no-limit         run slow benchmarks against all the data set sizes.\n"
+                   "  --output <file>    save the JSON results to <file> instead of stdout.\n"
+                   "  --version | -V     print out the version of libaddr_bench.\n"
+                ;
+            return 1;
+        }
+        else if(strcmp(argv[idx], "--list") == 0)
+        {
+            for(auto const & b : g_benchmarks)
+            {
+                std::cout << b.f_name << " -- " << b.f_description << '\n';
+            }
+            return 0;
+        }
+        else if(strcmp(argv[idx], "--no-limit") == 0)
+        {
+            g_no_limit = true;
+        }
+        else if(strcmp(argv[idx], "-V") == 0
+             || strcmp(argv[idx], "--version") == 0)
+        {
+            std::cout << LIBADDR_VERSION_STRING << '\n';
+            return 0;
+        }
+        else if(idx + 1 >= argc)
+        {
+            std::cerr
+                << "error: unknown command line option \""
+                << argv[idx]
+                << "\" or missing value. Try --help for additional info.\n";
+            return 1;
+        }
+        else if(strcmp(argv[idx], "--filter") == 0)
+        {
+            ++idx;
+            g_filter = argv[idx];
+        }
+        else if(strcmp(argv[idx], "--min") == 0)
+        {
+            ++idx;
+            if(!parse_size(argv[idx], g_min))
+            {
+                return 1;
+            }
+        }
+        else if(strcmp(argv[idx], "--max") == 0)
+        {
+            ++idx;
+            if(!parse_size(argv[idx], g_max))
+            {
+                return 1;
+            }
+        }
+        else if(strcmp(argv[idx], "--repeat") == 0)
+        {
+            ++idx;
+            if(!parse_size(argv[idx], g_repeat))
+            {
+                return 1;
+            }
+        }
+        else if(strcmp(argv[idx], "--output") == 0)
+        {
+            ++idx;
+            g_output = argv[idx];
+        }
+        else
+        {
+            std::cerr
+                << "error: unknown command line option \""
+                << argv[idx]
+                << "\". Try --help for additional info.\n";
+            return 1;
+        }
+    }
+
+    std::vector<result_t> results;
+    for(auto const & b : g_benchmarks)
+    {
+        if(!g_filter.empty()
+        && strstr(b.f_name, g_filter.c_str()) == nullptr)
+        {
+            continue;
+        }
+        for(std::size_t size(g_min); size <= g_max; size *= 10)
+        {
+            if(!g_no_limit
+            && b.f_limit != 0
+            && size > b.f_limit)
+            {
+                break;
+            }
+            std::cerr << "info: running " << b.f_name << " with " << size << " entries...\n";
+            results.push_back(run(b, size));
+        }
+    }
+
+    if(g_output.empty())
+    {
+        print_json(std::cout, results);
+    }
+    else
+    {
+        std::ofstream out(g_output);
+        if(!out.is_open())
+        {
+            std::cerr << "error: could not open \"" << g_output << "\" for writing.\n";
+            return 1;
+        }
+        print_json(out, results);
+    }
+
+    return 0;
+}
+
+// vim: ts=4 sw=4 et
@@ -33,6 +33,8 @@
 //
 #include    "libaddr/addr.h"
 #include    "libaddr/exception.h"
+#include    "libaddr/lookup_cache.h"
+#include    "libaddr/service_registry.h"
 
 
 // advgetopt
@@ -40,24 +42,17 @@
 #include    <advgetopt/validator_integer.h>
 
 
-// cppthread
-//
-#include    <cppthread/guard.h>
-#include    <cppthread/mutex.h>
-
-
 // snapdev
 //
 #include    <snapdev/int128_literal.h>
 #include    <snapdev/math.h>
 #include    <snapdev/not_reached.h>
 #include    <snapdev/ostream_int128.h>
-#include    <snapdev/static_to_dynamic_buffer.h>
 
 
 // C++ library
 //
-#include    <sstream>
+#include    <algorithm>
 #include    <iostream>
 
 
@@ -65,6 +60,10 @@
 //
 #include    <netdb.h>
 
+#if defined(__x86_64__)
+#include    <immintrin.h>
+#endif
+
 
 // last include
 //
@@ -265,34 +264,654 @@ namespace
 {
 
 
-/** \brief Whether the ostream index was allocated.
+/** \brief Helper used to write an address in a caller's buffer.
  *
- * This flag tells us whether we already allocated the ostream index or
- * not. We want to allocate it exactly once.
+ * This class writes characters in a buffer without ever going past its
+ * end. It still counts all the characters so the caller can know the
+ * size of the buffer required to hold the entire string (like
+ * snprintf() does).
  *
- * This allows our implementation works even when you use the feature
- * before calling main().
+ * The buffer always gets a null terminator when its size is not zero.
  */
-bool g_ostream_index_allocated = false;
+class buffer_writer
+{
+public:
+    buffer_writer(char * buf, std::size_t size)
+        : f_buf(buf)
+        , f_size(size)
+    {
+    }
 
+    void add(char c)
+    {
+        if(f_pos + 1 < f_size)
+        {
+            f_buf[f_pos] = c;
+        }
+        ++f_pos;
+    }
 
-/** \brief The ostream index.
- *
- * This value represents the ostream index as returned by the
- * std::ios_base::xalloc() function.
+    void add(char const * s, std::size_t length)
+    {
+        for(std::size_t idx(0); idx < length; ++idx)
+        {
+            add(s[idx]);
+        }
+    }
+
+    void add(std::string const & s)
+    {
+        add(s.c_str(), s.length());
+    }
+
+    void add_decimal(std::uint32_t value)
+    {
+        char digits[10];
+        std::size_t count(0);
+        do
+        {
+            digits[count] = static_cast<char>('0' + value % 10);
+            ++count;
+            value /= 10;
+        }
+        while(value != 0);
+        while(count > 0)
+        {
+            --count;
+            add(digits[count]);
+        }
+    }
+
+    void add_hex(std::uint32_t value)
+    {
+        char digits[8];
+        std::size_t count(0);
+        do
+        {
+            digits[count] = "0123456789abcdef"[value & 15];
+            ++count;
+            value >>= 4;
+        }
+        while(value != 0);
+        while(count > 0)
+        {
+            --count;
+            add(digits[count]);
+        }
+    }
+
+    void add_ipv4(std::uint8_t const * bytes)
+    {
+        for(int idx(0); idx < 4; ++idx)
+        {
+            if(idx != 0)
+            {
+                add('.');
+            }
+            add_decimal(bytes[idx]);
+        }
+    }
+
+    /** \brief Write an IPv6 address.
+     *
+     * This function generates the exact same output as the inet_ntop()
+     * function of the GNU C library: the longest run of two or more zeroes
+     * gets replaced by "::" (the first one if two runs have the same
+     * length) and IPv4 compatible and mapped addresses end with a dotted
+     * IPv4 address.
+     *
+     * \param[in] bytes  The 16 bytes of the address in network order.
+     */
+    void add_ipv6(std::uint8_t const * bytes)
+    {
+        std::uint32_t words[8];
+        for(int idx(0); idx < 8; ++idx)
+        {
+            words[idx] = (bytes[idx * 2] << 8) | bytes[idx * 2 + 1];
+        }
+
+        int best_base(-1);
+        int best_length(0);
+        int base(-1);
+        int length(0);
+        for(int idx(0); idx < 8; ++idx)
+        {
+            if(words[idx] == 0)
+            {
+                if(base == -1)
+                {
+                    base = idx;
+                    length = 1;
+                }
+                else
+                {
+                    ++length;
+                }
+            }
+            else if(base != -1)
+            {
+                if(length > best_length)
+                {
+                    best_base = base;
+                    best_length = length;
+                }
+                base = -1;
+            }
+        }
+        if(base != -1
+        && length > best_length)
+        {
+            best_base = base;
+            best_length = length;
+        }
+        if(best_length < 2)
+        {
+            best_base = -1;
+        }
+
+        for(int idx(0); idx < 8; ++idx)
+        {
+            if(best_base != -1
+            && idx >= best_base
+            && idx < best_base + best_length)
+            {
+                if(idx == best_base)
+                {
+                    add(':');
+                }
+                continue;
+            }
+            if(idx != 0)
+            {
+                add(':');
+            }
+            if(idx == 6
+            && best_base == 0
+            && (best_length == 6
+                || (best_length == 5 && words[5] == 0xFFFF)))
+            {
+                add_ipv4(bytes + 12);
+                return;
+            }
+            add_hex(words[idx]);
+        }
+        if(best_base != -1
+        && best_base + best_length == 8)
+        {
+            add(':');
+        }
+    }
+
+    std::size_t finish()
+    {
+        if(f_size > 0)
+        {
+            f_buf[std::min(f_pos, f_size - 1)] = '\0';
+        }
+        return f_pos;
+    }
+
+private:
+    char *          f_buf = nullptr;
+    std::size_t     f_size = 0;
+    std::size_t     f_pos = 0;
+};
+
+
+/** \brief Output the port of an address.
  *
- * You retrieve this value by calling the get_ostream_index() function
- * to make sure it is safely allocated in a multithread environment before
- * or after main() was called.
+ * This function writes the port or, if requested and available, the
+ * name of the port.
  *
  * \note
- * There no default value. Although it looks like the C++ implementation
- * under Linux returns 4 the first time we call xalloc(), this is an
- * implementation detail. To know whether the index was allocated or not,
- * we instead use the g_ostream_index_allocated flag.
+ * The port name is copied from the service_registry in a local buffer
+ * so no memory gets allocated (unless the name is really long).
+ *
+ * \param[in] a  The address with the port to output.
+ * \param[in] w  The writer receiving the port.
+ * \param[in] mode  The mode used to output the address.
+ */
+void write_port(addr const & a, buffer_writer & w, string_ip_t const mode)
+{
+    if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
+    {
+        w.add(':');
+    }
+    if((mode & STRING_IP_PORT_NAME) != 0)
+    {
+        char service_name[64];
+        std::size_t const length(service_registry::get_port_name(
+                  a.get_port()
+                , a.get_protocol()
+                , service_name
+                , sizeof(service_name)));
+        if(length > sizeof(service_name))
+        {
+            std::string const long_name(service_registry::get_port_name(a.get_port(), a.get_protocol()));
+            if(!long_name.empty())
+            {
+                w.add(long_name);
+                return;
+            }
+        }
+        else if(length > 0)
+        {
+            w.add(service_name, length);
+            return;
+        }
+    }
+    w.add_decimal(a.get_port());
+}
+
+
+/** \brief Check whether the mode requests the mask to be output.
+ *
+ * \param[in] a  The address to check.
+ * \param[in] mode  The mode used to output the address.
+ *
+ * \return true if the mask has to be written.
+ */
+bool need_mask(addr const & a, string_ip_t const mode)
+{
+    return (mode & (STRING_IP_MASK | STRING_IP_BRACKET_MASK | STRING_IP_MASK_AS_ADDRESS | STRING_IP_MASK_IF_NEEDED)) != 0
+        && (a.get_mask_size() != 128 || (mode & STRING_IP_MASK_IF_NEEDED) == 0);
+}
+
+
+/** \brief Write an address as an IPv4 address.
+ *
+ * This function implements addr::to_ipv4_string() without any memory
+ * allocation.
+ *
+ * \exception addr_invalid_state
+ * The address is not an IPv4 address and the mode requires it to be
+ * output.
+ *
+ * \exception addr_unexpected_mask
+ * The mask is not compatible with IPv4 and the mode requires it to be
+ * output.
+ *
+ * \param[in] a  The address to write.
+ * \param[in] w  The writer receiving the address.
+ * \param[in] mode  The mode used to output the address.
+ */
+void write_ipv4(addr const & a, buffer_writer & w, string_ip_t const mode)
+{
+    if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
+    {
+        if(!a.is_ipv4())
+        {
+            throw addr_invalid_state("Not an IPv4 compatible address.");
+        }
+
+        if((mode & STRING_IP_DEFAULT_AS_ASTERISK) != 0
+        && a.is_default())
+        {
+            w.add('*');
+        }
+        else
+        {
+            sockaddr_in6 in6;
+            a.get_ipv6(in6);
+            w.add_ipv4(in6.sin6_addr.s6_addr + 12);
+        }
+    }
+
+    if((mode & (STRING_IP_PORT | STRING_IP_PORT_NAME)) != 0)
+    {
+        write_port(a, w, mode);
+    }
+
+    if(need_mask(a, mode))
+    {
+        if(!a.is_mask_ipv4_compatible())
+        {
+            throw addr_unexpected_mask("mask is not valid for an IPv4 address");
+        }
+
+        if((mode & (STRING_IP_ADDRESS
+                  | STRING_IP_BRACKET_ADDRESS
+                  | STRING_IP_PORT
+                  | STRING_IP_PORT_NAME)) != 0)
+        {
+            w.add('/');
+        }
+        int bits(-1);
+        if((mode & STRING_IP_MASK_AS_ADDRESS) == 0)
+        {
+            bits = a.get_mask_size();
+        }
+        if(bits == -1)
+        {
+            std::uint8_t mask[16];
+            a.get_mask(mask);
+            w.add_ipv4(mask + 12);
+        }
+        else
+        {
+            w.add_decimal(bits - 96);
+        }
+    }
+}
+
+
+/** \brief Write an address as an IPv6 address.
+ *
+ * This function implements addr::to_ipv6_string() without any memory
+ * allocation.
+ *
+ * \param[in] a  The address to write.
+ * \param[in] w  The writer receiving the address.
+ * \param[in] mode  The mode used to output the address.
+ */
+void write_ipv6(addr const & a, buffer_writer & w, string_ip_t const mode)
+{
+    bool const include_brackets((mode &
+                (STRING_IP_BRACKET_ADDRESS
+                | STRING_IP_BRACKET_MASK
+                | STRING_IP_PORT
+                | STRING_IP_PORT_NAME)) != 0);
+
+    if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
+    {
+        // insert the IP, even if ANY or "BROADCAST"
+        //
+        if(include_brackets)
+        {
+            w.add('[');
+        }
+
+        if(a.is_default())
+        {
+            if((mode & STRING_IP_DEFAULT_AS_ASTERISK) != 0)
+            {
+                w.add('*');
+            }
+            else if((mode & STRING_IP_DEFAULT_AS_IPV4) != 0)
+            {
+                w.add("0.0.0.0", 7);
+            }
+            else
+            {
+                // this is exactly what inet_ntop() outputs for the default
+                // IPv6 address
+                //
+                w.add("::", 2);
+            }
+        }
+        else
+        {
+            sockaddr_in6 in6;
+            a.get_ipv6(in6);
+            w.add_ipv6(in6.sin6_addr.s6_addr);
+        }
+
+        if(include_brackets)
+        {
+            w.add(']');
+        }
+    }
+
+    if((mode & (STRING_IP_PORT | STRING_IP_PORT_NAME)) != 0)
+    {
+        write_port(a, w, mode);
+    }
+
+    if(need_mask(a, mode))
+    {
+        if((mode & (STRING_IP_ADDRESS
+                  | STRING_IP_BRACKET_ADDRESS
+                  | STRING_IP_PORT
+                  | STRING_IP_PORT_NAME)) != 0)
+        {
+            w.add('/');
+        }
+        int bits(-1);
+        if((mode & STRING_IP_MASK_AS_ADDRESS) == 0)
+        {
+            bits = a.get_mask_size();
+        }
+        if(bits == -1)
+        {
+            if(include_brackets)
+            {
+                w.add('[');
+            }
+            std::uint8_t mask[16];
+            a.get_mask(mask);
+            w.add_ipv6(mask);
+            if(include_brackets)
+            {
+                w.add(']');
+            }
+        }
+        else
+        {
+            w.add_decimal(bits);
+        }
+    }
+}
+
+
+/** \brief Convert an address to a string using one of the writers.
+ *
+ * This function first writes the address in a buffer on the stack. If
+ * that buffer is too small (i.e. a very long port name), the function
+ * tries again with a buffer of the right size.
+ *
+ * \param[in] a  The address to convert.
+ * \param[in] mode  The mode used to output the address.
+ * \param[in] write  The function used to write the address.
+ *
+ * \return The address as a string.
  */
-int g_ostream_index = 0;
+std::string write_to_string(
+      addr const & a
+    , string_ip_t const mode
+    , void (*write)(addr const &, buffer_writer &, string_ip_t))
+{
+    char buf[ADDR_STRING_BUFFER_SIZE];
+    buffer_writer w(buf, sizeof(buf));
+    write(a, w, mode);
+    std::size_t const length(w.finish());
+    if(length < sizeof(buf))
+    {
+        return std::string(buf, length);
+    }
 
+    std::string result(length, '\0');
+    buffer_writer large(result.data(), length + 1);
+    write(a, large, mode);
+    large.finish();
+    return result;
+}
+
+
+/** \brief Check whether a masked address matches a network.
+ *
+ * This function is the scalar version of the match. It compares the
+ * address by 64 bits at a time.
+ *
+ * \param[in] ip  The 16 bytes of the address to check.
+ * \param[in] net  The 16 bytes of the network, already masked.
+ * \param[in] mask  The 16 bytes of the mask.
+ *
+ * \return true if (\p ip & \p mask) == \p net.
+ */
+inline bool match_scalar(
+      std::uint8_t const * ip
+    , std::uint8_t const * net
+    , std::uint8_t const * mask)
+{
+    std::uint64_t a[2];
+    std::uint64_t n[2];
+    std::uint64_t m[2];
+    memcpy(a, ip, sizeof(a));
+    memcpy(n, net, sizeof(n));
+    memcpy(m, mask, sizeof(m));
+    return (((a[0] & m[0]) ^ n[0]) | ((a[1] & m[1]) ^ n[1])) == 0;
+}
+
+
+#if defined(__x86_64__)
+/** \brief Check whether the CPU supports AVX2.
+ *
+ * The SSE2 instructions are always available on x86-64. The AVX2
+ * instructions have to be checked at runtime.
+ *
+ * \return true if the AVX2 functions can be used.
+ */
+bool has_avx2()
+{
+    static bool const avx2(__builtin_cpu_supports("avx2"));
+    return avx2;
+}
+
+
+/** \brief Match many addresses against one network using SSE2.
+ *
+ * \param[in] count  The number of addresses.
+ * \param[in] net  The 16 bytes of the network, already masked.
+ * \param[in] mask  The 16 bytes of the mask.
+ * \param[out] out  One byte per address set to 1 on a match, 0 otherwise.
+ * \param[in] ip_address  A function returning the bytes of an address.
+ *
+ * \return The number of matches.
+ */
+template<typename F>
+std::size_t match_many_sse2(
+      std::size_t count
+    , std::uint8_t const * net
+    , std::uint8_t const * mask
+    , std::uint8_t * out
+    , F ip_address)
+{
+    __m128i const m(_mm_loadu_si128(reinterpret_cast<__m128i const *>(mask)));
+    __m128i const n(_mm_loadu_si128(reinterpret_cast<__m128i const *>(net)));
+    std::size_t found(0);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        __m128i const a(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ip_address(idx))));
+        bool const r(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, m), n)) == 0xFFFF);
+        out[idx] = r;
+        found += r;
+    }
+    return found;
+}
+
+
+/** \brief Match many addresses against one network using AVX2.
+ *
+ * This function checks two addresses per 256 bit operation.
+ *
+ * \param[in] count  The number of addresses.
+ * \param[in] net  The 16 bytes of the network, already masked.
+ * \param[in] mask  The 16 bytes of the mask.
+ * \param[out] out  One byte per address set to 1 on a match, 0 otherwise.
+ * \param[in] ip_address  A function returning the bytes of an address.
+ *
+ * \return The number of matches.
+ */
+template<typename F>
+__attribute__((target("avx2")))
+std::size_t match_many_avx2(
+      std::size_t count
+    , std::uint8_t const * net
+    , std::uint8_t const * mask
+    , std::uint8_t * out
+    , F ip_address)
+{
+    __m256i const m(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(mask))));
+    __m256i const n(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(net))));
+    std::size_t found(0);
+    std::size_t idx(0);
+    for(; idx + 2 <= count; idx += 2)
+    {
+        __m256i const a(_mm256_inserti128_si256(
+                  _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ip_address(idx))))
+                , _mm_loadu_si128(reinterpret_cast<__m128i const *>(ip_address(idx + 1)))
+                , 1));
+        std::uint32_t const bits(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(a, m), n)));
+        bool const r0((bits & 0xFFFF) == 0xFFFF);
+        bool const r1((bits >> 16) == 0xFFFF);
+        out[idx] = r0;
+        out[idx + 1] = r1;
+        found += r0 + r1;
+    }
+    if(idx < count)
+    {
+        bool const r(match_scalar(ip_address(idx), net, mask));
+        out[idx] = r;
+        found += r;
+    }
+    return found;
+}
+
+
+/** \brief Check whether an address matches any network using SSE2.
+ *
+ * \param[in] ip  The 16 bytes of the address to check.
+ * \param[in] nets  The networks, 16 bytes each, already masked.
+ * \param[in] masks  The masks, 16 bytes each.
+ * \param[in] count  The number of networks.
+ *
+ * \return true if one of the networks matches \p ip.
+ */
+inline bool match_any_sse2(
+      std::uint8_t const * ip
+    , std::uint8_t const * nets
+    , std::uint8_t const * masks
+    , std::size_t count)
+{
+    __m128i const a(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ip)));
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        __m128i const m(_mm_loadu_si128(reinterpret_cast<__m128i const *>(masks + idx * 16)));
+        __m128i const n(_mm_loadu_si128(reinterpret_cast<__m128i const *>(nets + idx * 16)));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, m), n)) == 0xFFFF)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief Check whether an address matches any network using AVX2.
+ *
+ * This function checks two networks per 256 bit operation.
+ *
+ * \param[in] ip  The 16 bytes of the address to check.
+ * \param[in] nets  The networks, 16 bytes each, already masked.
+ * \param[in] masks  The masks, 16 bytes each.
+ * \param[in] count  The number of networks.
+ *
+ * \return true if one of the networks matches \p ip.
+ */
+__attribute__((target("avx2")))
+bool match_any_avx2(
+      std::uint8_t const * ip
+    , std::uint8_t const * nets
+    , std::uint8_t const * masks
+    , std::size_t count)
+{
+    __m256i const a(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ip))));
+    std::size_t idx(0);
+    for(; idx + 2 <= count; idx += 2)
+    {
+        __m256i const m(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(masks + idx * 16)));
+        __m256i const n(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(nets + idx * 16)));
+        std::uint32_t const bits(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(a, m), n)));
+        if((bits & 0xFFFF) == 0xFFFF
+        || (bits >> 16) == 0xFFFF)
+        {
+            return true;
+        }
+    }
+    return idx < count
+        && match_scalar(ip, nets + idx * 16, masks + idx * 16);
+}
+#endif
 
 
 
@@ -399,8 +1018,8 @@ void addr::set_port_defined(bool defined)
  *
  * This function checks whether the \p port parameter represents a port
  * number ("80") or a port name ("http"). If the name is found in the
- * /etc/services file, then the corresponding number is used. If not found
- * then the function throws.
+ * service_registry (i.e. /etc/services) for TCP, then the corresponding
+ * number is used. If not found, then the function returns false.
  *
  * \param[in] port  The name of the protcol to use.
  *
@@ -409,8 +1028,8 @@ void addr::set_port_defined(bool defined)
  */
 bool addr::set_port(char const * port)
 {
-    struct servent * s(getservbyname(port, "tcp"));
-    if(s == nullptr)
+    int const s(service_registry::get_port(port, IPPROTO_TCP));
+    if(s == -1)
     {
         std::int64_t p(0);
         if(advgetopt::validator_integer::convert_string(port, p))
@@ -422,7 +1041,7 @@ bool addr::set_port(char const * port)
     }
     else
     {
-        set_port(s->s_port);
+        set_port(s);
         return true;
     }
 }
@@ -483,8 +1102,9 @@ void addr::set_protocol_defined(bool defined)
  * this addr object.
  *
  * \exception addr_invalid_argument
- * The supported protocol names are defined in /etc/protocols. However,
- * internally, we are likely to support many less protocols.
+ * The supported protocol names are defined in /etc/protocols (see the
+ * service_registry). However, internally, we are likely to support many
+ * less protocols.
  *
  * \param[in] protocol  The name of the protocol.
  *
@@ -497,35 +1117,17 @@ void addr::set_protocol(char const * protocol)
         throw addr_invalid_argument("protocol pointer to set_protocol() cannot be a nullptr.");
     }
 
-    protoent proto = {};
-    protoent * ptr(nullptr);
-
-    snapdev::static_to_dynamic_buffer<char, 1024> buf;
-    for(;;)
+    int const proto(service_registry::get_protocol(protocol));
+    if(proto == -1)
     {
-        int const r(getprotobyname_r(
-                  protocol
-                , &proto
-                , buf.get()
-                , buf.size()
-                , &ptr));
-        if(r == 0
-        && ptr != nullptr)
-        {
-            break;
-        }
-        if(r != ERANGE)
-        {
-            throw addr_invalid_argument(
-                              std::string("unknown protocol \"")
-                            + protocol
-                            + "\", expected \"tcp\" or \"udp\" (string).");
-        }
-        buf.increase_size(1024);
+        throw addr_invalid_argument(
+                          std::string("unknown protocol \"")
+                        + protocol
+                        + "\", expected \"tcp\" or \"udp\" (string).");
     }
 
     f_protocol_defined = true;
-    f_protocol = proto.p_proto;
+    f_protocol = proto;
 
     address_changed();
 }
@@ -1118,149 +1720,47 @@ void addr::set_ipv6(sockaddr_in6 const & in6)
 }
 
 
-/** \brief Retrieve a copy of this addr IP address.
- *
- * This function returns the current IP address saved in this
- * addr object. The IP may represent an IPv4 address in which
- * case the is_ipv4() returns true.
- *
- * \param[out] in6  The structure where the address gets saved.
- */
-void addr::get_ipv6(sockaddr_in6 & in6) const
-{
-    memcpy(&in6, &f_address, sizeof(in6));
-}
-
-
-/** \brief Retrive the IPv4 as a string.
- *
- * This function returns a string representing the IP address
- * defined in this addr object.
- *
- * The \p mode parameter defines what gets output.
- *
- * \li ip_string_t::STRING_IP_ONLY -- only the IP address
- * \li ip_string_t::STRING_IP_PORT -- the IP and port
- * \li ip_string_t::STRING_IP_MASK -- the IP and mask
- * \li ip_string_t::STRING_IP_ALL -- the IP, port, and mask
- *
- * The ip_string_t::STRING_IP_BRACKETS is viewed as
- * ip_string_t::STRING_IP_ONLY.
- *
- * The ip_string_t::STRING_IP_BRACKETS_MASK is viewed as
- * ip_string_t::STRING_IP_MASK.
- *
- * \exception addr_invalid_state_exception
- * If the addr object does not currently represent an IPv4 then
- * this exception is raised.
- *
- * \param[in] mode  How the output string is to be built.
- */
-std::string addr::to_ipv4_string(string_ip_t const mode) const
-{
-    std::stringstream result;
-
-    // this is an IPv4 mapped in an IPv6, "unmap" that IP
-    // so the inet_ntop() can correctly generate an output IP
-    //
-    if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
-    {
-        if(!is_ipv4())
-        {
-            throw addr_invalid_state("Not an IPv4 compatible address.");
-        }
-
-        if((mode & STRING_IP_DEFAULT_AS_ASTERISK) != 0
-        && is_default())
-        {
-            result << "*";
-        }
-        else
-        {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpedantic"
-            in_addr in = {
-                .s_addr = f_address.sin6_addr.s6_addr32[3],
-            };
-#pragma GCC diagnostic pop
-            char buf[INET_ADDRSTRLEN + 1];
-            if(inet_ntop(AF_INET, &in, buf, sizeof(buf)) == nullptr)
-            {
-                // this should just never happen
-                //
-                throw addr_unexpected_error("inet_ntop() somehow failed with AF_INET and IPv4 address");
-            }
-            result << buf;
-        }
-    }
-
-    if((mode & (STRING_IP_PORT | STRING_IP_PORT_NAME)) != 0)
-    {
-        if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
-        {
-            result << ':';
-        }
-        bool name_available(false);
-        if((mode & STRING_IP_PORT_NAME) != 0)
-        {
-            std::string const service_name(get_port_name());
-            if(!service_name.empty())
-            {
-                name_available = true;
-                result << service_name;
-            }
-        }
-        if(!name_available)
-        {
-            result << get_port();
-        }
-    }
-
-    if((mode & (STRING_IP_MASK | STRING_IP_BRACKET_MASK | STRING_IP_MASK_AS_ADDRESS | STRING_IP_MASK_IF_NEEDED)) != 0
-    && (get_mask_size() != 128 || (mode & STRING_IP_MASK_IF_NEEDED) == 0))
-    {
-        if(!is_mask_ipv4_compatible())
-        {
-            throw addr_unexpected_mask("mask is not valid for an IPv4 address");
-        }
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpedantic"
-        in_addr in = {
-            .s_addr = htonl((f_mask[12] << 24) | (f_mask[13] << 16) | (f_mask[14] << 8) | f_mask[15]),
-        };
-#pragma GCC diagnostic pop
-        char buf[INET_ADDRSTRLEN + 1];
-        if(inet_ntop(AF_INET, &in, buf, sizeof(buf)) == nullptr)
-        {
-            // this should just never happen
-            //
-            throw addr_unexpected_error("inet_ntop() somehow failed with AF_INET and IPv4 address");
-        }
-
-        if((mode & (STRING_IP_ADDRESS
-                  | STRING_IP_BRACKET_ADDRESS
-                  | STRING_IP_PORT
-                  | STRING_IP_PORT_NAME)) != 0)
-        {
-            result << '/';
-        }
-        int bits(-1);
-        if((mode & STRING_IP_MASK_AS_ADDRESS) == 0)
-        {
-            bits = get_mask_size();
-        }
-        if(bits == -1)
-        {
-            result << buf;
-        }
-        else
-        {
-            result << (bits - 96);
-        }
-    }
+/** \brief Retrieve a copy of this addr IP address.
+ *
+ * This function returns the current IP address saved in this
+ * addr object. The IP may represent an IPv4 address in which
+ * case the is_ipv4() returns true.
+ *
+ * \param[out] in6  The structure where the address gets saved.
+ */
+void addr::get_ipv6(sockaddr_in6 & in6) const
+{
+    memcpy(&in6, &f_address, sizeof(in6));
+}
+
 
-    return result.str();
+/** \brief Retrive the IPv4 as a string.
+ *
+ * This function returns a string representing the IP address
+ * defined in this addr object.
+ *
+ * The \p mode parameter defines what gets output.
+ *
+ * \li ip_string_t::STRING_IP_ONLY -- only the IP address
+ * \li ip_string_t::STRING_IP_PORT -- the IP and port
+ * \li ip_string_t::STRING_IP_MASK -- the IP and mask
+ * \li ip_string_t::STRING_IP_ALL -- the IP, port, and mask
+ *
+ * The ip_string_t::STRING_IP_BRACKETS is viewed as
+ * ip_string_t::STRING_IP_ONLY.
+ *
+ * The ip_string_t::STRING_IP_BRACKETS_MASK is viewed as
+ * ip_string_t::STRING_IP_MASK.
+ *
+ * \exception addr_invalid_state_exception
+ * If the addr object does not currently represent an IPv4 then
+ * this exception is raised.
+ *
+ * \param[in] mode  How the output string is to be built.
+ */
+std::string addr::to_ipv4_string(string_ip_t const mode) const
+{
+    return write_to_string(*this, mode, write_ipv4);
 }
 
 
@@ -1285,124 +1785,7 @@ std::string addr::to_ipv4_string(string_ip_t const mode) const
  */
 std::string addr::to_ipv6_string(string_ip_t const mode) const
 {
-    std::stringstream result;
-
-    bool const include_brackets((mode &
-                (STRING_IP_BRACKET_ADDRESS
-                | STRING_IP_BRACKET_MASK
-                | STRING_IP_PORT
-                | STRING_IP_PORT_NAME)) != 0);
-
-    if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
-    {
-        // insert the IP, even if ANY or "BROADCAST"
-        //
-        if(include_brackets)
-        {
-            result << '[';
-        }
-
-        if(is_default())
-        {
-            if((mode & STRING_IP_DEFAULT_AS_ASTERISK) != 0)
-            {
-                result << "*";
-            }
-            else if((mode & STRING_IP_DEFAULT_AS_IPV4) != 0)
-            {
-                result << "0.0.0.0";
-            }
-            else
-            {
-                // this is exactly what inet_ntop() outputs for the default
-                // IPv6 address
-                //
-                result << "::";
-            }
-        }
-        else
-        {
-            char buf[INET6_ADDRSTRLEN + 1];
-            if(inet_ntop(AF_INET6, &f_address.sin6_addr, buf, sizeof(buf)) == nullptr)
-            {
-                // this should just never happen
-                //
-                throw addr_unexpected_error("inet_ntop() somehow failed with AF_INET6 and IPv6 address");
-            }
-
-            result << buf;
-        }
-
-        if(include_brackets)
-        {
-            result << ']';
-        }
-    }
-
-    if((mode & (STRING_IP_PORT | STRING_IP_PORT_NAME)) != 0)
-    {
-        if((mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS)) != 0)
-        {
-            result << ':';
-        }
-        bool name_available(false);
-        if((mode & STRING_IP_PORT_NAME) != 0)
-        {
-            std::string const service_name(get_port_name());
-            if(!service_name.empty())
-            {
-                name_available = true;
-                result << service_name;
-            }
-        }
-        if(!name_available)
-        {
-            result << get_port();
-        }
-    }
-
-    if((mode & (STRING_IP_MASK | STRING_IP_BRACKET_MASK | STRING_IP_MASK_AS_ADDRESS | STRING_IP_MASK_IF_NEEDED)) != 0
-    && (get_mask_size() != 128 || (mode & STRING_IP_MASK_IF_NEEDED) == 0))
-    {
-        char buf[INET6_ADDRSTRLEN + 1];
-        if(inet_ntop(AF_INET6, f_mask, buf, sizeof(buf)) == nullptr)
-        {
-            // this should just never happen
-            //
-            throw addr_unexpected_error("inet_ntop() somehow failed with AF_INET and IPv4 address");
-        }
-
-        if((mode & (STRING_IP_ADDRESS
-                  | STRING_IP_BRACKET_ADDRESS
-                  | STRING_IP_PORT
-                  | STRING_IP_PORT_NAME)) != 0)
-        {
-            result << '/';
-        }
-        int bits(-1);
-        if((mode & STRING_IP_MASK_AS_ADDRESS) == 0)
-        {
-            bits = get_mask_size();
-        }
-        if(bits == -1)
-        {
-            if(include_brackets)
-            {
-                result << '[';
-            }
-            result << buf;
-            if(include_brackets)
-            {
-                result << ']';
-            }
-        }
-        else
-        {
-            result << bits;
-        }
-    }
-
-    return result.str();
+    return write_to_string(*this, mode, write_ipv6);
 }
 
 
@@ -1423,8 +1806,49 @@ std::string addr::to_ipv6_string(string_ip_t const mode) const
  */
 std::string addr::to_ipv4or6_string(string_ip_t mode) const
 {
-    return is_ipv4() ? to_ipv4_string(mode)
-                     : to_ipv6_string(mode);
+    return write_to_string(*this, mode, is_ipv4() ? write_ipv4 : write_ipv6);
+}
+
+
+/** \brief Write the address as IPv4 or IPv6 in a buffer.
+ *
+ * This function is the same as to_ipv4or6_string() except that it
+ * writes the result in the buffer supplied by the caller. It does not
+ * allocate memory (unless the STRING_IP_PORT_NAME flag is used) and
+ * does not make use of a stream.
+ *
+ * The function works like snprintf(): the output is truncated to
+ * \p size - 1 characters, a null terminator is always added (unless
+ * \p size is zero) and the returned value is the length of the
+ * complete output, not including the null terminator. So if the
+ * returned value is \p size or more, the buffer was too small.
+ *
+ * A buffer of ADDR_STRING_BUFFER_SIZE characters is enough for any
+ * address except when the port name is requested.
+ *
+ * \code
+ *     char buf[addr::ADDR_STRING_BUFFER_SIZE];
+ *     std::size_t const length(a.to_buffer(buf, sizeof(buf)));
+ * \endcode
+ *
+ * \param[out] buf  The buffer where the address gets written.
+ * \param[in] size  The size of \p buf in characters.
+ * \param[in] mode  How the output string is to be built.
+ *
+ * \return The length of the complete output.
+ */
+std::size_t addr::to_buffer(char * buf, std::size_t size, string_ip_t const mode) const
+{
+    buffer_writer w(buf, size);
+    if(is_ipv4())
+    {
+        write_ipv4(*this, w, mode);
+    }
+    else
+    {
+        write_ipv6(*this, w, mode);
+    }
+    return w.finish();
 }
 
 
@@ -1979,41 +2403,20 @@ void addr::set_from_socket(int s, bool peer)
  * name such as "snap.website".
  *
  * \note
- * The function does not cache the result because it is rarely used (at least
- * at this time). So you should cache the result and avoid calling this
- * function more than once as the process can be very slow.
- *
- * \todo
- * Speed enhancement can be achieved by using getaddrinfo_a(). That would
- * work with a vector of addr objects.
+ * The reverse lookup can be very slow. When the lookup_cache is enabled,
+ * the result is cached so calling this function again with the same IP
+ * address is fast. To get the names of many addresses without blocking
+ * for long, use lookup_cache::get_names().
  *
  * \return The domain name. If not available, an empty string.
+ *
+ * \sa lookup_cache::get_names()
  */
 std::string addr::get_name() const
 {
-    char host[NI_MAXHOST];
-
-    int flags(NI_NAMEREQD);
-    if(f_protocol == IPPROTO_UDP)
-    {
-        flags |= NI_DGRAM;
-    }
-
-    // TODO: test with the NI_IDN* flags and make sure we know what we get
-    //       (i.e. we want UTF-8 as a result)
-    //
-    int const r(getnameinfo(
-              reinterpret_cast<sockaddr const *>(&f_address)
-            , sizeof(f_address)
-            , host
-            , sizeof(host)
-            , nullptr
-            , 0
-            , flags));
-
-    // if return value is 0, then it worked
-    //
-    return r == 0 ? host : std::string();
+    std::string name;
+    lookup_cache::lookup_name(*this, name);
+    return name;
 }
 
 
@@ -2022,15 +2425,13 @@ std::string addr::get_name() const
  * This function transforms the port in this `addr` object in a
  * name such as "http".
  *
- * \note
- * The function does not cache the result because it is rarely used (at least
- * at this time). So you should cache the result and avoid calling this
- * function more than once as the process is somewhat slow.
+ * The name comes from the service_registry. For UDP addresses, the UDP
+ * service is returned, for all others, the TCP service.
  *
  * \warning
- * The getnameinfo() will return a string with a number if it does not
- * know the server (i.e. this is the equivalent to std::to_string() of
- * the port). For port 0, the function always returns an empty string.
+ * The function returns a string with a number if the service is not
+ * known (i.e. this is the equivalent to std::to_string() of the port).
+ * For port 0, the function always returns an empty string.
  *
  * \return The service name. If not available, an empty string.
  */
@@ -2041,26 +2442,10 @@ std::string addr::get_service() const
         return std::string();
     }
 
-    char service[NI_MAXSERV];
-
-    int flags(NI_NAMEREQD);
-    if(f_protocol == IPPROTO_UDP)
-    {
-        flags |= NI_DGRAM;
-    }
-    int const r(getnameinfo(
-              reinterpret_cast<sockaddr const *>(&f_address)
-            , sizeof(f_address)
-            , nullptr
-            , 0
-            , service
-            , sizeof(service)
-            , flags));
-
-    // return value is 0, then it worked
-    //
-    return r == 0 ? service
-                  : std::string();
+    std::string const service(service_registry::get_port_name(
+              get_port()
+            , f_protocol == IPPROTO_UDP ? IPPROTO_UDP : IPPROTO_TCP));
+    return service.empty() ? std::to_string(get_port()) : service;
 }
 
 
@@ -2093,36 +2478,14 @@ int addr::get_port() const
 /** \brief Convert the port into a name.
  *
  * Many ports are used for specific services. For example, port 80 represents
- * HTTP. This function converts the ports using the /etc/service file.
+ * HTTP. This function converts the ports using the service_registry
+ * (i.e. the /etc/services file).
  *
  * \return The name of the port or an empty string.
  */
 std::string addr::get_port_name() const
 {
-    servent service = {};
-    servent * list(nullptr);
-
-    snapdev::static_to_dynamic_buffer<char, 1024> buf;
-    std::string const proto(get_protocol_name());
-    for(;;)
-    {
-        int const r(getservbyport_r(
-              get_port()
-            , proto.c_str()
-            , &service
-            , buf.get()
-            , buf.size()
-            , &list));
-        if(r == 0)
-        {
-            return service.s_name;
-        }
-        if(r != ERANGE)
-        {
-            return std::string();
-        }
-        buf.increase_size(1024);
-    }
+    return service_registry::get_port_name(get_port(), f_protocol);
 }
 
 
@@ -2179,7 +2542,8 @@ int addr::get_protocol() const
 /** \brief Get the protocol name.
  *
  * A list of protocols is found in the /etc/protocols file. This function
- * transforms the protocol number in one of the names found in that file.
+ * transforms the protocol number in one of the names found in that file
+ * through the service_registry.
  *
  * If no such name is available, then this function returns an empty string.
  *
@@ -2190,28 +2554,7 @@ int addr::get_protocol() const
  */
 std::string addr::get_protocol_name() const
 {
-    struct protoent proto = {};
-    struct protoent * list(nullptr);
-
-    snapdev::static_to_dynamic_buffer<char, 1024> buf;
-    for(;;)
-    {
-        int const r(getprotobynumber_r(
-                  f_protocol
-                , &proto
-                , buf.get()
-                , buf.size()
-                , &list));
-        if(r == 0)
-        {
-            return proto.p_name;
-        }
-        if(r != ERANGE)
-        {
-            return std::string();
-        }
-        buf.increase_size(1024);
-    }
+    return service_registry::get_protocol_name(f_protocol);
 }
 
 
@@ -2244,15 +2587,118 @@ bool addr::match(addr const & ip, bool any) const
         return true;
     }
 
+    std::uint8_t net[16];
+    for(int idx(0); idx < 16; ++idx)
+    {
+        net[idx] = f_address.sin6_addr.s6_addr[idx] & f_mask[idx];
+    }
+    return match_scalar(ip.f_address.sin6_addr.s6_addr, net, f_mask);
+}
+
+
+/** \brief Match many addresses against this address and mask.
+ *
+ * This function is the same as calling match() on each address in
+ * \p ips. On x86-64 it uses SSE2 or AVX2 (if the CPU supports it)
+ * to compare the addresses.
+ *
+ * The \p out buffer must be at least \p count bytes. Each byte is set
+ * to 1 if the corresponding address matches and 0 otherwise.
+ *
+ * \param[in] ips  An array of \p count addresses.
+ * \param[in] count  The number of addresses in \p ips.
+ * \param[out] out  An array of \p count bytes receiving the results.
+ *
+ * \return The number of addresses that matched.
+ *
+ * \sa match()
+ */
+std::size_t addr::match_many(addr const * ips, std::size_t count, std::uint8_t * out) const
+{
+    std::uint8_t net[16];
     for(int idx(0); idx < 16; ++idx)
     {
-        if((f_address.sin6_addr.s6_addr[idx] & f_mask[idx]) != (ip.f_address.sin6_addr.s6_addr[idx] & f_mask[idx]))
+        net[idx] = f_address.sin6_addr.s6_addr[idx] & f_mask[idx];
+    }
+    auto const ip_address([ips](std::size_t idx)
         {
-            return false;
+            return ips[idx].f_address.sin6_addr.s6_addr;
+        });
+
+#if defined(__x86_64__)
+    if(has_avx2())
+    {
+        return match_many_avx2(count, net, f_mask, out, ip_address);
+    }
+    return match_many_sse2(count, net, f_mask, out, ip_address);
+#else
+    std::size_t found(0);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        bool const r(match_scalar(ip_address(idx), net, f_mask));
+        out[idx] = r;
+        found += r;
+    }
+    return found;
+#endif
+}
+
+
+/** \brief Match many addresses against a list of CIDRs.
+ *
+ * This function checks each address in \p ips against all the addresses
+ * and masks defined in \p cidrs. If any one of them matches, the
+ * corresponding byte in \p out is set to 1, otherwise it is set to 0.
+ * This is the same as calling match() with each CIDR until one returns
+ * true, only much faster.
+ *
+ * On x86-64 the function uses SSE2 or AVX2 (if the CPU supports it).
+ * With AVX2, two CIDRs are checked per instruction.
+ *
+ * \param[in] cidrs  The list of addresses with their masks.
+ * \param[in] ips  An array of \p count addresses.
+ * \param[in] count  The number of addresses in \p ips.
+ * \param[out] out  An array of \p count bytes receiving the results.
+ *
+ * \return The number of addresses that matched.
+ */
+std::size_t addr::match_many(vector_t const & cidrs, addr const * ips, std::size_t count, std::uint8_t * out)
+{
+    // prepare flat arrays so we can load the data directly in registers
+    //
+    std::vector<std::uint8_t> nets(cidrs.size() * 16);
+    std::vector<std::uint8_t> masks(cidrs.size() * 16);
+    for(std::size_t c(0); c < cidrs.size(); ++c)
+    {
+        for(int idx(0); idx < 16; ++idx)
+        {
+            masks[c * 16 + idx] = cidrs[c].f_mask[idx];
+            nets[c * 16 + idx] = cidrs[c].f_address.sin6_addr.s6_addr[idx] & cidrs[c].f_mask[idx];
         }
     }
 
-    return true;
+#if defined(__x86_64__)
+    bool (*match_any)(std::uint8_t const *, std::uint8_t const *, std::uint8_t const *, std::size_t)(
+                has_avx2() ? match_any_avx2 : match_any_sse2);
+#endif
+
+    std::size_t found(0);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        std::uint8_t const * ip(ips[idx].f_address.sin6_addr.s6_addr);
+#if defined(__x86_64__)
+        bool const r(match_any(ip, nets.data(), masks.data(), cidrs.size()));
+#else
+        bool r(false);
+        for(std::size_t c(0); c < cidrs.size() && !r; ++c)
+        {
+            r = match_scalar(ip, nets.data() + c * 16, masks.data() + c * 16);
+        }
+#endif
+        out[idx] = r;
+        found += r;
+    }
+    return found;
 }
 
 
@@ -2306,6 +2752,27 @@ bool addr::is_previous(addr const & a) const
 }
 
 
+/** \brief Compute a hash of this address.
+ *
+ * This function computes a hash of the IP address so it can be used
+ * in an unordered container such as addr::unordered_set_t. It is
+ * used by the std::hash<addr::addr> specialization.
+ *
+ * \warning
+ * Like the comparison operators, the function only uses the address
+ * itself. The family, port, flow info, scope identifier, protocol, and
+ * mask are all ignored.
+ *
+ * \return A hash of the IP address.
+ */
+std::size_t addr::hash() const
+{
+    std::uint64_t v[2];
+    memcpy(v, f_address.sin6_addr.s6_addr, sizeof(v));
+    return hash_mix(v[0] ^ hash_mix(v[1] ^ 0x9e3779b97f4a7c15ULL));
+}
+
+
 /** \brief Check whether two addresses are equal.
  *
  * This function compares the left hand side (this) and the right
@@ -2733,19 +3200,17 @@ void addr::address_changed()
  * functions, we need an index which this function supplies. The index
  * is allocated whenever you first use one of the addr ostream functions.
  *
+ * The index is a function static variable so the C++ runtime initializes
+ * it exactly once, even when this function is called before main() or
+ * by multiple threads at the same time. Once initialized, reading it does
+ * not require a lock.
+ *
  * \return The unique ostream index for the addr class.
  */
 int get_ostream_index()
 {
-    cppthread::guard lock(*cppthread::g_system_mutex);
-
-    if(!g_ostream_index_allocated)
-    {
-        g_ostream_index_allocated = true;
-        g_ostream_index = std::ios_base::xalloc();
-    }
-
-    return g_ostream_index;
+    static int const index(std::ios_base::xalloc());
+    return index;
 }
 
 
@@ -37,6 +37,8 @@
 #include    <memory>
 #include    <set>
 #include    <string>
+#include    <unordered_map>
+#include    <unordered_set>
 #include    <vector>
 
 
@@ -142,12 +144,42 @@ constexpr string_ip_t           STRING_IP_ALL = STRING_IP_BRACKET_ADDRESS
                                               | STRING_IP_PORT
                                               | STRING_IP_BRACKET_MASK;
 
+// a buffer large enough for any address except when it includes a port name
+// "[" + IPv6 + "]:" + port + "/[" + IPv6 mask + "]" + '\0'
+//
+constexpr std::size_t           ADDR_STRING_BUFFER_SIZE = 1 + 45 + 2 + 5 + 2 + 45 + 1 + 1;
+
+
+/** \brief Mix the bits of a 64 bit value.
+ *
+ * This function is the finalizer of MurmurHash3. It is used by the
+ * hash() functions of the address classes to spread the bits of the
+ * addresses over the entire hash value.
+ *
+ * \param[in] value  The value to mix.
+ *
+ * \return The mixed value.
+ */
+inline std::uint64_t hash_mix(std::uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
 
 class addr
 {
 public:
     typedef std::shared_ptr<addr>   pointer_t;
     typedef std::set<addr>          set_t;
+    typedef std::unordered_set<addr>
+                                    unordered_set_t;
+    template<typename T>
+    using unordered_map_t = std::unordered_map<addr, T>;
     typedef std::vector<addr>       vector_t;
     typedef int                     socket_flag_t;
 
@@ -188,6 +220,7 @@ public:
     std::string                     to_ipv4_string(string_ip_t const mode) const;
     std::string                     to_ipv6_string(string_ip_t const mode) const;
     std::string                     to_ipv4or6_string(string_ip_t const mode = STRING_IP_ALL) const;
+    std::size_t                     to_buffer(char * buf, std::size_t size, string_ip_t const mode = STRING_IP_ALL) const;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
     unsigned __int128               ip_to_uint128() const;
@@ -217,8 +250,12 @@ public:
     bool                            is_mask_defined() const;
 
     bool                            match(addr const & ip, bool any = false) const;
+    std::size_t                     match_many(addr const * ips, std::size_t count, std::uint8_t * out) const;
+    static std::size_t              match_many(vector_t const & cidrs, addr const * ips, std::size_t count, std::uint8_t * out);
     bool                            is_next(addr const & a) const;
     bool                            is_previous(addr const & a) const;
+    std::size_t                     hash() const;
+
     bool                            operator == (addr const & rhs) const;
     bool                            operator != (addr const & rhs) const;
     bool                            operator <  (addr const & rhs) const;
@@ -258,16 +295,19 @@ private:
 
 /** \brief Set of flags attached to an ostream for an addr object.
  *
- * This structure holds data used to output an addr object in an ostream.
- *
- * The mode defines how each address is output (see addr::to_ipv4or6_string()).
+ * This structure holds data used to output a container of addr objects
+ * in an ostream. It only gets allocated when the setaddrsep() is used.
  *
  * The separator is used whenever a vector or set of addresses is printed
  * out.
+ *
+ * \note
+ * The mode is not saved in this structure. Instead it is saved in the
+ * iword() of the stream so setting or reading it never allocates memory.
+ * See _get_addr_mode() for details.
  */
 struct _ostream_info
 {
-    string_ip_t         f_mode = STRING_IP_ALL;
     std::string         f_sep = std::string(",");
 };
 
@@ -283,6 +323,22 @@ struct _ostream_info
 int get_ostream_index();
 
 
+/** \brief Retrieve the address mode of an ostream.
+ *
+ * The mode is saved in the iword() of the stream. The default value of
+ * an iword() is 0 so we save the mode XOR'ed with STRING_IP_ALL. That way
+ * a stream which never received a setaddrmode() uses STRING_IP_ALL.
+ *
+ * \param[in] out  The stream from which the mode is read.
+ *
+ * \return The mode to use to output addresses in \p out.
+ */
+inline string_ip_t _get_addr_mode(std::ios_base & out)
+{
+    return static_cast<string_ip_t>(out.iword(get_ostream_index())) ^ STRING_IP_ALL;
+}
+
+
 /** \brief An intermediate structure to pass a new mode to ostream.
  *
  * This structure is used by the setaddrmode() function to update the
@@ -392,15 +448,7 @@ template<typename _CharT, typename _Traits>
 inline std::basic_ostream<_CharT, _Traits> &
 operator << (std::basic_ostream<_CharT, _Traits> & out, _setaddrmode mode)
 {
-    int const index(get_ostream_index());
-    _ostream_info * info(static_cast<_ostream_info *>(out.pword(index)));
-    if(info == nullptr)
-    {
-        info = new _ostream_info;
-        out.pword(index) = info;
-        out.register_callback(basic_stream_event_callback, index);
-    }
-    info->f_mode = mode.f_mode;
+    out.iword(get_ostream_index()) = mode.f_mode ^ STRING_IP_ALL;
     return out;
 }
 
@@ -444,14 +492,15 @@ template<typename _CharT, typename _Traits>
 inline std::basic_ostream<_CharT, _Traits> &
 operator << (std::basic_ostream<_CharT, _Traits> & out, addr const & address)
 {
-    _ostream_info * info(static_cast<_ostream_info *>(out.pword(get_ostream_index())));
-    if(info == nullptr)
+    string_ip_t const mode(_get_addr_mode(out));
+    char buf[ADDR_STRING_BUFFER_SIZE];
+    if(address.to_buffer(buf, sizeof(buf), mode) < sizeof(buf))
     {
-        out << address.to_ipv4or6_string(STRING_IP_ALL);
+        out << buf;
     }
     else
     {
-        out << address.to_ipv4or6_string(info->f_mode);
+        out << address.to_ipv4or6_string(mode);
     }
     return out;
 }
@@ -565,5 +614,19 @@ inline bool operator >= (in6_addr const & a, in6_addr const & b)
 }
 
 
+namespace std
+{
+template<>
+struct hash<addr::addr>
+{
+    std::size_t operator () (addr::addr const & a) const noexcept
+    {
+        return a.hash();
+    }
+};
+}
+// namespace std
+
+
 
 // vim: ts=4 sw=4 et
@@ -0,0 +1,789 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+/** \file
+ * \brief The implementation of the addr_lpm_table class.
+ *
+ * This file includes the implementation of the addr_lpm_table class,
+ * a path compressed binary trie (a.k.a. Patricia trie) used to find
+ * the most specific range matching an address.
+ */
+
+// self
+//
+#include    "libaddr/addr_lpm_table.h"
+#include    "libaddr/exception.h"
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace addr
+{
+
+
+namespace
+{
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+typedef unsigned __int128       key_t;
+
+
+/** \brief Compute the mask of a prefix.
+ *
+ * This function returns a 128 bit number with the top \p length bits
+ * set to 1 and the other bits set to 0.
+ *
+ * \param[in] length  The length of the prefix, from 0 to 128.
+ *
+ * \return The mask representing \p length.
+ */
+constexpr key_t prefix_mask(int length)
+{
+    return length == 0 ? 0 : ~static_cast<key_t>(0) << (128 - length);
+}
+
+
+/** \brief Retrieve bit at \p position.
+ *
+ * The bits are numbered from the most significant (0) to the least
+ * significant (127), which is the order in which the trie is walked.
+ *
+ * \param[in] key  The key to extract a bit from.
+ * \param[in] position  The position of the bit, 0 to 127.
+ *
+ * \return 0 or 1.
+ */
+constexpr int key_bit(key_t key, int position)
+{
+    return static_cast<int>(key >> (127 - position)) & 1;
+}
+
+
+/** \brief Count the number of bits two keys have in common.
+ *
+ * The function counts the number of most significant bits which are
+ * equal in both keys.
+ *
+ * \param[in] a  The first key.
+ * \param[in] b  The second key.
+ *
+ * \return The number of equal bits, from 0 to 128.
+ */
+int common_length(key_t a, key_t b)
+{
+    key_t const diff(a ^ b);
+    std::uint64_t const hi(static_cast<std::uint64_t>(diff >> 64));
+    if(hi != 0)
+    {
+        return __builtin_clzll(hi);
+    }
+    std::uint64_t const lo(static_cast<std::uint64_t>(diff));
+    if(lo != 0)
+    {
+        return 64 + __builtin_clzll(lo);
+    }
+    return 128;
+}
+
+
+/** \brief Break a range in a list of prefixes.
+ *
+ * The trie only understands prefixes (CIDRs). An addr_range can
+ * represent any set of consecutive addresses. This function breaks
+ * such a range in the smallest list of prefixes covering exactly the
+ * same set of addresses (see addr_range::to_cidrs()) and calls \p f
+ * with each one of them.
+ *
+ * A range with only a "from" or only a "to" address is viewed as a
+ * CIDR (address & mask). The mask must be a valid CIDR mask.
+ *
+ * \exception addr_unsupported_as_range
+ * If the mask of a "from" or "to" only range cannot be represented
+ * by a number of bits, then this exception is raised.
+ *
+ * \param[in] range  The range to transform.
+ * \param[in] f  The function called with each prefix and its length.
+ */
+template<typename F>
+void range_to_prefixes(addr_range const & range, F f)
+{
+    if(range.is_range())
+    {
+        for(auto const & a : range.to_cidrs())
+        {
+            f(a.ip_to_uint128(), a.get_mask_size());
+        }
+        return;
+    }
+
+    // a CIDR interval has the prefix length in common
+    //
+    key_t from(0);
+    key_t to(0);
+    bool valid(false);
+    try
+    {
+        valid = range.to_uint128_interval(from, to);
+    }
+    catch(addr_unsupported_as_range const &)
+    {
+        throw addr_unsupported_as_range("addr_lpm_table only supports CIDR masks");
+    }
+    if(valid)
+    {
+        f(from, common_length(from, to));
+    }
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Check whether two ranges are the same.
+ *
+ * The addr::operator == () ignores the mask. Here we want the mask
+ * to count since it changes the set of addresses represented by a
+ * "from" only range.
+ *
+ * \param[in] lhs  The left hand side range.
+ * \param[in] rhs  The right hand side range.
+ *
+ * \return true if both ranges represent the same addresses.
+ */
+bool same_range(addr_range const & lhs, addr_range const & rhs)
+{
+    return lhs.has_from() == rhs.has_from()
+        && lhs.has_to() == rhs.has_to()
+        && lhs.get_from() == rhs.get_from()
+        && lhs.get_to() == rhs.get_to()
+        && lhs.get_from().get_mask_size() == rhs.get_from().get_mask_size()
+        && lhs.get_to().get_mask_size() == rhs.get_to().get_mask_size();
+}
+
+
+}
+// no name namespace
+
+
+
+/** \brief Initialize an empty table.
+ *
+ * The table starts with one node, the root, which represents the
+ * prefix ::/0. It never gets removed.
+ */
+addr_lpm_table::addr_lpm_table()
+{
+    f_nodes.resize(1);
+}
+
+
+/** \brief Initialize a table from a vector of ranges.
+ *
+ * This constructor inserts all the ranges found in \p ranges. The
+ * index of each range in \p ranges is also its index in the table
+ * so the find_index() function returns a position in \p ranges.
+ *
+ * \param[in] ranges  The ranges to add to the table.
+ */
+addr_lpm_table::addr_lpm_table(addr_range::vector_t const & ranges)
+    : addr_lpm_table()
+{
+    f_ranges.reserve(ranges.size());
+    f_used.reserve(ranges.size());
+    for(auto const & r : ranges)
+    {
+        insert(r);
+    }
+}
+
+
+/** \brief Add a range to the table.
+ *
+ * This function adds the specified range to the table. If the range
+ * is not a CIDR (i.e. 10.0.0.5-10.0.3.77) then it gets broken up
+ * in the minimum number of prefixes to cover the exact same set of
+ * addresses.
+ *
+ * A range which has only a "from" or only a "to" address is viewed
+ * as a CIDR using that address mask, just like addr_range::match().
+ *
+ * Empty ranges and undefined ranges are saved but they never match
+ * anything.
+ *
+ * \note
+ * If you insert the same prefix twice, the last one inserted wins.
+ * The older range is shadowed: find() does not return it until the
+ * newer range gets removed.
+ *
+ * \exception addr_unsupported_as_range
+ * If the range uses a mask which is not a valid CIDR, this exception
+ * is raised.
+ *
+ * \param[in] range  The range to add to the table.
+ *
+ * \return The index of the new range.
+ */
+std::size_t addr_lpm_table::insert(addr_range const & range)
+{
+    std::size_t slot(0);
+    if(f_free_slots.empty())
+    {
+        slot = f_ranges.size();
+        f_ranges.push_back(range);
+        f_used.push_back(true);
+    }
+    else
+    {
+        slot = f_free_slots.back();
+        f_free_slots.pop_back();
+        f_ranges[slot] = range;
+        f_used[slot] = true;
+    }
+    ++f_size;
+
+    try
+    {
+        range_to_prefixes(range, [this, slot](key_t prefix, int length)
+            {
+                insert_prefix(prefix, length, static_cast<std::int32_t>(slot));
+            });
+    }
+    catch(addr_unsupported_as_range const &)
+    {
+        f_used[slot] = false;
+        f_free_slots.push_back(slot);
+        --f_size;
+        throw;
+    }
+
+    return slot;
+}
+
+
+/** \brief Remove a range from the table.
+ *
+ * This function searches for \p range in the table and removes it.
+ * The range must be exactly equal (including masks) to the range
+ * that was inserted.
+ *
+ * Once removed, the index of that range may be reused by a later
+ * call to insert().
+ *
+ * \param[in] range  The range to remove.
+ *
+ * \return true if the range was found and removed.
+ */
+bool addr_lpm_table::remove(addr_range const & range)
+{
+    std::int32_t slot(-1);
+    bool has_prefixes(false);
+    range_to_prefixes(range, [this, &range, &slot, &has_prefixes](key_t prefix, int length)
+        {
+            has_prefixes = true;
+            if(slot == -1)
+            {
+                slot = find_slot(prefix, length, range);
+                if(slot == -1)
+                {
+                    return;
+                }
+            }
+            remove_prefix(prefix, length, slot);
+        });
+
+    if(slot == -1)
+    {
+        if(has_prefixes)
+        {
+            return false;
+        }
+
+        // an empty range has no prefixes, search it in the list
+        //
+        for(std::size_t idx(0); idx < f_ranges.size(); ++idx)
+        {
+            if(f_used[idx]
+            && same_range(f_ranges[idx], range))
+            {
+                slot = static_cast<std::int32_t>(idx);
+                break;
+            }
+        }
+        if(slot == -1)
+        {
+            return false;
+        }
+    }
+
+    f_used[slot] = false;
+    f_ranges[slot] = addr_range();
+    f_free_slots.push_back(slot);
+    --f_size;
+
+    return true;
+}
+
+
+/** \brief Remove all the ranges from this table.
+ *
+ * This function resets the table as if just created with the default
+ * constructor.
+ */
+void addr_lpm_table::clear()
+{
+    f_nodes.clear();
+    f_nodes.resize(1);
+    f_free_nodes.clear();
+    f_ranges.clear();
+    f_used.clear();
+    f_free_slots.clear();
+    f_shadowed.clear();
+    f_size = 0;
+    f_prefix_count = 0;
+}
+
+
+/** \brief Check whether the table is empty.
+ *
+ * \return true if no ranges are defined in this table.
+ */
+bool addr_lpm_table::empty() const
+{
+    return f_size == 0;
+}
+
+
+/** \brief Retrieve the number of ranges in this table.
+ *
+ * \return The number of ranges that were inserted and not yet removed.
+ */
+std::size_t addr_lpm_table::size() const
+{
+    return f_size;
+}
+
+
+/** \brief Retrieve the number of prefixes in this table.
+ *
+ * Each range is broken up in one or more prefixes. This function
+ * returns the total number of prefixes currently attached to a range.
+ *
+ * \return The number of prefixes in the trie.
+ */
+std::size_t addr_lpm_table::prefix_count() const
+{
+    return f_prefix_count;
+}
+
+
+/** \brief Retrieve a range by index.
+ *
+ * The insert() and find_index() functions return an index. This
+ * function returns the corresponding range.
+ *
+ * \exception out_of_range
+ * If the index does not represent a range currently defined in the
+ * table, this exception is raised.
+ *
+ * \param[in] index  The index of the range to retrieve.
+ *
+ * \return A reference to the range.
+ */
+addr_range const & addr_lpm_table::get_range(std::size_t index) const
+{
+    if(index >= f_ranges.size()
+    || !f_used[index])
+    {
+        throw out_of_range(
+                  "index "
+                + std::to_string(index)
+                + " does not represent a range in this addr_lpm_table.");
+    }
+
+    return f_ranges[index];
+}
+
+
+/** \brief Search the most specific range matching \p address.
+ *
+ * This function walks the trie and returns the index of the range with
+ * the longest prefix matching \p address. The walk is limited to the
+ * number of bits in the address (128) and it does not allocate memory.
+ *
+ * \param[in] address  The address to search.
+ *
+ * \return The index of the range or NO_RANGE if no range matches.
+ */
+std::size_t addr_lpm_table::find_index(addr const & address) const
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    key_t const key(address.ip_to_uint128());
+#pragma GCC diagnostic pop
+
+    node const * n(f_nodes.data());
+    std::int32_t best(n->f_slot);
+    while(n->f_length < 128)
+    {
+        std::int32_t const child(n->f_child[key_bit(key, n->f_length)]);
+        if(child < 0)
+        {
+            break;
+        }
+        n = f_nodes.data() + child;
+        if(((n->f_prefix ^ key) & prefix_mask(n->f_length)) != 0)
+        {
+            break;
+        }
+        if(n->f_slot >= 0)
+        {
+            best = n->f_slot;
+        }
+    }
+
+    return best < 0 ? NO_RANGE : static_cast<std::size_t>(best);
+}
+
+
+/** \brief Search the most specific range matching \p address.
+ *
+ * This function is the same as find_index() except that it returns
+ * a pointer to the range.
+ *
+ * \warning
+ * The pointer remains valid until the table gets modified.
+ *
+ * \param[in] address  The address to search.
+ *
+ * \return A pointer to the range or nullptr if no range matches.
+ */
+addr_range const * addr_lpm_table::find(addr const & address) const
+{
+    std::size_t const index(find_index(address));
+    if(index == NO_RANGE)
+    {
+        return nullptr;
+    }
+    return &f_ranges[index];
+}
+
+
+/** \brief Check whether \p address matches any range.
+ *
+ * \param[in] address  The address to search.
+ *
+ * \return true if at least one range includes \p address.
+ */
+bool addr_lpm_table::match(addr const & address) const
+{
+    return find_index(address) != NO_RANGE;
+}
+
+
+/** \brief Allocate a node.
+ *
+ * The nodes are kept in a vector and referenced by index. This function
+ * reuses a node freed by remove_prefix() if available.
+ *
+ * \warning
+ * This function may reallocate the vector of nodes so any reference
+ * to a node is invalid after this call.
+ *
+ * \return The index of the new node.
+ */
+std::int32_t addr_lpm_table::allocate_node()
+{
+    if(!f_free_nodes.empty())
+    {
+        std::int32_t const idx(f_free_nodes.back());
+        f_free_nodes.pop_back();
+        f_nodes[idx] = node();
+        return idx;
+    }
+
+    f_nodes.emplace_back();
+    return static_cast<std::int32_t>(f_nodes.size() - 1);
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Attach one prefix to a range.
+ *
+ * This function searches for the node representing \p prefix / \p length
+ * and attaches \p slot to it. If the node does not exist, it gets created
+ * and when necessary an intermediate node is added to split an existing
+ * path.
+ *
+ * \param[in] prefix  The prefix (already masked).
+ * \param[in] length  The number of bits in the prefix.
+ * \param[in] slot  The index of the range.
+ */
+void addr_lpm_table::insert_prefix(key_t prefix, int length, std::int32_t slot)
+{
+    std::int32_t idx(0);
+    for(;;)
+    {
+        if(f_nodes[idx].f_length == length)
+        {
+            if(f_nodes[idx].f_slot < 0)
+            {
+                ++f_prefix_count;
+            }
+            else
+            {
+                f_shadowed[idx].push_back(f_nodes[idx].f_slot);
+            }
+            f_nodes[idx].f_slot = slot;
+            return;
+        }
+
+        int const bit(key_bit(prefix, f_nodes[idx].f_length));
+        std::int32_t const child(f_nodes[idx].f_child[bit]);
+        if(child < 0)
+        {
+            std::int32_t const leaf(allocate_node());
+            f_nodes[leaf].f_prefix = prefix;
+            f_nodes[leaf].f_length = length;
+            f_nodes[leaf].f_slot = slot;
+            f_nodes[idx].f_child[bit] = leaf;
+            ++f_prefix_count;
+            return;
+        }
+
+        int const child_length(f_nodes[child].f_length);
+        int const common(std::min({
+                  common_length(prefix, f_nodes[child].f_prefix)
+                , child_length
+                , length }));
+        if(common == child_length)
+        {
+            // the child is a prefix of the new prefix, go down
+            //
+            idx = child;
+            continue;
+        }
+
+        // we need a new node between idx and child
+        //
+        std::int32_t const split(allocate_node());
+        f_nodes[split].f_prefix = prefix & prefix_mask(common);
+        f_nodes[split].f_length = common;
+        f_nodes[split].f_child[key_bit(f_nodes[child].f_prefix, common)] = child;
+        f_nodes[idx].f_child[bit] = split;
+        if(common == length)
+        {
+            // the new prefix is the new node
+            //
+            f_nodes[split].f_slot = slot;
+        }
+        else
+        {
+            std::int32_t const leaf(allocate_node());
+            f_nodes[leaf].f_prefix = prefix;
+            f_nodes[leaf].f_length = length;
+            f_nodes[leaf].f_slot = slot;
+            f_nodes[split].f_child[key_bit(prefix, common)] = leaf;
+        }
+        ++f_prefix_count;
+        return;
+    }
+}
+
+
+/** \brief Search the slot of a range attached to a prefix.
+ *
+ * This function searches the node representing \p prefix / \p length
+ * and checks whether \p range is attached to it, either as the active
+ * range or as a shadowed range.
+ *
+ * \param[in] prefix  The prefix (already masked).
+ * \param[in] length  The number of bits in the prefix.
+ * \param[in] range  The range to search.
+ *
+ * \return The slot of \p range or -1 if not found.
+ */
+std::int32_t addr_lpm_table::find_slot(key_t prefix, int length, addr_range const & range) const
+{
+    std::int32_t idx(0);
+    while(f_nodes[idx].f_length < length)
+    {
+        idx = f_nodes[idx].f_child[key_bit(prefix, f_nodes[idx].f_length)];
+        if(idx < 0)
+        {
+            return -1;
+        }
+    }
+    if(f_nodes[idx].f_length != length
+    || f_nodes[idx].f_prefix != prefix
+    || f_nodes[idx].f_slot < 0)
+    {
+        return -1;
+    }
+
+    if(same_range(f_ranges[f_nodes[idx].f_slot], range))
+    {
+        return f_nodes[idx].f_slot;
+    }
+
+    auto const it(f_shadowed.find(idx));
+    if(it != f_shadowed.end())
+    {
+        for(auto const s : it->second)
+        {
+            if(same_range(f_ranges[s], range))
+            {
+                return s;
+            }
+        }
+    }
+
+    return -1;
+}
+
+
+/** \brief Detach one prefix from its range.
+ *
+ * This function searches the node representing \p prefix / \p length
+ * and detaches it from \p slot. If another range was shadowed by
+ * \p slot, it becomes active again. Nodes which become useless (no
+ * range and less than two children) are removed from the trie.
+ *
+ * \param[in] prefix  The prefix (already masked).
+ * \param[in] length  The number of bits in the prefix.
+ * \param[in] slot  The index of the range.
+ */
+void addr_lpm_table::remove_prefix(key_t prefix, int length, std::int32_t slot)
+{
+    // keep the parents so we can prune the trie
+    //
+    std::int32_t parents[130];
+    int depth(0);
+
+    std::int32_t idx(0);
+    while(f_nodes[idx].f_length < length)
+    {
+        parents[depth] = idx;
+        ++depth;
+        idx = f_nodes[idx].f_child[key_bit(prefix, f_nodes[idx].f_length)];
+        if(idx < 0)
+        {
+            return; // LCOV_EXCL_LINE
+        }
+    }
+    if(f_nodes[idx].f_length != length
+    || f_nodes[idx].f_prefix != prefix
+    || f_nodes[idx].f_slot < 0)
+    {
+        return; // LCOV_EXCL_LINE
+    }
+
+    auto it(f_shadowed.find(idx));
+    if(it != f_shadowed.end())
+    {
+        if(f_nodes[idx].f_slot == slot)
+        {
+            // the previous range becomes visible again
+            //
+            f_nodes[idx].f_slot = it->second.back();
+            it->second.pop_back();
+        }
+        else
+        {
+            it->second.erase(std::remove(it->second.begin(), it->second.end(), slot), it->second.end());
+        }
+        if(it->second.empty())
+        {
+            f_shadowed.erase(it);
+        }
+        return;
+    }
+    if(f_nodes[idx].f_slot != slot)
+    {
+        return; // LCOV_EXCL_LINE
+    }
+
+    f_nodes[idx].f_slot = -1;
+    --f_prefix_count;
+
+    // prune the node and then its parent if they became useless
+    //
+    while(idx != 0 && depth > 0)
+    {
+        node & n(f_nodes[idx]);
+        if(n.f_slot >= 0
+        || (n.f_child[0] >= 0 && n.f_child[1] >= 0))
+        {
+            break;
+        }
+
+        std::int32_t const replacement(n.f_child[0] >= 0 ? n.f_child[0] : n.f_child[1]);
+        --depth;
+        std::int32_t const parent(parents[depth]);
+        node & p(f_nodes[parent]);
+        p.f_child[p.f_child[0] == idx ? 0 : 1] = replacement;
+        f_free_nodes.push_back(idx);
+
+        if(replacement >= 0)
+        {
+            // the parent did not lose a child
+            //
+            break;
+        }
+        idx = parent;
+    }
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Check whether an address matches a table of ranges.
+ *
+ * This function is the same as the address_match_ranges() function
+ * using a vector of ranges, only it searches an addr_lpm_table which
+ * is much faster with large lists.
+ *
+ * \param[in] table  The table of ranges to search for \p address.
+ * \param[in] address  The address to search in \p table.
+ *
+ * \return true if \p address matches any one of the ranges in \p table.
+ */
+bool address_match_ranges(addr_lpm_table const & table, addr const & address)
+{
+    return table.match(address);
+}
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief The addr_lpm_table class.
+ *
+ * This header defines the addr_lpm_table class used to search a large
+ * list of ranges for the most specific range matching a given address
+ * (Longest Prefix Match).
+ */
+
+#include    <libaddr/addr_range.h>
+
+
+// C++
+//
+#include    <map>
+
+
+
+namespace addr
+{
+
+
+class addr_lpm_table
+{
+public:
+    typedef std::shared_ptr<addr_lpm_table> pointer_t;
+
+    static constexpr std::size_t const  NO_RANGE = static_cast<std::size_t>(-1);
+
+                                    addr_lpm_table();
+                                    addr_lpm_table(addr_range::vector_t const & ranges);
+
+    std::size_t                     insert(addr_range const & range);
+    bool                            remove(addr_range const & range);
+    void                            clear();
+
+    bool                            empty() const;
+    std::size_t                     size() const;
+    std::size_t                     prefix_count() const;
+    addr_range const &              get_range(std::size_t index) const;
+
+    std::size_t                     find_index(addr const & address) const;
+    addr_range const *              find(addr const & address) const;
+    bool                            match(addr const & address) const;
+
+private:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    typedef unsigned __int128       key_t;
+
+    struct node
+    {
+        key_t                       f_prefix = 0;
+        std::int32_t                f_child[2] = { -1, -1 };
+        std::int32_t                f_slot = -1;
+        std::uint8_t                f_length = 0;
+    };
+    typedef std::vector<node>       node_vector_t;
+    typedef std::map<std::int32_t, std::vector<std::int32_t>>
+                                    shadowed_map_t;
+
+    void                            insert_prefix(key_t prefix, int length, std::int32_t slot);
+    void                            remove_prefix(key_t prefix, int length, std::int32_t slot);
+    std::int32_t                    find_slot(key_t prefix, int length, addr_range const & range) const;
+#pragma GCC diagnostic pop
+    std::int32_t                    allocate_node();
+
+    node_vector_t                   f_nodes = node_vector_t();
+    std::vector<std::int32_t>       f_free_nodes = std::vector<std::int32_t>();
+    addr_range::vector_t            f_ranges = addr_range::vector_t();
+    std::vector<bool>               f_used = std::vector<bool>();
+    std::vector<std::size_t>        f_free_slots = std::vector<std::size_t>();
+    shadowed_map_t                  f_shadowed = shadowed_map_t();
+    std::size_t                     f_size = 0;
+    std::size_t                     f_prefix_count = 0;
+};
+
+
+bool address_match_ranges(addr_lpm_table const & table, addr const & address);
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
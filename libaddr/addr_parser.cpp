@@ -94,6 +94,8 @@
 //
 #include    "libaddr/addr_parser.h"
 #include    "libaddr/exception.h"
+#include    "libaddr/lookup_cache.h"
+#include    "libaddr/service_registry.h"
 
 
 // advgetopt
@@ -101,21 +103,38 @@
 #include    <advgetopt/validator_integer.h>
 
 
+// cppthread
+//
+#include    <cppthread/log.h>
+#include    <cppthread/runner.h>
+#include    <cppthread/thread.h>
+
+
 // snapdev
 //
+#include    <snapdev/raii_generic_deleter.h>
 #include    <snapdev/trim_string.h>
 
 
 // C++
 //
 #include    <algorithm>
+#include    <atomic>
+#include    <exception>
 #include    <iostream>
+#include    <map>
 
 
 // C
 //
+#include    <fcntl.h>
 #include    <ifaddrs.h>
 #include    <netdb.h>
+#include    <signal.h>
+#include    <string.h>
+#include    <sys/mman.h>
+#include    <sys/stat.h>
+#include    <unistd.h>
 
 
 // last include
@@ -132,6 +151,113 @@ namespace
 {
 
 
+/** \brief Size of the chunks read by the streaming parser.
+ *
+ * The parse_stream() function reads its input in chunks of this size.
+ */
+constexpr std::size_t const     STREAM_CHUNK_SIZE = 64 * 1024;
+
+
+/** \brief Minimum amount of input parsed by one thread.
+ *
+ * When parsing in parallel, the input is not broken up in chunks smaller
+ * than this size. Smaller inputs are parsed by fewer threads, possibly
+ * only the calling thread, since starting threads has a cost.
+ */
+constexpr std::size_t const     PARALLEL_CHUNK_MINIMUM_SIZE = 64 * 1024;
+
+
+/** \brief Run one job of a parallel parse.
+ *
+ * This runner executes one function in a separate thread. If the
+ * function raises an exception, it is saved so the calling thread
+ * can rethrow it once all the threads are done.
+ */
+class job_runner
+    : public cppthread::runner
+{
+public:
+    job_runner(std::function<void()> const & job)
+        : runner("addr_parser_job")
+        , f_job(job)
+    {
+    }
+
+    virtual void run() override
+    {
+        try
+        {
+            f_job();
+        }
+        catch(...)
+        {
+            f_exception = std::current_exception();
+        }
+    }
+
+    void rethrow() const
+    {
+        if(f_exception != nullptr)
+        {
+            std::rethrow_exception(f_exception);
+        }
+    }
+
+private:
+    std::function<void()>   f_job = std::function<void()>();
+    std::exception_ptr      f_exception = std::exception_ptr();
+};
+
+
+/** \brief Execute a set of jobs in parallel.
+ *
+ * This function runs each job in its own thread and waits for all of
+ * them to be done. The last job is executed by the calling thread.
+ * A job which thread cannot be started is also executed by the
+ * calling thread.
+ *
+ * If a job raised an exception, the exception of the first such job
+ * is rethrown once all the threads were stopped.
+ *
+ * \param[in] jobs  The jobs to execute.
+ */
+void run_jobs(std::vector<std::function<void()>> const & jobs)
+{
+    if(jobs.empty())
+    {
+        return;
+    }
+
+    std::vector<std::unique_ptr<job_runner>> runners;
+    std::vector<std::unique_ptr<cppthread::thread>> threads;
+    runners.reserve(jobs.size());
+    threads.reserve(jobs.size() - 1);
+    for(std::size_t idx(0); idx < jobs.size(); ++idx)
+    {
+        runners.push_back(std::make_unique<job_runner>(jobs[idx]));
+        if(idx + 1 < jobs.size())
+        {
+            threads.push_back(std::make_unique<cppthread::thread>("addr_parser_job", runners.back().get()));
+            if(!threads.back()->start())
+            {
+                threads.pop_back();
+                runners.back()->run();
+            }
+        }
+    }
+    runners.back()->run();
+
+    for(auto & t : threads)
+    {
+        t->stop();
+    }
+    for(auto const & r : runners)
+    {
+        r->rethrow();
+    }
+}
+
+
 /** \brief Delete an addrinfo structure.
  *
  * This deleter is used to make sure all the addinfo get released when
@@ -145,10 +271,480 @@ void addrinfo_deleter(addrinfo * ai)
 }
 
 
+/** \brief Convert a mask count to mask bits.
+ *
+ * This function clears the \p mask_count bits at the bottom of the
+ * \p mask_bits buffer which is expected to be all 1s on entry.
+ *
+ * \param[in,out] mask_bits  The 16 bytes of the mask.
+ * \param[in] mask_count  The number of bits to clear.
+ */
+void clear_mask_bits(std::uint8_t * mask_bits, int mask_count)
+{
+    int idx(15);
+    for(; mask_count > 8; mask_count -= 8, --idx)
+    {
+        mask_bits[idx] = 0;
+    }
+    mask_bits[idx] = 255 << mask_count;
+}
+
+
+/** \brief Parse a numeric IPv4 address.
+ *
+ * This function parses a dotted IPv4 address exactly like inet_pton()
+ * does: four decimal numbers from 0 to 255 without leading zeroes.
+ *
+ * \param[in] s  The start of the address.
+ * \param[in] e  The end of the address.
+ * \param[out] out  The 4 bytes of the address in network order.
+ *
+ * \return true if the whole input is a valid IPv4 address.
+ */
+bool parse_numeric_ipv4(char const * s, char const * e, std::uint8_t * out)
+{
+    int octets(0);
+    bool saw_digit(false);
+    unsigned int value(0);
+    for(; s < e; ++s)
+    {
+        char const c(*s);
+        if(c >= '0' && c <= '9')
+        {
+            if(saw_digit && value == 0)
+            {
+                return false;
+            }
+            value = value * 10 + c - '0';
+            if(value > 255)
+            {
+                return false;
+            }
+            if(!saw_digit)
+            {
+                ++octets;
+                if(octets > 4)
+                {
+                    return false;
+                }
+                saw_digit = true;
+            }
+        }
+        else if(c == '.' && saw_digit)
+        {
+            if(octets == 4)
+            {
+                return false;
+            }
+            out[octets - 1] = value;
+            value = 0;
+            saw_digit = false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if(octets < 4
+    || !saw_digit)
+    {
+        return false;
+    }
+    out[3] = value;
+    return true;
+}
+
+
+/** \brief Parse a numeric IPv6 address.
+ *
+ * This function parses an IPv6 address exactly like inet_pton() does,
+ * including the "::" and an IPv4 address in the last 32 bits.
+ *
+ * \param[in] s  The start of the address.
+ * \param[in] e  The end of the address.
+ * \param[out] out  The 16 bytes of the address in network order.
+ *
+ * \return true if the whole input is a valid IPv6 address.
+ */
+bool parse_numeric_ipv6(char const * s, char const * e, std::uint8_t * out)
+{
+    std::uint8_t tmp[16] = {};
+    std::uint8_t * tp(tmp);
+    std::uint8_t * const endp(tmp + 16);
+    std::uint8_t * colonp(nullptr);
+
+    if(s == e)
+    {
+        return false;
+    }
+    if(*s == ':')
+    {
+        ++s;
+        if(s == e
+        || *s != ':')
+        {
+            return false;
+        }
+    }
+
+    char const * token(s);
+    int digits(0);
+    unsigned int value(0);
+    while(s < e)
+    {
+        char const c(*s);
+        ++s;
+        int digit(-1);
+        if(c >= '0' && c <= '9')
+        {
+            digit = c - '0';
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            digit = c - 'a' + 10;
+        }
+        else if(c >= 'A' && c <= 'F')
+        {
+            digit = c - 'A' + 10;
+        }
+        if(digit >= 0)
+        {
+            if(digits == 4)
+            {
+                return false;
+            }
+            value = (value << 4) | digit;
+            ++digits;
+            continue;
+        }
+        if(c == ':')
+        {
+            token = s;
+            if(digits == 0)
+            {
+                if(colonp != nullptr)
+                {
+                    return false;
+                }
+                colonp = tp;
+                continue;
+            }
+            if(s == e
+            || tp + 2 > endp)
+            {
+                return false;
+            }
+            *tp++ = value >> 8;
+            *tp++ = value;
+            digits = 0;
+            value = 0;
+            continue;
+        }
+        if(c == '.'
+        && tp + 4 <= endp
+        && parse_numeric_ipv4(token, e, tp))
+        {
+            tp += 4;
+            digits = 0;
+            break;
+        }
+        return false;
+    }
+    if(digits > 0)
+    {
+        if(tp + 2 > endp)
+        {
+            return false;
+        }
+        *tp++ = value >> 8;
+        *tp++ = value;
+    }
+    if(colonp != nullptr)
+    {
+        if(tp == endp)
+        {
+            return false;
+        }
+        std::size_t const n(tp - colonp);
+        memmove(endp - n, colonp, n);
+        memset(colonp, 0, endp - n - colonp);
+        tp = endp;
+    }
+    if(tp != endp)
+    {
+        return false;
+    }
+    memcpy(out, tmp, 16);
+    return true;
+}
+
+
+/** \brief Parse a decimal number.
+ *
+ * This function parses a number of at most \p max_digits digits.
+ * The number must use the whole input.
+ *
+ * \param[in] s  The start of the number.
+ * \param[in] e  The end of the number.
+ * \param[in] max_digits  The maximum number of digits.
+ * \param[out] value  The resulting value.
+ *
+ * \return true if the input is a valid number.
+ */
+bool parse_numeric_decimal(char const * s, char const * e, int max_digits, int & value)
+{
+    if(s == e
+    || e - s > max_digits)
+    {
+        return false;
+    }
+    value = 0;
+    for(; s < e; ++s)
+    {
+        if(*s < '0' || *s > '9')
+        {
+            return false;
+        }
+        value = value * 10 + *s - '0';
+    }
+    return true;
+}
+
+
 }
 
 
 
+/** \brief A batch of address lookups.
+ *
+ * When the asynchronous lookup is turned on (see set_async_lookup()),
+ * the parser first goes through the input and gathers all the lookups
+ * in this batch instead of calling getaddrinfo(). The batch then
+ * resolves all the lookups at once with getaddrinfo_a(). Finally, the
+ * input is parsed a second time and the lookups are served from the
+ * batch so the results are in the same order as with the synchronous
+ * lookups. Numeric addresses are converted in the first pass. When that
+ * pass does not find any host name, its result is used as is and the
+ * second pass is skipped.
+ *
+ * Lookups found in the lookup_cache are not sent to getaddrinfo_a()
+ * and the new results are added to the cache.
+ *
+ * The same object is used by parse_async(), in which case the batch
+ * also holds a copy of the parser, the input, and the callback since
+ * the second pass happens once all the lookups are done.
+ *
+ * In that case, the batch is shared between parse_async() and the
+ * getaddrinfo_a() notification. When getaddrinfo_a() fails, we cannot
+ * know whether the notification will still happen so whichever side
+ * claims the batch first finishes it and the last one to release it
+ * deletes it. (If glibc cannot allocate its wait list, the notification
+ * never happens and the batch is not deleted, but the callback still
+ * gets called.)
+ */
+struct addr_parser::lookup_batch
+{
+    struct result_t
+    {
+        bool                        f_resolved = false;
+        int                         f_error = 0;
+        std::shared_ptr<addrinfo>   f_list = std::shared_ptr<addrinfo>();
+    };
+
+    typedef std::map<std::pair<std::string, std::string>, result_t>   results_t;
+
+    static bool is_numeric(std::string const & address)
+    {
+        // numeric addresses do not need a DNS server, the first pass
+        // converts them immediately
+        //
+        std::uint8_t buf[16];
+        char const * s(address.c_str());
+        char const * e(s + address.length());
+        return parse_numeric_ipv4(s, e, buf)
+            || parse_numeric_ipv6(s, e, buf);
+    }
+
+    void add(std::string const & address, std::string const & service, addrinfo const & hints)
+    {
+        f_hints = hints;
+        f_results.emplace(std::make_pair(address, service), result_t());
+    }
+
+    addr_range::vector_t collect(addr_parser & p, std::string const & in)
+    {
+        p.f_thread_count = 1;
+        p.f_lookup_batch = this;
+        addr_range::vector_t result;
+        try
+        {
+            result = p.parse(in);
+        }
+        catch(...)
+        {
+            p.f_lookup_batch = nullptr;
+            throw;
+        }
+        p.f_lookup_batch = nullptr;
+        f_collect = false;
+
+        f_pending.clear();
+        for(auto & r : f_results)
+        {
+            if(lookup_cache::find(
+                      r.first.first
+                    , r.first.second
+                    , f_hints
+                    , r.second.f_list
+                    , r.second.f_error))
+            {
+                r.second.f_resolved = true;
+            }
+            else
+            {
+                f_pending.push_back(&r);
+            }
+        }
+
+        return result;
+    }
+
+    int start(int mode, sigevent * sev)
+    {
+        f_requests.resize(f_pending.size());
+        f_list.clear();
+        f_list.reserve(f_pending.size());
+        for(std::size_t idx(0); idx < f_pending.size(); ++idx)
+        {
+            gaicb & req(f_requests[idx]);
+            req = gaicb();
+            req.ar_name = f_pending[idx]->first.first.c_str();
+            req.ar_service = f_pending[idx]->first.second.c_str();
+            req.ar_request = &f_hints;
+            f_list.push_back(&req);
+        }
+        return getaddrinfo_a(mode, f_list.data(), f_list.size(), sev);
+    }
+
+    void gather()
+    {
+        for(std::size_t idx(0); idx < f_pending.size(); ++idx)
+        {
+            auto & r(*f_pending[idx]);
+            gaicb & req(f_requests[idx]);
+
+            int e(gai_error(&req));
+            while(e == EAI_INPROGRESS)
+            {
+                gaicb const * wait[1] = { &req };
+                gai_suspend(wait, 1, nullptr);
+                e = gai_error(&req);
+            }
+
+            // a request which could not be queued looks like a success
+            // without a result; leave it to the synchronous getaddrinfo()
+            //
+            if(e != 0
+            || req.ar_result != nullptr)
+            {
+                r.second.f_resolved = true;
+                r.second.f_error = e;
+                if(req.ar_result != nullptr)
+                {
+                    r.second.f_list.reset(req.ar_result, addrinfo_deleter);
+                    req.ar_result = nullptr;
+                }
+                lookup_cache::insert(
+                          r.first.first
+                        , r.first.second
+                        , f_hints
+                        , r.second.f_list
+                        , e);
+            }
+        }
+    }
+
+    void resolve()
+    {
+        if(!f_pending.empty())
+        {
+            start(GAI_WAIT, nullptr);
+            gather();
+        }
+    }
+
+    void finish()
+    {
+        f_parser.f_lookup_batch = this;
+        addr_range::vector_t result;
+        try
+        {
+            result = f_parser.parse(f_input);
+        }
+        catch(...)
+        {
+            f_parser.f_lookup_batch = nullptr;
+            throw;
+        }
+        f_parser.f_lookup_batch = nullptr;
+        f_callback(result, f_parser);
+    }
+
+    bool claim()
+    {
+        return !f_claimed.exchange(true);
+    }
+
+    static void release(lookup_batch * batch)
+    {
+        if(--batch->f_references == 0)
+        {
+            delete batch;
+        }
+    }
+
+    static void done(sigval value)
+    {
+        lookup_batch * batch(static_cast<lookup_batch *>(value.sival_ptr));
+        if(batch->claim())
+        {
+            batch->gather();
+            try
+            {
+                batch->finish();
+            }
+            catch(std::exception const & e)
+            {
+                // this thread was created by getaddrinfo_a(), there is
+                // nobody to catch the exception
+                //
+                cppthread::log
+                    << cppthread::log_level_t::error
+                    << "addr_parser::parse_async() failed: "
+                    << e.what()
+                    << cppthread::end;
+            }
+        }
+        release(batch);
+    }
+
+    bool                    f_collect = true;
+    addrinfo                f_hints = addrinfo();
+    results_t               f_results = results_t();
+    std::vector<results_t::value_type *>
+                            f_pending = std::vector<results_t::value_type *>();
+    std::vector<gaicb>      f_requests = std::vector<gaicb>();
+    std::vector<gaicb *>    f_list = std::vector<gaicb *>();
+
+    // parse_async() only
+    //
+    addr_parser             f_parser = addr_parser();
+    std::string             f_input = std::string();
+    async_callback_t        f_callback = async_callback_t();
+    std::atomic<bool>       f_claimed = false;
+    std::atomic<int>        f_references = 2;
+};
+
 
 
 /** \brief Initialize an addr_parser object.
@@ -564,23 +1160,15 @@ std::string const & addr_parser::get_default_mask6() const
  */
 void addr_parser::set_protocol(std::string const & protocol)
 {
-    char buf[1024];
-    protoent p = {};
-    protoent * ptr(&p);
-    if(getprotobyname_r(
-              protocol.c_str()
-            , &p
-            , buf
-            , sizeof(buf)
-            , &ptr) != 0
-    || ptr == nullptr)
+    int const p(service_registry::get_protocol(protocol));
+    if(p == -1)
     {
         throw addr_invalid_argument(
                   "unknown protocol named \""
                 + protocol
                 + "\", expected \"tcp\" or \"udp\" or another name from /etc/protocols.");
     }
-    f_protocol = p.p_proto;
+    f_protocol = p;
 }
 
 
@@ -719,6 +1307,91 @@ sort_t addr_parser::get_sort_order() const
 }
 
 
+/** \brief Define the number of threads used to parse large inputs.
+ *
+ * By default, the parse() function parses its entire input in the
+ * calling thread. With this function you can ask the parser to break
+ * up large inputs in chunks, at entry separators, and parse them in
+ * parallel. The results are returned in the same order as with a single
+ * thread. The sort and merge (see set_sort_order()) also run in
+ * parallel.
+ *
+ * A \p count of 0 means that the number of available processors is
+ * used. A \p count of 1 (the default) turns off the parallel parsing.
+ *
+ * \note
+ * Only the parse() function working on a string makes use of threads.
+ * Also, the input must allow multiple addresses (see the
+ * ALLOW_MULTI_ADDRESSES_... flags) and be large enough for the threads
+ * to be useful.
+ *
+ * \param[in] count  The maximum number of threads to use.
+ *
+ * \sa get_thread_count()
+ */
+void addr_parser::set_thread_count(std::size_t count)
+{
+    if(count == 0)
+    {
+        count = std::max(1, cppthread::get_number_of_available_processors());
+    }
+    f_thread_count = count;
+}
+
+
+/** \brief Get the number of threads used to parse large inputs.
+ *
+ * This function returns the maximum number of threads the parse()
+ * function uses to parse its input. By default this is 1.
+ *
+ * \return The number of threads used by parse().
+ *
+ * \sa set_thread_count()
+ */
+std::size_t addr_parser::get_thread_count() const
+{
+    return f_thread_count;
+}
+
+
+/** \brief Resolve all the addresses of one input at once.
+ *
+ * By default, the parse() function calls getaddrinfo() for each address
+ * as it finds them in the input. With many host names, this means one
+ * round trip to the DNS server after the other.
+ *
+ * When this flag is set to true, parse() first gathers all the address
+ * lookups found in the input, then resolves all of them concurrently
+ * with getaddrinfo_a(), and finally assembles the results in the order
+ * of the input. The results are the same, only faster.
+ *
+ * This flag has no effect unless ALLOW_ADDRESS_LOOKUP is true.
+ *
+ * \param[in] async  Whether to resolve all the addresses at once.
+ *
+ * \sa get_async_lookup()
+ * \sa parse_async()
+ */
+void addr_parser::set_async_lookup(bool async)
+{
+    f_async_lookup = async;
+}
+
+
+/** \brief Check whether addresses get resolved all at once.
+ *
+ * This function returns the flag set by set_async_lookup().
+ *
+ * \return true if parse() resolves all the addresses at once.
+ *
+ * \sa set_async_lookup()
+ */
+bool addr_parser::get_async_lookup() const
+{
+    return f_async_lookup;
+}
+
+
 /** \brief Set or clear allow flags in the parser.
  *
  * This parser has a set of flags it uses to know whether the input
@@ -834,6 +1507,90 @@ bool addr_parser::get_allow(allow_t const flag) const
 }
 
 
+/** \brief Define how errors get saved.
+ *
+ * By default (ERROR_MODE_MESSAGES), each error is saved as a code in
+ * the errors() vector and as a human readable message in the
+ * error_messages() string.
+ *
+ * In ERROR_MODE_CODES, only the code and the position of the entry
+ * with the error are saved. This avoids formatting messages, which is
+ * much more expensive than the parsing itself, when most of the input
+ * is expected to be invalid. The messages can be generated later with
+ * error_to_string().
+ *
+ * Since the messages and codes of the existing errors would not match
+ * anymore, changing the mode clears the errors.
+ *
+ * \param[in] mode  The new error mode.
+ *
+ * \sa get_error_mode()
+ * \sa error_to_string()
+ */
+void addr_parser::set_error_mode(error_mode_t mode)
+{
+    if(mode != f_error_mode)
+    {
+        f_error_mode = mode;
+        clear_errors();
+    }
+}
+
+
+/** \brief Get the current error mode.
+ *
+ * This function returns the error mode as set by set_error_mode().
+ *
+ * \return The current error mode.
+ *
+ * \sa set_error_mode()
+ */
+error_mode_t addr_parser::get_error_mode() const
+{
+    return f_error_mode;
+}
+
+
+/** \brief Limit the number of errors saved in the parser.
+ *
+ * By default, all the errors are saved in the errors() vector and,
+ * in ERROR_MODE_MESSAGES, in the error_messages() string. When parsing
+ * a large stream (see parse_fd() and parse_file()) with many invalid
+ * entries, this means the memory used by the parser grows with the
+ * input.
+ *
+ * Once \p max errors were saved, the following errors are only counted:
+ * error_count() and has_errors() still include them but they do not
+ * appear in errors() or error_messages(). The number of such errors is
+ * error_count() minus the size of errors().
+ *
+ * A \p max of 0 (the default) means that there is no limit.
+ *
+ * \param[in] max  The maximum number of errors to save.
+ *
+ * \sa get_max_errors()
+ */
+void addr_parser::set_max_errors(std::size_t max)
+{
+    f_max_errors = max;
+}
+
+
+/** \brief Get the maximum number of errors saved in the parser.
+ *
+ * This function returns the limit set by set_max_errors(). By default
+ * this is 0, meaning that all the errors are saved.
+ *
+ * \return The maximum number of errors saved or 0.
+ *
+ * \sa set_max_errors()
+ */
+std::size_t addr_parser::get_max_errors() const
+{
+    return f_max_errors;
+}
+
+
 /** \brief Check whether errors were registered so far.
  *
  * This function returns true if the system detected errors in one
@@ -862,7 +1619,7 @@ bool addr_parser::get_allow(allow_t const flag) const
  */
 bool addr_parser::has_errors() const
 {
-    return !f_error.empty();
+    return f_error_count != 0;
 }
 
 
@@ -884,12 +1641,135 @@ bool addr_parser::has_errors() const
  */
 void addr_parser::emit_error(std::string const & msg)
 {
+    if(error_limit_reached())
+    {
+        return;
+    }
+    f_errors.push_back({ parser_error_t::PARSER_ERROR_OTHER, f_entry_offset, f_entry_length });
+    emit_error_message(msg);
+}
+
+
+/** \brief Count the errors beyond the limit.
+ *
+ * When the number of saved errors reached the limit set with
+ * set_max_errors(), this function increments the error counter and
+ * returns true. The caller then drops the error.
+ *
+ * \return true if the error must not be saved.
+ */
+bool addr_parser::error_limit_reached()
+{
+    if(f_max_errors == 0
+    || f_errors.size() < f_max_errors)
+    {
+        return false;
+    }
+    ++f_error_count;
+    return true;
+}
+
+
+/** \brief Record an error and check whether its message is wanted.
+ *
+ * This function saves the error \p code along with the position of the
+ * entry being parsed in the list of errors (see errors()).
+ *
+ * In ERROR_MODE_MESSAGES, the function returns true and the caller is
+ * expected to call emit_error_message() with the corresponding message.
+ * In ERROR_MODE_CODES, the error counter is incremented here and the
+ * function returns false so the message does not even get formatted.
+ * The same happens in both modes once the limit of errors is reached
+ * (see set_max_errors()), except that the error is not saved either.
+ *
+ * \param[in] code  The code of the error.
+ *
+ * \return true if the caller has to emit the error message.
+ */
+bool addr_parser::want_error_message(parser_error_t code)
+{
+    if(error_limit_reached())
+    {
+        return false;
+    }
+    f_errors.push_back({ code, f_entry_offset, f_entry_length });
+    if(f_error_mode == error_mode_t::ERROR_MODE_CODES)
+    {
+        ++f_error_count;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief Add an error message.
+ *
+ * This function appends \p msg to the error messages and increments
+ * the error counter. It is the second half of emit_error() which also
+ * records the PARSER_ERROR_OTHER code.
+ *
+ * The position of the message is saved in the last error so the
+ * error_to_string() function can find it even if the message includes
+ * newline characters.
+ *
+ * \param[in] msg  The message to add to the parser error messages.
+ */
+void addr_parser::emit_error_message(std::string const & msg)
+{
+    parser_error & e(f_errors.back());
+    e.f_message_offset = f_error.length();
+    e.f_message_length = msg.length();
     f_error += msg;
     f_error += "\n";
     ++f_error_count;
 }
 
 
+/** \brief Append the errors of another parser to this parser.
+ *
+ * This function is used to gather the errors of the parsers used
+ * internally (i.e. one per thread) in this parser. The positions of
+ * the messages are adjusted to their new position.
+ *
+ * The errors beyond the limit set with set_max_errors() are only
+ * counted.
+ *
+ * \param[in] p  The parser with the errors to append.
+ */
+void addr_parser::append_errors(addr_parser const & p)
+{
+    std::size_t keep(p.f_errors.size());
+    if(f_max_errors != 0)
+    {
+        keep = std::min(keep, f_max_errors - std::min(f_max_errors, f_errors.size()));
+    }
+
+    // the messages are in the same order as the errors so the messages
+    // to keep end where the first dropped message starts
+    //
+    std::size_t message_length(p.f_error.length());
+    for(std::size_t j(keep); j < p.f_errors.size(); ++j)
+    {
+        if(f_error_mode == error_mode_t::ERROR_MODE_MESSAGES
+        || p.f_errors[j].f_code == parser_error_t::PARSER_ERROR_OTHER)
+        {
+            message_length = p.f_errors[j].f_message_offset;
+            break;
+        }
+    }
+
+    std::size_t const message_offset(f_error.length());
+    std::size_t const idx(f_errors.size());
+    f_error.append(p.f_error, 0, message_length);
+    f_error_count += p.f_error_count;
+    f_errors.insert(f_errors.end(), p.f_errors.begin(), p.f_errors.begin() + keep);
+    for(auto it(f_errors.begin() + idx); it != f_errors.end(); ++it)
+    {
+        it->f_message_offset += message_offset;
+    }
+}
+
+
 /** \brief Return the current error messages.
  *
  * The error messages are added to the addr_parser using the
@@ -903,6 +1783,10 @@ void addr_parser::emit_error(std::string const & msg)
  * will return that same number (assuming no message included
  * a '\n' character when emit_error() was called.)
  *
+ * In ERROR_MODE_CODES, the parser does not generate messages so this
+ * string only includes the messages passed to emit_error(). Use the
+ * error_to_string() function to get the messages on demand.
+ *
  * \return A string with the list of messages.
  *
  * \sa emit_error()
@@ -933,9 +1817,125 @@ int addr_parser::error_count() const
 }
 
 
+/** \brief Get the list of errors.
+ *
+ * This function returns the errors that occurred since the start or
+ * the last clear_errors() call. Each error includes a code and the
+ * position and length of the entry which generated the error within
+ * the input given to the parse function.
+ *
+ * These are available in both error modes. Errors emitted with
+ * emit_error() use the PARSER_ERROR_OTHER code.
+ *
+ * \return A reference to the vector of errors.
+ *
+ * \sa error_to_string()
+ */
+parser_error::vector_t const & addr_parser::errors() const
+{
+    return f_errors;
+}
+
+
+/** \brief Get the message of one error.
+ *
+ * This function returns the human readable message of the error number
+ * \p idx in the errors() vector.
+ *
+ * In ERROR_MODE_MESSAGES, the message is taken from the error_messages()
+ * string. In ERROR_MODE_CODES, the message is generated by parsing the
+ * entry again with a copy of this parser; this is why the function
+ * needs the same input \p in as was given to the parse function. Note
+ * that if lookups are allowed, the entry may be looked up again.
+ *
+ * \exception out_of_range
+ * The \p idx parameter must be smaller than the number of errors.
+ *
+ * \param[in] idx  The index of the error to convert.
+ * \param[in] in  The input which was given to the parse function.
+ *
+ * \return The error message, without a newline.
+ *
+ * \sa set_error_mode()
+ */
+std::string addr_parser::error_to_string(std::size_t idx, std::string_view const & in) const
+{
+    if(idx >= f_errors.size())
+    {
+        throw out_of_range(
+                  "error index "
+                + std::to_string(idx)
+                + " is out of range, expected less than "
+                + std::to_string(f_errors.size())
+                + ".");
+    }
+
+    parser_error const & e(f_errors[idx]);
+    if(f_error_mode == error_mode_t::ERROR_MODE_MESSAGES
+    || e.f_code == parser_error_t::PARSER_ERROR_OTHER)
+    {
+        // in ERROR_MODE_CODES, only the emit_error() messages are saved
+        //
+        return f_error.substr(e.f_message_offset, e.f_message_length);
+    }
+
+    switch(e.f_code)
+    {
+    case parser_error_t::PARSER_ERROR_OPEN_FILE:
+        return "Could not open the input file for reading.";
+
+    case parser_error_t::PARSER_ERROR_IO:
+        return "I/O error while reading addresses.";
+
+    default:
+        break;
+
+    }
+
+    if(e.f_offset > in.length()
+    || e.f_length > in.length() - e.f_offset)
+    {
+        throw out_of_range("the error entry is outside of the specified input.");
+    }
+    std::string_view const entry(in.substr(e.f_offset, e.f_length));
+
+    // one entry may generate several errors, find which one this is
+    //
+    std::size_t const nth(std::count_if(
+              f_errors.begin()
+            , f_errors.begin() + idx
+            , [&e](auto const & other)
+            {
+                return other.f_code == e.f_code
+                    && other.f_offset == e.f_offset
+                    && other.f_length == e.f_length;
+            }));
+
+    addr_parser p(*this);
+    p.f_error_mode = error_mode_t::ERROR_MODE_MESSAGES;
+    p.clear_errors();
+    addr_range::vector_t result;
+    p.parse_entries(entry, 0, std::string(), result, range_callback_t());
+    std::size_t found(0);
+    for(std::size_t j(0); j < p.f_errors.size(); ++j)
+    {
+        if(p.f_errors[j].f_code == e.f_code)
+        {
+            if(found == nth)
+            {
+                return p.f_error.substr(p.f_errors[j].f_message_offset, p.f_errors[j].f_message_length);
+            }
+            ++found;
+        }
+    }
+
+    return "Invalid entry \"" + std::string(entry) + "\".";
+}
+
+
 /** \brief Clear the error message and error counter.
  *
- * This function clears all the error messages and reset the
+ * This function clears all the error messages and codes and reset the
  * counter back to zero. In order words, it will be possible
  * to tell how many times the emit_error() was called since
  * the start or the last clear_errors() call.
@@ -949,6 +1949,7 @@ void addr_parser::clear_errors()
 {
     f_error.clear();
     f_error_count = 0;
+    f_errors.clear();
 }
 
 
@@ -1033,127 +2034,936 @@ void addr_parser::clear_errors()
  */
 addr_range::vector_t addr_parser::parse(std::string const & in)
 {
-    addr_range::vector_t result;
-
-    std::string separators;
-    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_COMMAS))
+    addr_range::vector_t result;
+
+    if(f_async_lookup
+    && f_lookup_batch == nullptr
+    && get_allow(allow_t::ALLOW_ADDRESS_LOOKUP))
+    {
+        lookup_batch batch;
+        addr_parser p(*this);
+        p.clear_errors();
+        result = batch.collect(p, in);
+        if(batch.f_results.empty())
+        {
+            // no host names, the first pass is the final result
+            //
+            append_errors(p);
+            return result;
+        }
+        result.clear();
+        batch.resolve();
+
+        f_lookup_batch = &batch;
+        try
+        {
+            result = parse(in);
+        }
+        catch(...)
+        {
+            f_lookup_batch = nullptr;
+            throw;
+        }
+        f_lookup_batch = nullptr;
+
+        return result;
+    }
+
+    std::string const separators(get_separators());
+    std::size_t const thread_count(separators.empty()
+            ? 1
+            : std::min(f_thread_count, in.length() / PARALLEL_CHUNK_MINIMUM_SIZE));
+    if(thread_count > 1)
+    {
+        parse_parallel(in, separators, thread_count, result);
+    }
+    else
+    {
+        parse_entries(in, 0, separators, result, range_callback_t());
+    }
+
+    sort_ranges(result);
+
+    return result;
+}
+
+
+/** \brief Sort the ranges as defined by the sort order.
+ *
+ * This function applies the sort order (see set_sort_order()) to the
+ * \p result vector: a normal sort or a sort and merge, and then the
+ * IPv4 or IPv6 addresses are moved first.
+ *
+ * When the input is already sorted (i.e. it was sorted by
+ * parse_parallel()) the sort itself is skipped.
+ *
+ * \param[in,out] result  The ranges to sort.
+ */
+void addr_parser::sort_ranges(addr_range::vector_t & result) const
+{
+    // run a normal sort or a sort + merge if requested
+    //
+    if((f_sort & SORT_MERGE) != 0)
+    {
+        normalize_ranges(result);
+    }
+    else if((f_sort & SORT_FULL) != 0
+         && !std::is_sorted(result.begin(), result.end()))
+    {
+        std::stable_sort(result.begin(), result.end());
+    }
+
+    // move IPv4 or IPv6 first (should be IPv6 in newer systems)
+    //
+    if((f_sort & SORT_IPV4_FIRST) != 0)
+    {
+        std::stable_sort(
+              result.begin()
+            , result.end()
+            , [](auto const & a, auto const & b)
+            {
+                switch(a.compare(b))
+                {
+                case compare_t::COMPARE_IPV4_VS_IPV6:
+                case compare_t::COMPARE_FIRST:
+                    return true;
+
+                default:
+                    return false;
+
+                }
+            });
+    }
+    else if((f_sort & SORT_IPV6_FIRST) != 0)
+    {
+        std::stable_sort(
+              result.begin()
+            , result.end()
+            , [](auto const & a, auto const & b)
+            {
+                switch(a.compare(b))
+                {
+                case compare_t::COMPARE_IPV6_VS_IPV4:
+                case compare_t::COMPARE_FIRST:
+                    return true;
+
+                default:
+                    return false;
+
+                }
+            });
+    }
+}
+
+
+/** \brief Parse a stream of addresses, one entry at a time.
+ *
+ * This function reads the input stream \p in in chunks and parses the
+ * addresses found in it. Each resulting range is sent to the \p callback
+ * function as soon as its entry was parsed, so the amount of memory used
+ * remains constant whatever the size of the input.
+ *
+ * The entries are separated and commented as defined by the
+ * ALLOW_MULTI_ADDRESSES_COMMAS, ALLOW_MULTI_ADDRESSES_SPACES,
+ * ALLOW_MULTI_ADDRESSES_NEWLINES, ALLOW_COMMENT_HASH, and
+ * ALLOW_COMMENT_SEMICOLON flags, exactly like the parse() function
+ * taking a string. When none of the ALLOW_MULTI_ADDRESSES_... flags
+ * are set, the whole input is one entry and it gets buffered.
+ *
+ * Since the ranges are not kept, the sort order (see set_sort_order())
+ * is ignored by this function. If you need sorted results, push the
+ * ranges in a vector and sort (or normalize_ranges()) it afterward.
+ *
+ * Errors are reported as usual, see has_errors(). They are all saved
+ * in the parser unless you limit their number with set_max_errors().
+ *
+ * \param[in] in  The input stream to parse.
+ * \param[in] callback  The function called with each parsed range. It
+ * returns false to stop the parsing early.
+ *
+ * \return true if the entire input was parsed, false if the callback
+ * stopped the process or a read error occurred.
+ *
+ * \sa parse_fd()
+ * \sa parse_file()
+ */
+bool addr_parser::parse(std::istream & in, range_callback_t const & callback)
+{
+    return parse_stream(
+          [&in](char * buffer, std::size_t size) -> ssize_t
+          {
+              in.read(buffer, size);
+              if(in.bad())
+              {
+                  return -1;
+              }
+              return in.gcount();
+          }
+        , callback);
+}
+
+
+/** \brief Parse addresses read from a file descriptor.
+ *
+ * This function works like the parse() function taking an input stream,
+ * only it reads the data from the file descriptor \p fd. This is useful
+ * for pipes and sockets. The function reads until the end of the file
+ * is reached. The file descriptor is not closed.
+ *
+ * \param[in] fd  The file descriptor to read from.
+ * \param[in] callback  The function called with each parsed range.
+ *
+ * \return true if the entire input was parsed, false if the callback
+ * stopped the process or a read error occurred.
+ *
+ * \sa parse(std::istream & in, range_callback_t const & callback)
+ */
+bool addr_parser::parse_fd(int fd, range_callback_t const & callback)
+{
+    return parse_stream(
+          [fd](char * buffer, std::size_t size) -> ssize_t
+          {
+              for(;;)
+              {
+                  ssize_t const r(::read(fd, buffer, size));
+                  if(r >= 0
+                  || errno != EINTR)
+                  {
+                      return r;
+                  }
+              }
+          }
+        , callback);
+}
+
+
+/** \brief Parse the addresses found in a file.
+ *
+ * This function memory maps the file named \p filename and parses its
+ * content. The entries are parsed directly from the mapped pages, no
+ * copy of the file is made. The pages are mapped with a sequential
+ * access advice so the kernel can drop them once parsed.
+ *
+ * If the file is not a regular file (i.e. a FIFO or a character device)
+ * then the function falls back to reading it with parse_fd().
+ *
+ * \param[in] filename  The name of the file to parse.
+ * \param[in] callback  The function called with each parsed range.
+ *
+ * \return true if the entire file was parsed, false if the file could
+ * not be opened, the callback stopped the process, or a read error
+ * occurred.
+ *
+ * \sa parse(std::istream & in, range_callback_t const & callback)
+ */
+bool addr_parser::parse_file(std::string const & filename, range_callback_t const & callback)
+{
+    snapdev::raii_fd_t fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd == nullptr)
+    {
+        f_entry_offset = 0;
+        f_entry_length = 0;
+        if(want_error_message(parser_error_t::PARSER_ERROR_OPEN_FILE))
+        {
+            emit_error_message("Could not open \""
+                             + filename
+                             + "\" for reading ("
+                             + strerror(errno)
+                             + ").");
+        }
+        return false;
+    }
+
+    struct stat st = {};
+    if(fstat(fd.get(), &st) != 0
+    || !S_ISREG(st.st_mode))
+    {
+        return parse_fd(fd.get(), callback);
+    }
+
+    std::size_t const size(st.st_size);
+    void * data(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0));
+    if(data == MAP_FAILED)
+    {
+        // this includes empty files
+        //
+        return parse_fd(fd.get(), callback);
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    addr_range::vector_t result;
+    bool const r(parse_entries(
+              std::string_view(static_cast<char const *>(data), size)
+            , 0
+            , get_separators()
+            , result
+            , callback));
+
+    munmap(data, size);
+
+    return r;
+}
+
+
+/** \brief Parse the input using multiple threads.
+ *
+ * This function breaks up the input \p in in \p thread_count chunks of
+ * about the same size. The chunks are cut right after a separator so
+ * each entry is parsed as a whole by exactly one thread.
+ *
+ * Each thread uses its own copy of this parser so the error messages
+ * do not get mixed up. Once all the threads are done, the results and
+ * the errors are concatenated in the order of the input.
+ *
+ * When a sort is requested, each thread first sorts (and merges) its
+ * own results. The sorted runs are then merged by pairs, in parallel,
+ * until only one run remains. The caller, parse(), then only has to
+ * merge ranges overlapping between runs since the input is sorted.
+ *
+ * \param[in] in  The input to parse.
+ * \param[in] separators  The characters separating entries.
+ * \param[in] thread_count  The number of chunks to create.
+ * \param[out] result  The vector receiving the ranges.
+ */
+void addr_parser::parse_parallel(
+      std::string_view const & in
+    , std::string const & separators
+    , std::size_t thread_count
+    , addr_range::vector_t & result)
+{
+    std::vector<std::string_view::size_type> boundaries;
+    boundaries.reserve(thread_count + 1);
+    boundaries.push_back(0);
+    for(std::size_t idx(1); idx < thread_count; ++idx)
+    {
+        std::string_view::size_type const pos(std::max(
+                  in.length() / thread_count * idx
+                , boundaries.back()));
+        std::string_view::size_type const e(in.find_first_of(separators, pos));
+        if(e == std::string_view::npos)
+        {
+            break;
+        }
+        boundaries.push_back(e + 1);
+    }
+    boundaries.push_back(in.length());
+
+    std::size_t const count(boundaries.size() - 1);
+    addr_parser this_parser(*this);
+    this_parser.clear_errors();
+    std::vector<addr_parser> parsers(count, this_parser);
+    std::vector<addr_range::vector_t> results(count);
+    std::vector<std::function<void()>> jobs;
+    jobs.reserve(count);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        jobs.push_back([&, idx]()
+            {
+                parsers[idx].parse_entries(
+                          in.substr(boundaries[idx], boundaries[idx + 1] - boundaries[idx])
+                        , boundaries[idx]
+                        , separators
+                        , results[idx]
+                        , range_callback_t());
+
+                if((f_sort & SORT_MERGE) != 0)
+                {
+                    normalize_ranges(results[idx]);
+                }
+                else if((f_sort & SORT_FULL) != 0)
+                {
+                    std::stable_sort(results[idx].begin(), results[idx].end());
+                }
+            });
+    }
+    run_jobs(jobs);
+
+    // concatenate the results and errors in order
+    //
+    std::size_t total(0);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        total += results[idx].size();
+        append_errors(parsers[idx]);
+    }
+    result.reserve(result.size() + total);
+    std::vector<std::size_t> runs;
+    runs.reserve(count + 1);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        runs.push_back(result.size());
+        result.insert(result.end(), results[idx].begin(), results[idx].end());
+        addr_range::vector_t().swap(results[idx]);
+    }
+    runs.push_back(result.size());
+
+    if((f_sort & (SORT_MERGE | SORT_FULL)) == 0)
+    {
+        return;
+    }
+
+    // merge the sorted runs two by two, std::inplace_merge() is stable
+    // so the result is the same as one std::stable_sort()
+    //
+    while(runs.size() > 2)
+    {
+        std::vector<std::size_t> next;
+        next.reserve(runs.size() / 2 + 2);
+        jobs.clear();
+        std::size_t idx(0);
+        for(; idx + 2 < runs.size(); idx += 2)
+        {
+            std::size_t const first(runs[idx]);
+            std::size_t const middle(runs[idx + 1]);
+            std::size_t const last(runs[idx + 2]);
+            jobs.push_back([&result, first, middle, last]()
+                {
+                    std::inplace_merge(
+                              result.begin() + first
+                            , result.begin() + middle
+                            , result.begin() + last);
+                });
+            next.push_back(first);
+        }
+        if(idx + 1 < runs.size())
+        {
+            // odd number of runs, the last one is kept as is
+            //
+            next.push_back(runs[idx]);
+        }
+        next.push_back(runs.back());
+        run_jobs(jobs);
+        runs.swap(next);
+    }
+}
+
+
+/** \brief Parse the input without blocking on address lookups.
+ *
+ * This function parses \p in like parse() and calls \p callback with
+ * the results. The address lookups are done with getaddrinfo_a() so
+ * the function returns immediately and the calling thread (i.e. an
+ * event loop) is never blocked waiting on a DNS server.
+ *
+ * The \p callback is called from a thread created by getaddrinfo_a()
+ * once all the lookups are done. When no lookups are required (i.e.
+ * ALLOW_ADDRESS_LOOKUP is false, the input is empty, or all the names
+ * are found in the lookup_cache), the callback is called immediately,
+ * from the calling thread. The callback is also called from the calling
+ * thread, once the lookups are done, if getaddrinfo_a() fails to queue
+ * them.
+ *
+ * The callback receives the resulting ranges and a copy of this parser
+ * which holds the errors, if any, of this parse. This parser is not
+ * modified so it can be reused right away.
+ *
+ * \note
+ * The parsing itself, as opposed to the lookups, still happens in
+ * the calling thread (to find the host names) and then in the
+ * callback thread (to assemble the results).
+ *
+ * \param[in] in  The input to parse.
+ * \param[in] callback  The function called with the results.
+ *
+ * \sa set_async_lookup()
+ */
+void addr_parser::parse_async(std::string const & in, async_callback_t const & callback) const
+{
+    std::unique_ptr<lookup_batch> batch(std::make_unique<lookup_batch>());
+    batch->f_parser = *this;
+    batch->f_parser.clear_errors();
+    batch->f_input = in;
+    batch->f_callback = callback;
+
+    if(get_allow(allow_t::ALLOW_ADDRESS_LOOKUP))
+    {
+        addr_parser p(batch->f_parser);
+        addr_range::vector_t const result(batch->collect(p, in));
+        if(batch->f_results.empty())
+        {
+            // no host names, the first pass is the final result
+            //
+            p.f_thread_count = f_thread_count;
+            callback(result, p);
+            return;
+        }
+    }
+    else
+    {
+        batch->f_collect = false;
+    }
+    if(batch->f_pending.empty())
+    {
+        batch->finish();
+        return;
+    }
+
+    // once all the requests are done, getaddrinfo_a() calls done()
+    // from a new thread; the batch is shared with that thread
+    //
+    sigevent sev = {};
+    sev.sigev_notify = SIGEV_THREAD;
+    sev.sigev_notify_function = &lookup_batch::done;
+    sev.sigev_value.sival_ptr = batch.get();
+    lookup_batch * b(batch.release());
+    if(b->start(GAI_NOWAIT, &sev) != 0
+    && b->claim())
+    {
+        // getaddrinfo_a() could not queue all the requests (EAI_AGAIN),
+        // wait for the ones which were queued and finish here; the
+        // requests which were not queued are resolved synchronously
+        //
+        try
+        {
+            b->gather();
+            b->finish();
+        }
+        catch(...)
+        {
+            lookup_batch::release(b);
+            throw;
+        }
+    }
+    lookup_batch::release(b);
+}
+
+
+/** \brief Freeze the parser configuration in a plan.
+ *
+ * This function creates an immutable addr_parser::plan from the current
+ * configuration of this parser. The plan can be used by many threads
+ * at the same time and parses std::string_view input without creating
+ * intermediate strings.
+ *
+ * Changes made to this parser after the call do not affect the plan.
+ *
+ * \return A plan with a copy of this parser configuration.
+ *
+ * \sa addr_parser::plan
+ */
+addr_parser::plan addr_parser::freeze() const
+{
+    return plan(*this);
+}
+
+
+/** \brief Get the list of separators between entries.
+ *
+ * This function returns the list of characters that separate multiple
+ * entries as defined by the ALLOW_MULTI_ADDRESSES_... flags.
+ *
+ * \return The separators, an empty string if only one entry is allowed.
+ */
+std::string addr_parser::get_separators() const
+{
+    std::string separators;
+    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_COMMAS))
+    {
+        separators += ',';
+    }
+    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_SPACES))
+    {
+        separators += ' ';
+    }
+    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES))
+    {
+        separators += '\n';
+    }
+    return separators;
+}
+
+
+/** \brief Parse the entries found in a buffer.
+ *
+ * This function breaks up the input \p in in entries using the
+ * \p separators and parses each one of them. Commented out entries
+ * are skipped.
+ *
+ * When \p callback is set, the ranges found in each entry are sent to
+ * the callback and then removed from \p result. Otherwise the ranges
+ * accumulate in \p result.
+ *
+ * The \p offset is the position of \p in in the whole input. It is used
+ * to compute the position of the entries saved with the errors.
+ *
+ * \param[in] in  The input to parse.
+ * \param[in] offset  The position of \p in in the input.
+ * \param[in] separators  The characters separating entries.
+ * \param[in,out] result  The vector receiving the ranges.
+ * \param[in] callback  The callback to send ranges to, may be empty.
+ *
+ * \return false if the callback returned false, true otherwise.
+ *
+ * \sa errors()
+ */
+bool addr_parser::parse_entries(
+      std::string_view const & in
+    , std::size_t offset
+    , std::string const & separators
+    , addr_range::vector_t & result
+    , range_callback_t const & callback)
+{
+    auto flush = [&result, &callback]()
+    {
+        if(callback == nullptr)
+        {
+            return true;
+        }
+        bool r(true);
+        for(auto const & range : result)
+        {
+            if(!callback(range))
+            {
+                r = false;
+                break;
+            }
+        }
+        result.clear();
+        return r;
+    };
+
+    // when no lookup is allowed, most entries are expected to be simple
+    // numeric addresses which we can parse without any copies
+    //
+    bool const numeric(!get_allow(allow_t::ALLOW_ADDRESS_LOOKUP));
+
+    if(separators.empty())
+    {
+        f_entry_offset = offset;
+        f_entry_length = in.length();
+        if(!numeric
+        || !parse_numeric(in, result))
+        {
+            parse_cidr(std::string(in), result);
+        }
+        return flush();
+    }
+
+    std::string const comment_chars(
+              std::string(get_allow(allow_t::ALLOW_COMMENT_HASH) ? "#" : "")
+            + (get_allow(allow_t::ALLOW_COMMENT_SEMICOLON) ? ";" : ""));
+
+    std::string_view::size_type s(0);
+    while(s < in.length())
+    {
+        auto const it(std::find_first_of(in.begin() + s, in.end(), separators.begin(), separators.end()));
+        std::string_view::size_type const e(it - in.begin());
+        if(e > s
+        && (!get_allow(allow_t::ALLOW_COMMENT_HASH)      || in[s] != '#')    // commented out line?
+        && (!get_allow(allow_t::ALLOW_COMMENT_SEMICOLON) || in[s] != ';'))   // commented out line?
+        {
+            std::string_view::size_type ec(e);
+            if(!comment_chars.empty())
+            {
+                auto const comment(std::find_first_of(in.begin() + s, in.begin() + ec, comment_chars.begin(), comment_chars.end()));
+                if(comment != in.begin() + ec)
+                {
+                    ec = comment - in.begin();
+                }
+            }
+            std::string_view const entry(in.data() + s, ec - s);
+            f_entry_offset = offset + s;
+            f_entry_length = entry.length();
+            if(!numeric
+            || !parse_numeric(entry, result))
+            {
+                parse_cidr(std::string(entry), result);
+            }
+            if(!flush())
+            {
+                return false;
+            }
+        }
+        s = e + 1;
+    }
+
+    return true;
+}
+
+
+/** \brief Parse the data returned by a reader.
+ *
+ * This function reads the input in chunks of STREAM_CHUNK_SIZE bytes.
+ * Only complete entries (i.e. ending with a separator) get parsed; the
+ * last partial entry of a chunk is kept for the next iteration. So the
+ * buffer never grows beyond one chunk plus the longest entry.
+ *
+ * \param[in] reader  The function used to read the next chunk of data.
+ * It returns 0 on end of file and -1 on errors.
+ * \param[in] callback  The function called with each parsed range.
+ *
+ * \return true if the entire input was parsed.
+ */
+bool addr_parser::parse_stream(reader_t const & reader, range_callback_t const & callback)
+{
+    std::string const separators(get_separators());
+    addr_range::vector_t result;
+    std::string buffer;
+    std::size_t offset(0);
+    for(;;)
+    {
+        std::size_t const used(buffer.length());
+        buffer.resize(used + STREAM_CHUNK_SIZE);
+        ssize_t const r(reader(buffer.data() + used, STREAM_CHUNK_SIZE));
+        if(r < 0)
+        {
+            f_entry_offset = offset + used;
+            f_entry_length = 0;
+            if(want_error_message(parser_error_t::PARSER_ERROR_IO))
+            {
+                emit_error_message("I/O error while reading addresses.");
+            }
+            return false;
+        }
+        buffer.resize(used + r);
+        if(r == 0)
+        {
+            break;
+        }
+
+        if(separators.empty())
+        {
+            // without separators the whole input is one entry
+            //
+            continue;
+        }
+
+        std::string::size_type const last(buffer.find_last_of(separators));
+        if(last == std::string::npos)
+        {
+            continue;
+        }
+        if(!parse_entries(
+                  std::string_view(buffer.data(), last + 1)
+                , offset
+                , separators
+                , result
+                , callback))
+        {
+            return false;
+        }
+        buffer.erase(0, last + 1);
+        offset += last + 1;
+    }
+
+    return parse_entries(buffer, offset, separators, result, callback);
+}
+
+
+/** \brief Parse a numeric address in one pass.
+ *
+ * This function is a fast path used when DNS lookups are not allowed.
+ * It parses the most common forms of numeric addresses:
+ *
+ * \code
+ *     <ipv4> [ ':' <port> ] [ '/' <mask> ]
+ *     '[' <ipv6> ']' [ ':' <port> ] [ '/' <mask> ]
+ *     <ipv6> [ '/' <mask> ]
+ * \endcode
+ *
+ * where the port and mask are decimal numbers. The input is scanned once
+ * and the address gets created directly, without any intermediate string.
+ *
+ * Anything else (empty address, range, spaces, address like mask, default
+ * mask, invalid input, etc.) makes the function return false without
+ * changing \p result. The caller then uses the slower parse_cidr() which
+ * supports all the other cases and generates the errors.
+ *
+ * \param[in] in  The address to parse.
+ * \param[in,out] result  The list of resulting addresses.
+ *
+ * \return true if the address was parsed and added to \p result.
+ */
+bool addr_parser::parse_numeric(std::string_view const & in, addr_range::vector_t & result) const
+{
+    char const * s(in.data());
+    char const * const e(s + in.length());
+    if(s == e)
     {
-        separators += ',';
+        return false;
     }
-    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_SPACES))
+
+    bool const port_allowed(get_allow(allow_t::ALLOW_PORT)
+                         || get_allow(allow_t::ALLOW_REQUIRED_PORT));
+
+    // find the address, port, and mask boundaries
+    //
+    char const * address_start(s);
+    char const * address_end(nullptr);
+    bool ipv4_syntax(false);
+    if(*s == '[')
     {
-        separators += ' ';
+        ++address_start;
+        address_end = std::find(address_start, e, ']');
+        if(address_end == e)
+        {
+            return false;
+        }
+        s = address_end + 1;
     }
-    if(get_allow(allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES))
+    else
     {
-        separators += '\n';
+        std::size_t colons(0);
+        for(; s < e && *s != '/'; ++s)
+        {
+            if(*s == ':')
+            {
+                ++colons;
+            }
+        }
+        if(colons >= 2)
+        {
+            // IPv6 without brackets cannot have a port
+            //
+            address_end = s;
+        }
+        else
+        {
+            ipv4_syntax = true;
+            address_end = std::find(address_start, s, ':');
+            s = address_end;
+        }
     }
 
-    if(separators.empty())
+    char const * port_start(nullptr);
+    char const * port_end(nullptr);
+    if(s < e && *s == ':')
     {
-        parse_cidr(in, result);
+        if(!port_allowed)
+        {
+            return false;
+        }
+        port_start = s + 1;
+        port_end = std::find(port_start, e, '/');
+        s = port_end;
     }
-    else
+
+    char const * mask_start(nullptr);
+    if(s < e)
     {
-        std::string::size_type s(0);
-        while(s < in.length())
+        if(*s != '/'
+        || !get_allow(allow_t::ALLOW_MASK))
         {
-            auto const it(std::find_first_of(in.begin() + s, in.end(), separators.begin(), separators.end()));
-            std::string::size_type const e(it - in.begin());
-            if(e > s
-            && (!get_allow(allow_t::ALLOW_COMMENT_HASH)      || in[s] != '#')    // commented out line?
-            && (!get_allow(allow_t::ALLOW_COMMENT_SEMICOLON) || in[s] != ';'))   // commented out line?
-            {
-                std::string::size_type ec(e);
-                if(get_allow(allow_t::ALLOW_COMMENT_HASH)
-                || get_allow(allow_t::ALLOW_COMMENT_SEMICOLON))
-                {
-                    std::string const comment_chars(
-                              std::string(get_allow(allow_t::ALLOW_COMMENT_HASH) ? "#" : "")
-                            + (get_allow(allow_t::ALLOW_COMMENT_SEMICOLON) ? ";" : ""));
-                    auto const comment(std::find_first_of(in.begin() + s, in.begin() + ec, comment_chars.begin(), comment_chars.end()));
-                    if(comment != in.begin() + ec)
-                    {
-                        ec = comment - in.begin();
-                    }
-                }
-                parse_cidr(in.substr(s, ec - s), result);
-            }
-            s = e + 1;
+            return false;
         }
+        mask_start = s + 1;
     }
 
-    // run a normal sort first then attempt a merge if requested
+    // convert the address
     //
-    if((f_sort & (SORT_FULL | SORT_MERGE)) != 0)
+    sockaddr_in6 in6 = sockaddr_in6();
+    in6.sin6_family = AF_INET6;
+    bool is_ipv4(parse_numeric_ipv4(address_start, address_end, in6.sin6_addr.s6_addr + 12));
+    if(is_ipv4)
     {
-        std::stable_sort(result.begin(), result.end());
+        in6.sin6_addr.s6_addr16[5] = 0xFFFF;
+    }
+    else if(ipv4_syntax
+         || !parse_numeric_ipv6(address_start, address_end, in6.sin6_addr.s6_addr))
+    {
+        return false;
     }
 
-    if((f_sort & SORT_MERGE) != 0)
+    // convert the port
+    //
+    int port(0);
+    bool const defined_port(port_start != nullptr);
+    if(defined_port)
     {
-        std::size_t max(result.size());
-        if(max > 1)
+        if(!parse_numeric_decimal(port_start, port_end, 5, port)
+        || port > 65535)
         {
-            for(std::size_t idx(0); idx < max - 1; ++idx)
-            {
-                addr_range const r(result[idx].union_if_possible(result[idx + 1]));
-                if(r.is_defined()
-                && !r.is_empty())
-                {
-                    // merge worked, update the vector
-                    //
-                    result[idx] = r;
-                    result.erase(result.begin() + idx + 1);
-                    --max;
-                    --idx;
-                }
-            }
+            return false;
+        }
+    }
+    else if(get_allow(allow_t::ALLOW_REQUIRED_PORT))
+    {
+        return false;
+    }
+    else if(f_default_port != -1)
+    {
+        if(!port_allowed)
+        {
+            return false;
         }
+        port = f_default_port;
     }
+    in6.sin6_port = htons(port);
 
-    // move IPv4 or IPv6 first (should be IPv6 in newer systems)
+    // convert the mask
     //
-    if((f_sort & SORT_IPV4_FIRST) != 0)
+    std::uint8_t mask_bits[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 };
+    if(mask_start != nullptr)
     {
-        std::stable_sort(
-              result.begin()
-            , result.end()
-            , [](auto const & a, auto const & b)
-            {
-                switch(a.compare(b))
-                {
-                case compare_t::COMPARE_IPV4_VS_IPV6:
-                case compare_t::COMPARE_FIRST:
-                    return true;
-
-                default:
-                    return false;
+        int const max_mask(ipv4_syntax ? 32 : 128);
+        int mask_count(0);
+        if(!parse_numeric_decimal(mask_start, e, 3, mask_count)
+        || mask_count > max_mask)
+        {
+            return false;
+        }
+        clear_mask_bits(mask_bits, max_mask - mask_count);
+    }
+    else if(get_allow(allow_t::ALLOW_MASK)
+         && !(ipv4_syntax ? f_default_mask4 : f_default_mask6).empty())
+    {
+        return false;
+    }
 
-                }
-            });
+    addr a(in6);
+    a.set_hostname(std::string(address_start, address_end));
+    if(f_protocol != -1)
+    {
+        a.set_protocol(f_protocol);
     }
-    else if((f_sort & SORT_IPV6_FIRST) != 0)
+    a.set_port_defined(defined_port);
+    if(mask_start != nullptr)
     {
-        std::stable_sort(
-              result.begin()
-            , result.end()
-            , [](auto const & a, auto const & b)
-            {
-                switch(a.compare(b))
-                {
-                case compare_t::COMPARE_IPV6_VS_IPV4:
-                case compare_t::COMPARE_FIRST:
-                    return true;
+        a.set_mask(mask_bits);
+    }
 
-                default:
-                    return false;
+    result.emplace_back();
+    result.back().set_from(a);
 
-                }
-            });
+    return true;
+}
+
+
+/** \brief Look up an address.
+ *
+ * This function calls getaddrinfo() unless the lookup is part of a
+ * batch which was already resolved, in which case the batch result
+ * is returned. When the lookup_cache is enabled, the lookup goes
+ * through the cache.
+ *
+ * \param[in] address  The address to look up.
+ * \param[in] service  The service (port) to look up.
+ * \param[in] hints  The getaddrinfo() hints.
+ * \param[out] ai  The resulting list of addresses.
+ *
+ * \return 0 on success, a getaddrinfo() error otherwise.
+ */
+int addr_parser::get_address_info(
+      std::string const & address
+    , std::string const & service
+    , addrinfo const & hints
+    , std::shared_ptr<addrinfo> & ai)
+{
+    if(f_lookup_batch != nullptr)
+    {
+        auto const it(f_lookup_batch->f_results.find(std::make_pair(address, service)));
+        if(it != f_lookup_batch->f_results.end()
+        && it->second.f_resolved)
+        {
+            // getaddrinfo_a() does not save the errno of each request
+            //
+            ai = it->second.f_list;
+            errno = 0;
+            return it->second.f_error;
+        }
     }
 
-    return result;
+    return lookup_cache::lookup(address, service, hints, ai);
 }
 
 
@@ -1439,7 +3249,10 @@ void addr_parser::parse_address4(std::string const & in, addr_range::vector_t &
     }
     else
     {
-        emit_error("Port not allowed (" + in + ").");
+        if(want_error_message(parser_error_t::PARSER_ERROR_PORT_NOT_ALLOWED))
+        {
+            emit_error_message("Port not allowed (" + in + ").");
+        }
         return;
     }
 
@@ -1478,7 +3291,10 @@ void addr_parser::parse_address6(std::string const & in, std::size_t const colon
 
         if(p == std::string::npos)
         {
-            emit_error("IPv6 is missing the ']' (" + in + ").");
+            if(want_error_message(parser_error_t::PARSER_ERROR_IPV6_MISSING_BRACKET))
+            {
+                emit_error_message("IPv6 is missing the ']' (" + in + ").");
+            }
             return;
         }
 
@@ -1489,7 +3305,10 @@ void addr_parser::parse_address6(std::string const & in, std::size_t const colon
         {
             if(in[p] != ':')
             {
-                emit_error("The IPv6 address \"" + in + "\" is followed by unknown data.");
+                if(want_error_message(parser_error_t::PARSER_ERROR_IPV6_UNKNOWN_DATA))
+                {
+                    emit_error_message("The IPv6 address \"" + in + "\" is followed by unknown data.");
+                }
                 return;
             }
 
@@ -1498,7 +3317,10 @@ void addr_parser::parse_address6(std::string const & in, std::size_t const colon
             {
                 // even just a ':' is no allowed in this case
                 //
-                emit_error("Port not allowed (" + in + ").");
+                if(want_error_message(parser_error_t::PARSER_ERROR_PORT_NOT_ALLOWED))
+                {
+                    emit_error_message("Port not allowed (" + in + ").");
+                }
                 return;
             }
 
@@ -1569,7 +3391,10 @@ void addr_parser::parse_address_range_port(
     if(from.empty()
     && to.empty())
     {
-        emit_error("An address range requires at least one of the \"from\" or \"to\" addresses.");
+        if(want_error_message(parser_error_t::PARSER_ERROR_RANGE_EMPTY))
+        {
+            emit_error_message("An address range requires at least one of the \"from\" or \"to\" addresses.");
+        }
         return;
     }
 
@@ -1579,7 +3404,10 @@ void addr_parser::parse_address_range_port(
         parse_address_port(from, port_str, from_result, ipv6);
         if(from_result.size() > 1)
         {
-            emit_error("The \"from\" of an address range must be exactly one address.");
+            if(want_error_message(parser_error_t::PARSER_ERROR_RANGE_FROM))
+            {
+                emit_error_message("The \"from\" of an address range must be exactly one address.");
+            }
             return;
         }
         if(from_result.empty())
@@ -1600,7 +3428,10 @@ void addr_parser::parse_address_range_port(
         parse_address_port(to, port_str, to_result, ipv6);
         if(to_result.size() > 1)
         {
-            emit_error("The \"to\" of an address range must be exactly one address.");
+            if(want_error_message(parser_error_t::PARSER_ERROR_RANGE_TO))
+            {
+                emit_error_message("The \"to\" of an address range must be exactly one address.");
+            }
             return;
         }
         if(to_result.empty())
@@ -1665,7 +3496,10 @@ void addr_parser::parse_address_port(
     {
         if(get_allow(allow_t::ALLOW_REQUIRED_PORT))
         {
-            emit_error("Required port is missing.");
+            if(want_error_message(parser_error_t::PARSER_ERROR_PORT_REQUIRED))
+            {
+                emit_error_message("Required port is missing.");
+            }
             return;
         }
         if(f_default_port != -1)
@@ -1680,7 +3514,10 @@ void addr_parser::parse_address_port(
     {
         if(get_allow(allow_t::ALLOW_REQUIRED_ADDRESS))
         {
-            emit_error("Required address is missing.");
+            if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_REQUIRED))
+            {
+                emit_error_message("Required address is missing.");
+            }
             return;
         }
         // internal default if no address was defined
@@ -1733,40 +3570,51 @@ void addr_parser::parse_address_port(
     //
     if(get_allow(allow_t::ALLOW_ADDRESS_LOOKUP))
     {
-        addrinfo * addrlist(nullptr);
+        std::shared_ptr<addrinfo> ai;
         {
-            errno = 0;
-            char const * service(port_str.c_str());
-            if(port_str.empty())
+            std::string service(port_str);
+            if(service.empty())
             {
                 service = "0"; // fallback to port 0 when unspecified
             }
-            int const r(getaddrinfo(address.c_str(), service, &hints, &addrlist));
+            if(f_lookup_batch != nullptr
+            && f_lookup_batch->f_collect
+            && !lookup_batch::is_numeric(address))
+            {
+                // first pass of a batch, only gather the lookups
+                //
+                f_lookup_batch->add(address, service, hints);
+                return;
+            }
+            int const r(get_address_info(address, service, hints, ai));
             if(r != 0)
             {
                 // break on invalid addresses
                 //
                 int const e(errno); // if r == EAI_SYSTEM, then 'errno' is consistent here
-                emit_error(
-                          "Invalid address in \""
-                        + address
-                        + (port_str.empty() ? "" : ":")
-                        + port_str
-                        + "\" error "
-                        + std::to_string(r)
-                        + " -- "
-                        + gai_strerror(r)
-                        + (e == 0
-                            ? ""
-                            : " (errno: "
-                            + std::to_string(e)
+                if(want_error_message(parser_error_t::PARSER_ERROR_INVALID_ADDRESS))
+                {
+                    emit_error_message(
+                              "Invalid address in \""
+                            + address
+                            + (port_str.empty() ? "" : ":")
+                            + port_str
+                            + "\" error "
+                            + std::to_string(r)
                             + " -- "
-                            + strerror(e)
-                            + ")."));
+                            + gai_strerror(r)
+                            + (e == 0
+                                ? ""
+                                : " (errno: "
+                                + std::to_string(e)
+                                + " -- "
+                                + strerror(e)
+                                + ")."));
+                }
                 return;
             }
         }
-        std::shared_ptr<addrinfo> ai(addrlist, addrinfo_deleter);
+        addrinfo const * addrlist(ai.get());
 
         bool first(true);
         while(addrlist != nullptr)
@@ -1777,11 +3625,14 @@ void addr_parser::parse_address_port(
             {
                 if(addrlist->ai_addrlen != sizeof(sockaddr_in))
                 {
-                    emit_error("Unsupported address size ("                  // LCOV_EXCL_LINE
-                             + std::to_string(addrlist->ai_addrlen)          // LCOV_EXCL_LINE
-                             + ", expected"                                  // LCOV_EXCL_LINE
-                             + std::to_string(sizeof(sockaddr_in))           // LCOV_EXCL_LINE
-                             + ").");                                        // LCOV_EXCL_LINE
+                    if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_SIZE))    // LCOV_EXCL_LINE
+                    {                                                                    // LCOV_EXCL_LINE
+                        emit_error_message("Unsupported address size ("                  // LCOV_EXCL_LINE
+                                         + std::to_string(addrlist->ai_addrlen)          // LCOV_EXCL_LINE
+                                         + ", expected"                                  // LCOV_EXCL_LINE
+                                         + std::to_string(sizeof(sockaddr_in))           // LCOV_EXCL_LINE
+                                         + ").");                                        // LCOV_EXCL_LINE
+                    }                                                                    // LCOV_EXCL_LINE
                 }
                 else
                 {
@@ -1803,11 +3654,14 @@ void addr_parser::parse_address_port(
             {
                 if(addrlist->ai_addrlen != sizeof(sockaddr_in6))
                 {
-                    emit_error("Unsupported address size ("                  // LCOV_EXCL_LINE
-                             + std::to_string(addrlist->ai_addrlen)          // LCOV_EXCL_LINE
-                             + ", expected "                                 // LCOV_EXCL_LINE
-                             + std::to_string(sizeof(sockaddr_in6))          // LCOV_EXCL_LINE
-                             + ").");                                        // LCOV_EXCL_LINE
+                    if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_SIZE))    // LCOV_EXCL_LINE
+                    {                                                                    // LCOV_EXCL_LINE
+                        emit_error_message("Unsupported address size ("                  // LCOV_EXCL_LINE
+                                         + std::to_string(addrlist->ai_addrlen)          // LCOV_EXCL_LINE
+                                         + ", expected "                                 // LCOV_EXCL_LINE
+                                         + std::to_string(sizeof(sockaddr_in6))          // LCOV_EXCL_LINE
+                                         + ").");                                        // LCOV_EXCL_LINE
+                    }                                                                    // LCOV_EXCL_LINE
                 }
                 else
                 {
@@ -1829,9 +3683,12 @@ void addr_parser::parse_address_port(
                 //
                 first = false;                                              // LCOV_EXCL_LINE
 
-                emit_error("Unsupported address family "                    // LCOV_EXCL_LINE
-                         + std::to_string(addrlist->ai_family)              // LCOV_EXCL_LINE
-                         + ".");                                            // LCOV_EXCL_LINE
+                if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_FAMILY))     // LCOV_EXCL_LINE
+                {                                                                       // LCOV_EXCL_LINE
+                    emit_error_message("Unsupported address family "                    // LCOV_EXCL_LINE
+                                     + std::to_string(addrlist->ai_family)              // LCOV_EXCL_LINE
+                                     + ".");                                            // LCOV_EXCL_LINE
+                }                                                                       // LCOV_EXCL_LINE
             }
 
             addrlist = addrlist->ai_next;
@@ -1848,9 +3705,12 @@ void addr_parser::parse_address_port(
             || port < 0
             || port > 65535)
             {
-                emit_error("Invalid port in \""
-                         + port_str
-                         + "\" (no service name lookup allowed).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_INVALID_PORT))
+                {
+                    emit_error_message("Invalid port in \""
+                                     + port_str
+                                     + "\" (no service name lookup allowed).");
+                }
                 return;
             }
 
@@ -1862,9 +3722,12 @@ void addr_parser::parse_address_port(
                 //      a default port and also told the parser that no
                 //      port is allowed
                 //
-                emit_error("Found a port (\""
-                         + port_str
-                         + "\") when it is not allowed.");
+                if(want_error_message(parser_error_t::PARSER_ERROR_PORT_NOT_ALLOWED))
+                {
+                    emit_error_message("Found a port (\""
+                                     + port_str
+                                     + "\") when it is not allowed.");
+                }
                 return;
             }
         }
@@ -1909,9 +3772,12 @@ void addr_parser::parse_address_port(
             }
             else
             {
-                emit_error("Unknown address in \""
-                         + address
-                         + "\" (no DNS lookup was allowed).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_UNKNOWN_ADDRESS))
+                {
+                    emit_error_message("Unknown address in \""
+                                     + address
+                                     + "\" (no DNS lookup was allowed).");
+                }
             }
         }
     }
@@ -1976,9 +3842,12 @@ void addr_parser::parse_mask(
                 mask_count = mask_count * 10 + *s - '0';
                 if(mask_count > 10000)
                 {
-                    emit_error("Mask size too large ("
-                             + mask
-                             + ", expected a maximum of 128).");
+                    if(want_error_message(parser_error_t::PARSER_ERROR_MASK_SIZE))
+                    {
+                        emit_error_message("Mask size too large ("
+                                         + mask
+                                         + ", expected a maximum of 128).");
+                    }
                     return;
                 }
             }
@@ -1998,9 +3867,12 @@ void addr_parser::parse_mask(
         {
             if(mask_count > 32)
             {
-                emit_error("Unsupported mask size ("
-                         + std::to_string(mask_count)
-                         + ", expected 32 at the most for an IPv4).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_SIZE))
+                {
+                    emit_error_message("Unsupported mask size ("
+                                     + std::to_string(mask_count)
+                                     + ", expected 32 at the most for an IPv4).");
+                }
                 return;
             }
             mask_count = 32 - mask_count;
@@ -2009,9 +3881,12 @@ void addr_parser::parse_mask(
         {
             if(mask_count > 128)
             {
-                emit_error("Unsupported mask size ("
-                         + std::to_string(mask_count)
-                         + ", expected 128 at the most for an IPv6).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_SIZE))
+                {
+                    emit_error_message("Unsupported mask size ("
+                                     + std::to_string(mask_count)
+                                     + ", expected 128 at the most for an IPv6).");
+                }
                 return;
             }
             mask_count = 128 - mask_count;
@@ -2019,20 +3894,18 @@ void addr_parser::parse_mask(
 
         // clear a few bits at the bottom of mask_bits
         //
-        int idx(15);
-        for(; mask_count > 8; mask_count -= 8, --idx)
-        {
-            mask_bits[idx] = 0;
-        }
-        mask_bits[idx] = 255 << mask_count;
+        clear_mask_bits(mask_bits, mask_count);
     }
     else //if(mask_count < 0)
     {
         if(!get_allow(allow_t::ALLOW_ADDRESS_MASK))
         {
-            emit_error("Address like mask not allowed (/"
-                     + mask
-                     + "), try with a simple number instead.");
+            if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_MASK_NOT_ALLOWED))
+            {
+                emit_error_message("Address like mask not allowed (/"
+                                 + mask
+                                 + "), try with a simple number instead.");
+            }
             return;
         }
 
@@ -2064,7 +3937,10 @@ void addr_parser::parse_mask(
         {
             if(mask[0] == '[')
             {
-                emit_error("The address uses the IPv4 syntax, the mask cannot use IPv6.");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_FAMILY))
+                {
+                    emit_error_message("The address uses the IPv4 syntax, the mask cannot use IPv6.");
+                }
                 return;
             }
         }
@@ -2072,12 +3948,18 @@ void addr_parser::parse_mask(
         {
             if(mask[0] != '[')
             {
-                emit_error("The address uses the IPv6 syntax, the mask cannot use IPv4.");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_FAMILY))
+                {
+                    emit_error_message("The address uses the IPv6 syntax, the mask cannot use IPv4.");
+                }
                 return;
             }
             if(mask.back() != ']')
             {
-                emit_error("The IPv6 mask is missing the ']' (" + mask + ").");
+                if(want_error_message(parser_error_t::PARSER_ERROR_IPV6_MISSING_BRACKET))
+                {
+                    emit_error_message("The IPv6 mask is missing the ']' (" + mask + ").");
+                }
                 return;
             }
 
@@ -2105,17 +3987,20 @@ void addr_parser::parse_mask(
             // break on invalid addresses
             //
             int const e(errno); // if r == EAI_SYSTEM, then 'errno' is consistent here
-            emit_error("Invalid mask in \"/"
-                     + mask
-                     + "\", error "
-                     + std::to_string(r)
-                     + " -- "
-                     + gai_strerror(r)
-                     + " (errno: "
-                     + std::to_string(e)
-                     + " -- "
-                     + strerror(e)
-                     + ").");
+            if(want_error_message(parser_error_t::PARSER_ERROR_INVALID_MASK))
+            {
+                emit_error_message("Invalid mask in \"/"
+                                 + mask
+                                 + "\", error "
+                                 + std::to_string(r)
+                                 + " -- "
+                                 + gai_strerror(r)
+                                 + " (errno: "
+                                 + std::to_string(e)
+                                 + " -- "
+                                 + strerror(e)
+                                 + ").");
+            }
             return;
         }
         std::shared_ptr<addrinfo> mask_ai(masklist, addrinfo_deleter);
@@ -2127,17 +4012,23 @@ void addr_parser::parse_mask(
                 // this one happens when the user does not put the '[...]'
                 // around an IPv6 address
                 //
-                emit_error("Incompatible address between the address and"
-                          " mask address (first was an IPv4 second an IPv6).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_FAMILY))
+                {
+                    emit_error_message("Incompatible address between the address and"
+                                      " mask address (first was an IPv4 second an IPv6).");
+                }
                 return;
             }
             if(masklist->ai_addrlen != sizeof(sockaddr_in))
             {
-                emit_error("Unsupported address size ("                 // LCOV_EXCL_LINE
-                        + std::to_string(masklist->ai_addrlen)          // LCOV_EXCL_LINE
-                        + ", expected"                                  // LCOV_EXCL_LINE
-                        + std::to_string(sizeof(sockaddr_in))           // LCOV_EXCL_LINE
-                        + ").");                                        // LCOV_EXCL_LINE
+                if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_SIZE))   // LCOV_EXCL_LINE
+                {                                                                   // LCOV_EXCL_LINE
+                    emit_error_message("Unsupported address size ("                 // LCOV_EXCL_LINE
+                                    + std::to_string(masklist->ai_addrlen)          // LCOV_EXCL_LINE
+                                    + ", expected"                                  // LCOV_EXCL_LINE
+                                    + std::to_string(sizeof(sockaddr_in))           // LCOV_EXCL_LINE
+                                    + ").");                                        // LCOV_EXCL_LINE
+                }                                                                   // LCOV_EXCL_LINE
                 return;                                                 // LCOV_EXCL_LINE
             }
             memcpy(mask_bits + 12, &reinterpret_cast<sockaddr_in *>(masklist->ai_addr)->sin_addr.s_addr, 4); // last 4 bytes are the IPv4 address, keep the rest as 1s
@@ -2149,17 +4040,23 @@ void addr_parser::parse_mask(
                 // this one happens if the user puts the '[...]'
                 // around an IPv4 address
                 //
-                emit_error("Incompatible address between the address"
-                          " and mask address (first was an IPv6 second an IPv4).");
+                if(want_error_message(parser_error_t::PARSER_ERROR_MASK_FAMILY))
+                {
+                    emit_error_message("Incompatible address between the address"
+                                      " and mask address (first was an IPv6 second an IPv4).");
+                }
                 return;
             }
             if(masklist->ai_addrlen != sizeof(sockaddr_in6))
             {
-                emit_error("Unsupported address size ("                 // LCOV_EXCL_LINE
-                         + std::to_string(masklist->ai_addrlen)         // LCOV_EXCL_LINE
-                         + ", expected "                                // LCOV_EXCL_LINE
-                         + std::to_string(sizeof(sockaddr_in6))         // LCOV_EXCL_LINE
-                         + ").");                                       // LCOV_EXCL_LINE
+                if(want_error_message(parser_error_t::PARSER_ERROR_ADDRESS_SIZE))   // LCOV_EXCL_LINE
+                {                                                                   // LCOV_EXCL_LINE
+                    emit_error_message("Unsupported address size ("                 // LCOV_EXCL_LINE
+                                     + std::to_string(masklist->ai_addrlen)         // LCOV_EXCL_LINE
+                                     + ", expected "                                // LCOV_EXCL_LINE
+                                     + std::to_string(sizeof(sockaddr_in6))         // LCOV_EXCL_LINE
+                                     + ").");                                       // LCOV_EXCL_LINE
+                }                                                                   // LCOV_EXCL_LINE
                 return;                                                 // LCOV_EXCL_LINE
             }
             memcpy(mask_bits, &reinterpret_cast<sockaddr_in6 *>(masklist->ai_addr)->sin6_addr.s6_addr, 16);
@@ -2170,6 +4067,192 @@ void addr_parser::parse_mask(
 }
 
 
+/** \brief Initialize a plan from a parser.
+ *
+ * This constructor saves a copy of the \p parser configuration and
+ * precomputes a table used to detect separators and comment introducers
+ * in a single lookup per character.
+ *
+ * The errors currently found in \p parser are not copied.
+ *
+ * \param[in] parser  The parser to freeze.
+ *
+ * \sa addr_parser::freeze()
+ */
+addr_parser::plan::plan(addr_parser const & parser)
+    : f_parser(parser)
+{
+    f_parser.clear_errors();
+
+    for(char const c : f_parser.get_separators())
+    {
+        f_char_class[static_cast<std::uint8_t>(c)] |= CHAR_SEPARATOR;
+    }
+    if(f_parser.get_allow(allow_t::ALLOW_COMMENT_HASH))
+    {
+        f_char_class[static_cast<std::uint8_t>('#')] |= CHAR_COMMENT;
+    }
+    if(f_parser.get_allow(allow_t::ALLOW_COMMENT_SEMICOLON))
+    {
+        f_char_class[static_cast<std::uint8_t>(';')] |= CHAR_COMMENT;
+    }
+
+    f_multi = f_parser.get_allow(allow_t::ALLOW_MULTI_ADDRESSES_COMMAS)
+           || f_parser.get_allow(allow_t::ALLOW_MULTI_ADDRESSES_SPACES)
+           || f_parser.get_allow(allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES);
+    f_numeric = !f_parser.get_allow(allow_t::ALLOW_ADDRESS_LOOKUP);
+}
+
+
+/** \brief Get the frozen parser.
+ *
+ * This function gives access to the parser configuration saved in this
+ * plan. It can be used to query its settings.
+ *
+ * \return A reference to the parser of this plan.
+ */
+addr_parser const & addr_parser::plan::get_parser() const
+{
+    return f_parser;
+}
+
+
+/** \brief Parse the input with this plan.
+ *
+ * This function parses \p in exactly like addr_parser::parse() would
+ * with the frozen configuration and returns the resulting ranges.
+ *
+ * \param[in] in  The input to parse.
+ * \param[out] errors  If not nullptr, the error messages get appended
+ * to this string.
+ *
+ * \return The list of ranges found in \p in.
+ */
+addr_range::vector_t addr_parser::plan::parse(std::string_view const & in, std::string * errors) const
+{
+    addr_range::vector_t result;
+    parse(in, result, errors);
+    return result;
+}
+
+
+/** \brief Parse the input with this plan, appending to a vector.
+ *
+ * This function parses \p in and appends the resulting ranges to
+ * \p result. The function is const and does not modify the plan so
+ * it can be called from any number of threads simultaneously.
+ *
+ * Entries of numeric addresses are parsed directly from \p in. The
+ * only memory allocated is in \p result (which can be reused between
+ * calls to avoid any reallocation). Other entries go through the full
+ * parser with a temporary copy of the frozen parser.
+ *
+ * The sort order of the frozen parser is applied to the whole \p result
+ * vector.
+ *
+ * \param[in] in  The input to parse.
+ * \param[in,out] result  The vector where the ranges get appended.
+ * \param[out] errors  If not nullptr, the error messages get appended
+ * to this string.
+ *
+ * \return true if no errors occurred.
+ */
+bool addr_parser::plan::parse(
+      std::string_view const & in
+    , addr_range::vector_t & result
+    , std::string * errors) const
+{
+    bool valid(true);
+    if(!f_multi)
+    {
+        valid = parse_entry(in, result, errors);
+    }
+    else
+    {
+        char const * s(in.data());
+        char const * const end(s + in.length());
+        while(s < end)
+        {
+            char const * e(s);
+            char const * ec(nullptr);
+            for(; e < end; ++e)
+            {
+                std::uint8_t const c(f_char_class[static_cast<std::uint8_t>(*e)]);
+                if((c & CHAR_SEPARATOR) != 0)
+                {
+                    break;
+                }
+                if((c & CHAR_COMMENT) != 0
+                && ec == nullptr)
+                {
+                    ec = e;
+                }
+            }
+            if(ec == nullptr)
+            {
+                ec = e;
+            }
+            if(e > s
+            && ec != s)     // commented out entry?
+            {
+                if(!parse_entry(std::string_view(s, ec - s), result, errors))
+                {
+                    valid = false;
+                }
+            }
+            s = e + 1;
+        }
+    }
+
+    f_parser.sort_ranges(result);
+
+    return valid;
+}
+
+
+/** \brief Parse one entry.
+ *
+ * This function parses one entry. If the parser does not allow lookups,
+ * it first tries the numeric parser which works directly on \p in.
+ *
+ * \param[in] in  The entry to parse.
+ * \param[in,out] result  The vector where the ranges get appended.
+ * \param[out] errors  If not nullptr, the error messages get appended
+ * to this string.
+ *
+ * \return true if no errors occurred.
+ */
+bool addr_parser::plan::parse_entry(
+      std::string_view const & in
+    , addr_range::vector_t & result
+    , std::string * errors) const
+{
+    if(f_numeric
+    && f_parser.parse_numeric(in, result))
+    {
+        return true;
+    }
+
+    // no need to format messages nobody reads, but the caller who
+    // passes errors wants them whatever the mode of the frozen parser
+    //
+    addr_parser p(f_parser);
+    p.f_error_mode = errors == nullptr
+                        ? error_mode_t::ERROR_MODE_CODES
+                        : error_mode_t::ERROR_MODE_MESSAGES;
+    p.parse_cidr(std::string(in), result);
+    if(!p.has_errors())
+    {
+        return true;
+    }
+    if(errors != nullptr)
+    {
+        *errors += p.error_messages();
+    }
+    return false;
+}
+
+
 /** \brief Transform a string into an `addr` object.
  *
  * This function converts the string \p a in an IP address saved in
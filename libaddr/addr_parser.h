@@ -34,6 +34,19 @@
 #include    <libaddr/addr_range.h>
 
 
+// C++
+//
+#include    <functional>
+#include    <istream>
+#include    <string_view>
+
+
+// C
+//
+#include    <netdb.h>
+#include    <sys/types.h>
+
+
 
 namespace addr
 {
@@ -77,9 +90,59 @@ constexpr sort_t const                      SORT_MERGE          = 0x0008;
 constexpr sort_t const                      SORT_NO_EMPTY       = 0x0010;       // remove empty entries
 
 
+enum class error_mode_t
+{
+    ERROR_MODE_MESSAGES,                    // save error codes and messages (default)
+    ERROR_MODE_CODES,                       // only save error codes, see error_to_string()
+};
+
+
+enum class parser_error_t
+{
+    PARSER_ERROR_OTHER,                     // message given to emit_error()
+    PARSER_ERROR_OPEN_FILE,                 // parse_file() could not open the file
+    PARSER_ERROR_IO,                        // error while reading the input
+    PARSER_ERROR_ADDRESS_REQUIRED,          // address missing with ALLOW_REQUIRED_ADDRESS
+    PARSER_ERROR_INVALID_ADDRESS,           // getaddrinfo() failed on the address
+    PARSER_ERROR_UNKNOWN_ADDRESS,           // not a numeric address and lookups are not allowed
+    PARSER_ERROR_ADDRESS_SIZE,              // unexpected address size from getaddrinfo()
+    PARSER_ERROR_ADDRESS_FAMILY,            // unexpected address family from getaddrinfo()
+    PARSER_ERROR_IPV6_MISSING_BRACKET,      // '[' without ']'
+    PARSER_ERROR_IPV6_UNKNOWN_DATA,         // unexpected data after ']'
+    PARSER_ERROR_PORT_NOT_ALLOWED,          // port found without ALLOW_PORT
+    PARSER_ERROR_PORT_REQUIRED,             // port missing with ALLOW_REQUIRED_PORT
+    PARSER_ERROR_INVALID_PORT,              // port is not a valid number
+    PARSER_ERROR_RANGE_EMPTY,               // range without "from" or "to"
+    PARSER_ERROR_RANGE_FROM,                // range "from" is not exactly one address
+    PARSER_ERROR_RANGE_TO,                  // range "to" is not exactly one address
+    PARSER_ERROR_MASK_SIZE,                 // mask too large
+    PARSER_ERROR_ADDRESS_MASK_NOT_ALLOWED,  // mask like an address without ALLOW_ADDRESS_MASK
+    PARSER_ERROR_MASK_FAMILY,               // address and mask are not both IPv4 or IPv6
+    PARSER_ERROR_INVALID_MASK,              // getaddrinfo() failed on the mask
+};
+
+
+struct parser_error
+{
+    typedef std::vector<parser_error>   vector_t;
+
+    parser_error_t          f_code = parser_error_t::PARSER_ERROR_OTHER;
+    std::size_t             f_offset = 0;       // position of the entry in the input
+    std::size_t             f_length = 0;       // length of the entry
+    std::size_t             f_message_offset = 0;   // position of the message in error_messages()
+    std::size_t             f_message_length = 0;   // length of the message, 0 if none was emitted
+};
+
+
 class addr_parser
 {
 public:
+    typedef std::function<bool(addr_range const & range)>  range_callback_t;
+    typedef std::function<void(addr_range::vector_t const & result, addr_parser const & parser)>
+                                                            async_callback_t;
+
+    class plan;
+
                             addr_parser();
 
     void                    set_default_address(std::string const & address);
@@ -102,19 +165,55 @@ public:
     void                    set_sort_order(sort_t const sort);
     sort_t                  get_sort_order() const;
 
+    void                    set_thread_count(std::size_t count);
+    std::size_t             get_thread_count() const;
+
+    void                    set_async_lookup(bool async);
+    bool                    get_async_lookup() const;
+
     void                    set_allow(allow_t const flag, bool const allow);
     bool                    get_allow(allow_t const flag) const;
 
+    void                    set_error_mode(error_mode_t mode);
+    error_mode_t            get_error_mode() const;
+    void                    set_max_errors(std::size_t max);
+    std::size_t             get_max_errors() const;
     bool                    has_errors() const;
     void                    emit_error(std::string const & msg);
     std::string const &     error_messages() const;
     int                     error_count() const;
+    parser_error::vector_t const &
+                            errors() const;
+    std::string             error_to_string(std::size_t idx, std::string_view const & in = std::string_view()) const;
     void                    clear_errors();
 
     addr_range::vector_t    parse(std::string const & in);
+    bool                    parse(std::istream & in, range_callback_t const & callback);
+    bool                    parse_fd(int fd, range_callback_t const & callback);
+    bool                    parse_file(std::string const & filename, range_callback_t const & callback);
+
+    void                    parse_async(std::string const & in, async_callback_t const & callback) const;
+
+    plan                    freeze() const;
 
 private:
+    typedef std::function<ssize_t(char * buffer, std::size_t size)>   reader_t;
+
+    struct lookup_batch;
+
+    int                     get_address_info(std::string const & address, std::string const & service, addrinfo const & hints, std::shared_ptr<addrinfo> & ai);
+
+    bool                    error_limit_reached();
+    bool                    want_error_message(parser_error_t code);
+    void                    emit_error_message(std::string const & msg);
+    void                    append_errors(addr_parser const & p);
+    std::string             get_separators() const;
+    bool                    parse_entries(std::string_view const & in, std::size_t offset, std::string const & separators, addr_range::vector_t & result, range_callback_t const & callback);
+    bool                    parse_stream(reader_t const & reader, range_callback_t const & callback);
+    void                    parse_parallel(std::string_view const & in, std::string const & separators, std::size_t thread_count, addr_range::vector_t & result);
     void                    parse_address_range(std::string const & in, addr_range::vector_t & result);
+    bool                    parse_numeric(std::string_view const & in, addr_range::vector_t & result) const;
+    void                    sort_ranges(addr_range::vector_t & result) const;
     void                    parse_cidr(std::string const & in, addr_range::vector_t & result);
     bool                    parse_address(std::string const & in, std::string const & mask, addr_range::vector_t & result);
     void                    parse_address4(std::string const & in, addr_range::vector_t & result);
@@ -125,16 +224,48 @@ private:
 
     bool                    f_flags[static_cast<int>(allow_t::ALLOW_max)] = {};
     sort_t                  f_sort = SORT_NO;
+    std::size_t             f_thread_count = 1;
+    bool                    f_async_lookup = false;
+    lookup_batch *          f_lookup_batch = nullptr;
     std::string             f_default_address4 = std::string();
     std::string             f_default_address6 = std::string();
     std::string             f_default_mask4 = std::string();
     std::string             f_default_mask6 = std::string();
     int                     f_protocol = -1;
     int                     f_default_port = -1;
+    error_mode_t            f_error_mode = error_mode_t::ERROR_MODE_MESSAGES;
+    std::size_t             f_max_errors = 0;
     std::string             f_error = std::string();
     int                     f_error_count = 0;
+    parser_error::vector_t  f_errors = parser_error::vector_t();
+    std::size_t             f_entry_offset = 0;
+    std::size_t             f_entry_length = 0;
+};
+
+
+class addr_parser::plan
+{
+public:
+                            plan(addr_parser const & parser);
+
+    addr_parser const &     get_parser() const;
+
+    addr_range::vector_t    parse(std::string_view const & in, std::string * errors = nullptr) const;
+    bool                    parse(std::string_view const & in, addr_range::vector_t & result, std::string * errors = nullptr) const;
+
+private:
+    static constexpr std::uint8_t const CHAR_SEPARATOR = 0x01;
+    static constexpr std::uint8_t const CHAR_COMMENT   = 0x02;
+
+    bool                    parse_entry(std::string_view const & in, addr_range::vector_t & result, std::string * errors) const;
+
+    addr_parser             f_parser = addr_parser();
+    std::uint8_t            f_char_class[256] = {};
+    bool                    f_multi = false;
+    bool                    f_numeric = false;
 };
 
+
 addr string_to_addr(
           std::string const & a
         , std::string const & default_address = std::string()
@@ -48,6 +48,11 @@
 #include    <limits>
 
 
+// C
+//
+#include    <string.h>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -58,6 +63,60 @@ namespace addr
 {
 
 
+namespace
+{
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Compute the length of the largest prefix starting at \p from.
+ *
+ * This function computes the length of the largest CIDR which starts
+ * at \p from and does not go past \p to. The block is limited by the
+ * alignment of \p from (its number of trailing zeroes) and by the
+ * number of addresses between \p from and \p to.
+ *
+ * \param[in] from  The first address of the block.
+ * \param[in] to  The last address that can be included in the block.
+ *
+ * \return The length of the prefix, from 0 to 128.
+ */
+int largest_prefix(unsigned __int128 from, unsigned __int128 to)
+{
+    // number of bits defined by the alignment of 'from'
+    //
+    int align(128);
+    if(from != 0)
+    {
+        std::uint64_t const lo(static_cast<std::uint64_t>(from));
+        align = lo != 0
+                ? __builtin_ctzll(lo)
+                : 64 + __builtin_ctzll(static_cast<std::uint64_t>(from >> 64));
+    }
+
+    // number of bits defined by the size of the range; a count of 0
+    // means 2^128 (the whole address space)
+    //
+    unsigned __int128 const count(to - from + 1);
+    int span(128);
+    if(count != 0)
+    {
+        std::uint64_t const hi(static_cast<std::uint64_t>(count >> 64));
+        span = hi != 0
+                ? 127 - __builtin_clzll(hi)
+                : 63 - __builtin_clzll(static_cast<std::uint64_t>(count));
+    }
+
+    return 128 - std::min(align, span);
+}
+#pragma GCC diagnostic pop
+
+
+}
+// no name namespace
+
+
+
 /** \brief Return true if the range has a 'from' address defined.
  *
  * By default the 'from' and 'to' addresses of an addr_range are legal
@@ -420,6 +479,146 @@ bool addr_range::to_cidr(addr & a) const
 }
 
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Transform the range in an interval of 128 bit numbers.
+ *
+ * This function is used by the classes which handle ranges as numbers
+ * (addr_range_index, addr_range_set, and addr_lpm_table). The range is
+ * interpreted the same way as the match() function does:
+ *
+ * \li a range with a "from" and a "to" represents all the addresses
+ * between "from" and "to" inclusive; the masks are ignored;
+ * \li a range with only a "from" or only a "to" represents the CIDR
+ * defined by that address and its mask;
+ * \li an empty or undefined range does not represent any address.
+ *
+ * \exception addr_unsupported_as_range
+ * A "from" or "to" only range with a mask which is not a valid CIDR
+ * can't be represented as one interval and this exception is raised.
+ *
+ * \param[out] from  The first address of the interval.
+ * \param[out] to  The last address of the interval.
+ *
+ * \return false if the range does not represent any address, in which
+ * case \p from and \p to are not modified.
+ */
+bool addr_range::to_uint128_interval(
+      unsigned __int128 & from
+    , unsigned __int128 & to) const
+{
+    if(is_empty()
+    || !is_defined())
+    {
+        return false;
+    }
+
+    if(is_range())
+    {
+        from = f_from.ip_to_uint128();
+        to = f_to.ip_to_uint128();
+        return true;
+    }
+
+    addr const & a(f_has_from ? f_from : f_to);
+    int const length(a.get_mask_size());
+    if(length < 0)
+    {
+        throw addr_unsupported_as_range("addr_range only supports CIDR masks");
+    }
+    unsigned __int128 const mask(length == 0 ? 0 : ~static_cast<unsigned __int128>(0) << (128 - length));
+    unsigned __int128 const ip(a.ip_to_uint128());
+    from = ip & mask;
+    to = ip | ~mask;
+    return true;
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Transform the range in a list of CIDR addresses.
+ *
+ * Contrary to the to_cidr() function, this function works with any
+ * range. It returns the minimal list of CIDR addresses covering exactly
+ * the same set of addresses as this range. For example, the range
+ * 10.0.0.1-10.0.0.6 returns:
+ *
+ * \code
+ *     10.0.0.1/32
+ *     10.0.0.2/31
+ *     10.0.0.4/31
+ *     10.0.0.6/32
+ * \endcode
+ *
+ * Each CIDR is computed in constant time so the function is O(n) where
+ * n is the number of CIDRs returned (at most 2 x 128).
+ *
+ * If the range only has a "from" or only a "to" address, then that
+ * address and its mask are returned (the mask gets applied).
+ *
+ * An empty or undefined range returns an empty list.
+ *
+ * The CIDR addresses are copies of the "from" address so the port and
+ * protocol are kept.
+ *
+ * \exception addr_unsupported_as_range
+ * If the range only has a "from" or a "to" address and its mask cannot
+ * be represented as a CIDR, this exception is raised.
+ *
+ * \return The list of CIDR addresses covering the range.
+ */
+addr::vector_t addr_range::to_cidrs() const
+{
+    addr::vector_t result;
+
+    if(!is_range())
+    {
+        if(!is_defined())
+        {
+            return result;
+        }
+
+        addr a(f_has_from ? f_from : f_to);
+        if(a.get_mask_size() == -1)
+        {
+            throw addr_unsupported_as_range("unsupported mask for a CIDR");
+        }
+        a.apply_mask();
+        result.push_back(a);
+        return result;
+    }
+
+    if(is_empty())
+    {
+        return result;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    unsigned __int128 from(f_from.ip_to_uint128());
+    unsigned __int128 const to(f_to.ip_to_uint128());
+    for(;;)
+    {
+        int const length(largest_prefix(from, to));
+        addr a(f_from);
+        a.ip_from_uint128(from);
+        a.set_mask_count(length);
+        result.push_back(a);
+
+        unsigned __int128 const last(length == 0
+                    ? ~static_cast<unsigned __int128>(0)
+                    : from | ((static_cast<unsigned __int128>(1) << (128 - length)) - 1));
+        if(last >= to)
+        {
+            break;
+        }
+        from = last + 1;
+    }
+#pragma GCC diagnostic pop
+
+    return result;
+}
+
+
 /** \brief Transform a range in a vector of separate addresses.
  *
  * This function goes through a range and transforms it in a set of addresses.
@@ -450,31 +649,33 @@ addr::vector_t addr_range::to_addresses(std::size_t limit) const
             + std::to_string(limit));
     }
 
-    if(has_from()
-    && has_to())
-    {
-        addr a(f_from);
-        do
-        {
-            result.push_back(a);
-            ++a;
-        }
-        while(a <= f_to);
-    }
-    else if(has_from())
-    {
-        result.push_back(f_from);
-    }
-    else if(has_to())
+    result.reserve(size());
+    for(auto const & a : *this)
     {
-        result.push_back(f_to);
+        result.push_back(a);
     }
 
     return result;
 }
 
 
-addr::vector_t addr_range::to_addresses(vector_t ranges, std::size_t limit)
+/** \brief Transform a vector of ranges in a vector of separate addresses.
+ *
+ * This function is the same as the to_addresses() applied to each range
+ * with all the results concatenated. The \p limit is applied to the total.
+ *
+ * \exception out_of_range
+ * If the ranges represent more than \p limit addresses, then this
+ * exception is raised.
+ *
+ * \param[in] ranges  The ranges to transform.
+ * \param[in] limit  The maximum number of addresses accepted.
+ *
+ * \return The vector of addresses representing all the ranges.
+ *
+ * \sa vector_view
+ */
+addr::vector_t addr_range::to_addresses(vector_t const & ranges, std::size_t limit)
 {
     std::size_t total_size(0);
     for(auto const & r : ranges)
@@ -490,16 +691,384 @@ addr::vector_t addr_range::to_addresses(vector_t ranges, std::size_t limit)
     }
 
     addr::vector_t result;
-    for(auto const & r : ranges)
+    result.reserve(total_size);
+    for(auto const & a : vector_view(ranges))
     {
-        addr::vector_t const v(r.to_addresses(limit));
-        result.insert(result.end(), v.begin(), v.end());
+        result.push_back(a);
     }
 
     return result;
 } // LCOV_EXCL_LINE
 
 
+/** \brief Get an iterator to the first address of this range.
+ *
+ * This function returns an iterator which goes through all the addresses
+ * of this range, one at a time. Contrary to the to_addresses() function,
+ * the addresses are not saved in a vector so it works with any size of
+ * range:
+ *
+ * \code
+ *     for(auto const & a : range)
+ *     {
+ *         ...
+ *     }
+ * \endcode
+ *
+ * If the range only has a "from" or only a "to" address, then the
+ * iterator returns that one address. If the range is empty or not
+ * defined, then begin() == end().
+ *
+ * The addresses returned are copies of the "from" address (or "to" if
+ * "from" is not defined) with the IP changed so the port, mask, etc.
+ * are the same for all.
+ *
+ * \return An iterator to the first address of the range.
+ */
+addr_range::const_iterator addr_range::begin() const
+{
+    return begin(0, 1);
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Get an iterator starting at \p offset and moving by \p step.
+ *
+ * This function returns an iterator to the address at \p offset from
+ * the start of the range. Each increment of the iterator moves by
+ * \p step addresses. This can be used to scan a large range in
+ * parallel (i.e. thread N of M uses `begin(N, M)`) or to sample a
+ * range.
+ *
+ * If \p offset is past the end of the range, then the function returns
+ * end(). A \p step of zero is viewed as 1.
+ *
+ * \param[in] offset  The offset of the first address.
+ * \param[in] step  The number of addresses to skip on each increment.
+ *
+ * \return An iterator to the address at \p offset.
+ */
+addr_range::const_iterator addr_range::begin(unsigned __int128 offset, unsigned __int128 step) const
+{
+    if(!is_defined()
+    || is_empty())
+    {
+        return end();
+    }
+
+    addr const & first(f_has_from ? f_from : f_to);
+    addr const & last(f_has_to ? f_to : f_from);
+    const_iterator it(first, last.ip_to_uint128(), step);
+    it += offset;
+    return it;
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Get the end iterator.
+ *
+ * This function returns an iterator representing the end of the range.
+ *
+ * \return The end iterator.
+ */
+addr_range::const_iterator addr_range::end() const
+{
+    return const_iterator();
+}
+
+
+/** \brief Initialize an end iterator.
+ *
+ * The default iterator is an end iterator. It can't be dereferenced.
+ */
+addr_range::const_iterator::const_iterator()
+{
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Initialize an iterator.
+ *
+ * The iterator starts at the \p first address and ends once it goes
+ * past \p last. The iterator only saves one address and the numeric
+ * representation of the current and last addresses, so it uses O(1)
+ * memory whatever the size of the range.
+ *
+ * \param[in] first  The first address.
+ * \param[in] last  The last address as a number (see addr::ip_to_uint128()).
+ * \param[in] step  The number of addresses to skip on each increment.
+ */
+addr_range::const_iterator::const_iterator(
+          addr const & first
+        , unsigned __int128 last
+        , unsigned __int128 step)
+    : f_value(first.ip_to_uint128())
+    , f_last(last)
+    , f_step(step == 0 ? 1 : step)
+    , f_done(f_value > f_last)
+    , f_address(first)
+{
+}
+
+
+/** \brief Move the iterator forward by \p count addresses.
+ *
+ * If the move goes past the last address, the iterator becomes an end
+ * iterator. The 128 bit value never overflows.
+ *
+ * \param[in] count  The number of addresses to skip.
+ *
+ * \return A reference to this iterator.
+ */
+addr_range::const_iterator & addr_range::const_iterator::operator += (unsigned __int128 count)
+{
+    if(!f_done
+    && count != 0)
+    {
+        if(count > f_last - f_value)
+        {
+            f_done = true;
+        }
+        else
+        {
+            f_value += count;
+            f_address.ip_from_uint128(f_value);
+        }
+    }
+    return *this;
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Get the current address.
+ *
+ * \return A reference to the current address.
+ */
+addr_range::const_iterator::reference addr_range::const_iterator::operator * () const
+{
+    return f_address;
+}
+
+
+/** \brief Access the current address.
+ *
+ * \return A pointer to the current address.
+ */
+addr_range::const_iterator::pointer addr_range::const_iterator::operator -> () const
+{
+    return &f_address;
+}
+
+
+/** \brief Move to the next address.
+ *
+ * \return A reference to this iterator.
+ */
+addr_range::const_iterator & addr_range::const_iterator::operator ++ ()
+{
+    return *this += f_step;
+}
+
+
+/** \brief Move to the next address.
+ *
+ * \return A copy of the iterator before it was incremented.
+ */
+addr_range::const_iterator addr_range::const_iterator::operator ++ (int)
+{
+    const_iterator const result(*this);
+    *this += f_step;
+    return result;
+}
+
+
+/** \brief Compare two iterators.
+ *
+ * Two end iterators are always equal. Otherwise the iterators are equal
+ * when they point to the same address.
+ *
+ * \param[in] rhs  The other iterator.
+ *
+ * \return true if both iterators are equal.
+ */
+bool addr_range::const_iterator::operator == (const_iterator const & rhs) const
+{
+    if(f_done || rhs.f_done)
+    {
+        return f_done == rhs.f_done;
+    }
+    return f_value == rhs.f_value;
+}
+
+
+/** \brief Compare two iterators.
+ *
+ * \param[in] rhs  The other iterator.
+ *
+ * \return true if both iterators are different.
+ */
+bool addr_range::const_iterator::operator != (const_iterator const & rhs) const
+{
+    return !operator == (rhs);
+}
+
+
+/** \brief Create a view of a vector of ranges.
+ *
+ * This view can be used to iterate over all the addresses of a vector
+ * of ranges, one range after the other:
+ *
+ * \code
+ *     for(auto const & a : addr::addr_range::vector_view(ranges))
+ *     {
+ *         ...
+ *     }
+ * \endcode
+ *
+ * \warning
+ * The view keeps a reference to \p ranges. The vector must not be
+ * modified or destroyed while the view or its iterators are in use.
+ *
+ * \param[in] ranges  The vector of ranges to iterate over.
+ */
+addr_range::vector_view::vector_view(vector_t const & ranges)
+    : f_ranges(ranges)
+{
+}
+
+
+/** \brief Get an iterator to the first address.
+ *
+ * \return An iterator to the first address of the first non-empty range.
+ */
+addr_range::vector_view::const_iterator addr_range::vector_view::begin() const
+{
+    return const_iterator(&f_ranges, 0);
+}
+
+
+/** \brief Get the end iterator.
+ *
+ * \return The end iterator of this view.
+ */
+addr_range::vector_view::const_iterator addr_range::vector_view::end() const
+{
+    return const_iterator(&f_ranges, f_ranges.size());
+}
+
+
+/** \brief Initialize an end iterator.
+ */
+addr_range::vector_view::const_iterator::const_iterator()
+{
+}
+
+
+/** \brief Initialize an iterator at the start of range \p index.
+ *
+ * \param[in] ranges  The vector of ranges.
+ * \param[in] index  The index of the first range to iterate.
+ */
+addr_range::vector_view::const_iterator::const_iterator(vector_t const * ranges, std::size_t index)
+    : f_ranges(ranges)
+    , f_index(index)
+{
+    if(f_index < f_ranges->size())
+    {
+        f_it = (*f_ranges)[f_index].begin();
+        skip_empty();
+    }
+}
+
+
+/** \brief Move to the next range if the current one is done.
+ */
+void addr_range::vector_view::const_iterator::skip_empty()
+{
+    while(f_it == addr_range::const_iterator())
+    {
+        ++f_index;
+        if(f_index >= f_ranges->size())
+        {
+            f_index = f_ranges->size();
+            break;
+        }
+        f_it = (*f_ranges)[f_index].begin();
+    }
+}
+
+
+/** \brief Get the current address.
+ *
+ * \return A reference to the current address.
+ */
+addr_range::vector_view::const_iterator::reference addr_range::vector_view::const_iterator::operator * () const
+{
+    return *f_it;
+}
+
+
+/** \brief Access the current address.
+ *
+ * \return A pointer to the current address.
+ */
+addr_range::vector_view::const_iterator::pointer addr_range::vector_view::const_iterator::operator -> () const
+{
+    return f_it.operator -> ();
+}
+
+
+/** \brief Move to the next address.
+ *
+ * \return A reference to this iterator.
+ */
+addr_range::vector_view::const_iterator & addr_range::vector_view::const_iterator::operator ++ ()
+{
+    ++f_it;
+    skip_empty();
+    return *this;
+}
+
+
+/** \brief Move to the next address.
+ *
+ * \return A copy of the iterator before it was incremented.
+ */
+addr_range::vector_view::const_iterator addr_range::vector_view::const_iterator::operator ++ (int)
+{
+    const_iterator const result(*this);
+    ++*this;
+    return result;
+}
+
+
+/** \brief Compare two iterators.
+ *
+ * \param[in] rhs  The other iterator.
+ *
+ * \return true if both iterators are equal.
+ */
+bool addr_range::vector_view::const_iterator::operator == (const_iterator const & rhs) const
+{
+    return f_index == rhs.f_index
+        && f_it == rhs.f_it;
+}
+
+
+/** \brief Compare two iterators.
+ *
+ * \param[in] rhs  The other iterator.
+ *
+ * \return true if both iterators are different.
+ */
+bool addr_range::vector_view::const_iterator::operator != (const_iterator const & rhs) const
+{
+    return !operator == (rhs);
+}
+
+
 /** \brief Transform the range into a string.
  *
  * This function converts this range in a string.
@@ -528,47 +1097,88 @@ addr::vector_t addr_range::to_addresses(vector_t ranges, std::size_t limit)
  * \return The range or the "<empty address range>" string.
  */
 std::string addr_range::to_string(string_ip_t const mode) const
+{
+    char buf[ADDR_STRING_BUFFER_SIZE * 2];
+    std::size_t const length(to_buffer(buf, sizeof(buf), mode));
+    if(length < sizeof(buf))
+    {
+        return std::string(buf, length);
+    }
+
+    // this happens when the port name is very long
+    //
+    std::string result(length, '\0');
+    to_buffer(result.data(), length + 1, mode);
+    return result;
+}
+
+
+/** \brief Write the range in a buffer.
+ *
+ * This function is the same as to_string() except that it writes the
+ * result in the buffer supplied by the caller. Like the
+ * addr::to_buffer() function, it works like snprintf(): the output is
+ * truncated if necessary, it always gets null terminated (unless
+ * \p size is zero) and the function returns the length of the complete
+ * output.
+ *
+ * A buffer of `ADDR_STRING_BUFFER_SIZE * 2` characters is enough for
+ * any range except when the port name is requested.
+ *
+ * \param[out] buf  The buffer where the range gets written.
+ * \param[in] size  The size of \p buf in characters.
+ * \param[in] mode  The mode used to generate the addresses.
+ *
+ * \return The length of the complete output.
+ */
+std::size_t addr_range::to_buffer(char * buf, std::size_t size, string_ip_t const mode) const
 {
     if(is_empty()
     || (!has_from() && !has_to()))
     {
-        return std::string("<empty address range>");
+        char const empty[] = "<empty address range>";
+        if(size > 0)
+        {
+            std::size_t const length(std::min(size - 1, sizeof(empty) - 1));
+            memcpy(buf, empty, length);
+            buf[length] = '\0';
+        }
+        return sizeof(empty) - 1;
     }
 
-    std::string result;
+    if(size > 0)
+    {
+        buf[0] = '\0';
+    }
 
-    if(has_from() && has_to())
+    std::size_t length(0);
+    if(has_from())
     {
-        // we do not want the port nor mask in the from address
+        // we do not want the port nor mask in the from address if we
+        // also have a to address
         //
-        string_ip_t const from_mode(mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS));
-
         // WARNING: we are assuming that the from & to data has the same
         //          port information (which should be the case if you used
         //          the parser)
         //
-        std::string const from(f_from.to_ipv4or6_string(from_mode));
-        std::string const to(f_to.to_ipv4or6_string(mode));
-
-        result.reserve(from.length() + 1 + to.length());
-        result = from;
-        result += '-';
-        result += to;
-    }
-    else if(has_from())
-    {
-        result = f_from.to_ipv4or6_string(mode);
+        length = f_from.to_buffer(
+                  buf
+                , size
+                , has_to() ? mode & (STRING_IP_ADDRESS | STRING_IP_BRACKET_ADDRESS) : mode);
     }
-    else //if(has_to()) -- this is the only other possible case, no need to test
+    if(has_to())
     {
-        std::string const to(f_to.to_ipv4or6_string(mode));
+        if(length + 1 < size)
+        {
+            buf[length] = '-';
+        }
+        ++length;
 
-        result.reserve(1 + to.length());
-        result += '-';
-        result += f_to.to_ipv4or6_string(mode);
+        std::size_t const offset(std::min(length, size));
+        length += f_to.to_buffer(buf + offset, size - offset, mode);
     }
 
-    return result;
+    return length;
 }
 
 
@@ -614,7 +1224,16 @@ std::string addr_range::to_string(
         {
             result += separator;
         }
-        result += r.to_string(mode);
+        char buf[ADDR_STRING_BUFFER_SIZE * 2];
+        std::size_t const length(r.to_buffer(buf, sizeof(buf), mode));
+        if(length < sizeof(buf))
+        {
+            result.append(buf, length);
+        }
+        else
+        {
+            result += r.to_string(mode);
+        }
     }
 
     return result;
@@ -990,6 +1609,65 @@ compare_t addr_range::compare(addr_range const & rhs, bool mixed) const
 }
 
 
+/** \brief Compute a hash of this range.
+ *
+ * This function computes a hash of the range so it can be used in an
+ * unordered container such as addr_range::unordered_set_t. It is used
+ * by the std::hash<addr::addr_range> specialization.
+ *
+ * The hash is compatible with the operator == () of the range.
+ *
+ * \return A hash of this range.
+ */
+std::size_t addr_range::hash() const
+{
+    std::uint64_t h((f_has_from ? 1 : 0) | (f_has_to ? 2 : 0));
+    if(f_has_from)
+    {
+        h = hash_mix(h ^ f_from.hash());
+    }
+    if(f_has_to)
+    {
+        h = hash_mix(h ^ (f_to.hash() + 0x9e3779b97f4a7c15ULL));
+    }
+    return h;
+}
+
+
+/** \brief Check whether two ranges are equal.
+ *
+ * Two ranges are considered equal when they both have the same
+ * "from" and "to" flags and the addresses that are defined are equal.
+ * The addresses are compared with the addr::operator == () so the
+ * masks, ports, etc. are ignored.
+ *
+ * \param[in] rhs  The other range to compare against.
+ *
+ * \return true if both ranges are equal.
+ */
+bool addr_range::operator == (addr_range const & rhs) const
+{
+    return f_has_from == rhs.f_has_from
+        && f_has_to == rhs.f_has_to
+        && (!f_has_from || f_from == rhs.f_from)
+        && (!f_has_to || f_to == rhs.f_to);
+}
+
+
+/** \brief Check whether two ranges are different.
+ *
+ * \param[in] rhs  The other range to compare against.
+ *
+ * \return true if both ranges are not equal.
+ *
+ * \sa operator == ()
+ */
+bool addr_range::operator != (addr_range const & rhs) const
+{
+    return !operator == (rhs);
+}
+
+
 /** \brief Compare for smaller or larger.
  *
  * The `<` operator is used to sort a vector of address range.
@@ -1031,12 +1709,17 @@ bool addr_range::operator < (addr_range const & rhs) const
  * ranges as a result. This function allows you to check whether an
  * address matches any one of those ranges.
  *
+ * \note
+ * This function does a linear search. If you have a large number of
+ * ranges and many addresses to check, consider using an addr_lpm_table
+ * instead.
+ *
  * \param[in] ranges  The vector of ranges to search for \p address.
  * \param[in] address  The address to search in \p ranges.
  *
  * \return true if \p address matches any one of the \p ranges.
  */
-bool address_match_ranges(addr_range::vector_t ranges, addr const & address)
+bool address_match_ranges(addr_range::vector_t const & ranges, addr const & address)
 {
     auto const it(std::find_if
             ( ranges.begin()
@@ -1051,6 +1734,200 @@ bool address_match_ranges(addr_range::vector_t ranges, addr const & address)
 }
 
 
+/** \brief Sort and merge a vector of ranges.
+ *
+ * This function sorts the ranges and then merges the ones that overlap
+ * or are adjacent using the addr_range::union_if_possible() function.
+ * This is what the addr_parser does when the SORT_MERGE flag is set.
+ *
+ * The merge is done in a single pass: the merged ranges are written
+ * in place and the vector is truncated once at the end. So the function
+ * runs in O(n log n) (the cost of the sort). When the input is already
+ * sorted, the sort is skipped and the function runs in O(n).
+ *
+ * \param[in,out] ranges  The vector of ranges to normalize.
+ */
+void normalize_ranges(addr_range::vector_t & ranges)
+{
+    if(!std::is_sorted(ranges.begin(), ranges.end()))
+    {
+        std::stable_sort(ranges.begin(), ranges.end());
+    }
+
+    std::size_t const max(ranges.size());
+    std::size_t last(0);
+    for(std::size_t idx(1); idx < max; ++idx)
+    {
+        addr_range const r(ranges[last].union_if_possible(ranges[idx]));
+        if(r.is_defined()
+        && !r.is_empty())
+        {
+            ranges[last] = r;
+        }
+        else
+        {
+            ++last;
+            if(last != idx)
+            {
+                ranges[last] = ranges[idx];
+            }
+        }
+    }
+    if(max > 0)
+    {
+        ranges.resize(last + 1);
+    }
+}
+
+
+/** \brief Aggregate a vector of CIDRs.
+ *
+ * This function transforms the list of CIDRs (addresses with a mask)
+ * in a list of prefixes covering the same addresses.
+ *
+ * The \p flags parameter defines the optimizations to apply:
+ *
+ * \li AGGREGATE_ABSORB -- a prefix covered by a larger prefix is removed.
+ * For example, 10.0.0.0/24 is removed when 10.0.0.0/16 is also present.
+ * \li AGGREGATE_MERGE -- two sibling prefixes are merged in their parent.
+ * For example, 10.0.0.0/24 and 10.0.1.0/24 become 10.0.0.0/23. This is
+ * repeated as long as siblings are found.
+ *
+ * With AGGREGATE_ALL, the result is the minimal set of CIDRs covering
+ * the input. Duplicates are always removed.
+ *
+ * The input is sorted and then the prefixes are processed in one pass
+ * with a stack, so the function runs in O(n log n).
+ *
+ * IPv4 addresses are never merged in a prefix larger than 0.0.0.0/0
+ * (i.e. `::ffff:0:0/96`) since that would make them IPv6 addresses.
+ * Addresses with a mask which is not a CIDR (see addr::get_mask_size())
+ * are returned as is at the end of the output.
+ *
+ * \note
+ * The output addresses have their mask applied. The port and other
+ * parameters are copied from one of the input addresses, they are
+ * otherwise ignored.
+ *
+ * \param[in] cidrs  The list of addresses with their mask.
+ * \param[in] flags  The aggregation to apply.
+ *
+ * \return The aggregated list of CIDRs sorted by address.
+ */
+addr::vector_t aggregate_cidrs(addr::vector_t const & cidrs, aggregate_t flags)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    typedef unsigned __int128   uint128_t;
+#pragma GCC diagnostic pop
+
+    struct prefix_t
+    {
+        uint128_t               f_network = 0;
+        int                     f_size = 0;
+        std::size_t             f_index = 0;
+    };
+
+    constexpr uint128_t const ipv4_mapped(static_cast<uint128_t>(0xFFFF) << 32);
+    constexpr uint128_t const ipv4_mask(~static_cast<uint128_t>(0) << 32);
+
+    addr::vector_t result;
+    std::vector<prefix_t> prefixes;
+    prefixes.reserve(cidrs.size());
+    for(std::size_t idx(0); idx < cidrs.size(); ++idx)
+    {
+        int const size(cidrs[idx].get_mask_size());
+        if(size >= 0)
+        {
+            uint128_t const mask(size == 0 ? 0 : ~static_cast<uint128_t>(0) << (128 - size));
+            prefixes.push_back({ cidrs[idx].ip_to_uint128() & mask, size, idx });
+        }
+    }
+
+    std::sort(
+          prefixes.begin()
+        , prefixes.end()
+        , [](prefix_t const & a, prefix_t const & b)
+        {
+            return a.f_network < b.f_network
+                || (a.f_network == b.f_network && a.f_size < b.f_size);
+        });
+
+    std::vector<prefix_t> stack;
+    for(auto const & p : prefixes)
+    {
+        if(!stack.empty())
+        {
+            prefix_t const & top(stack.back());
+            if(top.f_network == p.f_network
+            && top.f_size == p.f_size)
+            {
+                // duplicate
+                //
+                continue;
+            }
+            if((flags & AGGREGATE_ABSORB) != 0
+            && top.f_size <= p.f_size
+            && (top.f_size == 0
+                || ((top.f_network ^ p.f_network) >> (128 - top.f_size)) == 0))
+            {
+                // p is covered by top
+                //
+                continue;
+            }
+        }
+        stack.push_back(p);
+
+        if((flags & AGGREGATE_MERGE) != 0)
+        {
+            while(stack.size() >= 2)
+            {
+                prefix_t & lhs(stack[stack.size() - 2]);
+                prefix_t const & rhs(stack.back());
+                int const size(rhs.f_size);
+                if(size == 0
+                || lhs.f_size != size
+                || (size <= 96
+                    && ((lhs.f_network & ipv4_mask) == ipv4_mapped
+                        || (rhs.f_network & ipv4_mask) == ipv4_mapped)))
+                {
+                    break;
+                }
+                uint128_t const bit(static_cast<uint128_t>(1) << (128 - size));
+                if((lhs.f_network & bit) != 0
+                || (lhs.f_network | bit) != rhs.f_network)
+                {
+                    break;
+                }
+                lhs.f_size = size - 1;
+                stack.pop_back();
+            }
+        }
+    }
+
+    result.reserve(stack.size());
+    for(auto const & p : stack)
+    {
+        addr a(cidrs[p.f_index]);
+        a.ip_from_uint128(p.f_network);
+        a.set_mask_count(p.f_size);
+        result.push_back(a);
+    }
+
+    // keep the non-CIDR entries as is
+    //
+    for(auto const & a : cidrs)
+    {
+        if(a.get_mask_size() < 0)
+        {
+            result.push_back(a);
+        }
+    }
+
+    return result;
+}
+
+
 /** \brief Optimize a vector of addresses.
  *
  * This function checks whether an address is equal or included in another.
@@ -1062,6 +1939,13 @@ bool address_match_ranges(addr_range::vector_t ranges, addr const & address)
  * another. For example, 10.0.0.0/24 is included in 10.0.0.0/16 so it can
  * be optimized out.
  *
+ * \note
+ * The order of the addresses is preserved. The network including other
+ * addresses takes the place of the first address of that group, with its
+ * mask applied. The function sorts a copy of the prefixes so it runs in
+ * O(n log n). To also merge sibling networks (i.e. 10.0.0.0/24 and
+ * 10.0.1.0/24 become 10.0.0.0/23), call aggregate_cidrs() instead.
+ *
  * \warning
  * The function ignores the port information. So two networks that match,
  * ignoring the port, will be optimized.
@@ -1072,42 +1956,94 @@ bool address_match_ranges(addr_range::vector_t ranges, addr const & address)
  */
 bool optimize_vector(addr::vector_t & v)
 {
-    bool result(false);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    typedef unsigned __int128   uint128_t;
+#pragma GCC diagnostic pop
 
-    std::size_t max(v.size());
-    for(std::size_t i(0); i < max; ++i)
+    struct prefix_t
     {
-        addr_range ra;
-        ra.from_cidr(v[i]);
-        for(std::size_t j(i + 1); j < max; ++j)
+        uint128_t               f_network = 0;
+        int                     f_size = 0;
+        std::size_t             f_index = 0;
+    };
+
+    std::vector<prefix_t> prefixes;
+    prefixes.reserve(v.size());
+    for(std::size_t idx(0); idx < v.size(); ++idx)
+    {
+        int const size(v[idx].get_mask_size());
+        if(size >= 0)
         {
-            addr_range rb;
-            rb.from_cidr(v[j]);
+            uint128_t const mask(size == 0 ? 0 : ~static_cast<uint128_t>(0) << (128 - size));
+            prefixes.push_back({ v[idx].ip_to_uint128() & mask, size, idx });
+        }
+    }
 
-            addr_range const u(ra.union_if_possible(rb));
-            if(u.is_defined())
+    // the network including others comes first
+    //
+    std::sort(
+          prefixes.begin()
+        , prefixes.end()
+        , [](prefix_t const & a, prefix_t const & b)
+        {
+            if(a.f_network != b.f_network)
             {
-                // union was possible -- check whether result has valid CIDR
-                //
-                addr p(u.get_from());
-                addr q(p);
-                p.apply_mask();
-                q.apply_mask(true);
-                if(p == u.get_from()
-                && q == u.get_to())
-                {
-                    ra = u;
-                    v[i] = p;
-                    v.erase(v.begin() + j);
-                    --max;
-                    --j; // cancel the ++j in the for() loop
-                    result = true;
-                }
+                return a.f_network < b.f_network;
+            }
+            if(a.f_size != b.f_size)
+            {
+                return a.f_size < b.f_size;
             }
+            return a.f_index < b.f_index;
+        });
+
+    // for each address, the index of the network which includes it and
+    // for each network, the index of the first address it includes
+    //
+    constexpr std::size_t const KEEP(static_cast<std::size_t>(-1));
+    std::vector<std::size_t> included_in(v.size(), KEEP);
+    std::vector<std::size_t> first(v.size(), KEEP);
+    prefix_t const * top(nullptr);
+    for(auto const & p : prefixes)
+    {
+        if(top != nullptr
+        && top->f_size <= p.f_size
+        && (top->f_size == 0
+            || ((top->f_network ^ p.f_network) >> (128 - top->f_size)) == 0))
+        {
+            included_in[p.f_index] = top->f_index;
+            first[top->f_index] = std::min(first[top->f_index], p.f_index);
+            continue;
         }
+        top = &p;
     }
 
-    return result;
+    // the network takes the place of the first address of its group
+    //
+    addr::vector_t result;
+    result.reserve(v.size());
+    for(std::size_t idx(0); idx < v.size(); ++idx)
+    {
+        std::size_t const network(included_in[idx] == KEEP ? idx : included_in[idx]);
+        if(std::min(network, first[network]) != idx)
+        {
+            continue;
+        }
+        result.push_back(v[network]);
+        if(first[network] != KEEP)
+        {
+            result.back().apply_mask();
+        }
+    }
+
+    if(result.size() == v.size())
+    {
+        return false;
+    }
+
+    v.swap(result);
+    return true;
 }
 
 
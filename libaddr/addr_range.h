@@ -38,16 +38,106 @@
 #include    <libaddr/addr.h>
 
 
+// C++
+//
+#include    <iterator>
+
+
 
 namespace addr
 {
 
 
+typedef std::uint_fast16_t                  aggregate_t;
+
+constexpr aggregate_t const                 AGGREGATE_ABSORB    = 0x0001;       // remove prefixes covered by a larger prefix
+constexpr aggregate_t const                 AGGREGATE_MERGE     = 0x0002;       // merge sibling prefixes in their parent prefix
+constexpr aggregate_t const                 AGGREGATE_ALL       = AGGREGATE_ABSORB | AGGREGATE_MERGE;
+
+
 class addr_range
 {
 public:
     typedef std::shared_ptr<addr_range>     pointer_t;
     typedef std::vector<addr_range>         vector_t;
+    typedef std::unordered_set<addr_range>  unordered_set_t;
+
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef addr                        value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef addr const *                pointer;
+        typedef addr const &                reference;
+
+                                    const_iterator();
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+                                    const_iterator(
+                                          addr const & first
+                                        , unsigned __int128 last
+                                        , unsigned __int128 step);
+
+        const_iterator &            operator += (unsigned __int128 count);
+#pragma GCC diagnostic pop
+
+        reference                   operator * () const;
+        pointer                     operator -> () const;
+        const_iterator &            operator ++ ();
+        const_iterator              operator ++ (int);
+        bool                        operator == (const_iterator const & rhs) const;
+        bool                        operator != (const_iterator const & rhs) const;
+
+    private:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        unsigned __int128           f_value = 0;
+        unsigned __int128           f_last = 0;
+        unsigned __int128           f_step = 1;
+#pragma GCC diagnostic pop
+        bool                        f_done = true;
+        addr                        f_address = addr();
+    };
+
+    class vector_view
+    {
+    public:
+        class const_iterator
+        {
+        public:
+            typedef std::forward_iterator_tag   iterator_category;
+            typedef addr                        value_type;
+            typedef std::ptrdiff_t              difference_type;
+            typedef addr const *                pointer;
+            typedef addr const &                reference;
+
+                                        const_iterator();
+                                        const_iterator(vector_t const * ranges, std::size_t index);
+
+            reference                   operator * () const;
+            pointer                     operator -> () const;
+            const_iterator &            operator ++ ();
+            const_iterator              operator ++ (int);
+            bool                        operator == (const_iterator const & rhs) const;
+            bool                        operator != (const_iterator const & rhs) const;
+
+        private:
+            void                        skip_empty();
+
+            vector_t const *            f_ranges = nullptr;
+            std::size_t                 f_index = 0;
+            addr_range::const_iterator  f_it = addr_range::const_iterator();
+        };
+
+                                    vector_view(vector_t const & ranges);
+
+        const_iterator              begin() const;
+        const_iterator              end() const;
+
+    private:
+        vector_t const &            f_ranges;
+    };
 
     bool                            has_from() const;
     bool                            has_to() const;
@@ -66,8 +156,22 @@ public:
     void                            swap_from_to();
     void                            from_cidr(addr const & a);
     bool                            to_cidr(addr & a) const;
+    addr::vector_t                  to_cidrs() const;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    bool                            to_uint128_interval(
+                                          unsigned __int128 & from
+                                        , unsigned __int128 & to) const;
+#pragma GCC diagnostic pop
     addr::vector_t                  to_addresses(std::size_t limit = 1000) const;
+    const_iterator                  begin() const;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    const_iterator                  begin(unsigned __int128 offset, unsigned __int128 step = 1) const;
+#pragma GCC diagnostic pop
+    const_iterator                  end() const;
     std::string                     to_string(string_ip_t const mode = STRING_IP_ALL) const;
+    std::size_t                     to_buffer(char * buf, std::size_t size, string_ip_t const mode = STRING_IP_ALL) const;
     static std::string              to_string(
                                           vector_t const & ranges
                                         , string_ip_t const mode = STRING_IP_ALL
@@ -78,9 +182,12 @@ public:
     addr_range                      union_if_possible(addr_range const & rhs) const;
     bool                            match(addr const & address) const;
     compare_t                       compare(addr_range const & rhs, bool mixed = false) const;
+    std::size_t                     hash() const;
+    bool                            operator == (addr_range const & rhs) const;
+    bool                            operator != (addr_range const & rhs) const;
     bool                            operator < (addr_range const & rhs) const;
 
-    static addr::vector_t           to_addresses(vector_t ranges, std::size_t limit = 1000);
+    static addr::vector_t           to_addresses(vector_t const & ranges, std::size_t limit = 1000);
 
 private:
     bool                            f_has_from = false;
@@ -90,7 +197,9 @@ private:
 };
 
 
-bool address_match_ranges(addr_range::vector_t ranges, addr const & address);
+bool address_match_ranges(addr_range::vector_t const & ranges, addr const & address);
+void normalize_ranges(addr_range::vector_t & ranges);
+addr::vector_t aggregate_cidrs(addr::vector_t const & cidrs, aggregate_t flags = AGGREGATE_ALL);
 bool optimize_vector(addr::vector_t & v);
 
 
@@ -98,14 +207,15 @@ template<typename _CharT, typename _Traits>
 inline std::basic_ostream<_CharT, _Traits> &
 operator << (std::basic_ostream<_CharT, _Traits> & out, addr_range const & range)
 {
-    _ostream_info * info(static_cast<_ostream_info *>(out.pword(get_ostream_index())));
-    if(info == nullptr)
+    string_ip_t const mode(_get_addr_mode(out));
+    char buf[ADDR_STRING_BUFFER_SIZE * 2];
+    if(range.to_buffer(buf, sizeof(buf), mode) < sizeof(buf))
     {
-        out << range.to_string(STRING_IP_ALL);
+        out << buf;
     }
     else
     {
-        out << range.to_string(info->f_mode);
+        out << range.to_string(mode);
     }
     return out;
 }
@@ -115,16 +225,17 @@ template<typename _CharT, typename _Traits>
 inline std::basic_ostream<_CharT, _Traits> &
 operator << (std::basic_ostream<_CharT, _Traits> & out, addr_range::vector_t const & ranges)
 {
+    string_ip_t const mode(_get_addr_mode(out));
     _ostream_info * info(static_cast<_ostream_info *>(out.pword(get_ostream_index())));
     if(info == nullptr)
     {
-        out << addr_range::to_string(ranges);
+        out << addr_range::to_string(ranges, mode);
     }
     else
     {
         out << addr_range::to_string(
                   ranges
-                , info->f_mode
+                , mode
                 , info->f_sep);
     }
     return out;
@@ -137,4 +248,18 @@ operator << (std::basic_ostream<_CharT, _Traits> & out, addr_range::vector_t con
 
 }
 // namespace addr
+
+
+namespace std
+{
+template<>
+struct hash<addr::addr_range>
+{
+    std::size_t operator () (addr::addr_range const & range) const noexcept
+    {
+        return range.hash();
+    }
+};
+}
+// namespace std
 // vim: ts=4 sw=4 et
@@ -0,0 +1,307 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+/** \file
+ * \brief The implementation of the addr_range_index class.
+ *
+ * This file includes the implementation of the addr_range_index class.
+ * The ranges are saved as two flat arrays of 128 bit numbers (the "from"
+ * and the "to" of each interval) which makes the search cache friendly.
+ */
+
+// self
+//
+#include    "libaddr/addr_range_index.h"
+#include    "libaddr/exception.h"
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace addr
+{
+
+
+/** \brief Initialize an empty index.
+ *
+ * An empty index does not contain any address.
+ */
+addr_range_index::addr_range_index()
+{
+}
+
+
+/** \brief Initialize an index from a list of ranges.
+ *
+ * This constructor calls set_ranges() with \p ranges.
+ *
+ * \param[in] ranges  The ranges to save in this index.
+ */
+addr_range_index::addr_range_index(addr_range::vector_t const & ranges)
+{
+    set_ranges(ranges);
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Replace the ranges of this index.
+ *
+ * This function transforms each range in an interval of 128 bit numbers,
+ * sorts them, and merges the intervals which overlap or touch each
+ * other. The result is a list of sorted non-overlapping intervals.
+ *
+ * The ranges are interpreted the same way as the addr_range::match()
+ * function does:
+ *
+ * \li a range with a "from" and a "to" represents all the addresses
+ * between "from" and "to" inclusive; the masks are ignored;
+ * \li a range with only a "from" or only a "to" represents the CIDR
+ * defined by that address and its mask;
+ * \li an empty or undefined range does not represent any address.
+ *
+ * \exception addr_unsupported_as_range
+ * A "from" or "to" only range with a mask which is not a valid CIDR
+ * can't be represented as one interval and this exception is raised.
+ *
+ * \param[in] ranges  The list of ranges to save in this index.
+ */
+void addr_range_index::set_ranges(addr_range::vector_t const & ranges)
+{
+    std::vector<std::pair<key_t, key_t>> intervals;
+    intervals.reserve(ranges.size());
+    for(auto const & r : ranges)
+    {
+        key_t from(0);
+        key_t to(0);
+        bool valid(false);
+        try
+        {
+            valid = r.to_uint128_interval(from, to);
+        }
+        catch(addr_unsupported_as_range const &)
+        {
+            throw addr_unsupported_as_range("addr_range_index only supports CIDR masks");
+        }
+        if(valid)
+        {
+            intervals.emplace_back(from, to);
+        }
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+
+    key_vector_t from;
+    key_vector_t to;
+    from.reserve(intervals.size());
+    to.reserve(intervals.size());
+    for(auto const & i : intervals)
+    {
+        if(!to.empty()
+        && (i.first <= to.back() || i.first - 1 == to.back()))
+        {
+            // overlap or adjacent, merge with previous interval
+            //
+            to.back() = std::max(to.back(), i.second);
+        }
+        else
+        {
+            from.push_back(i.first);
+            to.push_back(i.second);
+        }
+    }
+    from.shrink_to_fit();
+    to.shrink_to_fit();
+
+    f_from.swap(from);
+    f_to.swap(to);
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Remove all the ranges from this index.
+ *
+ * After this call, the index does not contain any address.
+ */
+void addr_range_index::clear()
+{
+    f_from.clear();
+    f_to.clear();
+}
+
+
+/** \brief Check whether the index is empty.
+ *
+ * \return true if the index does not contain any address.
+ */
+bool addr_range_index::empty() const
+{
+    return f_from.empty();
+}
+
+
+/** \brief Retrieve the number of intervals in this index.
+ *
+ * The index merges ranges which overlap or touch each other so this
+ * number may be smaller than the number of ranges used to create the
+ * index.
+ *
+ * \return The number of non-overlapping intervals.
+ */
+std::size_t addr_range_index::size() const
+{
+    return f_from.size();
+}
+
+
+/** \brief Retrieve the normalized list of ranges.
+ *
+ * This function converts the intervals back to ranges. The ranges are
+ * sorted and do not overlap. Each range has a "from" and a "to" address,
+ * even if the "from" and "to" are equal.
+ *
+ * \return The normalized vector of ranges.
+ */
+addr_range::vector_t addr_range_index::to_ranges() const
+{
+    addr_range::vector_t result;
+    result.reserve(f_from.size());
+    for(std::size_t idx(0); idx < f_from.size(); ++idx)
+    {
+        addr from;
+        from.ip_from_uint128(f_from[idx]);
+        addr to;
+        to.ip_from_uint128(f_to[idx]);
+        addr_range r;
+        r.set_from(from);
+        r.set_to(to);
+        result.push_back(r);
+    }
+    return result;
+}
+
+
+/** \brief Check whether an address is part of this index.
+ *
+ * This function searches the intervals with a binary search that
+ * compiles to conditional moves instead of branches.
+ *
+ * \param[in] address  The address to search.
+ *
+ * \return true if \p address is included in one of the intervals.
+ */
+bool addr_range_index::contains(addr const & address) const
+{
+    return contains_key(address.ip_to_uint128());
+}
+
+
+/** \brief Check whether each address is part of this index.
+ *
+ * This function checks all the addresses in \p addresses and saves the
+ * result of each check in \p result. The \p result vector is resized to
+ * \p count entries.
+ *
+ * \param[in] addresses  A pointer to an array of addresses.
+ * \param[in] count  The number of addresses in \p addresses.
+ * \param[out] result  The result of each check.
+ *
+ * \return The number of addresses that are included in this index.
+ */
+std::size_t addr_range_index::contains(addr const * addresses, std::size_t count, std::vector<bool> & result) const
+{
+    result.resize(count);
+    std::size_t found(0);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        bool const in(contains_key(addresses[idx].ip_to_uint128()));
+        result[idx] = in;
+        found += in;
+    }
+    return found;
+}
+
+
+/** \brief Check whether each address is part of this index.
+ *
+ * This function is an overload which accepts a vector of addresses.
+ *
+ * \param[in] addresses  The addresses to check.
+ * \param[out] result  The result of each check.
+ *
+ * \return The number of addresses that are included in this index.
+ */
+std::size_t addr_range_index::contains(addr::vector_t const & addresses, std::vector<bool> & result) const
+{
+    return contains(addresses.data(), addresses.size(), result);
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Search a key in the intervals.
+ *
+ * The loop always runs log2(n) times and the only condition selects
+ * which half to keep, which the compiler transforms in a conditional
+ * move. This avoids mispredicted branches when searching random
+ * addresses.
+ *
+ * \param[in] key  The address as a 128 bit number.
+ *
+ * \return true if \p key is included in one of the intervals.
+ */
+bool addr_range_index::contains_key(key_t key) const
+{
+    std::size_t n(f_from.size());
+    if(n == 0)
+    {
+        return false;
+    }
+
+    key_t const * base(f_from.data());
+    while(n > 1)
+    {
+        std::size_t const half(n / 2);
+        base = base[half] <= key ? base + half : base;
+        n -= half;
+    }
+
+    std::size_t const idx(base - f_from.data());
+    return *base <= key && key <= f_to[idx];
+}
+#pragma GCC diagnostic pop
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
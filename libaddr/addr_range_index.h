@@ -0,0 +1,80 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief The addr_range_index class.
+ *
+ * This header defines the addr_range_index class used to quickly check
+ * whether an address is part of a large list of ranges. The ranges are
+ * normalized in a sorted array of non-overlapping intervals which is
+ * searched with a binary search.
+ */
+
+// self
+//
+#include    <libaddr/addr_range.h>
+
+
+
+namespace addr
+{
+
+
+class addr_range_index
+{
+public:
+    typedef std::shared_ptr<addr_range_index>   pointer_t;
+
+                                    addr_range_index();
+                                    addr_range_index(addr_range::vector_t const & ranges);
+
+    void                            set_ranges(addr_range::vector_t const & ranges);
+    void                            clear();
+
+    bool                            empty() const;
+    std::size_t                     size() const;
+    addr_range::vector_t            to_ranges() const;
+
+    bool                            contains(addr const & address) const;
+    std::size_t                     contains(addr const * addresses, std::size_t count, std::vector<bool> & result) const;
+    std::size_t                     contains(addr::vector_t const & addresses, std::vector<bool> & result) const;
+
+private:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    typedef unsigned __int128       key_t;
+    typedef std::vector<key_t>      key_vector_t;
+
+    bool                            contains_key(key_t key) const;
+#pragma GCC diagnostic pop
+
+    key_vector_t                    f_from = key_vector_t();
+    key_vector_t                    f_to = key_vector_t();
+};
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
@@ -0,0 +1,495 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+/** \file
+ * \brief The implementation of the addr_range_set class.
+ *
+ * This file includes the implementation of the addr_range_set class.
+ * The set is a sorted vector of non-overlapping and non-adjacent
+ * intervals of 128 bit numbers. The set operations walk both vectors
+ * once, in order, so they all run in O(n + m).
+ */
+
+// self
+//
+#include    "libaddr/addr_range_set.h"
+#include    "libaddr/exception.h"
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace addr
+{
+
+
+/** \brief Initialize an empty set.
+ *
+ * An empty set does not contain any address.
+ */
+addr_range_set::addr_range_set()
+{
+}
+
+
+/** \brief Initialize a set from a list of ranges.
+ *
+ * This constructor calls set_ranges() with \p ranges.
+ *
+ * \param[in] ranges  The ranges to save in this set.
+ */
+addr_range_set::addr_range_set(addr_range::vector_t const & ranges)
+{
+    set_ranges(ranges);
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Replace the ranges of this set.
+ *
+ * This function transforms each range in an interval of 128 bit numbers,
+ * sorts them, and merges the intervals which overlap or touch each
+ * other.
+ *
+ * The ranges are interpreted the same way as the addr_range::match()
+ * function does:
+ *
+ * \li a range with a "from" and a "to" represents all the addresses
+ * between "from" and "to" inclusive; the masks are ignored;
+ * \li a range with only a "from" or only a "to" represents the CIDR
+ * defined by that address and its mask;
+ * \li an empty or undefined range does not represent any address.
+ *
+ * \exception addr_unsupported_as_range
+ * A "from" or "to" only range with a mask which is not a valid CIDR
+ * can't be represented as one interval and this exception is raised.
+ *
+ * \param[in] ranges  The list of ranges to save in this set.
+ */
+void addr_range_set::set_ranges(addr_range::vector_t const & ranges)
+{
+    interval_vector_t intervals;
+    intervals.reserve(ranges.size());
+    for(auto const & r : ranges)
+    {
+        key_t from(0);
+        key_t to(0);
+        bool valid(false);
+        try
+        {
+            valid = r.to_uint128_interval(from, to);
+        }
+        catch(addr_unsupported_as_range const &)
+        {
+            throw addr_unsupported_as_range("addr_range_set only supports CIDR masks");
+        }
+        if(valid)
+        {
+            intervals.emplace_back(from, to);
+        }
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+
+    f_intervals.clear();
+    f_intervals.reserve(intervals.size());
+    for(auto const & i : intervals)
+    {
+        append(i.first, i.second);
+    }
+    f_intervals.shrink_to_fit();
+}
+
+
+/** \brief Append an interval at the end of the set.
+ *
+ * The \p from parameter must be larger or equal to the "from" of the
+ * last interval. If the new interval overlaps or touches the last
+ * interval, then both get merged.
+ *
+ * \param[in] from  The first address of the interval.
+ * \param[in] to  The last address of the interval.
+ */
+void addr_range_set::append(key_t from, key_t to)
+{
+    if(!f_intervals.empty()
+    && (from <= f_intervals.back().second || from - 1 == f_intervals.back().second))
+    {
+        // overlap or adjacent, merge with previous interval
+        //
+        f_intervals.back().second = std::max(f_intervals.back().second, to);
+    }
+    else
+    {
+        f_intervals.emplace_back(from, to);
+    }
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Remove all the ranges from this set.
+ *
+ * After this call, the set does not contain any address.
+ */
+void addr_range_set::clear()
+{
+    f_intervals.clear();
+}
+
+
+/** \brief Check whether the set is empty.
+ *
+ * \return true if the set does not contain any address.
+ */
+bool addr_range_set::empty() const
+{
+    return f_intervals.empty();
+}
+
+
+/** \brief Retrieve the number of intervals in this set.
+ *
+ * This is the number of ranges returned by to_ranges(). To get the
+ * number of addresses, use cardinality().
+ *
+ * \return The number of non-overlapping intervals.
+ */
+std::size_t addr_range_set::size() const
+{
+    return f_intervals.size();
+}
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+/** \brief Retrieve the number of addresses in this set.
+ *
+ * This function returns the total number of addresses included in the
+ * set.
+ *
+ * \note
+ * The whole IPv6 space includes 2^128 addresses which does not fit in
+ * 128 bits. In that one case, the function returns 2^128 - 1.
+ *
+ * \return The number of addresses in this set.
+ */
+unsigned __int128 addr_range_set::cardinality() const
+{
+    key_t const max(~static_cast<key_t>(0));
+    key_t result(0);
+    for(auto const & i : f_intervals)
+    {
+        key_t const count(i.second - i.first);
+        if(count == max
+        || max - result <= count)
+        {
+            return max;
+        }
+        result += count + 1;
+    }
+    return result;
+}
+#pragma GCC diagnostic pop
+
+
+/** \brief Check whether an address is part of this set.
+ *
+ * \param[in] address  The address to search.
+ *
+ * \return true if \p address is included in one of the intervals.
+ */
+bool addr_range_set::contains(addr const & address) const
+{
+    key_t const key(address.ip_to_uint128());
+    auto const it(std::upper_bound(
+              f_intervals.begin()
+            , f_intervals.end()
+            , key
+            , [](key_t k, interval_t const & i)
+            {
+                return k < i.first;
+            }));
+    return it != f_intervals.begin()
+        && key <= std::prev(it)->second;
+}
+
+
+/** \brief Retrieve the normalized list of ranges.
+ *
+ * This function converts the intervals back to ranges. The ranges are
+ * sorted and do not overlap. Each range has a "from" and a "to" address,
+ * even if the "from" and "to" are equal.
+ *
+ * \return The normalized vector of ranges.
+ */
+addr_range::vector_t addr_range_set::to_ranges() const
+{
+    addr_range::vector_t result;
+    result.reserve(f_intervals.size());
+    for(auto const & i : f_intervals)
+    {
+        addr from;
+        from.ip_from_uint128(i.first);
+        addr to;
+        to.ip_from_uint128(i.second);
+        addr_range r;
+        r.set_from(from);
+        r.set_to(to);
+        result.push_back(r);
+    }
+    return result;
+}
+
+
+/** \brief Retrieve the set as a list of CIDRs.
+ *
+ * This function converts each interval to the minimal list of CIDRs
+ * representing it (see addr_range::to_cidrs()). Since the intervals
+ * do not touch each other, the result is also the minimal list of
+ * CIDRs representing the whole set.
+ *
+ * \return The set as a sorted list of CIDRs.
+ */
+addr::vector_t addr_range_set::to_cidrs() const
+{
+    addr::vector_t result;
+    for(auto const & r : to_ranges())
+    {
+        addr::vector_t const cidrs(r.to_cidrs());
+        result.insert(result.end(), cidrs.begin(), cidrs.end());
+    }
+    return result;
+}
+
+
+/** \brief Compute the union of two sets.
+ *
+ * The result includes all the addresses found in this set or in \p rhs.
+ *
+ * \param[in] rhs  The other set.
+ *
+ * \return The union of both sets.
+ */
+addr_range_set addr_range_set::set_union(addr_range_set const & rhs) const
+{
+    addr_range_set result;
+    result.f_intervals.reserve(f_intervals.size() + rhs.f_intervals.size());
+
+    auto a(f_intervals.begin());
+    auto b(rhs.f_intervals.begin());
+    while(a != f_intervals.end()
+       || b != rhs.f_intervals.end())
+    {
+        if(b == rhs.f_intervals.end()
+        || (a != f_intervals.end() && a->first < b->first))
+        {
+            result.append(a->first, a->second);
+            ++a;
+        }
+        else
+        {
+            result.append(b->first, b->second);
+            ++b;
+        }
+    }
+
+    return result;
+}
+
+
+/** \brief Compute the intersection of two sets.
+ *
+ * The result includes the addresses found in both, this set and \p rhs.
+ *
+ * \param[in] rhs  The other set.
+ *
+ * \return The intersection of both sets.
+ */
+addr_range_set addr_range_set::set_intersection(addr_range_set const & rhs) const
+{
+    addr_range_set result;
+
+    auto a(f_intervals.begin());
+    auto b(rhs.f_intervals.begin());
+    while(a != f_intervals.end()
+       && b != rhs.f_intervals.end())
+    {
+        key_t const from(std::max(a->first, b->first));
+        key_t const to(std::min(a->second, b->second));
+        if(from <= to)
+        {
+            result.f_intervals.emplace_back(from, to);
+        }
+        if(a->second < b->second)
+        {
+            ++a;
+        }
+        else
+        {
+            ++b;
+        }
+    }
+
+    return result;
+}
+
+
+/** \brief Compute the difference of two sets.
+ *
+ * The result includes the addresses found in this set and not in \p rhs.
+ * This is useful to compute an "allowlist minus blocklist".
+ *
+ * \param[in] rhs  The set of addresses to remove from this set.
+ *
+ * \return This set minus \p rhs.
+ */
+addr_range_set addr_range_set::set_difference(addr_range_set const & rhs) const
+{
+    addr_range_set result;
+
+    auto b(rhs.f_intervals.begin());
+    for(auto const & a : f_intervals)
+    {
+        // skip the intervals which end before this one starts
+        //
+        while(b != rhs.f_intervals.end()
+           && b->second < a.first)
+        {
+            ++b;
+        }
+
+        key_t from(a.first);
+        bool done(false);
+        for(auto it(b); it != rhs.f_intervals.end() && it->first <= a.second; ++it)
+        {
+            if(it->first > from)
+            {
+                result.f_intervals.emplace_back(from, it->first - 1);
+            }
+            if(it->second >= a.second)
+            {
+                done = true;
+                break;
+            }
+            from = it->second + 1;
+        }
+        if(!done)
+        {
+            result.f_intervals.emplace_back(from, a.second);
+        }
+    }
+
+    return result;
+}
+
+
+/** \brief Compute the complement of this set in the IPv4 space.
+ *
+ * The result includes all the IPv4 addresses (`::ffff:0.0.0.0` to
+ * `::ffff:255.255.255.255`) which are not in this set. IPv6 addresses
+ * found in this set are ignored.
+ *
+ * \return The IPv4 addresses not found in this set.
+ */
+addr_range_set addr_range_set::complement_ipv4() const
+{
+    key_t const from(static_cast<key_t>(0xFFFF) << 32);
+    return complement(from, from | 0xFFFFFFFF);
+}
+
+
+/** \brief Compute the complement of this set in the IPv6 space.
+ *
+ * The result includes all the IPv6 addresses which are not in this set.
+ * The IPv4 addresses (`::ffff:0:0/96`) are not considered part of
+ * the IPv6 space so they are never included in the result. Use
+ * complement_ipv4() to get those.
+ *
+ * \return The IPv6 addresses not found in this set.
+ */
+addr_range_set addr_range_set::complement_ipv6() const
+{
+    addr_range_set ipv4;
+    key_t const from(static_cast<key_t>(0xFFFF) << 32);
+    ipv4.f_intervals.emplace_back(from, from | 0xFFFFFFFF);
+
+    return complement(0, ~static_cast<key_t>(0)).set_difference(ipv4);
+}
+
+
+/** \brief Compute the complement of this set within an interval.
+ *
+ * \param[in] from  The first address of the space.
+ * \param[in] to  The last address of the space.
+ *
+ * \return The addresses between \p from and \p to not found in this set.
+ */
+addr_range_set addr_range_set::complement(key_t from, key_t to) const
+{
+    addr_range_set space;
+    space.f_intervals.emplace_back(from, to);
+    return space.set_difference(*this);
+}
+
+
+/** \brief Check whether two sets are equal.
+ *
+ * Since the sets are normalized, two sets including the same addresses
+ * are always equal.
+ *
+ * \param[in] rhs  The other set.
+ *
+ * \return true if both sets include the same addresses.
+ */
+bool addr_range_set::operator == (addr_range_set const & rhs) const
+{
+    return f_intervals == rhs.f_intervals;
+}
+
+
+/** \brief Check whether two sets are different.
+ *
+ * \param[in] rhs  The other set.
+ *
+ * \return true if the sets do not include the same addresses.
+ */
+bool addr_range_set::operator != (addr_range_set const & rhs) const
+{
+    return f_intervals != rhs.f_intervals;
+}
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief The addr_range_set class.
+ *
+ * This header defines the addr_range_set class used to compute the union,
+ * intersection, difference and complement of lists of ranges. The ranges
+ * are normalized in a sorted array of non-overlapping intervals so each
+ * operation is a single merge walk over both sets.
+ */
+
+// self
+//
+#include    <libaddr/addr_range.h>
+
+
+
+namespace addr
+{
+
+
+class addr_range_set
+{
+public:
+    typedef std::shared_ptr<addr_range_set>     pointer_t;
+
+                                    addr_range_set();
+                                    addr_range_set(addr_range::vector_t const & ranges);
+
+    void                            set_ranges(addr_range::vector_t const & ranges);
+    void                            clear();
+
+    bool                            empty() const;
+    std::size_t                     size() const;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    unsigned __int128               cardinality() const;
+#pragma GCC diagnostic pop
+    bool                            contains(addr const & address) const;
+    addr_range::vector_t            to_ranges() const;
+    addr::vector_t                  to_cidrs() const;
+
+    addr_range_set                  set_union(addr_range_set const & rhs) const;
+    addr_range_set                  set_intersection(addr_range_set const & rhs) const;
+    addr_range_set                  set_difference(addr_range_set const & rhs) const;
+    addr_range_set                  complement_ipv4() const;
+    addr_range_set                  complement_ipv6() const;
+
+    bool                            operator == (addr_range_set const & rhs) const;
+    bool                            operator != (addr_range_set const & rhs) const;
+
+private:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    typedef unsigned __int128       key_t;
+    typedef std::pair<key_t, key_t> interval_t;
+    typedef std::vector<interval_t> interval_vector_t;
+
+    void                            append(key_t from, key_t to);
+    addr_range_set                  complement(key_t from, key_t to) const;
+#pragma GCC diagnostic pop
+
+    interval_vector_t               f_intervals = interval_vector_t();
+};
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
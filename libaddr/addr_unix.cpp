@@ -32,6 +32,7 @@
 // self
 //
 #include    "libaddr/addr_unix.h"
+#include    "libaddr/addr.h"
 #include    "libaddr/exception.h"
 
 
@@ -783,6 +784,34 @@ int addr_unix::unlink()
 }
 
 
+/** \brief Compute a hash of this address.
+ *
+ * This function computes a hash of the Unix address so it can be used
+ * in an unordered container such as addr_unix::unordered_set_t. It is
+ * used by the std::hash<addr::addr_unix> specialization.
+ *
+ * The hash uses the same data as the operator == (), the scheme is
+ * ignored.
+ *
+ * \return A hash of the Unix address.
+ */
+std::size_t addr_unix::hash() const
+{
+    std::uint8_t const * a(reinterpret_cast<std::uint8_t const *>(&f_address));
+    std::uint64_t h(sizeof(f_address));
+    std::size_t idx(0);
+    for(; idx + sizeof(std::uint64_t) <= sizeof(f_address); idx += sizeof(std::uint64_t))
+    {
+        std::uint64_t v;
+        memcpy(&v, a + idx, sizeof(v));
+        h = hash_mix(h ^ v);
+    }
+    std::uint64_t v(0);
+    memcpy(&v, a + idx, sizeof(f_address) - idx);
+    return hash_mix(h ^ v);
+}
+
+
 /** \brief Check whether two addresses are equal.
  *
  * This function compares the left hand side (this) and the right
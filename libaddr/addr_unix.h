@@ -48,6 +48,7 @@
 //
 #include    <memory>
 #include    <string>
+#include    <unordered_set>
 #include    <vector>
 
 
@@ -87,6 +88,8 @@ class addr_unix
 public:
     typedef std::shared_ptr<addr_unix>  pointer_t;
     typedef std::vector<addr_unix>      vector_t;
+    typedef std::unordered_set<addr_unix>
+                                        unordered_set_t;
     typedef int                         socket_flag_t;
 
                                     addr_unix();
@@ -114,6 +117,8 @@ public:
     std::string                     to_uri() const;
     int                             unlink();
 
+    std::size_t                     hash() const;
+
     bool                            operator == (addr_unix const & rhs) const;
     bool                            operator != (addr_unix const & rhs) const;
     bool                            operator <  (addr_unix const & rhs) const;
@@ -174,5 +179,19 @@ inline bool operator >= (sockaddr_un const & a, sockaddr_un const & b)
 }
 
 
+namespace std
+{
+template<>
+struct hash<addr::addr_unix>
+{
+    std::size_t operator () (addr::addr_unix const & a) const noexcept
+    {
+        return a.hash();
+    }
+};
+}
+// namespace std
+
+
 
 // vim: ts=4 sw=4 et
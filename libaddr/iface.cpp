@@ -33,6 +33,9 @@
 // self
 //
 #include    "libaddr/iface.h"
+#include    "libaddr/addr_lpm_table.h"
+#include    "libaddr/exception.h"
+#include    "libaddr/netlink_private.h"
 #include    "libaddr/route.h"
 
 
@@ -41,23 +44,36 @@
 //
 #include    <cppthread/guard.h>
 #include    <cppthread/mutex.h>
+#include    <cppthread/runner.h>
+#include    <cppthread/thread.h>
 
 
 // snapdev
 //
 #include    <snapdev/not_reached.h>
+#include    <snapdev/raii_generic_deleter.h>
 
 
 // C++
 //
 #include    <algorithm>
+#include    <atomic>
 #include    <iostream>
+#include    <iterator>
+#include    <map>
+#include    <mutex>
 
 
 // C
 //
+#include    <fcntl.h>
 #include    <ifaddrs.h>
+#include    <linux/netlink.h>
+#include    <linux/rtnetlink.h>
 #include    <net/if.h>
+#include    <poll.h>
+#include    <sys/socket.h>
+#include    <unistd.h>
 
 
 // last include
@@ -70,6 +86,10 @@ namespace addr
 {
 
 
+class iface_cache;
+class iface_index;
+
+
 /** \brief Details used by the addr class implementation.
  *
  * We have a function to check whether an address is part of
@@ -90,7 +110,7 @@ namespace
  * After the TTL is elapsed, the next call ignores the cache and re-reads
  * the list of interfaces from the kernel.
  */
-std::uint32_t g_cache_ttl = 5 * 60;
+std::atomic<std::uint32_t> g_cache_ttl(5 * 60);
 
 
 /** \brief Cache lifetime.
@@ -98,7 +118,7 @@ std::uint32_t g_cache_ttl = 5 * 60;
  * This parameter is set to time(nullptr) + TTL whenever a new set of
  * interfaces is gathered from the OS.
  */
-time_t g_cache_timeout = 0;
+std::atomic<time_t> g_cache_timeout(0);
 
 
 /** \brief Array of interfaces.
@@ -106,6 +126,10 @@ time_t g_cache_timeout = 0;
  * This vector keeps the interfaces in our cache for a few minutes. This
  * way, functions that make heavy use of interfaces will still go fast.
  *
+ * The vector is never modified once saved here. A new list replaces
+ * it with std::atomic_store() and readers get it with std::atomic_load()
+ * so they never wait on a thread reading the interfaces.
+ *
  * You can call the reset_cache() function if you want to reset the
  * cache and make sure what you load is fresh. This is not necessary if
  * you just started your process.
@@ -113,6 +137,65 @@ time_t g_cache_timeout = 0;
 iface::pointer_vector_t g_cache_iface = iface::pointer_vector_t();
 
 
+/** \brief Mutex held while the list of interfaces gets updated.
+ *
+ * Only one thread reads the interfaces at a time. Other threads which
+ * find the cache out of date wait for that thread and then use its
+ * result instead of reading the interfaces again.
+ *
+ * The netlink monitor also holds this mutex while it updates the list.
+ */
+cppthread::mutex g_refresh_mutex = cppthread::mutex();
+
+
+/** \brief Mutex protecting the monitor and the callbacks.
+ */
+cppthread::mutex g_monitor_mutex = cppthread::mutex();
+
+
+/** \brief The netlink monitor, if running.
+ *
+ * This pointer is protected by g_monitor_mutex.
+ */
+iface_cache * g_monitor = nullptr;
+
+
+/** \brief Whether the netlink monitor keeps the cache current.
+ *
+ * While true, the TTL is ignored.
+ */
+std::atomic<bool> g_monitoring(false);
+
+
+/** \brief The callbacks to call on changes.
+ *
+ * This map is protected by g_monitor_mutex.
+ */
+std::map<iface::callback_id_t, iface::event_callback_t> g_callbacks = std::map<iface::callback_id_t, iface::event_callback_t>();
+
+
+/** \brief The identifier of the next callback.
+ */
+iface::callback_id_t g_next_callback_id = 0;
+
+
+/** \brief The index of the cached interfaces.
+ *
+ * The index is built from one list of interfaces. When the cache gets
+ * a new list, or the netlink monitor sees a route change, the index is
+ * rebuilt on the next search.
+ *
+ * Like the list, the index is never modified once saved here and it
+ * is accessed with std::atomic_load() and std::atomic_store().
+ */
+std::shared_ptr<iface_index const> g_cache_index = std::shared_ptr<iface_index const>();
+
+
+/** \brief Mutex held while the index gets built.
+ */
+cppthread::mutex g_index_mutex = cppthread::mutex();
+
+
 /** \brief Delete an ifaddrs structure.
  *
  * This deleter is used to make sure all the ifaddrs get released when
@@ -127,6 +210,7 @@ void ifaddrs_deleter(struct ifaddrs * ia)
 
 
 
+
 }
 // no name namespace
 
@@ -235,46 +319,78 @@ unsigned int get_interface_index_by_name(std::string const & name)
 
 
 
-/** \brief Return a list of local addresses on this machine.
- *
- * Peruse the list of available interfaces, and return any detected
- * ip addresses in a vector.
+/** \brief The interface cache updater.
  *
- * These addresses include:
- *
- * \li A mask whenever available (very likely if the interface is up).
- * \li A name you can retrieve with get_iface_name()
- * \li A set of flags defining the current status of the network interface
- *     (i.e. IFF_UP, IFF_BROADCAST, IFF_NOARP, etc.)
+ * This class reads the list of interfaces with getifaddrs() and, when
+ * the monitor is started, keeps that list current using the netlink
+ * RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR, and RTNLGRP_IPV6_IFADDR events.
  *
- * \note
- * The function caches the list of interfaces. On a second call, and if
- * the cache did not yet time out (see set_local_addresses_cache_ttl()
- * for details), then the same list is returned. You can prevent the
- * behavior by first clearing the cache (see reset_local_addresses_cache()
- * for details).
- * \note
- * The cache is managed in a thread safe manner.
+ * The monitor runs in its own thread. Each change creates a new list
+ * which replaces the cached list atomically. The iface objects are
+ * never modified once in a list, so readers can keep using a list
+ * as long as they want.
+ */
+class iface_cache
+    : public cppthread::runner
+{
+public:
+                            iface_cache(int netlink_socket, int wake_read, int wake_write);
+                            iface_cache(iface_cache const &) = delete;
+    iface_cache &           operator = (iface_cache const &) = delete;
+
+    static iface::pointer_vector_t
+                            read_interfaces();
+
+    bool                    start();
+    void                    stop();
+    virtual void            run() override;
+
+private:
+    typedef std::vector<std::pair<iface_event_t, iface::pointer_t>>
+                            events_t;
+
+    void                    reload();
+    void                    process(char const * buf, std::size_t size);
+    void                    address_changed(nlmsghdr const * h, events_t & events);
+    void                    link_changed(nlmsghdr const * h, events_t & events);
+    void                    publish(events_t const & events);
+
+    snapdev::raii_fd_t      f_socket;
+    snapdev::raii_fd_t      f_wake_read;
+    snapdev::raii_fd_t      f_wake_write;
+    std::map<std::string, unsigned int>
+                            f_link_flags = std::map<std::string, unsigned int>();
+    cppthread::thread       f_thread;
+};
+
+
+/** \brief Initialize the monitor.
  *
- * \return A vector of all the local interface IP addresses.
+ * The monitor takes ownership of the file descriptors.
  *
- * \sa set_local_addresses_cache_ttl()
- * \sa reset_local_addresses_cache()
+ * \param[in] netlink_socket  The socket receiving the netlink messages.
+ * \param[in] wake_read  The pipe used to wake up the thread on stop().
+ * \param[in] wake_write  The other side of the wake up pipe.
  */
-iface::pointer_vector_t iface::get_local_addresses()
+iface_cache::iface_cache(int netlink_socket, int wake_read, int wake_write)
+    : runner("iface_cache")
+    , f_socket(netlink_socket)
+    , f_wake_read(wake_read)
+    , f_wake_write(wake_write)
+    , f_thread("iface_cache", this)
 {
-    // check whether we have that vector in our cache, if so use that
-    {
-        cppthread::guard lock(*cppthread::g_system_mutex);
+}
 
-        if(g_cache_timeout >= time(nullptr)
-        && g_cache_iface != nullptr)
-        {
-            return g_cache_iface;
-        }
-        g_cache_iface = std::make_shared<vector_t>();
-    }
 
+/** \brief Read the list of interfaces from the kernel.
+ *
+ * This function calls getifaddrs() and transforms the results in a
+ * vector of iface objects.
+ *
+ * \return The list of interfaces or a null pointer on error.
+ */
+iface::pointer_vector_t iface_cache::read_interfaces()
+{
     // get the list of interface addresses
     //
     struct ifaddrs * ifa_start(nullptr);
@@ -288,7 +404,7 @@ iface::pointer_vector_t iface::get_local_addresses()
     std::shared_ptr<struct ifaddrs> auto_free(ifa_start, ifaddrs_deleter);
 
     uint8_t mask[16];
-    iface::pointer_vector_t iface_list(std::make_shared<vector_t>());
+    iface::pointer_vector_t iface_list(std::make_shared<iface::vector_t>());
     for(struct ifaddrs * ifa(ifa_start); ifa != nullptr; ifa = ifa->ifa_next)
     {
         // the documentation says there may be no addresses at all
@@ -381,13 +497,522 @@ iface::pointer_vector_t iface::get_local_addresses()
         iface_list->push_back(the_interface);
     }
 
+    return iface_list;
+}
+
+
+/** \brief Start the monitor thread.
+ *
+ * The cache gets reloaded first since events may have been missed
+ * before the socket was listening.
+ *
+ * \return true if the thread started.
+ */
+bool iface_cache::start()
+{
+    reload();
+    return f_thread.start();
+}
+
+
+/** \brief Stop the monitor thread.
+ *
+ * This function wakes up the thread and waits for it to exit.
+ */
+void iface_cache::stop()
+{
+    char const c('s');
+    if(write(f_wake_write.get(), &c, 1) != 1)
+    {
+        return; // LCOV_EXCL_LINE
+    }
+    f_thread.stop();
+}
+
+
+/** \brief Read the netlink messages until stopped.
+ *
+ * If the kernel could not send all the events (ENOBUFS), the whole list
+ * of interfaces is read again. In that case, no events are sent to the
+ * callbacks.
+ */
+void iface_cache::run()
+{
+    // netlink messages are aligned on 4 bytes
+    //
+    alignas(nlmsghdr) char buf[16 * 1024];
+    for(;;)
+    {
+        pollfd fds[2] = {};
+        fds[0].fd = f_socket.get();
+        fds[0].events = POLLIN;
+        fds[1].fd = f_wake_read.get();
+        fds[1].events = POLLIN;
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return; // LCOV_EXCL_LINE
+        }
+        if(fds[1].revents != 0)
+        {
+            return;
+        }
+        if((fds[0].revents & POLLIN) == 0)
+        {
+            return; // LCOV_EXCL_LINE
+        }
+
+        ssize_t const size(recv(f_socket.get(), buf, sizeof(buf), 0));
+        if(size < 0)
+        {
+            if(errno == ENOBUFS)
+            {
+                reload();
+            }
+            else if(errno != EINTR
+                 && errno != EAGAIN)
+            {
+                return; // LCOV_EXCL_LINE
+            }
+            continue;
+        }
+        if(size == 0)
+        {
+            return;
+        }
+        process(buf, size);
+    }
+}
+
+
+/** \brief Read the interfaces and save them in the cache.
+ */
+void iface_cache::reload()
+{
+    cppthread::guard lock(g_refresh_mutex);
+
+    iface::pointer_vector_t list(read_interfaces());
+    if(list == nullptr)
+    {
+        return; // LCOV_EXCL_LINE
+    }
+
+    f_link_flags.clear();
+    for(auto const & i : *list)
+    {
+        f_link_flags[i->f_name] = i->f_flags;
+    }
+
+    std::atomic_store(&g_cache_iface, list);
+}
+
+
+/** \brief Process a buffer of netlink messages.
+ *
+ * \param[in] buf  The buffer with the messages.
+ * \param[in] size  The number of bytes in \p buf.
+ */
+void iface_cache::process(char const * buf, std::size_t size)
+{
+    events_t events;
+    bool routes_changed(false);
+    {
+        cppthread::guard lock(g_refresh_mutex);
+
+        // when the cache was reset, the next reader reads everything
+        // so we only need to check for route changes
+        //
+        iface::pointer_vector_t current(std::atomic_load(&g_cache_iface));
+        iface::pointer_vector_t list;
+        if(current != nullptr)
+        {
+            list = std::make_shared<iface::vector_t>(*current);
+        }
+
+        int len(static_cast<int>(size));
+        for(nlmsghdr const * h(reinterpret_cast<nlmsghdr const *>(buf));
+            NLMSG_OK(h, len);
+            h = NLMSG_NEXT(h, len))
+        {
+            switch(h->nlmsg_type)
+            {
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                if(list != nullptr)
+                {
+                    address_changed(h, events);
+                }
+                break;
+
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                if(list != nullptr)
+                {
+                    link_changed(h, events);
+                }
+                break;
+
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                routes_changed = true;
+                break;
+
+            default:
+                // NLMSG_DONE, NLMSG_ERROR, etc.
+                break;
+
+            }
+        }
+
+        // apply the events to the new list
+        //
+        for(auto const & e : events)
+        {
+            auto same(std::find_if(
+                      list->begin()
+                    , list->end()
+                    , [&e](iface::pointer_t const & i)
+                      {
+                          return i->f_name == e.second->f_name
+                              && i->f_address == e.second->f_address;
+                      }));
+            if(e.first == iface_event_t::IFACE_EVENT_ADDRESS_REMOVED)
+            {
+                if(same != list->end())
+                {
+                    list->erase(same);
+                }
+            }
+            else if(same != list->end())
+            {
+                *same = e.second;
+            }
+            else
+            {
+                list->push_back(e.second);
+            }
+        }
+
+        if(list != nullptr)
+        {
+            std::atomic_store(&g_cache_iface, list);
+        }
+    }
+
+    if(routes_changed)
+    {
+        // the index keeps the default interface, drop it too
+        //
+        route::reset_routes_cache();
+        std::atomic_store(&g_cache_index, std::shared_ptr<iface_index const>());
+    }
+
+    publish(events);
+}
+
+
+/** \brief Convert an address message.
+ *
+ * This function transforms an RTM_NEWADDR or RTM_DELADDR message in
+ * an iface object and adds the corresponding event to \p events.
+ *
+ * An RTM_NEWADDR for an address which is already known (the kernel
+ * sends those when the lifetime of an IPv6 address gets updated)
+ * generates an IFACE_EVENT_LINK_CHANGED event instead of an
+ * IFACE_EVENT_ADDRESS_ADDED.
+ *
+ * \param[in] h  The netlink message.
+ * \param[in,out] events  The list of events.
+ */
+void iface_cache::address_changed(nlmsghdr const * h, events_t & events)
+{
+    ifaddrmsg const * msg(nlmsg_payload<ifaddrmsg>(h));
+    int len(static_cast<int>(IFA_PAYLOAD(h)));
+    if(len < 0
+    || (msg->ifa_family != AF_INET && msg->ifa_family != AF_INET6))
+    {
+        return;
+    }
+
+    void const * local(nullptr);
+    void const * address(nullptr);
+    void const * broadcast(nullptr);
+    std::string name;
+    for(rtattr const * rta(IFA_RTA(msg)); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        switch(rta->rta_type)
+        {
+        case IFA_LOCAL:
+            local = RTA_DATA(rta);
+            break;
+
+        case IFA_ADDRESS:
+            address = RTA_DATA(rta);
+            break;
+
+        case IFA_BROADCAST:
+            broadcast = RTA_DATA(rta);
+            break;
+
+        case IFA_LABEL:
+            name = static_cast<char const *>(RTA_DATA(rta));
+            break;
+
+        }
+    }
+    if(local == nullptr)
+    {
+        local = address;
+    }
+    if(local == nullptr)
+    {
+        return;
+    }
+    if(name.empty())
+    {
+        char n[IF_NAMESIZE + 1];
+        if(if_indextoname(msg->ifa_index, n) == nullptr)
+        {
+            return;
+        }
+        n[IF_NAMESIZE] = '\0';
+        name = n;
+    }
+
+    iface::pointer_t the_interface(std::make_shared<iface>());
+    the_interface->f_name = name;
+    auto const flags(f_link_flags.find(name));
+    if(flags != f_link_flags.end())
+    {
+        the_interface->f_flags = flags->second;
+    }
+
+    if(msg->ifa_family == AF_INET)
+    {
+        sockaddr_in in = {};
+        in.sin_family = AF_INET;
+        memcpy(&in.sin_addr, local, sizeof(in.sin_addr));
+        the_interface->f_address.set_ipv4(in);
+        the_interface->f_address.set_mask_count(96 + std::min(msg->ifa_prefixlen, static_cast<unsigned char>(32)));
+        if(broadcast != nullptr)
+        {
+            memcpy(&in.sin_addr, broadcast, sizeof(in.sin_addr));
+            the_interface->f_broadcast_address.set_ipv4(in);
+        }
+        if(address != nullptr
+        && address != local
+        && memcmp(address, local, sizeof(in.sin_addr)) != 0)
+        {
+            memcpy(&in.sin_addr, address, sizeof(in.sin_addr));
+            the_interface->f_destination_address.set_ipv4(in);
+        }
+    }
+    else
+    {
+        sockaddr_in6 in6 = {};
+        in6.sin6_family = AF_INET6;
+        memcpy(&in6.sin6_addr, local, sizeof(in6.sin6_addr));
+        the_interface->f_address.set_ipv6(in6);
+        the_interface->f_address.set_mask_count(std::min(msg->ifa_prefixlen, static_cast<unsigned char>(128)));
+        if(address != nullptr
+        && address != local
+        && memcmp(address, local, sizeof(in6.sin6_addr)) != 0)
+        {
+            memcpy(&in6.sin6_addr, address, sizeof(in6.sin6_addr));
+            the_interface->f_destination_address.set_ipv6(in6);
+        }
+    }
+
+    if(h->nlmsg_type == RTM_DELADDR)
+    {
+        events.emplace_back(iface_event_t::IFACE_EVENT_ADDRESS_REMOVED, the_interface);
+        return;
+    }
+
+    // the kernel also sends RTM_NEWADDR when a known address gets
+    // updated (i.e. the lifetime of an IPv6 address), report a change
+    //
+    iface::pointer_vector_t current(std::atomic_load(&g_cache_iface));
+    bool const known(std::find_if(
+              current->begin()
+            , current->end()
+            , [&the_interface](iface::pointer_t const & i)
+              {
+                  return i->f_name == the_interface->f_name
+                      && i->f_address == the_interface->f_address;
+              }) != current->end());
+    events.emplace_back(
+              known
+                ? iface_event_t::IFACE_EVENT_LINK_CHANGED
+                : iface_event_t::IFACE_EVENT_ADDRESS_ADDED
+            , the_interface);
+}
+
+
+/** \brief Convert a link message.
+ *
+ * An RTM_NEWLINK message changes the flags of all the addresses of
+ * that interface. An RTM_DELLINK message removes all of them.
+ *
+ * \param[in] h  The netlink message.
+ * \param[in,out] events  The list of events.
+ */
+void iface_cache::link_changed(nlmsghdr const * h, events_t & events)
+{
+    ifinfomsg const * msg(nlmsg_payload<ifinfomsg>(h));
+    int len(static_cast<int>(IFLA_PAYLOAD(h)));
+    if(len < 0)
+    {
+        return;
+    }
+
+    std::string name;
+    for(rtattr const * rta(IFLA_RTA(msg)); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
     {
-        cppthread::guard lock(*cppthread::g_system_mutex);
+        if(rta->rta_type == IFLA_IFNAME)
+        {
+            name = static_cast<char const *>(RTA_DATA(rta));
+        }
+    }
+    if(name.empty())
+    {
+        return;
+    }
+
+    bool const removed(h->nlmsg_type == RTM_DELLINK);
+    if(removed)
+    {
+        f_link_flags.erase(name);
+    }
+    else
+    {
+        auto const it(f_link_flags.find(name));
+        if(it != f_link_flags.end()
+        && it->second == msg->ifi_flags)
+        {
+            return;
+        }
+        f_link_flags[name] = msg->ifi_flags;
+    }
+
+    iface::pointer_vector_t current(std::atomic_load(&g_cache_iface));
+    for(auto const & i : *current)
+    {
+        if(i->f_name == name)
+        {
+            if(removed)
+            {
+                events.emplace_back(iface_event_t::IFACE_EVENT_ADDRESS_REMOVED, i);
+            }
+            else
+            {
+                iface::pointer_t updated(std::make_shared<iface>(*i));
+                updated->f_flags = msg->ifi_flags;
+                events.emplace_back(iface_event_t::IFACE_EVENT_LINK_CHANGED, updated);
+            }
+        }
+    }
+}
+
 
+/** \brief Call the callbacks with the events.
+ *
+ * The callbacks are called from the monitor thread, after the new list
+ * was saved in the cache.
+ *
+ * \param[in] events  The events to send.
+ */
+void iface_cache::publish(events_t const & events)
+{
+    if(events.empty())
+    {
+        return;
+    }
+
+    std::vector<iface::event_callback_t> callbacks;
+    {
+        cppthread::guard lock(g_monitor_mutex);
+        for(auto const & c : g_callbacks)
+        {
+            callbacks.push_back(c.second);
+        }
+    }
+
+    for(auto const & e : events)
+    {
+        for(auto const & c : callbacks)
+        {
+            c(e.first, e.second);
+        }
+    }
+}
+
+
+
+
+/** \brief Return a list of local addresses on this machine.
+ *
+ * Peruse the list of available interfaces, and return any detected
+ * ip addresses in a vector.
+ *
+ * These addresses include:
+ *
+ * \li A mask whenever available (very likely if the interface is up).
+ * \li A name you can retrieve with get_iface_name()
+ * \li A set of flags defining the current status of the network interface
+ *     (i.e. IFF_UP, IFF_BROADCAST, IFF_NOARP, etc.)
+ *
+ * \note
+ * The function caches the list of interfaces. On a second call, and if
+ * the cache did not yet time out (see set_local_addresses_cache_ttl()
+ * for details), then the same list is returned. You can prevent the
+ * behavior by first clearing the cache (see reset_local_addresses_cache()
+ * for details).
+ * \note
+ * While the netlink monitor runs (see start_local_addresses_monitor()),
+ * the TTL is ignored since the monitor keeps the list current.
+ * \note
+ * The cache is managed in a thread safe manner. The returned list is
+ * never modified. When the cache times out, only one thread reads
+ * the interfaces again; the others wait for its result.
+ *
+ * \return A vector of all the local interface IP addresses.
+ *
+ * \sa set_local_addresses_cache_ttl()
+ * \sa reset_local_addresses_cache()
+ */
+iface::pointer_vector_t iface::get_local_addresses()
+{
+    // check whether we have that vector in our cache, if so use that
+    //
+    iface::pointer_vector_t cache(std::atomic_load(&g_cache_iface));
+    if(cache != nullptr
+    && (g_monitoring || g_cache_timeout >= time(nullptr)))
+    {
+        return cache;
+    }
+
+    cppthread::guard lock(g_refresh_mutex);
+
+    // another thread may have read the interfaces while we were waiting
+    //
+    cache = std::atomic_load(&g_cache_iface);
+    if(cache != nullptr
+    && (g_monitoring || g_cache_timeout >= time(nullptr)))
+    {
+        return cache;
+    }
+
+    cache = iface_cache::read_interfaces();
+    if(cache != nullptr)
+    {
         g_cache_timeout = time(nullptr) + g_cache_ttl;
-        g_cache_iface.swap(iface_list);
-        return g_cache_iface;
+        std::atomic_store(&g_cache_iface, cache);
     }
+    return cache;
 }
 
 
@@ -399,10 +1024,10 @@ iface::pointer_vector_t iface::get_local_addresses()
  */
 void iface::reset_local_addresses_cache()
 {
-    cppthread::guard lock(*cppthread::g_system_mutex);
+    cppthread::guard lock(g_refresh_mutex);
 
     g_cache_timeout = 0;
-    g_cache_iface.reset();
+    std::atomic_store(&g_cache_iface, iface::pointer_vector_t());
 }
 
 
@@ -411,7 +1036,8 @@ void iface::reset_local_addresses_cache()
  * By default the TTL of the interface cache is set to 5 minutes. If you do
  * not expect any changes, you could grow this number quite a bit. If you
  * do expect a lot of changes all the time, then a much smaller number
- * should be used.
+ * should be used. If you want the list to always be current, start the
+ * netlink monitor instead.
  *
  * 0 does not cancel the use of the cache entirely. Instead, it will be
  * used for up to one second.
@@ -420,6 +1046,8 @@ void iface::reset_local_addresses_cache()
  * This function is thread safe.
  *
  * \param[in] duration_seconds  The duration of the interface cache.
+ *
+ * \sa start_local_addresses_monitor()
  */
 void iface::set_local_addresses_cache_ttl(std::uint32_t duration_seconds)
 {
@@ -427,6 +1055,158 @@ void iface::set_local_addresses_cache_ttl(std::uint32_t duration_seconds)
 }
 
 
+/** \brief Keep the interface cache current with netlink events.
+ *
+ * This function starts a thread listening to the netlink
+ * RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR, and RTNLGRP_IPV6_IFADDR groups.
+ * Each time an address gets added or removed or the flags of an
+ * interface change, the cache is updated and the callbacks registered
+ * with add_local_addresses_callback() get called.
+ *
+ * The monitor also listens to the RTNLGRP_IPV4_ROUTE and
+ * RTNLGRP_IPV6_ROUTE groups. Each time a route changes, the route
+ * cache gets reset (see route::reset_routes_cache()).
+ *
+ * While the monitor runs, get_local_addresses() always returns the
+ * cached list without checking the TTL.
+ *
+ * By default, the function creates its own netlink socket. You may
+ * instead pass a socket (or any other datagram file descriptor, which
+ * is useful in tests) that receives netlink messages. The monitor
+ * takes ownership of that file descriptor.
+ *
+ * \param[in] netlink_socket  A socket receiving the netlink messages or
+ * -1 to let the function create one.
+ *
+ * \return true if the monitor is running. false if the socket could not
+ * be created or the monitor was already running.
+ *
+ * \sa stop_local_addresses_monitor()
+ */
+bool iface::start_local_addresses_monitor(int netlink_socket)
+{
+    snapdev::raii_fd_t s(netlink_socket);
+
+    cppthread::guard lock(g_monitor_mutex);
+    if(g_monitor != nullptr)
+    {
+        return false;
+    }
+
+    if(s.get() == -1)
+    {
+        snapdev::raii_fd_t nl(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+        if(nl.get() == -1)
+        {
+            return false; // LCOV_EXCL_LINE
+        }
+        sockaddr_nl local = {};
+        local.nl_family = AF_NETLINK;
+        local.nl_groups = RTMGRP_LINK
+                        | RTMGRP_IPV4_IFADDR
+                        | RTMGRP_IPV6_IFADDR
+                        | RTMGRP_IPV4_ROUTE
+                        | RTMGRP_IPV6_ROUTE;
+        if(bind(nl.get(), reinterpret_cast<sockaddr const *>(&local), sizeof(local)) != 0)
+        {
+            return false; // LCOV_EXCL_LINE
+        }
+        s.swap(nl);
+    }
+
+    int wake[2];
+    if(pipe2(wake, O_CLOEXEC) != 0)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+
+    std::unique_ptr<iface_cache> monitor(std::make_unique<iface_cache>(s.release(), wake[0], wake[1]));
+    g_monitoring = true;
+    if(!monitor->start())
+    {
+        g_monitoring = false; // LCOV_EXCL_LINE
+        return false; // LCOV_EXCL_LINE
+    }
+    g_monitor = monitor.release();
+    return true;
+}
+
+
+/** \brief Stop the netlink monitor.
+ *
+ * This function stops the thread started by
+ * start_local_addresses_monitor(). The cache goes back to using the
+ * TTL. The callbacks remain registered.
+ */
+void iface::stop_local_addresses_monitor()
+{
+    std::unique_ptr<iface_cache> monitor;
+    {
+        cppthread::guard lock(g_monitor_mutex);
+        monitor.reset(g_monitor);
+        g_monitor = nullptr;
+    }
+    if(monitor != nullptr)
+    {
+        monitor->stop();
+        g_monitoring = false;
+
+        // the TTL was not maintained while monitoring
+        //
+        g_cache_timeout = time(nullptr) + g_cache_ttl;
+    }
+}
+
+
+/** \brief Check whether the netlink monitor is running.
+ *
+ * \return true if start_local_addresses_monitor() was called successfully
+ * and stop_local_addresses_monitor() was not yet called.
+ */
+bool iface::is_local_addresses_monitor_running()
+{
+    return g_monitoring;
+}
+
+
+/** \brief Add a callback called on interface changes.
+ *
+ * The \p callback is called from the monitor thread each time an
+ * address is added or removed or the flags of an interface change.
+ * The cache is already updated when the callback is called.
+ *
+ * The callbacks are only called while the monitor runs.
+ *
+ * \param[in] callback  The function to call.
+ *
+ * \return An identifier to use with remove_local_addresses_callback().
+ *
+ * \sa start_local_addresses_monitor()
+ */
+iface::callback_id_t iface::add_local_addresses_callback(event_callback_t const & callback)
+{
+    cppthread::guard lock(g_monitor_mutex);
+    ++g_next_callback_id;
+    g_callbacks[g_next_callback_id] = callback;
+    return g_next_callback_id;
+}
+
+
+/** \brief Remove a callback.
+ *
+ * \note
+ * The monitor may still call the callback once after this call if it
+ * was already sending an event.
+ *
+ * \param[in] id  The identifier returned by add_local_addresses_callback().
+ */
+void iface::remove_local_addresses_callback(callback_id_t id)
+{
+    cppthread::guard lock(g_monitor_mutex);
+    g_callbacks.erase(id);
+}
+
+
 /** \brief Get the interface name.
  *
  * This function returns the name of the interface such as 'eth0' or 'p4p1'.
@@ -574,6 +1354,228 @@ bool iface::has_destination_address() const
 
 
 
+/** \brief The index used to search the interfaces.
+ *
+ * The find_addr_interface() and is_broadcast_address() functions are
+ * called often (i.e. for each UDP packet received). Instead of going
+ * through the list of interfaces each time, they use this index:
+ *
+ * \li an LPM table of the interface subnets,
+ * \li a hash of the broadcast addresses, and
+ * \li the interface of the default route, read once.
+ */
+class iface_index
+{
+public:
+    typedef std::shared_ptr<iface_index const>  pointer_t;
+
+                            iface_index(iface::pointer_vector_t const & interfaces);
+
+    iface::pointer_vector_t const &
+                            get_interfaces() const;
+    iface::pointer_t        find_interface(addr const & a) const;
+    iface::pointer_t        find_broadcast(addr const & a) const;
+    iface::pointer_t        get_default_interface() const;
+
+private:
+    iface::pointer_vector_t f_interfaces;
+    addr_lpm_table          f_subnets = addr_lpm_table();
+    iface::vector_t         f_subnet_interfaces = iface::vector_t();
+    iface::vector_t         f_unindexed = iface::vector_t();
+    addr::unordered_map_t<iface::pointer_t>
+                            f_broadcast = addr::unordered_map_t<iface::pointer_t>();
+    mutable std::once_flag  f_default_once = std::once_flag();
+    mutable iface::pointer_t
+                            f_default_interface = iface::pointer_t();
+};
+
+
+/** \brief Build the index of a list of interfaces.
+ *
+ * The interfaces are added to the LPM table in reverse order so when
+ * two interfaces use the exact same subnet, the first one in the list
+ * is found, as with a linear search.
+ *
+ * An interface with a mask which is not a valid CIDR cannot be added
+ * to the LPM table. Such interfaces are searched linearly.
+ *
+ * \param[in] interfaces  The list of interfaces to index.
+ */
+iface_index::iface_index(iface::pointer_vector_t const & interfaces)
+    : f_interfaces(interfaces)
+{
+    if(f_interfaces == nullptr)
+    {
+        return;
+    }
+
+    for(auto it(f_interfaces->rbegin()); it != f_interfaces->rend(); ++it)
+    {
+        addr_range range;
+        range.set_from((*it)->get_address());
+        try
+        {
+            std::size_t const idx(f_subnets.insert(range));
+            if(idx >= f_subnet_interfaces.size())
+            {
+                f_subnet_interfaces.resize(idx + 1);
+            }
+            f_subnet_interfaces[idx] = *it;
+        }
+        catch(addr_unsupported_as_range const &)
+        {
+            f_unindexed.insert(f_unindexed.begin(), *it);
+        }
+    }
+
+    for(auto const & i : *f_interfaces)
+    {
+        if(i->has_broadcast_address())
+        {
+            f_broadcast.emplace(i->get_broadcast_address(), i);
+        }
+    }
+}
+
+
+/** \brief Get the list of interfaces this index was built from.
+ *
+ * \return The indexed list of interfaces.
+ */
+iface::pointer_vector_t const & iface_index::get_interfaces() const
+{
+    return f_interfaces;
+}
+
+
+/** \brief Search the interface with the most specific subnet.
+ *
+ * \param[in] a  The address to search.
+ *
+ * \return The interface or a null pointer.
+ */
+iface::pointer_t iface_index::find_interface(addr const & a) const
+{
+    std::size_t const idx(f_subnets.find_index(a));
+    if(idx != addr_lpm_table::NO_RANGE)
+    {
+        return f_subnet_interfaces[idx];
+    }
+
+    for(auto const & i : f_unindexed)
+    {
+        if(i->get_address().match(a))
+        {
+            return i;
+        }
+    }
+
+    return iface::pointer_t();
+}
+
+
+/** \brief Search the interface using \p a as its broadcast address.
+ *
+ * \param[in] a  The address to search.
+ *
+ * \return The interface or a null pointer.
+ */
+iface::pointer_t iface_index::find_broadcast(addr const & a) const
+{
+    auto const it(f_broadcast.find(a));
+    if(it == f_broadcast.end())
+    {
+        return iface::pointer_t();
+    }
+    return it->second;
+}
+
+
+/** \brief Get the interface of the default route.
+ *
+ * The default route is searched in the cached routes (see
+ * route::get_routes()) the first time this function gets called. The
+ * result is then kept along the index, so the following calls do not
+ * lock anything or read the routes again.
+ *
+ * The index is replaced whenever the list of interfaces changes. The
+ * netlink monitor also drops the index when a route changes.
+ *
+ * \return The interface of the default route or a null pointer.
+ */
+iface::pointer_t iface_index::get_default_interface() const
+{
+    std::call_once(f_default_once, [this]()
+    {
+        // to determine the default interface, we need the list of routes
+        // so we first gather that information and then search for the
+        // interface that has that name
+        //
+        route::pointer_vector_t const all_routes(route::get_routes());
+        route::vector_t routes;
+        std::copy_if(
+                  all_routes->cbegin()
+                , all_routes->cend()
+                , std::back_inserter(routes)
+                , [](auto const & r)
+                {
+                    return r->get_destination_address().is_ipv4();
+                });
+        route::pointer_t default_route(find_default_route(routes));
+        if(default_route != nullptr
+        && f_interfaces != nullptr)
+        {
+            std::string const & default_iface(default_route->get_interface_name());
+            auto it(std::find_if(
+                      f_interfaces->cbegin()
+                    , f_interfaces->cend()
+                    , [default_iface](auto const & i)
+                    {
+                        return i->get_name() == default_iface;
+                    }));
+            if(it != f_interfaces->cend())
+            {
+                f_default_interface = *it;
+            }
+        }
+    });
+
+    return f_default_interface;
+}
+
+
+/** \brief Get the index of the current list of interfaces.
+ *
+ * This function gets the current list of interfaces and returns its
+ * index, building it if the list changed since the last call.
+ *
+ * \return The index of the current interfaces.
+ */
+iface_index::pointer_t get_index()
+{
+    iface::pointer_vector_t interfaces(iface::get_local_addresses());
+    iface_index::pointer_t index(std::atomic_load(&g_cache_index));
+    if(index != nullptr
+    && index->get_interfaces() == interfaces)
+    {
+        return index;
+    }
+
+    cppthread::guard lock(g_index_mutex);
+
+    index = std::atomic_load(&g_cache_index);
+    if(index != nullptr
+    && index->get_interfaces() == interfaces)
+    {
+        return index;
+    }
+
+    index = std::make_shared<iface_index const>(interfaces);
+    std::atomic_store(&g_cache_index, index);
+    return index;
+}
+
+
 /** \brief Search for the interface corresponding to this address.
  *
  * Peruse the list of available interfaces and return the one that matches
@@ -587,10 +1589,16 @@ bool iface::has_destination_address() const
  * If the address is a remote address, then this function returns a null
  * pointer.
  *
- * \warning
- * If you allow for the default destination, this function calls the
- * route::get_ipv4_routes() function which can be costly. Try to avoid
- * doing that in a loop.
+ * If several interfaces match, the one with the most specific subnet
+ * is returned. The search uses an index of the cached interfaces (see
+ * iface::get_local_addresses()) so it is fast enough to be called for
+ * each packet.
+ *
+ * \note
+ * If you allow for the default destination, the first call which needs
+ * it after the index gets rebuilt searches the default route in the
+ * cached routes (see route::get_routes()). The result is then kept
+ * along the index.
  *
  * \param[in] a  The address used to search for an interface.
  * \param[in] allow_default_destination  If true and \p a doesn't match
@@ -601,58 +1609,27 @@ bool iface::has_destination_address() const
  */
 iface::pointer_t find_addr_interface(addr const & a, bool allow_default_destination)
 {
-    iface::pointer_vector_t interfaces(iface::get_local_addresses());
-
-    for(auto i : *interfaces)
-    {
-        if(i->get_address().match(a))
-        {
-            return i;
-        }
-    }
+    iface_index::pointer_t index(get_index());
 
-    // if there is a default, keep a copy in case we do not find a
-    // local address while looking (and only if the user requested
-    // such, which is the default)
-    //
-    if(!allow_default_destination)
+    iface::pointer_t result(index->find_interface(a));
+    if(result != nullptr
+    || !allow_default_destination)
     {
-        return iface::pointer_t();
+        return result;
     }
 
-    // to determine the default interface, we need the list of routes
-    // so we first gather that information and then search for the
-    // interface that has that name
+    // if there is a default, return it since we did not find a
+    // local address (and only if the user requested such, which is
+    // the default)
     //
-    route::vector_t routes(route::get_ipv4_routes());
-    route::pointer_t default_route(find_default_route(routes));
-    if(default_route == nullptr)
-    {
-        return iface::pointer_t(); // LCOV_EXCL_LINE
-    }
-
-    std::string const & default_iface(default_route->get_interface_name());
-    auto it(std::find_if(
-              interfaces->cbegin()
-            , interfaces->cend()
-            , [default_iface](auto const & i)
-            {
-                return i->get_name() == default_iface;
-            }));
-    if(it == interfaces->cend())
-    {
-        return iface::pointer_t(); // LCOV_EXCL_LINE
-    }
-
-    return *it;
+    return index->get_default_interface();
 }
 
 
 /** \brief Check whether \p a represents an interface's broadcast address.
  *
- * The function first searches for the address among the interfaces
- * available on this computer. If found, it then verifies that \p a
- * represents the broadcasting address of that interface.
+ * The function searches for the address among the broadcast addresses
+ * of the interfaces available on this computer.
  *
  * \warning
  * This test does not return true if the address is a multicase address
@@ -669,13 +1646,10 @@ iface::pointer_t find_addr_interface(addr const & a, bool allow_default_destinat
  * way, our applications will not detect a broadcast IP address if not
  * properly set in the interface.
  *
- * \todo
- * The current version does not cache anything so each call requires
- * us to list the interfaces and search through the vector. We may want
- * to look into a way to cache the data. The current version is that way
- * for two reasons: (1) in most cases the list is checked only once, and
- * (2) this way we can make sure to always test with the current set
- * of IPs in the system. Long term service need that ability.
+ * The search uses a hash of the broadcast addresses of the cached
+ * interfaces (see iface::get_local_addresses()). To always test with
+ * the current set of IPs in the system, start the netlink monitor
+ * (see iface::start_local_addresses_monitor()).
  *
  * \param[in] a  The address to check as a broadcast address.
  *
@@ -683,13 +1657,7 @@ iface::pointer_t find_addr_interface(addr const & a, bool allow_default_destinat
  */
 bool is_broadcast_address(addr const & a)
 {
-    iface::pointer_t ptr(find_addr_interface(a, false));
-    if(ptr == nullptr)
-    {
-        return false;
-    }
-
-    return ptr->get_broadcast_address() == a;
+    return get_index()->find_broadcast(a) != nullptr;
 }
 
 
@@ -34,6 +34,11 @@
 #include    <libaddr/addr.h>
 
 
+// C++
+//
+#include    <functional>
+
+
 
 namespace addr
 {
@@ -57,16 +62,32 @@ private:
 iface_index_name::vector_t          get_interface_name_index();
 
 
+enum class iface_event_t
+{
+    IFACE_EVENT_ADDRESS_ADDED,
+    IFACE_EVENT_ADDRESS_REMOVED,
+    IFACE_EVENT_LINK_CHANGED,
+};
+
+
 class iface
 {
 public:
     typedef std::shared_ptr<iface>      pointer_t;
     typedef std::vector<pointer_t>      vector_t;
     typedef std::shared_ptr<vector_t>   pointer_vector_t;
+    typedef std::function<void(iface_event_t event, pointer_t const & i)>
+                                        event_callback_t;
+    typedef int                         callback_id_t;
 
     static iface::pointer_vector_t  get_local_addresses();
     static void                     reset_local_addresses_cache();
     static void                     set_local_addresses_cache_ttl(std::uint32_t duration_seconds);
+    static bool                     start_local_addresses_monitor(int netlink_socket = -1);
+    static void                     stop_local_addresses_monitor();
+    static bool                     is_local_addresses_monitor_running();
+    static callback_id_t            add_local_addresses_callback(event_callback_t const & callback);
+    static void                     remove_local_addresses_callback(callback_id_t id);
 
     std::string                     get_name() const;
     unsigned int                    get_flags() const;
@@ -78,6 +99,8 @@ public:
     bool                            has_destination_address() const;
 
 private:
+    friend class iface_cache;
+
     std::string                     f_name = std::string();
     unsigned int                    f_flags = 0;
     addr                            f_address = addr();
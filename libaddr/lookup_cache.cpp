@@ -0,0 +1,1187 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+/** \file
+ * \brief The implementation of the lookup_cache class.
+ *
+ * The cache is broken up in SHARD_COUNT shards, each with its own mutex,
+ * LRU list, and hash map. A key always goes to the same shard so threads
+ * looking up different hosts rarely wait on each other.
+ *
+ * The forward (getaddrinfo()) and reverse (getnameinfo()) lookups use
+ * separate shards. The reverse lookups of get_names() are run by a
+ * small pool of threads.
+ */
+
+// self
+//
+#include    "libaddr/lookup_cache.h"
+#include    "libaddr/addr.h"
+
+
+// cppthread
+//
+#include    <cppthread/guard.h>
+#include    <cppthread/mutex.h>
+#include    <cppthread/runner.h>
+#include    <cppthread/thread.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <array>
+#include    <atomic>
+#include    <chrono>
+#include    <list>
+#include    <unordered_map>
+
+
+// C
+//
+#include    <errno.h>
+#include    <string.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace addr
+{
+
+
+namespace
+{
+
+
+/** \brief The key of a forward lookup.
+ *
+ * The results of getaddrinfo() depend on the host, the service, and
+ * the hints. All of these are part of the key.
+ */
+struct key_t
+{
+    std::string         f_host = std::string();
+    std::string         f_service = std::string();
+    int                 f_family = AF_UNSPEC;
+    int                 f_socktype = 0;
+    int                 f_protocol = 0;
+    int                 f_flags = 0;
+
+    bool operator == (key_t const & rhs) const
+    {
+        return f_family == rhs.f_family
+            && f_socktype == rhs.f_socktype
+            && f_protocol == rhs.f_protocol
+            && f_flags == rhs.f_flags
+            && f_service == rhs.f_service
+            && f_host == rhs.f_host;
+    }
+};
+
+
+/** \brief Compute the hash of a forward lookup key.
+ *
+ * The hash is used to select the shard and as the hash of the map.
+ */
+struct key_hash
+{
+    std::size_t operator () (key_t const & key) const noexcept
+    {
+        std::uint64_t h(std::hash<std::string>()(key.f_host));
+        h = hash_mix(h ^ std::hash<std::string>()(key.f_service));
+        h = hash_mix(h
+                ^ (static_cast<std::uint64_t>(key.f_family) << 48)
+                ^ (static_cast<std::uint64_t>(key.f_socktype) << 32)
+                ^ (static_cast<std::uint64_t>(key.f_protocol) << 16)
+                ^ static_cast<std::uint64_t>(key.f_flags));
+        return h;
+    }
+};
+
+
+/** \brief The key of a reverse lookup.
+ *
+ * The name of an address only depends on its 16 bytes (IPv4 addresses
+ * are saved as IPv4 mapped IPv6 addresses).
+ */
+struct name_key_t
+{
+    std::uint64_t       f_ip[2] = { 0, 0 };
+
+    bool operator == (name_key_t const & rhs) const
+    {
+        return f_ip[0] == rhs.f_ip[0]
+            && f_ip[1] == rhs.f_ip[1];
+    }
+};
+
+
+/** \brief Compute the hash of a reverse lookup key.
+ *
+ * This is the same hash as addr::hash().
+ */
+struct name_key_hash
+{
+    std::size_t operator () (name_key_t const & key) const noexcept
+    {
+        return hash_mix(key.f_ip[0] ^ hash_mix(key.f_ip[1] ^ 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+
+/** \brief One shard of the cache.
+ *
+ * The LRU list has the most recently used entries first. The map
+ * points to the entries in that list.
+ *
+ * A negative entry has an f_error other than 0 and an empty value.
+ *
+ * \tparam K  The type of the key.
+ * \tparam V  The type of the cached value.
+ * \tparam H  The hash of the key.
+ */
+template<typename K, typename V, typename H>
+struct shard_t
+{
+    struct entry_t
+    {
+        K                                       f_key = K();
+        V                                       f_value = V();
+        int                                     f_error = 0;
+        std::chrono::steady_clock::time_point   f_expires = std::chrono::steady_clock::time_point();
+    };
+
+    typedef std::list<entry_t>                  lru_t;
+    typedef std::unordered_map<K, typename lru_t::iterator, H>
+                                                map_t;
+
+    bool find(K const & key, V & value, int & error)
+    {
+        cppthread::guard lock(f_mutex);
+
+        auto const it(f_map.find(key));
+        if(it == f_map.end())
+        {
+            ++f_statistics.f_misses;
+            return false;
+        }
+
+        typename lru_t::iterator const entry(it->second);
+        if(entry->f_expires <= std::chrono::steady_clock::now())
+        {
+            f_map.erase(it);
+            f_lru.erase(entry);
+            ++f_statistics.f_expirations;
+            ++f_statistics.f_misses;
+            return false;
+        }
+
+        f_lru.splice(f_lru.begin(), f_lru, entry);
+        value = entry->f_value;
+        error = entry->f_error;
+        if(error == 0)
+        {
+            ++f_statistics.f_hits;
+        }
+        else
+        {
+            ++f_statistics.f_negative_hits;
+        }
+        return true;
+    }
+
+    void insert(
+          K const & key
+        , V const & value
+        , int error
+        , std::chrono::seconds ttl
+        , std::size_t max_size)
+    {
+        entry_t entry;
+        entry.f_key = key;
+        entry.f_value = value;
+        entry.f_error = error;
+        entry.f_expires = std::chrono::steady_clock::now() + ttl;
+
+        cppthread::guard lock(f_mutex);
+
+        auto const it(f_map.find(key));
+        if(it != f_map.end())
+        {
+            *it->second = entry;
+            f_lru.splice(f_lru.begin(), f_lru, it->second);
+            return;
+        }
+
+        f_lru.push_front(entry);
+        f_map.emplace(key, f_lru.begin());
+        shrink(max_size);
+    }
+
+    /** \brief Remove the least recently used entries.
+     *
+     * The shard mutex must be locked by the caller.
+     *
+     * \param[in] max_size  The maximum number of entries to keep.
+     */
+    void shrink(std::size_t max_size)
+    {
+        while(f_lru.size() > max_size)
+        {
+            f_map.erase(f_lru.back().f_key);
+            f_lru.pop_back();
+            ++f_statistics.f_evictions;
+        }
+    }
+
+    void clear()
+    {
+        cppthread::guard lock(f_mutex);
+        f_map.clear();
+        f_lru.clear();
+    }
+
+    void add_statistics(lookup_cache::statistics_t & statistics)
+    {
+        cppthread::guard lock(f_mutex);
+        statistics.f_hits += f_statistics.f_hits;
+        statistics.f_negative_hits += f_statistics.f_negative_hits;
+        statistics.f_misses += f_statistics.f_misses;
+        statistics.f_expirations += f_statistics.f_expirations;
+        statistics.f_evictions += f_statistics.f_evictions;
+        statistics.f_size += f_lru.size();
+    }
+
+    void reset_statistics()
+    {
+        cppthread::guard lock(f_mutex);
+        f_statistics = lookup_cache::statistics_t();
+    }
+
+    cppthread::mutex                            f_mutex = cppthread::mutex();
+    lru_t                                       f_lru = lru_t();
+    map_t                                       f_map = map_t();
+    lookup_cache::statistics_t                  f_statistics = lookup_cache::statistics_t();
+};
+
+
+typedef shard_t<key_t, std::shared_ptr<addrinfo>, key_hash>     addrinfo_shard_t;
+typedef shard_t<name_key_t, std::string, name_key_hash>         name_shard_t;
+
+
+typedef std::array<addrinfo_shard_t, lookup_cache::SHARD_COUNT>  addrinfo_shards_t;
+typedef std::array<name_shard_t, lookup_cache::SHARD_COUNT>      name_shards_t;
+
+
+std::atomic<bool>           g_enabled(false);
+std::atomic<std::uint32_t>  g_positive_ttl(lookup_cache::DEFAULT_POSITIVE_TTL);
+std::atomic<std::uint32_t>  g_negative_ttl(lookup_cache::DEFAULT_NEGATIVE_TTL);
+std::atomic<std::size_t>    g_max_size(lookup_cache::DEFAULT_MAX_SIZE);
+
+
+/** \brief The shards of the cache.
+ *
+ * Like the name_resolver, the shards are allocated once and never
+ * deleted. The name workers and the asynchronous getaddrinfo_a()
+ * notifications may still save results while the process exits and
+ * they must not find a destroyed mutex.
+ */
+addrinfo_shards_t &         g_shards = *new addrinfo_shards_t;
+name_shards_t &             g_name_shards = *new name_shards_t;
+
+
+/** \brief Delete an addrinfo structure.
+ *
+ * \param[in] ai  The addrinfo structure to free.
+ */
+void addrinfo_deleter(addrinfo * ai)
+{
+    freeaddrinfo(ai);
+}
+
+
+key_t make_key(
+      std::string const & host
+    , std::string const & service
+    , addrinfo const & hints)
+{
+    key_t key;
+    key.f_host = host;
+    key.f_service = service;
+    key.f_family = hints.ai_family;
+    key.f_socktype = hints.ai_socktype;
+    key.f_protocol = hints.ai_protocol;
+    key.f_flags = hints.ai_flags;
+    return key;
+}
+
+
+name_key_t make_name_key(addr const & a)
+{
+    sockaddr_in6 in6;
+    a.get_ipv6(in6);
+
+    name_key_t key;
+    memcpy(key.f_ip, in6.sin6_addr.s6_addr, sizeof(key.f_ip));
+    return key;
+}
+
+
+template<typename S, typename K>
+S & get_shard(std::array<S, lookup_cache::SHARD_COUNT> & shards, K const & key)
+{
+    return shards[(typename S::map_t::hasher()(key) >> 56) % lookup_cache::SHARD_COUNT];
+}
+
+
+/** \brief Get the maximum number of entries in one shard.
+ *
+ * \return The maximum size of one shard, at least 1.
+ */
+std::size_t shard_max_size()
+{
+    return std::max(
+              static_cast<std::size_t>(1)
+            , (g_max_size.load() + lookup_cache::SHARD_COUNT - 1) / lookup_cache::SHARD_COUNT);
+}
+
+
+/** \brief Check whether an error is worth caching.
+ *
+ * Errors such as "host not found" are going to be returned again on
+ * the next call. Temporary errors (EAI_AGAIN, EAI_MEMORY, EAI_SYSTEM,
+ * etc.) are never cached.
+ *
+ * \param[in] error  The getaddrinfo() or getnameinfo() error.
+ *
+ * \return true if the error can be cached.
+ */
+bool is_negative_cacheable(int error)
+{
+    switch(error)
+    {
+    case EAI_NONAME:
+    case EAI_SERVICE:
+#ifdef EAI_NODATA
+    case EAI_NODATA:
+#endif
+#ifdef EAI_ADDRFAMILY
+    case EAI_ADDRFAMILY:
+#endif
+        return true;
+
+    default:
+        return false;
+
+    }
+}
+
+
+/** \brief Get the TTL of a new entry.
+ *
+ * \param[in] error  The error of the lookup, 0 on success.
+ *
+ * \return The TTL of the entry, 0 if it should not be cached.
+ */
+std::uint32_t get_ttl(int error)
+{
+    if(!g_enabled
+    || g_max_size == 0
+    || (error != 0 && !is_negative_cacheable(error)))
+    {
+        return 0;
+    }
+
+    return error == 0 ? g_positive_ttl : g_negative_ttl;
+}
+
+
+/** \brief Call getnameinfo() on an address.
+ *
+ * \param[in] a  The address to look up.
+ * \param[out] name  The name of the address.
+ *
+ * \return 0 on success, a getnameinfo() error otherwise.
+ */
+int get_name_info(addr const & a, std::string & name)
+{
+    // IPv4 addresses are passed as such; glibc does not search the
+    // hosts file for IPv4 mapped IPv6 addresses
+    //
+    sockaddr_in in;
+    sockaddr_in6 in6;
+    sockaddr const * address(nullptr);
+    socklen_t length(0);
+    if(a.is_ipv4())
+    {
+        a.get_ipv4(in);
+        address = reinterpret_cast<sockaddr const *>(&in);
+        length = sizeof(in);
+    }
+    else
+    {
+        a.get_ipv6(in6);
+        address = reinterpret_cast<sockaddr const *>(&in6);
+        length = sizeof(in6);
+    }
+
+    // TODO: test with the NI_IDN* flags and make sure we know what we get
+    //       (i.e. we want UTF-8 as a result)
+    //
+    char host[NI_MAXHOST];
+    int const r(getnameinfo(
+              address
+            , length
+            , host
+            , sizeof(host)
+            , nullptr
+            , 0
+            , NI_NAMEREQD));
+    if(r == 0)
+    {
+        name = host;
+    }
+    else
+    {
+        name.clear();
+    }
+    return r;
+}
+
+
+/** \brief A reverse lookup handled by the name workers.
+ *
+ * The request is shared between the get_names() callers waiting on it
+ * and the worker running the lookup. The f_done, f_name, and f_error
+ * fields are protected by the name_resolver mutex.
+ */
+struct name_request_t
+{
+    typedef std::shared_ptr<name_request_t>     pointer_t;
+
+    addr                f_address = addr();
+    name_key_t          f_key = name_key_t();
+    bool                f_done = false;
+    std::string         f_name = std::string();
+    int                 f_error = 0;
+};
+
+
+class name_worker;
+
+
+/** \brief The pool of threads running reverse lookups.
+ *
+ * getnameinfo() has no asynchronous version so get_names() queues the
+ * lookups and NAME_WORKER_COUNT threads run them. The same address
+ * requested by several callers is only looked up once.
+ *
+ * The resolver is allocated once and never deleted. Its threads may
+ * be blocked in getnameinfo() when the process exits.
+ *
+ * The queue is limited to NAME_QUEUE_MAX_SIZE requests so a slow DNS
+ * server does not make it grow without end. Once full, new addresses
+ * are not queued.
+ */
+class name_resolver
+{
+public:
+    void                    start();
+    name_request_t::pointer_t
+                            queue(addr const & a, name_key_t const & key);
+    name_request_t::pointer_t
+                            next();
+    void                    done(name_request_t::pointer_t request, std::string const & name, int error);
+
+    cppthread::mutex        f_mutex = cppthread::mutex();
+
+private:
+    typedef std::unordered_map<name_key_t, name_request_t::pointer_t, name_key_hash>
+                            requests_t;
+
+    std::list<name_request_t::pointer_t>
+                            f_queue = std::list<name_request_t::pointer_t>();
+    requests_t              f_in_flight = requests_t();
+    std::vector<std::unique_ptr<name_worker>>
+                            f_workers = std::vector<std::unique_ptr<name_worker>>();
+};
+
+
+name_resolver *             g_name_resolver = new name_resolver;
+
+
+/** \brief One thread of the name_resolver.
+ *
+ * The worker runs the lookups as they get queued and saves the results
+ * in the cache.
+ */
+class name_worker
+    : public cppthread::runner
+{
+public:
+    name_worker()
+        : runner("name_worker")
+        , f_thread("name_worker", this)
+    {
+    }
+
+    bool start()
+    {
+        return f_thread.start();
+    }
+
+    virtual void run() override
+    {
+        for(;;)
+        {
+            name_request_t::pointer_t request(g_name_resolver->next());
+            std::string name;
+            int const r(get_name_info(request->f_address, name));
+            lookup_cache::insert_name(request->f_address, name, r);
+            g_name_resolver->done(request, name, r);
+        }
+    }
+
+private:
+    cppthread::thread       f_thread;
+};
+
+
+/** \brief Start the worker threads.
+ *
+ * The threads are started on the first call to get_names() so processes
+ * which never use the batch do not pay for them.
+ *
+ * The resolver mutex must be locked by the caller.
+ */
+void name_resolver::start()
+{
+    if(!f_workers.empty())
+    {
+        return;
+    }
+
+    for(std::size_t idx(0); idx < lookup_cache::NAME_WORKER_COUNT; ++idx)
+    {
+        f_workers.push_back(std::make_unique<name_worker>());
+        f_workers.back()->start();
+    }
+}
+
+
+/** \brief Queue a reverse lookup.
+ *
+ * If the same address is already being looked up, the existing request
+ * is returned instead.
+ *
+ * The resolver mutex must be locked by the caller.
+ *
+ * \param[in] a  The address to look up.
+ * \param[in] key  The key of the address.
+ *
+ * \return The request to wait on or a null pointer if the queue is full.
+ */
+name_request_t::pointer_t name_resolver::queue(addr const & a, name_key_t const & key)
+{
+    auto const it(f_in_flight.find(key));
+    if(it != f_in_flight.end())
+    {
+        return it->second;
+    }
+
+    if(f_queue.size() >= lookup_cache::NAME_QUEUE_MAX_SIZE)
+    {
+        return name_request_t::pointer_t();
+    }
+
+    start();
+
+    name_request_t::pointer_t request(std::make_shared<name_request_t>());
+    request->f_address = a;
+    request->f_key = key;
+    f_in_flight.emplace(key, request);
+    f_queue.push_back(request);
+    f_mutex.broadcast();
+    return request;
+}
+
+
+/** \brief Wait for the next request.
+ *
+ * \return The next request to look up.
+ */
+name_request_t::pointer_t name_resolver::next()
+{
+    cppthread::guard lock(f_mutex);
+    while(f_queue.empty())
+    {
+        f_mutex.wait();
+    }
+    name_request_t::pointer_t request(f_queue.front());
+    f_queue.pop_front();
+    return request;
+}
+
+
+/** \brief Save the result of a request and wake up the callers.
+ *
+ * \param[in] request  The request which is done.
+ * \param[in] name  The resulting name.
+ * \param[in] error  The getnameinfo() error.
+ */
+void name_resolver::done(name_request_t::pointer_t request, std::string const & name, int error)
+{
+    cppthread::guard lock(f_mutex);
+    request->f_done = true;
+    request->f_name = name;
+    request->f_error = error;
+    f_in_flight.erase(request->f_key);
+    f_mutex.broadcast();
+}
+
+
+}
+// no name namespace
+
+
+
+/** \brief Turn the lookup cache on or off.
+ *
+ * The lookup cache is off by default. Once turned on, all the lookups
+ * done by the addr_parser (and thus string_to_addr()) and by
+ * addr::get_name() go through the cache first.
+ *
+ * Turning the cache off also flushes it.
+ *
+ * \note
+ * This function is thread safe.
+ *
+ * \param[in] enabled  Whether the cache is used.
+ */
+void lookup_cache::set_enabled(bool enabled)
+{
+    g_enabled = enabled;
+    if(!enabled)
+    {
+        flush();
+    }
+}
+
+
+/** \brief Check whether the lookup cache is on.
+ *
+ * \return true if the lookup cache is used.
+ */
+bool lookup_cache::get_enabled()
+{
+    return g_enabled;
+}
+
+
+/** \brief Change the TTL of successful lookups.
+ *
+ * Successful lookups are kept in the cache for this many seconds. The
+ * default is DEFAULT_POSITIVE_TTL (5 minutes). A TTL of 0 prevents
+ * successful lookups from being cached.
+ *
+ * The new TTL applies to entries added after this call.
+ *
+ * \param[in] duration_seconds  The new TTL in seconds.
+ */
+void lookup_cache::set_positive_ttl(std::uint32_t duration_seconds)
+{
+    g_positive_ttl = duration_seconds;
+}
+
+
+/** \brief Get the TTL of successful lookups.
+ *
+ * \return The positive TTL in seconds.
+ */
+std::uint32_t lookup_cache::get_positive_ttl()
+{
+    return g_positive_ttl;
+}
+
+
+/** \brief Change the TTL of failed lookups.
+ *
+ * Lookups which failed with a permanent error (i.e. EAI_NONAME) are
+ * kept in the cache for this many seconds. The default is
+ * DEFAULT_NEGATIVE_TTL (30 seconds). A TTL of 0 prevents failures
+ * from being cached.
+ *
+ * \param[in] duration_seconds  The new TTL in seconds.
+ */
+void lookup_cache::set_negative_ttl(std::uint32_t duration_seconds)
+{
+    g_negative_ttl = duration_seconds;
+}
+
+
+/** \brief Get the TTL of failed lookups.
+ *
+ * \return The negative TTL in seconds.
+ */
+std::uint32_t lookup_cache::get_negative_ttl()
+{
+    return g_negative_ttl;
+}
+
+
+/** \brief Change the maximum number of entries in the cache.
+ *
+ * The cache keeps at most about \p size entries of each kind (forward
+ * and reverse lookups). The limit is applied
+ * per shard so each shard keeps up to `size / SHARD_COUNT` entries
+ * (rounded up). When a shard is full, its least recently used entry
+ * is evicted.
+ *
+ * Reducing the size evicts entries immediately.
+ *
+ * \param[in] size  The new maximum number of entries.
+ */
+void lookup_cache::set_max_size(std::size_t size)
+{
+    g_max_size = size;
+
+    std::size_t const max_size(shard_max_size());
+    for(auto & shard : g_shards)
+    {
+        cppthread::guard lock(shard.f_mutex);
+        shard.shrink(max_size);
+    }
+    for(auto & shard : g_name_shards)
+    {
+        cppthread::guard lock(shard.f_mutex);
+        shard.shrink(max_size);
+    }
+}
+
+
+/** \brief Get the maximum number of entries in the cache.
+ *
+ * \return The maximum number of entries.
+ */
+std::size_t lookup_cache::get_max_size()
+{
+    return g_max_size;
+}
+
+
+/** \brief Search the cache.
+ *
+ * This function searches the cache for the lookup of \p host and
+ * \p service with \p hints. On a hit, the function sets \p list
+ * and \p error to the cached results and returns true. Note that
+ * a negative hit returns true with an \p error other than 0.
+ *
+ * Expired entries are removed and reported as misses.
+ *
+ * \param[in] host  The host to look up.
+ * \param[in] service  The service to look up.
+ * \param[in] hints  The getaddrinfo() hints.
+ * \param[out] list  The cached list of addresses.
+ * \param[out] error  The cached getaddrinfo() error.
+ *
+ * \return true if the lookup was found in the cache.
+ */
+bool lookup_cache::find(
+      std::string const & host
+    , std::string const & service
+    , addrinfo const & hints
+    , std::shared_ptr<addrinfo> & list
+    , int & error)
+{
+    if(!g_enabled)
+    {
+        return false;
+    }
+
+    key_t const key(make_key(host, service, hints));
+    return get_shard(g_shards, key).find(key, list, error);
+}
+
+
+/** \brief Add a lookup result to the cache.
+ *
+ * This function saves the result of a getaddrinfo() call. The \p list
+ * is shared with the cache so it must not be modified.
+ *
+ * Temporary errors are not cached. If the cache is disabled or the
+ * corresponding TTL is 0, nothing happens.
+ *
+ * \param[in] host  The host which was looked up.
+ * \param[in] service  The service which was looked up.
+ * \param[in] hints  The getaddrinfo() hints.
+ * \param[in] list  The resulting list of addresses.
+ * \param[in] error  The getaddrinfo() error, 0 on success.
+ */
+void lookup_cache::insert(
+      std::string const & host
+    , std::string const & service
+    , addrinfo const & hints
+    , std::shared_ptr<addrinfo> const & list
+    , int error)
+{
+    std::uint32_t const ttl(get_ttl(error));
+    if(ttl == 0)
+    {
+        return;
+    }
+
+    key_t const key(make_key(host, service, hints));
+    get_shard(g_shards, key).insert(
+              key
+            , list
+            , error
+            , std::chrono::seconds(ttl)
+            , shard_max_size());
+}
+
+
+/** \brief Look up an address through the cache.
+ *
+ * This function returns the cached result if available. Otherwise it
+ * calls getaddrinfo() and saves the result in the cache.
+ *
+ * When the cache is disabled, this is the same as calling getaddrinfo().
+ *
+ * On return, errno is set as getaddrinfo() left it, or to 0 when the
+ * result comes from the cache.
+ *
+ * \param[in] host  The host to look up.
+ * \param[in] service  The service to look up.
+ * \param[in] hints  The getaddrinfo() hints.
+ * \param[out] list  The resulting list of addresses.
+ *
+ * \return 0 on success, a getaddrinfo() error otherwise.
+ */
+int lookup_cache::lookup(
+      std::string const & host
+    , std::string const & service
+    , addrinfo const & hints
+    , std::shared_ptr<addrinfo> & list)
+{
+    int error(0);
+    if(find(host, service, hints, list, error))
+    {
+        errno = 0;
+        return error;
+    }
+
+    errno = 0;
+    addrinfo * addrlist(nullptr);
+    error = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &addrlist);
+    int const e(errno);
+    if(error == 0)
+    {
+        list.reset(addrlist, addrinfo_deleter);
+    }
+    else
+    {
+        list.reset();
+    }
+    insert(host, service, hints, list, error);
+    errno = e;
+    return error;
+}
+
+
+/** \brief Search the cache for the name of an address.
+ *
+ * This function searches the cache for the result of a reverse lookup
+ * of \p a. Only the IP address is used as the key; the port, mask,
+ * and protocol are ignored.
+ *
+ * On a hit, the function sets \p name and \p error and returns true.
+ * A negative hit (the address has no name) returns true with an
+ * \p error other than 0 and an empty \p name.
+ *
+ * \param[in] a  The address to search.
+ * \param[out] name  The cached name.
+ * \param[out] error  The cached getnameinfo() error.
+ *
+ * \return true if the address was found in the cache.
+ */
+bool lookup_cache::find_name(
+      addr const & a
+    , std::string & name
+    , int & error)
+{
+    if(!g_enabled)
+    {
+        return false;
+    }
+
+    name_key_t const key(make_name_key(a));
+    return get_shard(g_name_shards, key).find(key, name, error);
+}
+
+
+/** \brief Add a reverse lookup result to the cache.
+ *
+ * This function saves the result of a getnameinfo() call. The same
+ * TTLs and maximum size as the forward lookups apply.
+ *
+ * \param[in] a  The address which was looked up.
+ * \param[in] name  The resulting name.
+ * \param[in] error  The getnameinfo() error, 0 on success.
+ */
+void lookup_cache::insert_name(
+      addr const & a
+    , std::string const & name
+    , int error)
+{
+    std::uint32_t const ttl(get_ttl(error));
+    if(ttl == 0)
+    {
+        return;
+    }
+
+    name_key_t const key(make_name_key(a));
+    get_shard(g_name_shards, key).insert(
+              key
+            , error == 0 ? name : std::string()
+            , error
+            , std::chrono::seconds(ttl)
+            , shard_max_size());
+}
+
+
+/** \brief Look up the name of an address through the cache.
+ *
+ * This function returns the cached name if available. Otherwise it
+ * calls getnameinfo() and saves the result in the cache.
+ *
+ * When the cache is disabled, this is the same as calling getnameinfo().
+ *
+ * \param[in] a  The address to look up.
+ * \param[out] name  The name of the address, empty if not available.
+ *
+ * \return 0 on success, a getnameinfo() error otherwise.
+ */
+int lookup_cache::lookup_name(
+      addr const & a
+    , std::string & name)
+{
+    int error(0);
+    if(find_name(a, name, error))
+    {
+        return error;
+    }
+
+    error = get_name_info(a, name);
+    insert_name(a, name, error);
+    return error;
+}
+
+
+/** \brief Get the names of many addresses at once.
+ *
+ * This function looks up the names of all the \p addresses concurrently
+ * and waits at most \p timeout for the results. The addresses found in
+ * the cache are returned immediately. The others are looked up by a pool
+ * of NAME_WORKER_COUNT threads.
+ *
+ * The names which are not available before the deadline are returned
+ * with the NAME_STATUS_PENDING status. Their lookup goes on in the
+ * background and the result is saved in the cache so a later call
+ * (i.e. the next log line with the same address) gets it. This only
+ * works if the cache is enabled.
+ *
+ * The same address is only looked up once, even if it appears multiple
+ * times in \p addresses or is requested by several threads at the same
+ * time.
+ *
+ * At most NAME_QUEUE_MAX_SIZE lookups wait for a worker. When the queue
+ * is full, the other addresses are returned with the NAME_STATUS_PENDING
+ * status without being queued. A later call can try again.
+ *
+ * The resulting vector has one entry per address, in the same order.
+ *
+ * \param[in] addresses  The addresses to look up.
+ * \param[in] timeout  The maximum amount of time to wait for the results.
+ *
+ * \return The name of each address and its status.
+ */
+lookup_cache::name_vector_t lookup_cache::get_names(
+      addr::vector_t const & addresses
+    , std::chrono::milliseconds timeout)
+{
+    std::chrono::steady_clock::time_point const deadline(std::chrono::steady_clock::now() + timeout);
+
+    name_vector_t result(addresses.size());
+    std::vector<name_request_t::pointer_t> requests(addresses.size());
+    for(std::size_t idx(0); idx < addresses.size(); ++idx)
+    {
+        int error(0);
+        if(find_name(addresses[idx], result[idx].f_name, error))
+        {
+            result[idx].f_status = error == 0
+                        ? name_status_t::NAME_STATUS_FOUND
+                        : name_status_t::NAME_STATUS_NOT_FOUND;
+        }
+    }
+
+    cppthread::guard lock(g_name_resolver->f_mutex);
+
+    bool done(true);
+    for(std::size_t idx(0); idx < addresses.size(); ++idx)
+    {
+        if(result[idx].f_status == name_status_t::NAME_STATUS_PENDING)
+        {
+            requests[idx] = g_name_resolver->queue(addresses[idx], make_name_key(addresses[idx]));
+            if(requests[idx] != nullptr)
+            {
+                done = false;
+            }
+        }
+    }
+
+    while(!done)
+    {
+        done = true;
+        for(std::size_t idx(0); idx < addresses.size(); ++idx)
+        {
+            if(requests[idx] != nullptr
+            && !requests[idx]->f_done)
+            {
+                done = false;
+                break;
+            }
+        }
+        if(done)
+        {
+            break;
+        }
+
+        std::chrono::steady_clock::time_point const now(std::chrono::steady_clock::now());
+        if(now >= deadline)
+        {
+            break;
+        }
+        g_name_resolver->f_mutex.timed_wait(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count());
+    }
+
+    for(std::size_t idx(0); idx < addresses.size(); ++idx)
+    {
+        if(requests[idx] != nullptr
+        && requests[idx]->f_done)
+        {
+            result[idx].f_name = requests[idx]->f_name;
+            result[idx].f_status = requests[idx]->f_error == 0
+                        ? name_status_t::NAME_STATUS_FOUND
+                        : name_status_t::NAME_STATUS_NOT_FOUND;
+        }
+    }
+
+    return result;
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * This function empties the cache. The statistics are not reset, see
+ * reset_statistics() for that.
+ */
+void lookup_cache::flush()
+{
+    for(auto & shard : g_shards)
+    {
+        shard.clear();
+    }
+    for(auto & shard : g_name_shards)
+    {
+        shard.clear();
+    }
+}
+
+
+/** \brief Get the cache statistics.
+ *
+ * This function returns the sum of the counters of all the forward
+ * lookup shards and the current number of forward entries in the cache.
+ *
+ * \return The forward lookup cache statistics.
+ *
+ * \sa get_name_statistics()
+ */
+lookup_cache::statistics_t lookup_cache::get_statistics()
+{
+    statistics_t result;
+    for(auto & shard : g_shards)
+    {
+        shard.add_statistics(result);
+    }
+    return result;
+}
+
+
+/** \brief Get the reverse lookup cache statistics.
+ *
+ * This function returns the sum of the counters of all the reverse
+ * lookup shards and the current number of names in the cache.
+ *
+ * \return The reverse lookup cache statistics.
+ *
+ * \sa get_statistics()
+ */
+lookup_cache::statistics_t lookup_cache::get_name_statistics()
+{
+    statistics_t result;
+    for(auto & shard : g_name_shards)
+    {
+        shard.add_statistics(result);
+    }
+    return result;
+}
+
+
+/** \brief Reset the cache counters.
+ *
+ * This function resets the hits, misses, expirations, and evictions
+ * counters back to zero.
+ */
+void lookup_cache::reset_statistics()
+{
+    for(auto & shard : g_shards)
+    {
+        shard.reset_statistics();
+    }
+    for(auto & shard : g_name_shards)
+    {
+        shard.reset_statistics();
+    }
+}
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
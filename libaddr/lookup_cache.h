@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief The process wide cache of address lookups.
+ *
+ * This header defines the lookup_cache class used to cache the results
+ * of getaddrinfo() and getnameinfo() calls. The addr_parser and
+ * addr::get_name() use it, when enabled, so the same host names and
+ * addresses do not get looked up over and over again.
+ */
+
+// self
+//
+#include    <libaddr/addr.h>
+
+
+// C++
+//
+#include    <chrono>
+#include    <cstdint>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+
+// C
+//
+#include    <netdb.h>
+
+
+
+namespace addr
+{
+
+
+class lookup_cache
+{
+public:
+    static constexpr std::size_t const      SHARD_COUNT = 16;
+    static constexpr std::size_t const      DEFAULT_MAX_SIZE = 4096;
+    static constexpr std::uint32_t const    DEFAULT_POSITIVE_TTL = 5 * 60;
+    static constexpr std::uint32_t const    DEFAULT_NEGATIVE_TTL = 30;
+    static constexpr std::size_t const      NAME_WORKER_COUNT = 8;
+    static constexpr std::size_t const      NAME_QUEUE_MAX_SIZE = 1024;
+
+    enum class name_status_t
+    {
+        NAME_STATUS_FOUND,
+        NAME_STATUS_NOT_FOUND,
+        NAME_STATUS_PENDING,
+    };
+
+    struct name_t
+    {
+        name_status_t       f_status = name_status_t::NAME_STATUS_PENDING;
+        std::string         f_name = std::string();
+    };
+    typedef std::vector<name_t>     name_vector_t;
+
+    struct statistics_t
+    {
+        std::uint64_t       f_hits = 0;
+        std::uint64_t       f_negative_hits = 0;
+        std::uint64_t       f_misses = 0;
+        std::uint64_t       f_expirations = 0;
+        std::uint64_t       f_evictions = 0;
+        std::size_t         f_size = 0;
+    };
+
+    static void             set_enabled(bool enabled);
+    static bool             get_enabled();
+    static void             set_positive_ttl(std::uint32_t duration_seconds);
+    static std::uint32_t    get_positive_ttl();
+    static void             set_negative_ttl(std::uint32_t duration_seconds);
+    static std::uint32_t    get_negative_ttl();
+    static void             set_max_size(std::size_t size);
+    static std::size_t      get_max_size();
+
+    static bool             find(
+                                  std::string const & host
+                                , std::string const & service
+                                , addrinfo const & hints
+                                , std::shared_ptr<addrinfo> & list
+                                , int & error);
+    static void             insert(
+                                  std::string const & host
+                                , std::string const & service
+                                , addrinfo const & hints
+                                , std::shared_ptr<addrinfo> const & list
+                                , int error);
+    static int              lookup(
+                                  std::string const & host
+                                , std::string const & service
+                                , addrinfo const & hints
+                                , std::shared_ptr<addrinfo> & list);
+    static bool             find_name(
+                                  addr const & a
+                                , std::string & name
+                                , int & error);
+    static void             insert_name(
+                                  addr const & a
+                                , std::string const & name
+                                , int error);
+    static int              lookup_name(
+                                  addr const & a
+                                , std::string & name);
+    static name_vector_t    get_names(
+                                  addr::vector_t const & addresses
+                                , std::chrono::milliseconds timeout);
+    static void             flush();
+
+    static statistics_t     get_statistics();
+    static statistics_t     get_name_statistics();
+    static void             reset_statistics();
+};
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
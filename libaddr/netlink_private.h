@@ -0,0 +1,62 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief Helpers to parse netlink messages.
+ *
+ * This header is private to the library. It is shared by the interface
+ * and the route implementations which both read netlink messages.
+ */
+
+// C
+//
+#include    <linux/netlink.h>
+
+
+
+namespace addr
+{
+
+
+/** \brief Get the payload of a netlink message.
+ *
+ * This is the same as the NLMSG_DATA() macro without the old style
+ * cast of that macro.
+ *
+ * \tparam T  The type of the payload.
+ * \param[in] h  The netlink message.
+ *
+ * \return A pointer to the payload of \p h.
+ */
+template<typename T>
+T const * nlmsg_payload(nlmsghdr const * h)
+{
+    return reinterpret_cast<T const *>(reinterpret_cast<char const *>(h) + NLMSG_HDRLEN);
+}
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
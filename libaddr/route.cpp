@@ -33,20 +33,39 @@
 
 // self
 //
+#include    "libaddr/addr_lpm_table.h"
 #include    "libaddr/exception.h"
+#include    "libaddr/netlink_private.h"
 #include    "libaddr/route.h"
 
 
+// cppthread
+//
+#include    <cppthread/guard.h>
+#include    <cppthread/mutex.h>
+
+
+// snapdev
+//
+#include    <snapdev/raii_generic_deleter.h>
+
+
 // C++
 //
 #include    <algorithm>
+#include    <atomic>
 #include    <fstream>
 #include    <iostream>
+#include    <map>
 
 
 // C
 //
+#include    <linux/netlink.h>
+#include    <linux/rtnetlink.h>
+#include    <net/if.h>
 #include    <net/route.h>
+#include    <sys/socket.h>
 
 
 // last include
@@ -149,7 +168,7 @@ int hex_to_number(char c)
     }
     if(c >= 'a' && c <= 'f')
     {
-        return c - 'a' + 10; // LCOV_EXCL_LINE
+        return c - 'a' + 10;
     }
     if(c >= 'A' && c <= 'F')
     {
@@ -161,6 +180,23 @@ int hex_to_number(char c)
 
 addr hex_to_addr(std::string const & address)
 {
+    if(address.length() == 32)
+    {
+        // IPv6 addresses are written in network order
+        //
+        struct sockaddr_in6 in6 = sockaddr_in6();
+        in6.sin6_family = AF_INET6;
+        in6.sin6_port = 0;
+        for(int i(0); i < 16; ++i)
+        {
+            in6.sin6_addr.s6_addr[i] =
+                      (hex_to_number(address[i * 2 + 0]) << 4)
+                    | (hex_to_number(address[i * 2 + 1]) << 0)
+                ;
+        }
+        return addr(in6);
+    }
+
     if(address.length() != 8)
     {
         throw addr_invalid_argument("invalid length for an hex address"); // LCOV_EXCL_LINE
@@ -223,6 +259,297 @@ flag_name_t const g_rtf_flag_names[] =
 };
 
 
+/** \brief Cache TTL.
+ *
+ * The time the cache survives another call to route::get_routes().
+ *
+ * After the TTL is elapsed, the next call ignores the cache and re-reads
+ * the routes from the kernel.
+ */
+std::atomic<std::uint32_t> g_routes_ttl(5 * 60);
+
+
+/** \brief Cache lifetime.
+ *
+ * This parameter is set to time(nullptr) + TTL whenever a new set of
+ * routes is gathered from the OS.
+ */
+std::atomic<time_t> g_routes_timeout(0);
+
+
+/** \brief The cached routes.
+ *
+ * The vector is never modified once saved here. A new list replaces
+ * it with std::atomic_store() and readers get it with std::atomic_load()
+ * so they never wait on a thread reading the routes.
+ */
+route::pointer_vector_t g_cache_routes = route::pointer_vector_t();
+
+
+/** \brief Mutex used to refresh the cache.
+ *
+ * Only one thread reads the routes when the cache times out. The others
+ * wait for its result.
+ */
+cppthread::mutex g_routes_mutex = cppthread::mutex();
+
+
+/** \brief The prefix table used to search the routes.
+ *
+ * This table is compiled from the cached list of routes. Each prefix
+ * (destination and mask) found in the list of routes is added to an
+ * LPM table. The routes using the same prefix are sorted by metric
+ * so the first one is the route the kernel uses.
+ *
+ * IPv4 and IPv6 routes are saved in separate LPM tables. In one table,
+ * a short IPv6 prefix such as the IPv6 default route (::/0) would also
+ * match all the IPv4 addresses.
+ *
+ * When the route cache gets refreshed, the table is updated by
+ * removing the prefixes which disappeared and adding the new ones.
+ * The other prefixes keep their place in the LPM table.
+ */
+class route_table
+{
+public:
+    typedef std::shared_ptr<route_table const>  pointer_t;
+
+    route::pointer_vector_t const &
+                            get_routes() const;
+    void                    update(route::pointer_vector_t const & routes);
+    route::pointer_t        find(addr const & destination) const;
+
+private:
+    typedef std::pair<addr, int>                prefix_t;
+    typedef std::map<prefix_t, std::size_t>     prefix_map_t;
+
+    struct family_t
+    {
+        addr_lpm_table          f_table = addr_lpm_table();
+        std::vector<route::vector_t>
+                                f_slot_routes = std::vector<route::vector_t>();
+    };
+
+    family_t &              get_family(addr const & a);
+    family_t const &        get_family(addr const & a) const;
+
+    route::pointer_vector_t f_routes = route::pointer_vector_t();
+    prefix_map_t            f_prefixes = prefix_map_t();
+    family_t                f_ipv4 = family_t();
+    family_t                f_ipv6 = family_t();
+};
+
+
+/** \brief Get the table of the family of \p a.
+ *
+ * \param[in] a  The address defining the family.
+ *
+ * \return The IPv4 or the IPv6 table.
+ */
+route_table::family_t & route_table::get_family(addr const & a)
+{
+    return a.is_ipv4() ? f_ipv4 : f_ipv6;
+}
+
+
+/** \brief Get the table of the family of \p a.
+ *
+ * \param[in] a  The address defining the family.
+ *
+ * \return The IPv4 or the IPv6 table.
+ */
+route_table::family_t const & route_table::get_family(addr const & a) const
+{
+    return a.is_ipv4() ? f_ipv4 : f_ipv6;
+}
+
+
+/** \brief Get the list of routes this table was compiled from.
+ *
+ * \return The compiled list of routes.
+ */
+route::pointer_vector_t const & route_table::get_routes() const
+{
+    return f_routes;
+}
+
+
+/** \brief Update the table with a new list of routes.
+ *
+ * The routes are grouped by prefix and sorted by metric. Then the
+ * prefixes which are not used anymore are removed from the LPM table
+ * and the new prefixes get inserted. The routes of the prefixes found
+ * in both lists are replaced in place.
+ *
+ * Routes which destination mask is not a valid CIDR are ignored.
+ *
+ * \param[in] routes  The new list of routes.
+ */
+void route_table::update(route::pointer_vector_t const & routes)
+{
+    std::map<prefix_t, route::vector_t> prefixes;
+    for(auto const & r : *routes)
+    {
+        addr destination(r->get_destination_address());
+        destination.apply_mask();
+        prefixes[prefix_t(destination, destination.get_mask_size())].push_back(r);
+    }
+
+    for(auto it(f_prefixes.begin()); it != f_prefixes.end(); )
+    {
+        if(prefixes.find(it->first) == prefixes.end())
+        {
+            family_t & family(get_family(it->first.first));
+            family.f_table.remove(family.f_table.get_range(it->second));
+            family.f_slot_routes[it->second].clear();
+            it = f_prefixes.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for(auto & p : prefixes)
+    {
+        // the kernel uses the route with the smallest metric, as an
+        // unsigned number (i.e. 0xFFFFFFFF is the largest metric)
+        //
+        std::stable_sort(
+                  p.second.begin()
+                , p.second.end()
+                , [](auto const & a, auto const & b)
+                {
+                    return static_cast<std::uint32_t>(a->get_metric())
+                         < static_cast<std::uint32_t>(b->get_metric());
+                });
+
+        family_t & family(get_family(p.first.first));
+        auto it(f_prefixes.find(p.first));
+        if(it != f_prefixes.end())
+        {
+            family.f_slot_routes[it->second].swap(p.second);
+            continue;
+        }
+
+        addr_range range;
+        range.set_from(p.first.first);
+        std::size_t idx(0);
+        try
+        {
+            idx = family.f_table.insert(range);
+        }
+        catch(addr_unsupported_as_range const &)
+        {
+            continue; // LCOV_EXCL_LINE
+        }
+        if(idx >= family.f_slot_routes.size())
+        {
+            family.f_slot_routes.resize(idx + 1);
+        }
+        family.f_slot_routes[idx].swap(p.second);
+        f_prefixes[p.first] = idx;
+    }
+
+    f_routes = routes;
+}
+
+
+/** \brief Search the route used to reach \p destination.
+ *
+ * \param[in] destination  The address to search.
+ *
+ * \return The route with the longest matching prefix and the smallest
+ * metric or a null pointer.
+ */
+route::pointer_t route_table::find(addr const & destination) const
+{
+    family_t const & family(get_family(destination));
+    std::size_t const idx(family.f_table.find_index(destination));
+    if(idx == addr_lpm_table::NO_RANGE)
+    {
+        return route::pointer_t();
+    }
+
+    // a rejecting route (unreachable, prohibit, blackhole) means the
+    // destination cannot be reached
+    //
+    route::pointer_t const & r(family.f_slot_routes[idx].front());
+    if((r->get_flags() & RTF_UP) == 0)
+    {
+        return route::pointer_t();
+    }
+
+    return r;
+}
+
+
+/** \brief The compiled route table.
+ *
+ * The table is never modified once saved here. A refresh copies it,
+ * updates the copy, and saves the copy with std::atomic_store().
+ */
+route_table::pointer_t g_route_table = route_table::pointer_t();
+
+
+/** \brief Mutex used to update the compiled route table.
+ */
+cppthread::mutex g_route_table_mutex = cppthread::mutex();
+
+
+/** \brief Convert a netlink address attribute to an addr.
+ *
+ * \param[in] family  The family of the route (AF_INET or AF_INET6).
+ * \param[in] data  The attribute data.
+ * \param[in] size  The size of the attribute data.
+ * \param[out] a  The resulting address.
+ *
+ * \return true if the attribute had the expected size.
+ */
+bool netlink_to_addr(int family, void const * data, std::size_t size, addr & a)
+{
+    if(family == AF_INET)
+    {
+        struct sockaddr_in in = sockaddr_in();
+        if(size != sizeof(in.sin_addr))
+        {
+            return false; // LCOV_EXCL_LINE
+        }
+        in.sin_family = AF_INET;
+        memcpy(&in.sin_addr, data, sizeof(in.sin_addr));
+        a.set_ipv4(in);
+        return true;
+    }
+
+    struct sockaddr_in6 in6 = sockaddr_in6();
+    if(size != sizeof(in6.sin6_addr))
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+    in6.sin6_family = AF_INET6;
+    memcpy(&in6.sin6_addr, data, sizeof(in6.sin6_addr));
+    a.set_ipv6(in6);
+    return true;
+}
+
+
+/** \brief Get the name of an interface from its index.
+ *
+ * \param[in] index  The index of the interface.
+ *
+ * \return The name of the interface or an empty string.
+ */
+std::string index_to_name(int index)
+{
+    char name[IF_NAMESIZE + 1];
+    if(if_indextoname(index, name) == nullptr)
+    {
+        return std::string(); // LCOV_EXCL_LINE
+    }
+    return name;
+}
+
+
 
 }
 // no name namespace
@@ -244,11 +571,14 @@ flag_name_t const g_rtf_flag_names[] =
  * if some mandatory columns are missing and thus this function
  * cannot properly load the columns.
  *
- * \todo
- * Write the IPv6 function. It's similar only there are no headers
- * and (obviously?!) the IPs are IPv6 instead of IPv4.
+ * \note
+ * This function reads the file each time it gets called. Use
+ * get_routes() to get the cached IPv4 and IPv6 routes.
  *
  * \return A vector of the routes found in the file.
+ *
+ * \sa get_ipv6_routes()
+ * \sa get_routes()
  */
 route::vector_t route::get_ipv4_routes()
 {
@@ -340,6 +670,440 @@ route::vector_t route::get_ipv4_routes()
 }
 
 
+/** \brief Read the list of IPv6 routes.
+ *
+ * This function reads the list of IPv6 routes using the
+ * /proc/net/ipv6_route file. It returns a vector of easy to use route
+ * objects.
+ *
+ * Contrary to the IPv4 file, this one has no headers. Each line
+ * includes the destination, its prefix length, the source, its prefix
+ * length, the next hop (gateway), the metric, the reference counter,
+ * the use counter, the flags, and the interface name. All the numbers
+ * are written in hexadecimal.
+ *
+ * The IPv6 file does not include an MTU, window, or IRTT so these
+ * parameters are always set to 0.
+ *
+ * \note
+ * This function reads the file each time it gets called. Use
+ * get_routes() to get the cached IPv4 and IPv6 routes.
+ *
+ * \return A vector of the routes found in the file.
+ *
+ * \sa get_ipv4_routes()
+ * \sa get_routes()
+ */
+route::vector_t route::get_ipv6_routes()
+{
+    route::vector_t routes;
+
+    std::ifstream in("/proc/net/ipv6_route");
+
+    for(;;)
+    {
+        // read one entry
+        //
+        words_t entries;
+        int const e(readwords(in, entries));
+        if(e < 0)
+        {
+            break;
+        }
+        if(entries.size() < 10)
+        {
+            continue; // LCOV_EXCL_LINE
+        }
+
+        // convert each column to data in a 'route' object
+        //
+        route r;
+
+        r.f_destination_address = hex_to_addr(entries[0]);
+        r.f_destination_address.set_mask_count(std::stol(entries[1], nullptr, 16));
+        r.f_gateway_address     = hex_to_addr(entries[4]);
+        r.f_metric              = static_cast<int>(std::stoul(entries[5], nullptr, 16));
+        r.f_reference_count     = std::stol(entries[6], nullptr, 16);
+        r.f_use                 = std::stol(entries[7], nullptr, 16);
+        r.f_flags               = std::stol(entries[8], nullptr, 16);
+        r.f_interface_name      = entries[9];
+
+        routes.push_back(pointer_t(new route(r)));
+    }
+
+    return routes;
+}
+
+
+/** \brief Read the routes with netlink.
+ *
+ * This function sends an RTM_GETROUTE dump request for all the families
+ * and transforms the answers in route objects. Only the routes of the
+ * main table are kept, as in the /proc/net/route file.
+ *
+ * The flags are computed from the message since netlink does not
+ * include the RTF_... flags: RTF_UP for routes that can be used,
+ * RTF_REJECT for unreachable, prohibited and blackhole routes,
+ * RTF_GATEWAY when a gateway is defined, RTF_HOST when the destination
+ * is a single address, and RTF_ADDRCONF for routes added by router
+ * advertisements.
+ *
+ * The reference count and use counter are not available and are
+ * always set to 0.
+ *
+ * \param[out] routes  The vector where the routes get saved.
+ *
+ * \return true if the routes could be read, false otherwise and errno
+ * is set to the error that happened.
+ */
+bool route::get_netlink_routes(vector_t & routes)
+{
+    snapdev::raii_fd_t s(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+    if(s.get() == -1)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+
+    struct
+    {
+        nlmsghdr    f_header;
+        rtmsg       f_message;
+    } request = {};
+    request.f_header.nlmsg_len = NLMSG_LENGTH(sizeof(rtmsg));
+    request.f_header.nlmsg_type = RTM_GETROUTE;
+    request.f_header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.f_header.nlmsg_seq = 1;
+    request.f_message.rtm_family = AF_UNSPEC;
+    if(send(s.get(), &request, request.f_header.nlmsg_len, 0) < 0)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+
+    std::vector<char> buf(32 * 1024);
+    for(;;)
+    {
+        ssize_t const size(recv(s.get(), buf.data(), buf.size(), 0));
+        if(size < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            return false; // LCOV_EXCL_LINE
+        }
+
+        int len(static_cast<int>(size));
+        for(nlmsghdr const * h(reinterpret_cast<nlmsghdr const *>(buf.data()));
+            NLMSG_OK(h, len);
+            h = NLMSG_NEXT(h, len))
+        {
+            if(h->nlmsg_type == NLMSG_DONE)
+            {
+                return true;
+            }
+            if(h->nlmsg_type == NLMSG_ERROR)
+            {
+                // LCOV_EXCL_START
+                nlmsgerr const * err(nlmsg_payload<nlmsgerr>(h));
+                errno = err->error < 0 ? -err->error : EIO;
+                return false;
+                // LCOV_EXCL_STOP
+            }
+            if(h->nlmsg_type != RTM_NEWROUTE)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+
+            rtmsg const * msg(nlmsg_payload<rtmsg>(h));
+            if(msg->rtm_family != AF_INET
+            && msg->rtm_family != AF_INET6)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            if((msg->rtm_flags & RTM_F_CLONED) != 0)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+
+            route r;
+            int table(msg->rtm_table);
+            int const max_mask(msg->rtm_family == AF_INET ? 32 : 128);
+
+            // the destination defaults to the "any" address of the family
+            //
+            if(msg->rtm_family == AF_INET)
+            {
+                struct sockaddr_in in = sockaddr_in();
+                in.sin_family = AF_INET;
+                r.f_destination_address.set_ipv4(in);
+                r.f_gateway_address.set_ipv4(in);
+            }
+
+            int attr_len(RTM_PAYLOAD(h));
+            for(rtattr const * attr(RTM_RTA(msg));
+                RTA_OK(attr, attr_len);
+                attr = RTA_NEXT(attr, attr_len))
+            {
+                switch(attr->rta_type)
+                {
+                case RTA_TABLE:
+                    table = *reinterpret_cast<std::uint32_t const *>(RTA_DATA(attr));
+                    break;
+
+                case RTA_DST:
+                    netlink_to_addr(msg->rtm_family, RTA_DATA(attr), RTA_PAYLOAD(attr), r.f_destination_address);
+                    break;
+
+                case RTA_GATEWAY:
+                    netlink_to_addr(msg->rtm_family, RTA_DATA(attr), RTA_PAYLOAD(attr), r.f_gateway_address);
+                    break;
+
+                case RTA_OIF:
+                    r.f_interface_name = index_to_name(*reinterpret_cast<int const *>(RTA_DATA(attr)));
+                    break;
+
+                case RTA_PRIORITY:
+                    r.f_metric = *reinterpret_cast<std::uint32_t const *>(RTA_DATA(attr));
+                    break;
+
+                case RTA_MULTIPATH:
+                    // LCOV_EXCL_START
+                    if(r.f_interface_name.empty()
+                    && RTA_PAYLOAD(attr) >= sizeof(rtnexthop))
+                    {
+                        // keep the first hop
+                        //
+                        rtnexthop const * nh(reinterpret_cast<rtnexthop const *>(RTA_DATA(attr)));
+                        r.f_interface_name = index_to_name(nh->rtnh_ifindex);
+                        int nh_len(nh->rtnh_len - sizeof(rtnexthop));
+                        for(rtattr const * nh_attr(RTNH_DATA(nh));
+                            RTA_OK(nh_attr, nh_len);
+                            nh_attr = RTA_NEXT(nh_attr, nh_len))
+                        {
+                            if(nh_attr->rta_type == RTA_GATEWAY)
+                            {
+                                netlink_to_addr(msg->rtm_family, RTA_DATA(nh_attr), RTA_PAYLOAD(nh_attr), r.f_gateway_address);
+                            }
+                        }
+                    }
+                    // LCOV_EXCL_STOP
+                    break;
+
+                case RTA_METRICS:
+                    {
+                        int metrics_len(RTA_PAYLOAD(attr));
+                        for(rtattr const * m(reinterpret_cast<rtattr const *>(RTA_DATA(attr)));
+                            RTA_OK(m, metrics_len);
+                            m = RTA_NEXT(m, metrics_len))
+                        {
+                            std::uint32_t const value(*reinterpret_cast<std::uint32_t const *>(RTA_DATA(m)));
+                            switch(m->rta_type)
+                            {
+                            case RTAX_MTU:
+                                r.f_mtu = value;
+                                break;
+
+                            case RTAX_WINDOW:
+                                r.f_window = value;
+                                break;
+
+                            case RTAX_RTT:
+                                r.f_irtt = value >> 3;
+                                break;
+
+                            }
+                        }
+                    }
+                    break;
+
+                }
+            }
+
+            if(table != RT_TABLE_MAIN)
+            {
+                continue;
+            }
+
+            r.f_destination_address.set_mask_count(128 - max_mask + msg->rtm_dst_len);
+
+            switch(msg->rtm_type)
+            {
+            case RTN_UNICAST:
+                r.f_flags |= RTF_UP;
+                break;
+
+            case RTN_UNREACHABLE:
+            case RTN_PROHIBIT:
+            case RTN_BLACKHOLE:
+                r.f_flags |= RTF_REJECT;
+                break;
+
+            default:
+                continue; // LCOV_EXCL_LINE
+
+            }
+            if(!r.f_gateway_address.is_default())
+            {
+                r.f_flags |= RTF_GATEWAY;
+            }
+            if(msg->rtm_dst_len == max_mask)
+            {
+                r.f_flags |= RTF_HOST;
+            }
+            if(msg->rtm_protocol == RTPROT_RA)
+            {
+                r.f_flags |= RTF_ADDRCONF; // LCOV_EXCL_LINE
+            }
+
+            routes.push_back(pointer_t(new route(r)));
+        }
+    }
+}
+
+
+/** \brief Get the IPv4 and IPv6 routes.
+ *
+ * This function returns the routes of the main table of the kernel,
+ * IPv4 and IPv6, in one vector. The routes are read with netlink. If
+ * that fails, the function falls back to reading the /proc/net/route
+ * and /proc/net/ipv6_route files (see get_ipv4_routes() and
+ * get_ipv6_routes()).
+ *
+ * \note
+ * The function caches the list of routes. On a second call, and if
+ * the cache did not yet time out (see set_routes_cache_ttl() for
+ * details), then the same list is returned. The iface netlink monitor
+ * (see iface::start_local_addresses_monitor()) resets the cache each
+ * time a route changes.
+ * \note
+ * The cache is managed in a thread safe manner. The returned list is
+ * never modified. When the cache times out, only one thread reads
+ * the routes again; the others wait for its result.
+ *
+ * \return A vector of all the IPv4 and IPv6 routes.
+ *
+ * \sa reset_routes_cache()
+ * \sa set_routes_cache_ttl()
+ */
+route::pointer_vector_t route::get_routes()
+{
+    pointer_vector_t cache(std::atomic_load(&g_cache_routes));
+    if(cache != nullptr
+    && g_routes_timeout >= time(nullptr))
+    {
+        return cache;
+    }
+
+    cppthread::guard lock(g_routes_mutex);
+
+    // another thread may have read the routes while we were waiting
+    //
+    cache = std::atomic_load(&g_cache_routes);
+    if(cache != nullptr
+    && g_routes_timeout >= time(nullptr))
+    {
+        return cache;
+    }
+
+    std::shared_ptr<vector_t> routes(std::make_shared<vector_t>());
+    if(!get_netlink_routes(*routes))
+    {
+        // LCOV_EXCL_START
+        *routes = get_ipv4_routes();
+        vector_t const ipv6(get_ipv6_routes());
+        routes->insert(routes->end(), ipv6.begin(), ipv6.end());
+        // LCOV_EXCL_STOP
+    }
+
+    cache = routes;
+    g_routes_timeout = time(nullptr) + g_routes_ttl;
+    std::atomic_store(&g_cache_routes, cache);
+    return cache;
+}
+
+
+/** \brief Search the route used to reach a destination.
+ *
+ * This function searches the cached routes (see get_routes()) for the
+ * route the kernel would use to send a packet to \p destination: the
+ * route with the longest matching prefix and, among the routes with
+ * that prefix, the one with the smallest metric.
+ *
+ * The search uses a prefix table compiled from the cached routes so
+ * its cost depends on the length of the address, not the number of
+ * routes. The table gets updated the first time this function is
+ * called after the route cache was refreshed.
+ *
+ * \note
+ * Only the main table is considered. Policy routing rules are ignored.
+ *
+ * \param[in] destination  The address to reach.
+ *
+ * \return The route to use or a null pointer if no route matches or
+ * the matching route rejects packets.
+ */
+route::pointer_t route::find_route(addr const & destination)
+{
+    pointer_vector_t const routes(get_routes());
+    route_table::pointer_t table(std::atomic_load(&g_route_table));
+    if(table == nullptr
+    || table->get_routes() != routes)
+    {
+        cppthread::guard lock(g_route_table_mutex);
+
+        // another thread may have updated the table while we were waiting
+        //
+        table = std::atomic_load(&g_route_table);
+        if(table == nullptr
+        || table->get_routes() != routes)
+        {
+            std::shared_ptr<route_table> updated(table == nullptr
+                    ? std::make_shared<route_table>()
+                    : std::make_shared<route_table>(*table));
+            updated->update(routes);
+            table = updated;
+            std::atomic_store(&g_route_table, table);
+        }
+    }
+
+    return table->find(destination);
+}
+
+
+/** \brief Explicitly reset the route cache.
+ *
+ * This function resets the cache timeout to 0 and resets the vector of
+ * routes. The next call to get_routes() reads the routes again.
+ */
+void route::reset_routes_cache()
+{
+    cppthread::guard lock(g_routes_mutex);
+
+    g_routes_timeout = 0;
+    std::atomic_store(&g_cache_routes, pointer_vector_t());
+}
+
+
+/** \brief Change the TTL of the route cache.
+ *
+ * By default the TTL of the route cache is set to 5 minutes. Routes
+ * rarely change so a larger number is generally fine. To always have
+ * the current routes, start the iface netlink monitor which resets
+ * the cache on each change.
+ *
+ * 0 does not cancel the use of the cache entirely. Instead, it will be
+ * used for up to one second.
+ *
+ * \param[in] duration_seconds  The duration of the route cache.
+ *
+ * \sa iface::start_local_addresses_monitor()
+ */
+void route::set_routes_cache_ttl(std::uint32_t duration_seconds)
+{
+    g_routes_ttl = duration_seconds;
+}
+
+
 std::string const & route::get_interface_name() const
 {
     return f_interface_name;
@@ -419,6 +1183,36 @@ int route::get_irtt() const
 }
 
 
+/** \brief Search the route used to reach a destination in a list.
+ *
+ * This function compiles \p routes and searches the route the kernel
+ * would use to reach \p destination, like route::find_route() does
+ * with the cached routes. Since the list gets compiled on each call,
+ * prefer route::find_route() when searching many destinations.
+ *
+ * \param[in] routes  The routes to search.
+ * \param[in] destination  The address to reach.
+ *
+ * \return The route to use or a null pointer.
+ */
+route::pointer_t find_route(route::vector_t const & routes, addr const & destination)
+{
+    route_table table;
+    table.update(std::make_shared<route::vector_t const>(routes));
+    return table.find(destination);
+}
+
+
+/** \brief Search for the default route.
+ *
+ * This function returns the first route which destination is the
+ * default address and which is up. Routes rejecting packets (such as
+ * an unreachable default route) are ignored.
+ *
+ * \param[in] routes  The routes to search.
+ *
+ * \return The default route or a null pointer.
+ */
 route::pointer_t find_default_route(route::vector_t const & routes)
 {
     auto it(std::find_if(
@@ -426,7 +1220,8 @@ route::pointer_t find_default_route(route::vector_t const & routes)
         , routes.cend()
         , [](auto const & r)
         {
-            return r->get_destination_address().is_default();
+            return r->get_destination_address().is_default()
+                && (r->get_flags() & RTF_UP) != 0;
         }));
 
     if(it == routes.cend())
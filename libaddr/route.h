@@ -45,8 +45,15 @@ class route
 public:
     typedef std::shared_ptr<route>  pointer_t;
     typedef std::vector<pointer_t>  vector_t;
+    typedef std::shared_ptr<vector_t const>
+                                    pointer_vector_t;
 
     static vector_t                 get_ipv4_routes();
+    static vector_t                 get_ipv6_routes();
+    static pointer_vector_t         get_routes();
+    static void                     reset_routes_cache();
+    static void                     set_routes_cache_ttl(std::uint32_t duration_seconds);
+    static pointer_t                find_route(addr const & destination);
 
     std::string const &             get_interface_name() const;
     addr const &                    get_destination_address() const;
@@ -61,6 +68,8 @@ public:
     int                             get_irtt() const;
 
 private:
+    static bool                     get_netlink_routes(vector_t & routes);
+
     std::string                     f_interface_name = std::string();
     addr                            f_destination_address = addr();  // Destination + Mask
     addr                            f_gateway_address = addr();
@@ -75,6 +84,7 @@ private:
 
 
 route::pointer_t find_default_route(route::vector_t const & routes);
+route::pointer_t find_route(route::vector_t const & routes, addr const & destination);
 
 
 }
@@ -0,0 +1,766 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+/** \file
+ * \brief The implementation of the service_registry class.
+ *
+ * The registry reads the services and protocols files in a snapshot of
+ * hash tables. A reload creates a new snapshot, swaps it in with
+ * std::atomic_store(), and increments a generation counter.
+ *
+ * Each thread keeps a pointer to the last snapshot it used along with
+ * its generation. As long as the generation does not change, a lookup
+ * only reads the atomic counter. The std::atomic_load() of the shared
+ * pointer, which uses a lock internally, only happens once per thread
+ * after a reload.
+ *
+ * The snapshots are shared pointers. An old snapshot gets freed once
+ * each thread which used it did another lookup (or exited). This is why
+ * the names are returned by value or copied in a buffer.
+ */
+
+// self
+//
+#include    "libaddr/service_registry.h"
+
+
+// snapdev
+//
+#include    <snapdev/tokenize_string.h>
+
+
+// cppthread
+//
+#include    <cppthread/guard.h>
+#include    <cppthread/mutex.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <atomic>
+#include    <chrono>
+#include    <cstring>
+#include    <fstream>
+#include    <memory>
+#include    <unordered_map>
+#include    <vector>
+
+
+// C
+//
+#include    <dirent.h>
+#include    <netinet/in.h>
+#include    <sys/stat.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace addr
+{
+
+
+namespace
+{
+
+
+/** \brief The state of one of the loaded files.
+ *
+ * This is used to detect changes to the files. A file which does not
+ * exist is saved with f_exists set to false so its creation is
+ * detected too.
+ */
+struct file_stamp_t
+{
+    std::string                 f_filename = std::string();
+    bool                        f_exists = false;
+    timespec                    f_mtime = timespec();
+    off_t                       f_size = 0;
+
+    bool operator == (file_stamp_t const & rhs) const
+    {
+        return f_filename == rhs.f_filename
+            && f_exists == rhs.f_exists
+            && f_mtime.tv_sec == rhs.f_mtime.tv_sec
+            && f_mtime.tv_nsec == rhs.f_mtime.tv_nsec
+            && f_size == rhs.f_size;
+    }
+};
+
+
+typedef std::vector<file_stamp_t>       file_stamps_t;
+
+
+/** \brief The port of a service for one protocol.
+ */
+struct service_port_t
+{
+    int                         f_protocol = 0;
+    int                         f_port = 0;
+};
+
+
+/** \brief An immutable copy of the services and protocols.
+ *
+ * The service names (and aliases) point to the list of ports, one per
+ * protocol. The reverse map uses the port and protocol as its key.
+ */
+struct snapshot_t
+{
+    typedef std::shared_ptr<snapshot_t const>   pointer_t;
+
+    std::unordered_map<std::string, std::vector<service_port_t>>
+                                f_service_ports = std::unordered_map<std::string, std::vector<service_port_t>>();
+    std::unordered_map<std::uint32_t, std::string>
+                                f_port_names = std::unordered_map<std::uint32_t, std::string>();
+    std::unordered_map<std::string, int>
+                                f_protocol_numbers = std::unordered_map<std::string, int>();
+    std::unordered_map<int, std::string>
+                                f_protocol_names = std::unordered_map<int, std::string>();
+    file_stamps_t               f_stamps = file_stamps_t();
+};
+
+
+cppthread::mutex                            g_mutex = cppthread::mutex();
+std::string                                 g_services_filename = service_registry::DEFAULT_SERVICES_FILENAME;
+std::string                                 g_protocols_filename = service_registry::DEFAULT_PROTOCOLS_FILENAME;
+std::string                                 g_drop_in_directory = service_registry::DEFAULT_DROP_IN_DIRECTORY;
+snapshot_t::pointer_t                       g_snapshot = snapshot_t::pointer_t();
+std::atomic<std::uint64_t>                  g_generation(0);
+std::atomic<std::uint32_t>                  g_check_interval(service_registry::DEFAULT_CHECK_INTERVAL);
+std::atomic<std::int64_t>                   g_next_check(0);
+
+
+/** \brief The snapshot last used by a thread.
+ *
+ * The f_generation is the value of g_generation when f_snapshot was
+ * loaded from g_snapshot.
+ */
+struct thread_snapshot_t
+{
+    std::uint64_t               f_generation = 0;
+    snapshot_t::pointer_t       f_snapshot = snapshot_t::pointer_t();
+};
+
+
+thread_local thread_snapshot_t              g_thread_snapshot = thread_snapshot_t();
+
+
+std::uint32_t port_key(int port, int protocol)
+{
+    return (static_cast<std::uint32_t>(port) << 16) | static_cast<std::uint16_t>(protocol);
+}
+
+
+std::int64_t now_seconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+file_stamp_t get_stamp(std::string const & filename)
+{
+    file_stamp_t stamp;
+    stamp.f_filename = filename;
+    struct stat s;
+    if(stat(filename.c_str(), &s) == 0)
+    {
+        stamp.f_exists = true;
+        stamp.f_mtime = s.st_mtim;
+        stamp.f_size = s.st_size;
+    }
+    return stamp;
+}
+
+
+/** \brief Get the list of files to load.
+ *
+ * The order matters since the first definition of a name or number
+ * wins: the system services, then the drop-in files sorted by name.
+ * The drop-in directory itself is included so adding or removing a
+ * file is detected.
+ *
+ * The protocols file is loaded first since the services refer to
+ * protocols by name.
+ *
+ * The g_mutex must be locked by the caller.
+ *
+ * \return The list of protocols, services, and drop-in files.
+ */
+file_stamps_t get_stamps()
+{
+    file_stamps_t stamps;
+    stamps.push_back(get_stamp(g_protocols_filename));
+    stamps.push_back(get_stamp(g_services_filename));
+    stamps.push_back(get_stamp(g_drop_in_directory));
+
+    std::vector<std::string> drop_ins;
+    DIR * d(opendir(g_drop_in_directory.c_str()));
+    if(d != nullptr)
+    {
+        for(dirent * e(readdir(d)); e != nullptr; e = readdir(d))
+        {
+            std::string const name(e->d_name);
+            if(name.length() > 5
+            && name.compare(name.length() - 5, 5, ".conf") == 0)
+            {
+                drop_ins.push_back(g_drop_in_directory + '/' + name);
+            }
+        }
+        closedir(d);
+    }
+    std::sort(drop_ins.begin(), drop_ins.end());
+    for(auto const & f : drop_ins)
+    {
+        stamps.push_back(get_stamp(f));
+    }
+
+    return stamps;
+}
+
+
+/** \brief Read the fields of each line of a file.
+ *
+ * This function reads \p filename and calls \p callback with the
+ * fields of each non-empty line. Comments, introduced by '#', are
+ * removed.
+ *
+ * \param[in] filename  The name of the file to read.
+ * \param[in] callback  The function called with the fields of each line.
+ */
+template<typename F>
+void read_fields(std::string const & filename, F callback)
+{
+    std::ifstream in(filename);
+    std::string line;
+    std::vector<std::string> fields;
+    while(std::getline(in, line))
+    {
+        std::string::size_type const comment(line.find('#'));
+        if(comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+        fields.clear();
+        snapdev::tokenize_string(fields, line, " \t\r", true);
+        if(!fields.empty())
+        {
+            callback(fields);
+        }
+    }
+}
+
+
+/** \brief Parse a number.
+ *
+ * \param[in] s  The string to parse.
+ * \param[in] max  The largest acceptable number.
+ *
+ * \return The number or -1 if \p s is not a valid number.
+ */
+int parse_number(std::string const & s, int max)
+{
+    if(s.empty())
+    {
+        return -1;
+    }
+    int result(0);
+    for(char const c : s)
+    {
+        if(c < '0' || c > '9')
+        {
+            return -1;
+        }
+        result = result * 10 + c - '0';
+        if(result > max)
+        {
+            return -1;
+        }
+    }
+    return result;
+}
+
+
+/** \brief Load the protocols of a file in a snapshot.
+ *
+ * The format is the one of /etc/protocols:
+ *
+ * \code
+ *     <name> <number> [<alias> ...]
+ * \endcode
+ *
+ * \param[in] filename  The name of the file to load.
+ * \param[in,out] snapshot  The snapshot receiving the protocols.
+ */
+void load_protocols(std::string const & filename, snapshot_t & snapshot)
+{
+    read_fields(filename, [&snapshot](std::vector<std::string> const & fields)
+    {
+        if(fields.size() < 2)
+        {
+            return;
+        }
+        int const number(parse_number(fields[1], 65535));
+        if(number < 0)
+        {
+            return;
+        }
+        snapshot.f_protocol_names.emplace(number, fields[0]);
+        snapshot.f_protocol_numbers.emplace(fields[0], number);
+        for(std::size_t idx(2); idx < fields.size(); ++idx)
+        {
+            snapshot.f_protocol_numbers.emplace(fields[idx], number);
+        }
+    });
+}
+
+
+/** \brief Load the services of a file in a snapshot.
+ *
+ * The format is the one of /etc/services:
+ *
+ * \code
+ *     <name> <port>/<protocol> [<alias> ...]
+ * \endcode
+ *
+ * The protocols must already be loaded since the protocol is a name.
+ *
+ * \param[in] filename  The name of the file to load.
+ * \param[in,out] snapshot  The snapshot receiving the services.
+ */
+void load_services(std::string const & filename, snapshot_t & snapshot)
+{
+    read_fields(filename, [&snapshot](std::vector<std::string> const & fields)
+    {
+        if(fields.size() < 2)
+        {
+            return;
+        }
+        std::string::size_type const slash(fields[1].find('/'));
+        if(slash == std::string::npos)
+        {
+            return;
+        }
+        int const port(parse_number(fields[1].substr(0, slash), 65535));
+        auto const proto(snapshot.f_protocol_numbers.find(fields[1].substr(slash + 1)));
+        if(port < 0
+        || proto == snapshot.f_protocol_numbers.end())
+        {
+            return;
+        }
+        service_port_t const service{ proto->second, port };
+        snapshot.f_port_names.emplace(port_key(port, service.f_protocol), fields[0]);
+        for(std::size_t idx(0); idx < fields.size(); ++idx)
+        {
+            if(idx == 1)
+            {
+                continue;
+            }
+            std::vector<service_port_t> & ports(snapshot.f_service_ports[fields[idx]]);
+            if(std::find_if(
+                      ports.begin()
+                    , ports.end()
+                    , [&service](service_port_t const & p)
+                      {
+                          return p.f_protocol == service.f_protocol;
+                      }) == ports.end())
+            {
+                ports.push_back(service);
+            }
+        }
+    });
+}
+
+
+/** \brief Load a new snapshot.
+ *
+ * This function reads all the files and publishes the new snapshot.
+ *
+ * The g_mutex must be locked by the caller.
+ *
+ * \return The new snapshot.
+ */
+snapshot_t::pointer_t load()
+{
+    std::shared_ptr<snapshot_t> snapshot(std::make_shared<snapshot_t>());
+    snapshot->f_stamps = get_stamps();
+
+    load_protocols(g_protocols_filename, *snapshot);
+
+    // the protocols we cannot do without, in case the file is missing
+    //
+    snapshot->f_protocol_names.emplace(IPPROTO_IP, "ip");
+    snapshot->f_protocol_names.emplace(IPPROTO_TCP, "tcp");
+    snapshot->f_protocol_names.emplace(IPPROTO_UDP, "udp");
+    snapshot->f_protocol_numbers.emplace("ip", IPPROTO_IP);
+    snapshot->f_protocol_numbers.emplace("tcp", IPPROTO_TCP);
+    snapshot->f_protocol_numbers.emplace("udp", IPPROTO_UDP);
+
+    for(std::size_t idx(1); idx < snapshot->f_stamps.size(); ++idx)
+    {
+        if(idx != 2)    // skip the drop-in directory itself
+        {
+            load_services(snapshot->f_stamps[idx].f_filename, *snapshot);
+        }
+    }
+
+    std::atomic_store(&g_snapshot, snapshot_t::pointer_t(snapshot));
+    ++g_generation;
+    g_next_check = now_seconds() + g_check_interval;
+    return snapshot;
+}
+
+
+/** \brief Get the current snapshot.
+ *
+ * The first call loads the files. Later calls check whether the files
+ * changed once every check interval.
+ *
+ * The snapshot is kept in g_thread_snapshot so the returned reference
+ * remains valid until the same thread calls this function again.
+ *
+ * \return The current snapshot.
+ */
+snapshot_t const & get_snapshot()
+{
+    std::uint32_t const interval(g_check_interval);
+    if(interval != 0)
+    {
+        // only one thread wins the exchange and checks the files
+        //
+        std::int64_t const now(now_seconds());
+        std::int64_t next(g_next_check);
+        if(now >= next
+        && g_next_check.compare_exchange_strong(next, now + interval))
+        {
+            service_registry::reload_if_changed();
+        }
+    }
+
+    thread_snapshot_t & t(g_thread_snapshot);
+    std::uint64_t const generation(g_generation);
+    if(t.f_snapshot == nullptr
+    || t.f_generation != generation)
+    {
+        t.f_snapshot = std::atomic_load(&g_snapshot);
+        if(t.f_snapshot == nullptr)
+        {
+            cppthread::guard lock(g_mutex);
+            t.f_snapshot = std::atomic_load(&g_snapshot);
+            if(t.f_snapshot == nullptr)
+            {
+                t.f_snapshot = load();
+            }
+        }
+        t.f_generation = generation;
+    }
+
+    return *t.f_snapshot;
+}
+
+
+}
+// no name namespace
+
+
+
+/** \brief Change the name of the services file.
+ *
+ * By default, the registry loads the services from /etc/services. This
+ * function can be used to load another file instead. The change takes
+ * effect on the next reload.
+ *
+ * \param[in] filename  The name of the services file.
+ *
+ * \sa reload()
+ */
+void service_registry::set_services_filename(std::string const & filename)
+{
+    cppthread::guard lock(g_mutex);
+    g_services_filename = filename;
+}
+
+
+/** \brief Get the name of the services file.
+ *
+ * \return The name of the services file.
+ */
+std::string service_registry::get_services_filename()
+{
+    cppthread::guard lock(g_mutex);
+    return g_services_filename;
+}
+
+
+/** \brief Change the name of the protocols file.
+ *
+ * By default, the registry loads the protocols from /etc/protocols.
+ * The change takes effect on the next reload.
+ *
+ * The "ip", "tcp", and "udp" protocols are always defined, even if
+ * missing from the file.
+ *
+ * \param[in] filename  The name of the protocols file.
+ *
+ * \sa reload()
+ */
+void service_registry::set_protocols_filename(std::string const & filename)
+{
+    cppthread::guard lock(g_mutex);
+    g_protocols_filename = filename;
+}
+
+
+/** \brief Get the name of the protocols file.
+ *
+ * \return The name of the protocols file.
+ */
+std::string service_registry::get_protocols_filename()
+{
+    cppthread::guard lock(g_mutex);
+    return g_protocols_filename;
+}
+
+
+/** \brief Change the drop-in directory.
+ *
+ * The files ending with ".conf" in this directory are loaded after
+ * the services file, sorted by name. They use the same format as
+ * /etc/services. This is where a project adds its own services
+ * without having to edit the system file.
+ *
+ * A name or port already defined by an earlier file is not redefined.
+ *
+ * The change takes effect on the next reload.
+ *
+ * \param[in] directory  The drop-in directory.
+ *
+ * \sa reload()
+ */
+void service_registry::set_drop_in_directory(std::string const & directory)
+{
+    cppthread::guard lock(g_mutex);
+    g_drop_in_directory = directory;
+}
+
+
+/** \brief Get the drop-in directory.
+ *
+ * \return The drop-in directory.
+ */
+std::string service_registry::get_drop_in_directory()
+{
+    cppthread::guard lock(g_mutex);
+    return g_drop_in_directory;
+}
+
+
+/** \brief Change how often the files get checked for changes.
+ *
+ * Once every \p duration_seconds, one of the lookups checks whether
+ * the files changed and reloads them if so. Use 0 to turn off the
+ * check, in which case only an explicit reload() updates the registry.
+ *
+ * \param[in] duration_seconds  The number of seconds between checks.
+ */
+void service_registry::set_check_interval(std::uint32_t duration_seconds)
+{
+    g_check_interval = duration_seconds;
+    g_next_check = now_seconds() + duration_seconds;
+}
+
+
+/** \brief Get how often the files get checked for changes.
+ *
+ * \return The number of seconds between checks.
+ */
+std::uint32_t service_registry::get_check_interval()
+{
+    return g_check_interval;
+}
+
+
+/** \brief Reload the services and protocols.
+ *
+ * This function reads the files again and replaces the registry.
+ * Threads doing lookups at the same time keep using the previous
+ * data until their next lookup.
+ */
+void service_registry::reload()
+{
+    cppthread::guard lock(g_mutex);
+    load();
+}
+
+
+/** \brief Reload the files if they changed.
+ *
+ * This function checks the modification time and size of each file and
+ * reloads the registry if any one of them changed, was added, or was
+ * removed.
+ *
+ * \return true if the registry was reloaded.
+ */
+bool service_registry::reload_if_changed()
+{
+    cppthread::guard lock(g_mutex);
+    snapshot_t::pointer_t snapshot(std::atomic_load(&g_snapshot));
+    if(snapshot != nullptr
+    && snapshot->f_stamps == get_stamps())
+    {
+        return false;
+    }
+    load();
+    return true;
+}
+
+
+/** \brief Get the port of a service.
+ *
+ * This function searches for the port of the service named \p name
+ * (or one of its aliases) for the specified \p protocol.
+ *
+ * \param[in] name  The name of the service (i.e. "http").
+ * \param[in] protocol  The protocol (i.e. IPPROTO_TCP).
+ *
+ * \return The port or -1 if the service is not known.
+ */
+int service_registry::get_port(std::string const & name, int protocol)
+{
+    snapshot_t const & snapshot(get_snapshot());
+    auto const it(snapshot.f_service_ports.find(name));
+    if(it != snapshot.f_service_ports.end())
+    {
+        for(auto const & p : it->second)
+        {
+            if(p.f_protocol == protocol)
+            {
+                return p.f_port;
+            }
+        }
+    }
+    return -1;
+}
+
+
+/** \brief Get the name of a port.
+ *
+ * This function returns the name of the service using \p port with
+ * \p protocol.
+ *
+ * \param[in] port  The port to search.
+ * \param[in] protocol  The protocol (i.e. IPPROTO_TCP).
+ *
+ * \return The name of the service or an empty string.
+ */
+std::string service_registry::get_port_name(int port, int protocol)
+{
+    snapshot_t const & snapshot(get_snapshot());
+    auto const it(snapshot.f_port_names.find(port_key(port, protocol)));
+    if(it == snapshot.f_port_names.end())
+    {
+        return std::string();
+    }
+    return it->second;
+}
+
+
+/** \brief Copy the name of a port in a buffer.
+ *
+ * This function is the same as the other get_port_name() except that
+ * the name gets copied in \p buf so no memory gets allocated. The name
+ * is not null terminated.
+ *
+ * If the name is longer than \p size, nothing is copied. The caller
+ * can then use the other get_port_name() function instead.
+ *
+ * \param[in] port  The port to search.
+ * \param[in] protocol  The protocol (i.e. IPPROTO_TCP).
+ * \param[out] buf  The buffer receiving the name.
+ * \param[in] size  The size of \p buf.
+ *
+ * \return The length of the name or 0 if the port has no name.
+ */
+std::size_t service_registry::get_port_name(int port, int protocol, char * buf, std::size_t size)
+{
+    snapshot_t const & snapshot(get_snapshot());
+    auto const it(snapshot.f_port_names.find(port_key(port, protocol)));
+    if(it == snapshot.f_port_names.end())
+    {
+        return 0;
+    }
+    std::size_t const length(it->second.length());
+    if(length <= size)
+    {
+        memcpy(buf, it->second.data(), length);
+    }
+    return length;
+}
+
+
+/** \brief Get the number of a protocol.
+ *
+ * \param[in] name  The name (or alias) of the protocol (i.e. "tcp").
+ *
+ * \return The protocol number or -1 if the protocol is not known.
+ */
+int service_registry::get_protocol(std::string const & name)
+{
+    snapshot_t const & snapshot(get_snapshot());
+    auto const it(snapshot.f_protocol_numbers.find(name));
+    if(it == snapshot.f_protocol_numbers.end())
+    {
+        return -1;
+    }
+    return it->second;
+}
+
+
+/** \brief Get the name of a protocol.
+ *
+ * \param[in] protocol  The protocol number (i.e. IPPROTO_TCP).
+ *
+ * \return The name of the protocol or an empty string.
+ */
+std::string service_registry::get_protocol_name(int protocol)
+{
+    snapshot_t const & snapshot(get_snapshot());
+    auto const it(snapshot.f_protocol_names.find(protocol));
+    if(it == snapshot.f_protocol_names.end())
+    {
+        return std::string();
+    }
+    return it->second;
+}
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
@@ -0,0 +1,75 @@
+// Copyright (c) 2012-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#pragma once
+
+/** \file
+ * \brief The in-memory registry of services and protocols.
+ *
+ * This header defines the service_registry class which loads the
+ * /etc/services and /etc/protocols files once and offers O(1) lookups
+ * in both directions (name to number and number to name).
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <string>
+
+
+
+namespace addr
+{
+
+
+class service_registry
+{
+public:
+    static constexpr char const *           DEFAULT_SERVICES_FILENAME = "/etc/services";
+    static constexpr char const *           DEFAULT_PROTOCOLS_FILENAME = "/etc/protocols";
+    static constexpr char const *           DEFAULT_DROP_IN_DIRECTORY = "/etc/libaddr/services.d";
+    static constexpr std::uint32_t const    DEFAULT_CHECK_INTERVAL = 10;
+
+    static void                 set_services_filename(std::string const & filename);
+    static std::string          get_services_filename();
+    static void                 set_protocols_filename(std::string const & filename);
+    static std::string          get_protocols_filename();
+    static void                 set_drop_in_directory(std::string const & directory);
+    static std::string          get_drop_in_directory();
+    static void                 set_check_interval(std::uint32_t duration_seconds);
+    static std::uint32_t        get_check_interval();
+
+    static void                 reload();
+    static bool                 reload_if_changed();
+
+    static int                  get_port(std::string const & name, int protocol);
+    static std::string          get_port_name(int port, int protocol);
+    static std::size_t          get_port_name(int port, int protocol, char * buf, std::size_t size);
+    static int                  get_protocol(std::string const & name);
+    static std::string          get_protocol_name(int protocol);
+};
+
+
+
+}
+// namespace addr
+// vim: ts=4 sw=4 et
@@ -34,12 +34,14 @@
  *
  * This file implements a test that verifies the function that
  * reads the list of IP addresses as defined in your local
- * interfaces.
+ * interfaces. It also verifies the netlink monitor using a
+ * stubbed netlink socket.
  */
 
 // addr
 //
 #include    <libaddr/iface.h>
+#include    <libaddr/route.h>
 
 
 // self
@@ -47,9 +49,18 @@
 #include    "catch_main.h"
 
 
+// C++
+//
+#include    <condition_variable>
+#include    <mutex>
+
+
 // C
 //
+#include    <linux/rtnetlink.h>
 #include    <net/if.h>
+#include    <sys/socket.h>
+#include    <unistd.h>
 
 
 // last include
@@ -58,6 +69,103 @@
 
 
 
+namespace
+{
+
+
+void add_attribute(std::vector<char> & msg, int type, void const * data, std::size_t size)
+{
+    std::size_t const pos(msg.size());
+    msg.resize(pos + RTA_SPACE(size));
+    rtattr * rta(reinterpret_cast<rtattr *>(msg.data() + pos));
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(size);
+    memcpy(RTA_DATA(rta), data, size);
+}
+
+
+template<typename T>
+std::vector<char> start_message(int type, T const & body)
+{
+    std::vector<char> msg(NLMSG_SPACE(sizeof(body)));
+    nlmsghdr * h(reinterpret_cast<nlmsghdr *>(msg.data()));
+    h->nlmsg_type = type;
+    memcpy(NLMSG_DATA(h), &body, sizeof(body));
+    return msg;
+}
+
+
+void send_message(int s, std::vector<char> & msg)
+{
+    reinterpret_cast<nlmsghdr *>(msg.data())->nlmsg_len = msg.size();
+    CATCH_REQUIRE(send(s, msg.data(), msg.size(), 0) == static_cast<ssize_t>(msg.size()));
+}
+
+
+std::vector<char> ipv4_address_message(int type, char const * label, std::uint32_t ip, int prefix)
+{
+    ifaddrmsg body = {};
+    body.ifa_family = AF_INET;
+    body.ifa_prefixlen = prefix;
+    std::vector<char> msg(start_message(type, body));
+    std::uint32_t const address(htonl(ip));
+    add_attribute(msg, IFA_LOCAL, &address, sizeof(address));
+    add_attribute(msg, IFA_ADDRESS, &address, sizeof(address));
+    add_attribute(msg, IFA_LABEL, label, strlen(label) + 1);
+    return msg;
+}
+
+
+class event_collector
+{
+public:
+    void add(addr::iface_event_t event, addr::iface::pointer_t const & i)
+    {
+        std::unique_lock<std::mutex> lock(f_mutex);
+        f_events.emplace_back(event, i);
+        f_changed.notify_all();
+    }
+
+    std::vector<std::pair<addr::iface_event_t, addr::iface::pointer_t>> wait(std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock(f_mutex);
+        f_changed.wait_for(lock, std::chrono::seconds(10), [this, count]()
+            {
+                return f_events.size() >= count;
+            });
+        std::vector<std::pair<addr::iface_event_t, addr::iface::pointer_t>> result;
+        result.swap(f_events);
+        return result;
+    }
+
+private:
+    std::mutex                  f_mutex = std::mutex();
+    std::condition_variable     f_changed = std::condition_variable();
+    std::vector<std::pair<addr::iface_event_t, addr::iface::pointer_t>>
+                                f_events = std::vector<std::pair<addr::iface_event_t, addr::iface::pointer_t>>();
+};
+
+
+addr::iface::pointer_t find_interface(std::string const & name, addr::addr const & a)
+{
+    addr::iface::pointer_vector_t list(addr::iface::get_local_addresses());
+    for(auto const & i : *list)
+    {
+        if(i->get_name() == name
+        && i->get_address() == a)
+        {
+            return i;
+        }
+    }
+    return addr::iface::pointer_t();
+}
+
+
+}
+// no name namespace
+
+
+
 CATCH_TEST_CASE( "ipv4::interfaces", "[ipv4]" )
 {
     CATCH_GIVEN("iface::get_local_addresses()")
@@ -106,7 +214,171 @@ CATCH_TEST_CASE( "ipv4::interfaces", "[ipv4]" )
             }
         }
         CATCH_END_SECTION()
+
+        CATCH_START_SECTION("index matches a linear search")
+        {
+            for(auto i : *list)
+            {
+                // the most specific subnet wins so the interface found
+                // may differ, but it has to include the address
+                //
+                addr::addr const & a(i->get_address());
+                addr::iface::pointer_t found(addr::find_addr_interface(a, false));
+                CATCH_REQUIRE(found != nullptr);
+                CATCH_REQUIRE(found->get_address().match(a));
+                CATCH_REQUIRE(found->get_address().get_mask_size() >= a.get_mask_size());
+
+                if(i->has_broadcast_address())
+                {
+                    CATCH_REQUIRE(addr::is_broadcast_address(i->get_broadcast_address()));
+                }
+            }
+
+            addr::addr const localhost(addr::string_to_addr("127.0.0.1"));
+            addr::iface::pointer_t lo(addr::find_addr_interface(localhost, false));
+            CATCH_REQUIRE(lo != nullptr);
+            CATCH_REQUIRE(lo->get_name() == "lo");
+
+            // a documentation address (RFC 5737) is never local
+            //
+            addr::addr const remote(addr::string_to_addr("192.0.2.77"));
+            bool linear(false);
+            for(auto i : *list)
+            {
+                if(i->get_address().match(remote))
+                {
+                    linear = true;
+                }
+            }
+            CATCH_REQUIRE(linear == (addr::find_addr_interface(remote, false) != nullptr));
+            CATCH_REQUIRE_FALSE(addr::is_broadcast_address(remote));
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+
+CATCH_TEST_CASE( "ipv4::interfaces_monitor", "[ipv4]" )
+{
+    CATCH_START_SECTION("interfaces_monitor: stubbed netlink socket")
+    {
+        addr::iface::reset_local_addresses_cache();
+
+        int sv[2];
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv) == 0);
+
+        CATCH_REQUIRE_FALSE(addr::iface::is_local_addresses_monitor_running());
+        CATCH_REQUIRE(addr::iface::start_local_addresses_monitor(sv[0]));
+        CATCH_REQUIRE(addr::iface::is_local_addresses_monitor_running());
+        CATCH_REQUIRE_FALSE(addr::iface::start_local_addresses_monitor());
+
+        event_collector collector;
+        addr::iface::callback_id_t const id(addr::iface::add_local_addresses_callback(
+                [&collector](addr::iface_event_t event, addr::iface::pointer_t const & i)
+                {
+                    collector.add(event, i);
+                }));
+
+        addr::addr const loopback(addr::string_to_addr("127.0.0.1"));
+        addr::iface::pointer_t lo(find_interface("lo", loopback));
+        CATCH_REQUIRE(lo != nullptr);
+
+        // add an address
+        //
+        std::vector<char> msg(ipv4_address_message(RTM_NEWADDR, "lo", 0x7F090909, 8));
+        send_message(sv[1], msg);
+        auto events(collector.wait(1));
+        CATCH_REQUIRE(events.size() == 1);
+        CATCH_REQUIRE(events[0].first == addr::iface_event_t::IFACE_EVENT_ADDRESS_ADDED);
+        CATCH_REQUIRE(events[0].second->get_name() == "lo");
+        CATCH_REQUIRE(events[0].second->get_flags() == lo->get_flags());
+        CATCH_REQUIRE(events[0].second->get_address().to_ipv4_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "127.9.9.9/8");
+
+        addr::addr const added(addr::string_to_addr("127.9.9.9"));
+        CATCH_REQUIRE(find_interface("lo", added) != nullptr);
+
+        // the same address again is a change
+        //
+        send_message(sv[1], msg);
+        events = collector.wait(1);
+        CATCH_REQUIRE(events.size() == 1);
+        CATCH_REQUIRE(events[0].first == addr::iface_event_t::IFACE_EVENT_LINK_CHANGED);
+
+        // an IPv6 address without a label
+        //
+        ifaddrmsg body = {};
+        body.ifa_family = AF_INET6;
+        body.ifa_prefixlen = 64;
+        body.ifa_index = if_nametoindex("lo");
+        msg = start_message(RTM_NEWADDR, body);
+        in6_addr const ip6 = { { { 0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x99 } } };
+        add_attribute(msg, IFA_ADDRESS, &ip6, sizeof(ip6));
+        send_message(sv[1], msg);
+        events = collector.wait(1);
+        CATCH_REQUIRE(events.size() == 1);
+        CATCH_REQUIRE(events[0].first == addr::iface_event_t::IFACE_EVENT_ADDRESS_ADDED);
+        CATCH_REQUIRE(events[0].second->get_name() == "lo");
+        CATCH_REQUIRE(events[0].second->get_address().to_ipv6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "fd00::99/64");
+
+        // change the flags of "lo"
+        //
+        std::size_t lo_count(0);
+        for(auto const & i : *addr::iface::get_local_addresses())
+        {
+            if(i->get_name() == "lo")
+            {
+                ++lo_count;
+            }
+        }
+        ifinfomsg link = {};
+        link.ifi_family = AF_UNSPEC;
+        link.ifi_flags = lo->get_flags() | IFF_PROMISC;
+        msg = start_message(RTM_NEWLINK, link);
+        add_attribute(msg, IFLA_IFNAME, "lo", 3);
+        send_message(sv[1], msg);
+        events = collector.wait(lo_count);
+        CATCH_REQUIRE(events.size() == lo_count);
+        for(auto const & e : events)
+        {
+            CATCH_REQUIRE(e.first == addr::iface_event_t::IFACE_EVENT_LINK_CHANGED);
+            CATCH_REQUIRE(e.second->get_flags() == (lo->get_flags() | IFF_PROMISC));
+        }
+        CATCH_REQUIRE(find_interface("lo", added)->get_flags() == (lo->get_flags() | IFF_PROMISC));
+
+        // remove the IPv4 address; a route change resets the route
+        // cache; unknown messages are ignored
+        //
+        addr::route::pointer_vector_t const routes(addr::route::get_routes());
+        CATCH_REQUIRE(addr::route::get_routes() == routes);
+        msg = ipv4_address_message(RTM_DELADDR, "lo", 0x7F090909, 8);
+        reinterpret_cast<nlmsghdr *>(msg.data())->nlmsg_len = msg.size();
+        std::vector<char> route_msg(start_message(RTM_NEWROUTE, rtmsg()));
+        reinterpret_cast<nlmsghdr *>(route_msg.data())->nlmsg_len = route_msg.size();
+        msg.insert(msg.end(), route_msg.begin(), route_msg.end());
+        nlmsghdr const done = { NLMSG_LENGTH(0), NLMSG_DONE, 0, 0, 0 };
+        std::size_t const pos(msg.size());
+        msg.resize(pos + NLMSG_SPACE(0));
+        memcpy(msg.data() + pos, &done, sizeof(done));
+        CATCH_REQUIRE(send(sv[1], msg.data(), msg.size(), 0) == static_cast<ssize_t>(msg.size()));
+        events = collector.wait(1);
+        CATCH_REQUIRE(events.size() == 1);
+        CATCH_REQUIRE(events[0].first == addr::iface_event_t::IFACE_EVENT_ADDRESS_REMOVED);
+        CATCH_REQUIRE(find_interface("lo", added) == nullptr);
+        CATCH_REQUIRE(addr::route::get_routes() != routes);
+
+        addr::iface::remove_local_addresses_callback(id);
+        addr::iface::stop_local_addresses_monitor();
+        CATCH_REQUIRE_FALSE(addr::iface::is_local_addresses_monitor_running());
+        close(sv[1]);
+
+        // go back to the real list
+        //
+        addr::iface::reset_local_addresses_cache();
+        CATCH_REQUIRE(find_interface("lo", added) == nullptr);
+        CATCH_REQUIRE(find_interface("lo", loopback)->get_flags() == lo->get_flags());
     }
+    CATCH_END_SECTION()
 }
 
 
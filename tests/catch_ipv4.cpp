@@ -48,6 +48,13 @@
 #include    "catch_main.h"
 
 
+// C++
+//
+#include    <fstream>
+#include    <future>
+#include    <thread>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -3030,6 +3037,856 @@ CATCH_TEST_CASE("ipv4::network", "[ipv4]")
 }
 
 
+CATCH_TEST_CASE("ipv4::numeric", "[ipv4]")
+{
+    CATCH_GIVEN("addr_parser() without lookup")
+    {
+        CATCH_START_SECTION("ipv4::numeric: many addresses with ports and masks")
+        {
+            struct expected_t
+            {
+                std::uint32_t   f_ip = 0;
+                int             f_port = -1;
+                int             f_mask = -1;
+            };
+            std::vector<expected_t> expected;
+            std::string input;
+            for(int count(0); count < 1'000; ++count)
+            {
+                expected_t e;
+                e.f_ip = rand() ^ (rand() << 16);
+                input += std::to_string(e.f_ip >> 24)
+                       + '.' + std::to_string((e.f_ip >> 16) & 255)
+                       + '.' + std::to_string((e.f_ip >> 8) & 255)
+                       + '.' + std::to_string(e.f_ip & 255);
+                if(rand() % 2 == 0)
+                {
+                    e.f_port = rand() & 0xFFFF;
+                    input += ':' + std::to_string(e.f_port);
+                }
+                if(rand() % 2 == 0)
+                {
+                    e.f_mask = rand() % 33;
+                    input += '/' + std::to_string(e.f_mask);
+                }
+                input += '\n';
+                expected.push_back(e);
+            }
+
+            addr::addr_parser p;
+            p.set_protocol(IPPROTO_TCP);
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES, true);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+            addr::addr_range::vector_t const ips(p.parse(input));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == expected.size());
+
+            for(std::size_t idx(0); idx < ips.size(); ++idx)
+            {
+                CATCH_REQUIRE(ips[idx].has_from());
+                CATCH_REQUIRE_FALSE(ips[idx].has_to());
+                addr::addr const & a(ips[idx].get_from());
+                CATCH_REQUIRE(a.is_ipv4());
+
+                sockaddr_in in;
+                a.get_ipv4(in);
+                CATCH_REQUIRE(ntohl(in.sin_addr.s_addr) == expected[idx].f_ip);
+                CATCH_REQUIRE(a.get_hostname() == a.to_ipv4_string(addr::STRING_IP_ADDRESS));
+                CATCH_REQUIRE(a.get_port_defined() == (expected[idx].f_port != -1));
+                CATCH_REQUIRE(a.get_port() == std::max(expected[idx].f_port, 0));
+                CATCH_REQUIRE(a.get_protocol() == IPPROTO_TCP);
+                CATCH_REQUIRE(a.get_mask_size() == (expected[idx].f_mask == -1 ? 128 : 96 + expected[idx].f_mask));
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::numeric: default port")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_default_port(8080);
+            addr::addr_range::vector_t const ips(p.parse("10.0.0.1"));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == 1);
+            CATCH_REQUIRE(ips[0].get_from().to_ipv4_string(addr::STRING_IP_ADDRESS_PORT) == "10.0.0.1:8080");
+            CATCH_REQUIRE_FALSE(ips[0].get_from().get_port_defined());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::numeric: not so simple addresses still work")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_MASK, true);
+            addr::addr_range::vector_t const ips(p.parse(" 10.0.0.1 , 10.0.0.2/255.255.0.0,:55"));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == 3);
+            CATCH_REQUIRE(ips[0].get_from().to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.1:0/32");
+            CATCH_REQUIRE(ips[1].get_from().to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.2:0/16");
+            CATCH_REQUIRE(ips[2].get_from().to_ipv4_string(addr::STRING_IP_ALL) == "0.0.0.0:55/32");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::numeric: invalid addresses still generate errors")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+
+            CATCH_REQUIRE(p.parse("10.0.0.01").empty());
+            CATCH_REQUIRE(p.error_messages() == "Unknown address in \"10.0.0.01\" (no DNS lookup was allowed).\n");
+            p.clear_errors();
+
+            CATCH_REQUIRE(p.parse("10.0.0.1/33").empty());
+            CATCH_REQUIRE(p.error_messages() == "Unsupported mask size (33, expected 32 at the most for an IPv4).\n");
+            p.clear_errors();
+
+            CATCH_REQUIRE(p.parse("10.0.0.1:65536").empty());
+            CATCH_REQUIRE(p.error_messages() == "Invalid port in \"65536\" (no service name lookup allowed).\n");
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv4::stream", "[ipv4]")
+{
+    CATCH_GIVEN("addr_parser() with a callback")
+    {
+        std::string input("# list of hosts\n");
+        for(int count(0); count < 20'000; ++count)
+        {
+            input += "10."
+                   + std::to_string(count >> 16)
+                   + '.'
+                   + std::to_string((count >> 8) & 255)
+                   + '.'
+                   + std::to_string(count & 255);
+            if(count % 7 == 0)
+            {
+                input += " # comment";
+            }
+            input += '\n';
+            if(count % 100 == 0)
+            {
+                input += "; 192.168.0.1\n\n";
+            }
+        }
+
+        addr::addr_parser p;
+        p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+        p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES, true);
+        p.set_allow(addr::allow_t::ALLOW_COMMENT_HASH, true);
+        p.set_allow(addr::allow_t::ALLOW_COMMENT_SEMICOLON, true);
+        addr::addr_range::vector_t const expected(p.parse(input));
+        CATCH_REQUIRE_FALSE(p.has_errors());
+        CATCH_REQUIRE(expected.size() == 20'000);
+
+        CATCH_START_SECTION("ipv4::stream: parse an input stream")
+        {
+            std::istringstream in(input);
+            addr::addr_range::vector_t ips;
+            CATCH_REQUIRE(p.parse(in, [&ips](addr::addr_range const & range)
+                {
+                    ips.push_back(range);
+                    return true;
+                }));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips == expected);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::stream: stop early")
+        {
+            std::istringstream in(input);
+            std::size_t count(0);
+            CATCH_REQUIRE_FALSE(p.parse(in, [&count](addr::addr_range const & range)
+                {
+                    CATCH_REQUIRE(range.has_from());
+                    ++count;
+                    return count < 100;
+                }));
+            CATCH_REQUIRE(count == 100);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::stream: parse a pipe")
+        {
+            int fds[2];
+            CATCH_REQUIRE(pipe(fds) == 0);
+            std::shared_ptr<int> pipe_in(fds, socket_deleter);
+            std::shared_ptr<int> pipe_out(fds + 1, socket_deleter);
+            std::thread writer([&input, &fds]()
+                {
+                    std::size_t pos(0);
+                    while(pos < input.length())
+                    {
+                        ssize_t const r(write(fds[1], input.data() + pos, std::min(input.length() - pos, static_cast<std::size_t>(1'000))));
+                        if(r <= 0)
+                        {
+                            break;
+                        }
+                        pos += r;
+                    }
+                    close(fds[1]);
+                    fds[1] = -1;
+                });
+
+            addr::addr_range::vector_t ips;
+            bool const r(p.parse_fd(fds[0], [&ips](addr::addr_range const & range)
+                {
+                    ips.push_back(range);
+                    return true;
+                }));
+            writer.join();
+            CATCH_REQUIRE(r);
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips == expected);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::stream: parse a file")
+        {
+            std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/addresses.txt");
+            {
+                std::ofstream out(filename);
+                out << input;
+            }
+
+            addr::addr_range::vector_t ips;
+            CATCH_REQUIRE(p.parse_file(filename, [&ips](addr::addr_range const & range)
+                {
+                    ips.push_back(range);
+                    return true;
+                }));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips == expected);
+
+            // an empty file has no entries
+            //
+            {
+                std::ofstream out(filename);
+            }
+            ips.clear();
+            CATCH_REQUIRE(p.parse_file(filename, [&ips](addr::addr_range const & range)
+                {
+                    ips.push_back(range);
+                    return true;
+                }));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.empty());
+
+            unlink(filename.c_str());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::stream: missing file")
+        {
+            std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/no-such-file.txt");
+            CATCH_REQUIRE_FALSE(p.parse_file(filename, [](addr::addr_range const &)
+                {
+                    return true;
+                }));
+            CATCH_REQUIRE(p.has_errors());
+            CATCH_REQUIRE(p.error_messages() == "Could not open \"" + filename + "\" for reading (No such file or directory).\n");
+            p.clear_errors();
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv4::parallel", "[ipv4][ipv6]")
+{
+    CATCH_GIVEN("addr_parser() with multiple threads")
+    {
+        std::string input;
+        for(int count(0); count < 100'000; ++count)
+        {
+            std::uint32_t const ip(rand() ^ (rand() << 16));
+            switch(rand() % 10)
+            {
+            case 0:
+                input += "[2001:db8::" + std::to_string(ip & 0xFFF) + "]";
+                break;
+
+            case 1:
+                input += "# commented out";
+                break;
+
+            case 2:
+                input += "10.0.0.256";  // error
+                break;
+
+            default:
+                input += std::to_string(ip >> 24)
+                       + '.' + std::to_string((ip >> 16) & 255)
+                       + '.' + std::to_string((ip >> 8) & 255)
+                       + '.' + std::to_string(ip & 255);
+                if(rand() % 2 == 0)
+                {
+                    input += "/" + std::to_string(8 + rand() % 25);
+                }
+                break;
+
+            }
+            input += count % 10 == 0 ? '\n' : ',';
+        }
+
+        CATCH_START_SECTION("ipv4::parallel: same results as with one thread")
+        {
+            addr::sort_t const sorts[] =
+            {
+                addr::SORT_NO,
+                addr::SORT_FULL,
+                addr::SORT_MERGE,
+                addr::SORT_FULL | addr::SORT_IPV6_FIRST,
+                addr::SORT_MERGE | addr::SORT_IPV4_FIRST,
+            };
+            for(auto const sort : sorts)
+            {
+                addr::addr_parser p;
+                p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+                p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+                p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES, true);
+                p.set_allow(addr::allow_t::ALLOW_COMMENT_HASH, true);
+                p.set_allow(addr::allow_t::ALLOW_MASK, true);
+                p.set_sort_order(sort);
+                CATCH_REQUIRE(p.get_thread_count() == 1);
+                addr::addr_range::vector_t const expected(p.parse(input));
+                std::string const errors(p.error_messages());
+                int const error_count(p.error_count());
+                CATCH_REQUIRE(error_count > 0);
+                p.clear_errors();
+
+                p.set_thread_count(7);
+                CATCH_REQUIRE(p.get_thread_count() == 7);
+                addr::addr_range::vector_t const ips(p.parse(input));
+                CATCH_REQUIRE(p.error_messages() == errors);
+                CATCH_REQUIRE(p.error_count() == error_count);
+                CATCH_REQUIRE(ips == expected);
+
+                p.set_thread_count(0);
+                CATCH_REQUIRE(p.get_thread_count() >= 1);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::parallel: small input uses one thread")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_thread_count(16);
+            addr::addr_range::vector_t const ips(p.parse("10.0.0.1,10.0.0.2,10.0.0.3"));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == 3);
+            CATCH_REQUIRE(ips[2].get_from().to_ipv4_string(addr::STRING_IP_ADDRESS) == "10.0.0.3");
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv4::plan", "[ipv4][ipv6]")
+{
+    CATCH_GIVEN("addr_parser::plan")
+    {
+        CATCH_START_SECTION("ipv4::plan: same results as the parser")
+        {
+            std::string const inputs[] =
+            {
+                "",
+                "10.0.0.1",
+                "10.0.0.1:80/24",
+                " 10.0.0.1 , 10.0.0.2/255.255.0.0,:55",
+                "10.0.0.1,#10.0.0.2,10.0.0.3;comment,,;10.0.0.4\n[::1]:443 # end",
+                "10.0.0.256,10.0.0.5,bad.address.example",
+                "192.168.0.0/24,192.168.1.0/24,10.0.0.0/8,[fd00::1]",
+            };
+            addr::sort_t const sorts[] =
+            {
+                addr::SORT_NO,
+                addr::SORT_FULL | addr::SORT_IPV6_FIRST,
+                addr::SORT_MERGE,
+            };
+            for(auto const & in : inputs)
+            {
+                for(auto const sort : sorts)
+                {
+                    addr::addr_parser p;
+                    p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+                    p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+                    p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_NEWLINES, true);
+                    p.set_allow(addr::allow_t::ALLOW_COMMENT_HASH, true);
+                    p.set_allow(addr::allow_t::ALLOW_COMMENT_SEMICOLON, true);
+                    p.set_allow(addr::allow_t::ALLOW_MASK, true);
+                    p.set_allow(addr::allow_t::ALLOW_ADDRESS_MASK, true);
+                    p.set_sort_order(sort);
+
+                    addr::addr_parser::plan const plan(p.freeze());
+
+                    addr::addr_range::vector_t const expected(p.parse(in));
+
+                    std::string errors;
+                    addr::addr_range::vector_t ips;
+                    bool const valid(plan.parse(in, ips, &errors));
+                    CATCH_REQUIRE(valid == !p.has_errors());
+                    CATCH_REQUIRE(errors == p.error_messages());
+                    CATCH_REQUIRE(ips == expected);
+
+                    CATCH_REQUIRE(plan.parse(in) == expected);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::plan: the plan is not affected by later changes")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_default_port(80);
+            addr::addr_parser::plan const plan(p.freeze());
+
+            p.set_default_port(443);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, false);
+            CATCH_REQUIRE(plan.get_parser().get_default_port() == 80);
+
+            addr::addr_range::vector_t const ips(plan.parse("10.0.0.1,10.0.0.2"));
+            CATCH_REQUIRE(ips.size() == 2);
+            CATCH_REQUIRE(ips[0].get_from().get_port() == 80);
+            CATCH_REQUIRE(ips[1].get_from().get_port() == 80);
+            CATCH_REQUIRE_FALSE(p.has_errors());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::plan: errors from a parser in codes mode")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_error_mode(addr::error_mode_t::ERROR_MODE_CODES);
+            addr::addr_parser::plan const plan(p.freeze());
+
+            std::string errors;
+            addr::addr_range::vector_t ips;
+            CATCH_REQUIRE_FALSE(plan.parse("10.0.0.300", ips, &errors));
+            CATCH_REQUIRE(ips.empty());
+            CATCH_REQUIRE_FALSE(errors.empty());
+
+            // the parser used to freeze the plan still saves codes only
+            //
+            CATCH_REQUIRE(p.parse("10.0.0.300").empty());
+            CATCH_REQUIRE(p.has_errors());
+            CATCH_REQUIRE(p.error_messages().empty());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::plan: use the same plan from multiple threads")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_SPACES, true);
+            addr::addr_parser::plan const plan(p.freeze());
+
+            std::vector<std::string> inputs(4'000);
+            for(std::size_t idx(0); idx < inputs.size(); ++idx)
+            {
+                inputs[idx] = "10.0."
+                            + std::to_string(idx >> 8)
+                            + '.'
+                            + std::to_string(idx & 255)
+                            + (idx % 3 == 0 ? " 10.0.0.300" : "");
+            }
+
+            std::vector<int> failures(4);
+            std::vector<std::thread> threads;
+            for(std::size_t t(0); t < failures.size(); ++t)
+            {
+                threads.emplace_back([&plan, &inputs, &failures, t]()
+                    {
+                        addr::addr_range::vector_t ips;
+                        for(std::size_t idx(t); idx < inputs.size(); idx += failures.size())
+                        {
+                            ips.clear();
+                            std::string errors;
+                            bool const valid(plan.parse(inputs[idx], ips, &errors));
+                            if(valid != (idx % 3 != 0)
+                            || ips.size() != 1
+                            || ips[0].get_from().to_ipv4_string(addr::STRING_IP_ADDRESS) != inputs[idx].substr(0, inputs[idx].find(' ')))
+                            {
+                                ++failures[t];
+                            }
+                        }
+                    });
+            }
+            for(auto & t : threads)
+            {
+                t.join();
+            }
+            for(auto const f : failures)
+            {
+                CATCH_REQUIRE(f == 0);
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv4::error_codes", "[ipv4]")
+{
+    CATCH_GIVEN("addr_parser() with invalid entries")
+    {
+        std::string const input(
+                  "10.0.0.1,10.0.0.01,10.0.0.2:65536,"
+                  "10.0.0.3/33,[::1,10.0.0.4/1.2.3.4,10.0.0.5");
+
+        auto setup = [](addr::addr_parser & p)
+        {
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+        };
+
+        struct expected_t
+        {
+            addr::parser_error_t    f_code = addr::parser_error_t::PARSER_ERROR_OTHER;
+            std::size_t             f_offset = 0;
+            std::size_t             f_length = 0;
+            char const *            f_message = nullptr;
+        };
+        expected_t const expected[] =
+        {
+            { addr::parser_error_t::PARSER_ERROR_UNKNOWN_ADDRESS, 9, 9, "Unknown address in \"10.0.0.01\" (no DNS lookup was allowed)." },
+            { addr::parser_error_t::PARSER_ERROR_INVALID_PORT, 19, 14, "Invalid port in \"65536\" (no service name lookup allowed)." },
+            { addr::parser_error_t::PARSER_ERROR_MASK_SIZE, 34, 11, "Unsupported mask size (33, expected 32 at the most for an IPv4)." },
+            { addr::parser_error_t::PARSER_ERROR_IPV6_MISSING_BRACKET, 46, 4, "IPv6 is missing the ']' ([::1)." },
+            { addr::parser_error_t::PARSER_ERROR_ADDRESS_MASK_NOT_ALLOWED, 51, 16, "Address like mask not allowed (/1.2.3.4), try with a simple number instead." },
+        };
+
+        CATCH_START_SECTION("ipv4::error_codes: messages mode saves codes and messages")
+        {
+            addr::addr_parser p;
+            setup(p);
+            CATCH_REQUIRE(p.get_error_mode() == addr::error_mode_t::ERROR_MODE_MESSAGES);
+            addr::addr_range::vector_t const ips(p.parse(input));
+            CATCH_REQUIRE(ips.size() == 2);
+
+            std::string messages;
+            addr::parser_error::vector_t const & errors(p.errors());
+            CATCH_REQUIRE(errors.size() == std::size(expected));
+            CATCH_REQUIRE(p.error_count() == static_cast<int>(std::size(expected)));
+            for(std::size_t idx(0); idx < std::size(expected); ++idx)
+            {
+                CATCH_REQUIRE(errors[idx].f_code == expected[idx].f_code);
+                CATCH_REQUIRE(errors[idx].f_offset == expected[idx].f_offset);
+                CATCH_REQUIRE(errors[idx].f_length == expected[idx].f_length);
+                CATCH_REQUIRE(p.error_to_string(idx) == expected[idx].f_message);
+                messages += expected[idx].f_message;
+                messages += '\n';
+            }
+            CATCH_REQUIRE(p.error_messages() == messages);
+
+            p.clear_errors();
+            CATCH_REQUIRE(p.errors().empty());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::error_codes: codes mode renders messages on demand")
+        {
+            addr::addr_parser p;
+            setup(p);
+            p.set_error_mode(addr::error_mode_t::ERROR_MODE_CODES);
+            CATCH_REQUIRE(p.get_error_mode() == addr::error_mode_t::ERROR_MODE_CODES);
+            addr::addr_range::vector_t const ips(p.parse(input));
+            CATCH_REQUIRE(ips.size() == 2);
+            CATCH_REQUIRE(p.has_errors());
+            CATCH_REQUIRE(p.error_count() == static_cast<int>(std::size(expected)));
+            CATCH_REQUIRE(p.error_messages().empty());
+
+            addr::parser_error::vector_t const & errors(p.errors());
+            CATCH_REQUIRE(errors.size() == std::size(expected));
+            for(std::size_t idx(0); idx < std::size(expected); ++idx)
+            {
+                CATCH_REQUIRE(errors[idx].f_code == expected[idx].f_code);
+                CATCH_REQUIRE(errors[idx].f_offset == expected[idx].f_offset);
+                CATCH_REQUIRE(errors[idx].f_length == expected[idx].f_length);
+                CATCH_REQUIRE(p.error_to_string(idx, input) == expected[idx].f_message);
+            }
+
+            // messages from the application are kept as is
+            //
+            p.emit_error("Custom error.");
+            CATCH_REQUIRE(p.error_count() == static_cast<int>(std::size(expected)) + 1);
+            CATCH_REQUIRE(p.errors().back().f_code == addr::parser_error_t::PARSER_ERROR_OTHER);
+            CATCH_REQUIRE(p.error_to_string(std::size(expected), input) == "Custom error.");
+            CATCH_REQUIRE(p.error_messages() == "Custom error.\n");
+
+            CATCH_REQUIRE_THROWS_MATCHES(
+                      p.error_to_string(std::size(expected) + 1, input)
+                    , addr::out_of_range
+                    , Catch::Matchers::ExceptionMessage(
+                              "out_of_range: error index 6 is out of range, expected less than 6."));
+            CATCH_REQUIRE_THROWS_MATCHES(
+                      p.error_to_string(0, "10.0.0.1")
+                    , addr::out_of_range
+                    , Catch::Matchers::ExceptionMessage(
+                              "out_of_range: the error entry is outside of the specified input."));
+
+            // changing the mode clears the errors
+            //
+            p.set_error_mode(addr::error_mode_t::ERROR_MODE_MESSAGES);
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(p.errors().empty());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::error_codes: offsets are relative to the whole stream")
+        {
+            addr::addr_parser p;
+            setup(p);
+            p.set_error_mode(addr::error_mode_t::ERROR_MODE_CODES);
+            std::string big_input;
+            for(int count(0); count < 10'000; ++count)
+            {
+                big_input += "10.0.0.1,";
+            }
+            std::size_t const offset(big_input.length());
+            big_input += input;
+
+            std::istringstream in(big_input);
+            std::size_t count(0);
+            CATCH_REQUIRE(p.parse(in, [&count](addr::addr_range const &)
+                {
+                    ++count;
+                    return true;
+                }));
+            CATCH_REQUIRE(count == 10'002);
+            addr::parser_error::vector_t const & errors(p.errors());
+            CATCH_REQUIRE(errors.size() == std::size(expected));
+            for(std::size_t idx(0); idx < std::size(expected); ++idx)
+            {
+                CATCH_REQUIRE(errors[idx].f_offset == offset + expected[idx].f_offset);
+                CATCH_REQUIRE(p.error_to_string(idx, big_input) == expected[idx].f_message);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::error_codes: messages with a newline")
+        {
+            // with only commas as separators, the newline is part of the
+            // first entry and thus of its error message
+            //
+            std::string const newline_input("1.2.3.4:x\n5,10.0.0.01");
+            char const * const port_message("Invalid port in \"x\n5\" (no service name lookup allowed).");
+            char const * const address_message("Unknown address in \"10.0.0.01\" (no DNS lookup was allowed).");
+
+            addr::addr_parser p;
+            setup(p);
+            CATCH_REQUIRE(p.parse(newline_input).empty());
+            CATCH_REQUIRE(p.errors().size() == 2);
+            CATCH_REQUIRE(p.error_to_string(0) == port_message);
+            CATCH_REQUIRE(p.error_to_string(1) == address_message);
+
+            p.set_error_mode(addr::error_mode_t::ERROR_MODE_CODES);
+            p.emit_error("Custom\nerror.");
+            CATCH_REQUIRE(p.parse(newline_input).empty());
+            p.emit_error("Last error.");
+            CATCH_REQUIRE(p.errors().size() == 4);
+            CATCH_REQUIRE(p.error_to_string(0, newline_input) == "Custom\nerror.");
+            CATCH_REQUIRE(p.error_to_string(1, newline_input) == port_message);
+            CATCH_REQUIRE(p.error_to_string(2, newline_input) == address_message);
+            CATCH_REQUIRE(p.error_to_string(3, newline_input) == "Last error.");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::error_codes: limit the number of saved errors")
+        {
+            std::string big_input;
+            for(int count(0); count < 4'000; ++count)
+            {
+                big_input += input;
+                big_input += ',';
+            }
+
+            addr::addr_parser p;
+            setup(p);
+            CATCH_REQUIRE(p.get_max_errors() == 0);
+            p.set_max_errors(7);
+            CATCH_REQUIRE(p.get_max_errors() == 7);
+
+            std::istringstream in(big_input);
+            std::size_t count(0);
+            CATCH_REQUIRE(p.parse(in, [&count](addr::addr_range const &)
+                {
+                    ++count;
+                    return true;
+                }));
+            CATCH_REQUIRE(count == 8'000);
+            CATCH_REQUIRE(p.error_count() == static_cast<int>(std::size(expected)) * 4'000);
+            addr::parser_error::vector_t const & errors(p.errors());
+            CATCH_REQUIRE(errors.size() == 7);
+            std::string messages;
+            for(std::size_t idx(0); idx < errors.size(); ++idx)
+            {
+                expected_t const & e(expected[idx % std::size(expected)]);
+                CATCH_REQUIRE(errors[idx].f_code == e.f_code);
+                CATCH_REQUIRE(p.error_to_string(idx) == e.f_message);
+                messages += e.f_message;
+                messages += '\n';
+            }
+            CATCH_REQUIRE(p.error_messages() == messages);
+
+            // application errors are counted too
+            //
+            p.emit_error("Custom error.");
+            CATCH_REQUIRE(p.error_count() == static_cast<int>(std::size(expected)) * 4'000 + 1);
+            CATCH_REQUIRE(p.errors().size() == 7);
+            CATCH_REQUIRE(p.error_messages() == messages);
+
+            // the per-thread errors are limited the same way
+            //
+            addr::addr_parser t;
+            setup(t);
+            t.set_max_errors(7);
+            t.set_thread_count(4);
+            CATCH_REQUIRE(t.parse(big_input).size() == 8'000);
+            CATCH_REQUIRE(t.error_count() == static_cast<int>(std::size(expected)) * 4'000);
+            CATCH_REQUIRE(t.errors().size() == 7);
+            CATCH_REQUIRE(t.error_messages() == messages);
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv4::async_lookup", "[ipv4]")
+{
+    CATCH_GIVEN("addr_parser() with lookups resolved at once")
+    {
+        // "localhost" is expected to be defined in /etc/hosts
+        //
+        std::string const input("localhost,127.0.0.1:80,localhost:443,10.0.0.1,localhost");
+
+        auto setup = [](addr::addr_parser & p)
+        {
+            p.set_protocol(IPPROTO_TCP);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+        };
+
+        addr::addr_parser sync_parser;
+        setup(sync_parser);
+        addr::addr_range::vector_t const expected(sync_parser.parse(input));
+        CATCH_REQUIRE_FALSE(sync_parser.has_errors());
+        CATCH_REQUIRE(expected.size() >= 5);
+
+        CATCH_START_SECTION("ipv4::async_lookup: same results as sequential lookups")
+        {
+            addr::addr_parser p;
+            setup(p);
+            CATCH_REQUIRE_FALSE(p.get_async_lookup());
+            p.set_async_lookup(true);
+            CATCH_REQUIRE(p.get_async_lookup());
+
+            addr::addr_range::vector_t const ips(p.parse(input));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips == expected);
+
+            // the parser can be reused
+            //
+            CATCH_REQUIRE(p.parse(input) == expected);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::async_lookup: completion callback")
+        {
+            addr::addr_parser p;
+            setup(p);
+
+            std::promise<addr::addr_range::vector_t> promise;
+            std::future<addr::addr_range::vector_t> future(promise.get_future());
+            bool errors(true);
+            p.parse_async(input, [&promise, &errors](addr::addr_range::vector_t const & result, addr::addr_parser const & parser)
+                {
+                    errors = parser.has_errors();
+                    promise.set_value(result);
+                });
+            addr::addr_range::vector_t const ips(future.get());
+            CATCH_REQUIRE_FALSE(errors);
+            CATCH_REQUIRE(ips == expected);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::async_lookup: completion callback with errors")
+        {
+            addr::addr_parser p;
+            setup(p);
+            p.set_allow(addr::allow_t::ALLOW_REQUIRED_PORT, true);
+
+            std::promise<int> promise;
+            std::future<int> future(promise.get_future());
+            p.parse_async("localhost:80,localhost", [&promise](addr::addr_range::vector_t const & result, addr::addr_parser const & parser)
+                {
+                    promise.set_value(result.empty() ? -1 : parser.error_count());
+                });
+            CATCH_REQUIRE(future.get() == 1);
+            CATCH_REQUIRE_FALSE(p.has_errors());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::async_lookup: no lookup calls the callback immediately")
+        {
+            addr::addr_parser p;
+            setup(p);
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+
+            bool called(false);
+            p.parse_async("10.0.0.1,10.0.0.2", [&called](addr::addr_range::vector_t const & result, addr::addr_parser const & parser)
+                {
+                    called = true;
+                    CATCH_REQUIRE(result.size() == 2);
+                    CATCH_REQUIRE_FALSE(parser.has_errors());
+                });
+            CATCH_REQUIRE(called);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv4::async_lookup: input without host names")
+        {
+            addr::addr_parser s;
+            setup(s);
+            s.set_allow(addr::allow_t::ALLOW_REQUIRED_PORT, true);
+            addr::addr_range::vector_t const numeric(s.parse("10.0.0.1:80,10.0.0.3,10.0.0.2:80"));
+            CATCH_REQUIRE(numeric.size() == 2);
+            CATCH_REQUIRE(s.error_count() == 1);
+
+            addr::addr_parser p;
+            setup(p);
+            p.set_allow(addr::allow_t::ALLOW_REQUIRED_PORT, true);
+            p.set_async_lookup(true);
+            CATCH_REQUIRE(p.parse("10.0.0.1:80,10.0.0.3,10.0.0.2:80") == numeric);
+            CATCH_REQUIRE(p.error_count() == 1);
+            CATCH_REQUIRE(p.error_messages() == s.error_messages());
+
+            bool called(false);
+            p.parse_async("10.0.0.1:80,10.0.0.3,10.0.0.2:80", [&called, &numeric, &s](addr::addr_range::vector_t const & result, addr::addr_parser const & parser)
+                {
+                    called = true;
+                    CATCH_REQUIRE(result == numeric);
+                    CATCH_REQUIRE(parser.error_count() == 1);
+                    CATCH_REQUIRE(parser.error_messages() == s.error_messages());
+                });
+            CATCH_REQUIRE(called);
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
 CATCH_TEST_CASE("ipv4::string_to_addr", "[ipv4]")
 {
     CATCH_GIVEN("string_to_addr() ipv4")
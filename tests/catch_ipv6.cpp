@@ -58,6 +58,11 @@
 #include    <snapdev/string_replace_many.h>
 
 
+// C++
+//
+#include    <thread>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -2671,6 +2676,430 @@ CATCH_TEST_CASE("ipv6::network_type", "[ipv6]")
 }
 
 
+CATCH_TEST_CASE("ipv6::to_buffer", "[ipv6]")
+{
+    CATCH_GIVEN("random addresses")
+    {
+        CATCH_START_SECTION("ipv6::to_buffer: output matches inet_ntop()")
+        {
+            for(int count(0); count < 10'000; ++count)
+            {
+                // use many zeroes to test the "::" reduction
+                //
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    if(rand() % 3 != 0)
+                    {
+                        in6.sin6_addr.s6_addr16[idx] = 0;
+                    }
+                    else
+                    {
+                        in6.sin6_addr.s6_addr16[idx] = rand();
+                    }
+                }
+                if(count % 10 == 0)
+                {
+                    // IPv4 compatible and mapped addresses
+                    //
+                    in6.sin6_addr.s6_addr32[0] = 0;
+                    in6.sin6_addr.s6_addr32[1] = 0;
+                    in6.sin6_addr.s6_addr16[4] = 0;
+                    in6.sin6_addr.s6_addr16[5] = count % 20 == 0 ? 0 : 0xFFFF;
+                }
+                addr::addr a(in6);
+
+                char expected[INET6_ADDRSTRLEN];
+                CATCH_REQUIRE(inet_ntop(AF_INET6, &in6.sin6_addr, expected, sizeof(expected)) != nullptr);
+
+                char buf[addr::ADDR_STRING_BUFFER_SIZE];
+                if(a.is_default())
+                {
+                    // "::" and "::ffff:0.0.0.0" are both viewed as default
+                    //
+                    CATCH_REQUIRE(a.to_ipv6_string(addr::STRING_IP_ADDRESS) == "::");
+                    std::size_t const length(a.to_buffer(buf, sizeof(buf), addr::STRING_IP_ADDRESS));
+                    CATCH_REQUIRE(length == strlen(buf));
+                    CATCH_REQUIRE(std::string(buf) == (a.is_ipv4() ? "0.0.0.0" : "::"));
+                }
+                else if(a.is_ipv4())
+                {
+                    std::size_t const length(a.to_buffer(buf, sizeof(buf), addr::STRING_IP_ADDRESS));
+                    CATCH_REQUIRE(length == strlen(buf));
+                    CATCH_REQUIRE(a.to_ipv6_string(addr::STRING_IP_ADDRESS) == expected);
+                }
+                else
+                {
+                    std::size_t const length(a.to_buffer(buf, sizeof(buf), addr::STRING_IP_ADDRESS));
+                    CATCH_REQUIRE(length == strlen(buf));
+                    CATCH_REQUIRE(std::string(buf) == expected);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv6::to_buffer: same as to_ipv6_string() with all modes")
+        {
+            for(int count(0); count < 1'000; ++count)
+            {
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                in6.sin6_port = htons(rand());
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    in6.sin6_addr.s6_addr16[idx] = rand() % 2 == 0 ? 0 : rand();
+                }
+                addr::addr a(in6);
+                if(a.is_ipv4())
+                {
+                    continue;
+                }
+                if(count % 2 == 0)
+                {
+                    a.set_mask_count(rand() % 129);
+                }
+                else
+                {
+                    std::uint8_t mask[16];
+                    for(int idx(0); idx < 16; ++idx)
+                    {
+                        mask[idx] = rand();
+                    }
+                    a.set_mask(mask);
+                }
+
+                for(addr::string_ip_t mode(0); mode < 0x400; ++mode)
+                {
+                    if((mode & addr::STRING_IP_PORT_NAME) != 0)
+                    {
+                        continue;
+                    }
+                    std::string const expected(a.to_ipv6_string(mode));
+                    char buf[addr::ADDR_STRING_BUFFER_SIZE];
+                    CATCH_REQUIRE(a.to_buffer(buf, sizeof(buf), mode) == expected.length());
+                    CATCH_REQUIRE(expected == buf);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_GIVEN("a small buffer")
+    {
+        CATCH_START_SECTION("ipv6::to_buffer: output gets truncated")
+        {
+            addr::addr a(addr::string_to_addr("[2001:db8::17]:80", "", 0, "tcp"));
+            std::string const expected("[2001:db8::17]:80");
+
+            for(std::size_t size(0); size <= expected.length() + 1; ++size)
+            {
+                char buf[32];
+                memset(buf, '?', sizeof(buf));
+                CATCH_REQUIRE(a.to_buffer(buf, size, addr::STRING_IP_ADDRESS_PORT) == expected.length());
+                if(size == 0)
+                {
+                    CATCH_REQUIRE(buf[0] == '?');
+                }
+                else
+                {
+                    CATCH_REQUIRE(std::string(buf) == expected.substr(0, size - 1));
+                    CATCH_REQUIRE(buf[size] == '?');
+                }
+            }
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_GIVEN("ostream")
+    {
+        CATCH_START_SECTION("ipv6::to_buffer: ostream in multiple threads")
+        {
+            addr::addr a(addr::string_to_addr("[2001:db8::17]:80", "", 0, "tcp"));
+
+            std::vector<std::string> results(8);
+            std::vector<std::thread> threads;
+            for(std::size_t idx(0); idx < results.size(); ++idx)
+            {
+                threads.emplace_back([&a, &results, idx]()
+                    {
+                        std::stringstream ss;
+                        ss << a << ' ';
+                        ss << addr::setaddrmode(idx % 2 == 0
+                                        ? addr::STRING_IP_ADDRESS
+                                        : addr::STRING_IP_ADDRESS_PORT);
+                        for(int count(0); count < 1'000; ++count)
+                        {
+                            ss << a;
+                        }
+                        results[idx] = ss.str();
+                    });
+            }
+            for(auto & t : threads)
+            {
+                t.join();
+            }
+
+            for(std::size_t idx(0); idx < results.size(); ++idx)
+            {
+                std::string expected("[2001:db8::17]:80/128 ");
+                for(int count(0); count < 1'000; ++count)
+                {
+                    expected += idx % 2 == 0 ? "2001:db8::17" : "[2001:db8::17]:80";
+                }
+                CATCH_REQUIRE(results[idx] == expected);
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv6::numeric", "[ipv6]")
+{
+    CATCH_GIVEN("addr_parser() without lookup")
+    {
+        CATCH_START_SECTION("ipv6::numeric: many addresses with ports and masks")
+        {
+            std::vector<sockaddr_in6> expected;
+            std::vector<int> masks;
+            std::string input;
+            for(int count(0); count < 1'000; ++count)
+            {
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    in6.sin6_addr.s6_addr16[idx] = rand() % 3 == 0 ? 0 : rand();
+                }
+                if(count % 10 == 0)
+                {
+                    // IPv4 mapped
+                    //
+                    in6.sin6_addr.s6_addr32[0] = 0;
+                    in6.sin6_addr.s6_addr32[1] = 0;
+                    in6.sin6_addr.s6_addr16[4] = 0;
+                    in6.sin6_addr.s6_addr16[5] = 0xFFFF;
+                }
+                char buf[INET6_ADDRSTRLEN];
+                CATCH_REQUIRE(inet_ntop(AF_INET6, &in6.sin6_addr, buf, sizeof(buf)) != nullptr);
+
+                input += '[';
+                input += buf;
+                input += ']';
+                if(rand() % 2 == 0)
+                {
+                    in6.sin6_port = htons(rand());
+                    input += ':' + std::to_string(ntohs(in6.sin6_port));
+                }
+                int mask(-1);
+                if(rand() % 2 == 0)
+                {
+                    mask = rand() % 129;
+                    input += '/' + std::to_string(mask);
+                }
+                input += ',';
+                expected.push_back(in6);
+                masks.push_back(mask);
+            }
+
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+            addr::addr_range::vector_t const ips(p.parse(input));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == expected.size());
+
+            for(std::size_t idx(0); idx < ips.size(); ++idx)
+            {
+                addr::addr const & a(ips[idx].get_from());
+                sockaddr_in6 out;
+                a.get_ipv6(out);
+                CATCH_REQUIRE(memcmp(&out.sin6_addr, &expected[idx].sin6_addr, sizeof(out.sin6_addr)) == 0);
+                CATCH_REQUIRE(out.sin6_port == expected[idx].sin6_port);
+                CATCH_REQUIRE(a.get_mask_size() == (masks[idx] == -1 ? 128 : masks[idx]));
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv6::numeric: address without brackets")
+        {
+            addr::addr_parser p;
+            p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+            p.set_allow(addr::allow_t::ALLOW_MASK, true);
+            addr::addr_range::vector_t const ips(p.parse("2001:DB8::1:2/64"));
+            CATCH_REQUIRE_FALSE(p.has_errors());
+            CATCH_REQUIRE(ips.size() == 1);
+            CATCH_REQUIRE(ips[0].get_from().to_ipv6_string(addr::STRING_IP_ALL) == "[2001:db8::1:2]:0/64");
+            CATCH_REQUIRE(ips[0].get_from().get_hostname() == "2001:DB8::1:2");
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv6::match_many", "[ipv6]")
+{
+    CATCH_GIVEN("random addresses and CIDRs")
+    {
+        auto random_addr = [](bool ipv4)
+            {
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    // keep the number of distinct values low to get matches
+                    //
+                    in6.sin6_addr.s6_addr16[idx] = rand() % 4 == 0 ? rand() : rand() % 2;
+                }
+                if(ipv4)
+                {
+                    in6.sin6_addr.s6_addr32[0] = 0;
+                    in6.sin6_addr.s6_addr32[1] = 0;
+                    in6.sin6_addr.s6_addr16[4] = 0;
+                    in6.sin6_addr.s6_addr16[5] = 0xFFFF;
+                }
+                return addr::addr(in6);
+            };
+
+        std::vector<addr::addr> ips;
+        for(int idx(0); idx < 1'001; ++idx)
+        {
+            ips.push_back(random_addr(idx % 3 == 0));
+        }
+
+        CATCH_START_SECTION("ipv6::match_many: one CIDR")
+        {
+            for(int count(0); count < 100; ++count)
+            {
+                addr::addr cidr(random_addr(count % 2 == 0));
+                cidr.set_mask_count(count % 2 == 0 ? 96 + rand() % 33 : rand() % 129);
+
+                std::vector<std::uint8_t> out(ips.size(), 2);
+                std::size_t const found(cidr.match_many(ips.data(), ips.size(), out.data()));
+
+                std::size_t expected(0);
+                for(std::size_t idx(0); idx < ips.size(); ++idx)
+                {
+                    bool const m(cidr.match(ips[idx]));
+                    CATCH_REQUIRE(out[idx] == (m ? 1 : 0));
+                    expected += m;
+                }
+                CATCH_REQUIRE(found == expected);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv6::match_many: list of CIDRs")
+        {
+            for(int count(0); count < 20; ++count)
+            {
+                addr::addr::vector_t cidrs;
+                int const max(count);
+                for(int c(0); c < max; ++c)
+                {
+                    addr::addr cidr(random_addr(c % 2 == 0));
+                    cidr.set_mask_count(c % 2 == 0 ? 96 + rand() % 33 : rand() % 129);
+                    cidrs.push_back(cidr);
+                }
+
+                std::vector<std::uint8_t> out(ips.size(), 2);
+                std::size_t const found(addr::addr::match_many(cidrs, ips.data(), ips.size(), out.data()));
+
+                std::size_t expected(0);
+                for(std::size_t idx(0); idx < ips.size(); ++idx)
+                {
+                    bool m(false);
+                    for(auto const & c : cidrs)
+                    {
+                        m = m || c.match(ips[idx]);
+                    }
+                    CATCH_REQUIRE(out[idx] == (m ? 1 : 0));
+                    expected += m;
+                }
+                CATCH_REQUIRE(found == expected);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv6::match_many: empty input")
+        {
+            addr::addr cidr(random_addr(false));
+            CATCH_REQUIRE(cidr.match_many(nullptr, 0, nullptr) == 0);
+            CATCH_REQUIRE(addr::addr::match_many(addr::addr::vector_t(), nullptr, 0, nullptr) == 0);
+
+            std::vector<std::uint8_t> out(ips.size(), 2);
+            CATCH_REQUIRE(addr::addr::match_many(addr::addr::vector_t(), ips.data(), ips.size(), out.data()) == 0);
+            for(auto const o : out)
+            {
+                CATCH_REQUIRE(o == 0);
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ipv6::hash", "[ipv6]")
+{
+    CATCH_GIVEN("addresses in unordered containers")
+    {
+        CATCH_START_SECTION("ipv6::hash: same address, different port and mask")
+        {
+            addr::addr a(addr::string_to_addr("[2001:db8::1]:80", std::string(), -1, "tcp"));
+            addr::addr b(addr::string_to_addr("[2001:db8::1]:443", std::string(), -1, "tcp"));
+            b.set_mask_count(64);
+            CATCH_REQUIRE(a == b);
+            CATCH_REQUIRE(a.hash() == b.hash());
+            CATCH_REQUIRE(std::hash<addr::addr>()(a) == a.hash());
+
+            addr::addr c(addr::string_to_addr("[2001:db8::2]:80", std::string(), -1, "tcp"));
+            CATCH_REQUIRE(a.hash() != c.hash());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("ipv6::hash: unordered_set_t and unordered_map_t agree with set_t")
+        {
+            addr::addr::set_t set;
+            addr::addr::unordered_set_t uset;
+            addr::addr::unordered_map_t<int> umap;
+            for(int idx(0); idx < 1'000; ++idx)
+            {
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                for(int j(0); j < 8; ++j)
+                {
+                    in6.sin6_addr.s6_addr16[j] = rand() % 3;
+                }
+                if(idx % 2 == 0)
+                {
+                    in6.sin6_addr.s6_addr32[0] = 0;
+                    in6.sin6_addr.s6_addr32[1] = 0;
+                    in6.sin6_addr.s6_addr16[4] = 0;
+                    in6.sin6_addr.s6_addr16[5] = 0xFFFF;
+                }
+                addr::addr const a(in6);
+                set.insert(a);
+                uset.insert(a);
+                ++umap[a];
+            }
+            CATCH_REQUIRE(uset.size() == set.size());
+            CATCH_REQUIRE(umap.size() == set.size());
+
+            int total(0);
+            for(auto const & a : set)
+            {
+                CATCH_REQUIRE(uset.count(a) == 1);
+                total += umap.at(a);
+            }
+            CATCH_REQUIRE(total == 1'000);
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
 CATCH_TEST_CASE("ipv6::network", "[ipv6]")
 {
     CATCH_GIVEN("set_from_socket()")
@@ -0,0 +1,417 @@
+// Copyright (c) 2011-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+// contact@m2osw.com
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and
+// associated documentation files (the "Software"), to
+// deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify,
+// merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice
+// shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+// EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+/** \file
+ * \brief Check the lookup_cache class.
+ *
+ * This set of unit tests verifies that the lookup_cache returns the
+ * cached results, including negative ones, and that entries expire
+ * and get evicted as expected. It also checks the reverse lookups
+ * and the get_names() batch.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr_parser.h>
+#include    <libaddr/lookup_cache.h>
+
+
+// self
+//
+#include    "catch_main.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+addrinfo get_hints()
+{
+    addrinfo hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    return hints;
+}
+
+
+std::shared_ptr<addrinfo> make_list()
+{
+    // the cache never looks at the list so a fake one is good enough
+    //
+    return std::make_shared<addrinfo>();
+}
+
+
+void reset_cache()
+{
+    addr::lookup_cache::set_enabled(false);
+    addr::lookup_cache::set_positive_ttl(addr::lookup_cache::DEFAULT_POSITIVE_TTL);
+    addr::lookup_cache::set_negative_ttl(addr::lookup_cache::DEFAULT_NEGATIVE_TTL);
+    addr::lookup_cache::set_max_size(addr::lookup_cache::DEFAULT_MAX_SIZE);
+    addr::lookup_cache::reset_statistics();
+}
+
+
+addr::addr make_addr(char const * ip)
+{
+    addr::addr_parser p;
+    p.set_protocol(IPPROTO_TCP);
+    addr::addr_range::vector_t const ranges(p.parse(ip));
+    CATCH_REQUIRE(ranges.size() == 1);
+    return ranges[0].get_from();
+}
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("lookup_cache", "[lookup_cache]")
+{
+    CATCH_START_SECTION("lookup_cache: disabled by default")
+    {
+        reset_cache();
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::get_enabled());
+        CATCH_REQUIRE(addr::lookup_cache::get_positive_ttl() == addr::lookup_cache::DEFAULT_POSITIVE_TTL);
+        CATCH_REQUIRE(addr::lookup_cache::get_negative_ttl() == addr::lookup_cache::DEFAULT_NEGATIVE_TTL);
+        CATCH_REQUIRE(addr::lookup_cache::get_max_size() == addr::lookup_cache::DEFAULT_MAX_SIZE);
+
+        addrinfo const hints(get_hints());
+        addr::lookup_cache::insert("example.com", "80", hints, make_list(), 0);
+
+        std::shared_ptr<addrinfo> list;
+        int error(-1);
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("example.com", "80", hints, list, error));
+
+        addr::lookup_cache::statistics_t const stats(addr::lookup_cache::get_statistics());
+        CATCH_REQUIRE(stats.f_hits == 0);
+        CATCH_REQUIRE(stats.f_misses == 0);
+        CATCH_REQUIRE(stats.f_size == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache: positive and negative hits")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addrinfo const hints(get_hints());
+        std::shared_ptr<addrinfo> const found(make_list());
+        addr::lookup_cache::insert("example.com", "80", hints, found, 0);
+        addr::lookup_cache::insert("unknown.example.com", "80", hints, nullptr, EAI_NONAME);
+
+        // temporary errors are not cached
+        //
+        addr::lookup_cache::insert("slow.example.com", "80", hints, nullptr, EAI_AGAIN);
+
+        std::shared_ptr<addrinfo> list;
+        int error(-1);
+        CATCH_REQUIRE(addr::lookup_cache::find("example.com", "80", hints, list, error));
+        CATCH_REQUIRE(error == 0);
+        CATCH_REQUIRE(list == found);
+
+        CATCH_REQUIRE(addr::lookup_cache::find("unknown.example.com", "80", hints, list, error));
+        CATCH_REQUIRE(error == EAI_NONAME);
+        CATCH_REQUIRE(list == nullptr);
+
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("slow.example.com", "80", hints, list, error));
+
+        // the service and hints are part of the key
+        //
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("example.com", "443", hints, list, error));
+        addrinfo udp(hints);
+        udp.ai_socktype = SOCK_DGRAM;
+        udp.ai_protocol = IPPROTO_UDP;
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("example.com", "80", udp, list, error));
+
+        addr::lookup_cache::statistics_t stats(addr::lookup_cache::get_statistics());
+        CATCH_REQUIRE(stats.f_hits == 1);
+        CATCH_REQUIRE(stats.f_negative_hits == 1);
+        CATCH_REQUIRE(stats.f_misses == 3);
+        CATCH_REQUIRE(stats.f_size == 2);
+
+        addr::lookup_cache::flush();
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("example.com", "80", hints, list, error));
+        stats = addr::lookup_cache::get_statistics();
+        CATCH_REQUIRE(stats.f_misses == 4);
+        CATCH_REQUIRE(stats.f_size == 0);
+
+        addr::lookup_cache::reset_statistics();
+        stats = addr::lookup_cache::get_statistics();
+        CATCH_REQUIRE(stats.f_hits == 0);
+        CATCH_REQUIRE(stats.f_negative_hits == 0);
+        CATCH_REQUIRE(stats.f_misses == 0);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache: a TTL of zero disables caching")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+        addr::lookup_cache::set_positive_ttl(0);
+        addr::lookup_cache::set_negative_ttl(0);
+        CATCH_REQUIRE(addr::lookup_cache::get_positive_ttl() == 0);
+        CATCH_REQUIRE(addr::lookup_cache::get_negative_ttl() == 0);
+
+        addrinfo const hints(get_hints());
+        addr::lookup_cache::insert("example.com", "80", hints, make_list(), 0);
+        addr::lookup_cache::insert("unknown.example.com", "80", hints, nullptr, EAI_NONAME);
+        CATCH_REQUIRE(addr::lookup_cache::get_statistics().f_size == 0);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache: least recently used entries get evicted")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addrinfo const hints(get_hints());
+        for(int idx(0); idx < 1000; ++idx)
+        {
+            addr::lookup_cache::insert("host" + std::to_string(idx) + ".example.com", "80", hints, make_list(), 0);
+        }
+        CATCH_REQUIRE(addr::lookup_cache::get_statistics().f_size == 1000);
+
+        // one entry per shard
+        //
+        addr::lookup_cache::set_max_size(1);
+        CATCH_REQUIRE(addr::lookup_cache::get_max_size() == 1);
+        addr::lookup_cache::statistics_t stats(addr::lookup_cache::get_statistics());
+        CATCH_REQUIRE(stats.f_size <= addr::lookup_cache::SHARD_COUNT);
+        CATCH_REQUIRE(stats.f_evictions == 1000 - stats.f_size);
+
+        // the last entry added is the most recently used of its shard
+        //
+        std::shared_ptr<addrinfo> list;
+        int error(-1);
+        CATCH_REQUIRE(addr::lookup_cache::find("host999.example.com", "80", hints, list, error));
+        CATCH_REQUIRE_FALSE(addr::lookup_cache::find("host0.example.com", "80", hints, list, error));
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache: the parser uses the cache")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addr::addr_parser p;
+        p.set_protocol(IPPROTO_TCP);
+        p.set_default_port(80);
+        addr::addr_range::vector_t const first(p.parse("localhost"));
+        CATCH_REQUIRE_FALSE(p.has_errors());
+        CATCH_REQUIRE_FALSE(first.empty());
+
+        addr::lookup_cache::statistics_t stats(addr::lookup_cache::get_statistics());
+        CATCH_REQUIRE(stats.f_hits == 0);
+        CATCH_REQUIRE(stats.f_misses == 1);
+        CATCH_REQUIRE(stats.f_size == 1);
+
+        addr::addr_range::vector_t const second(p.parse("localhost"));
+        CATCH_REQUIRE(second == first);
+
+        stats = addr::lookup_cache::get_statistics();
+        CATCH_REQUIRE(stats.f_hits == 1);
+        CATCH_REQUIRE(stats.f_misses == 1);
+
+        // the batch lookups use the cache too
+        //
+        p.set_async_lookup(true);
+        addr::addr_range::vector_t const third(p.parse("localhost"));
+        CATCH_REQUIRE(third == first);
+
+        stats = addr::lookup_cache::get_statistics();
+        CATCH_REQUIRE(stats.f_hits == 2);
+        CATCH_REQUIRE(stats.f_misses == 1);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("lookup_cache_names", "[lookup_cache]")
+{
+    CATCH_START_SECTION("lookup_cache_names: get_name() uses the cache")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addr::addr const localhost(make_addr("127.0.0.1"));
+        std::size_t const forward_size(addr::lookup_cache::get_statistics().f_size);
+        std::string const name(localhost.get_name());
+        CATCH_REQUIRE_FALSE(name.empty());
+
+        addr::lookup_cache::statistics_t stats(addr::lookup_cache::get_name_statistics());
+        CATCH_REQUIRE(stats.f_hits == 0);
+        CATCH_REQUIRE(stats.f_misses == 1);
+        CATCH_REQUIRE(stats.f_size == 1);
+
+        // the port and protocol are not part of the key
+        //
+        addr::addr other(localhost);
+        other.set_port(8080);
+        other.set_protocol(IPPROTO_UDP);
+        CATCH_REQUIRE(other.get_name() == name);
+
+        stats = addr::lookup_cache::get_name_statistics();
+        CATCH_REQUIRE(stats.f_hits == 1);
+        CATCH_REQUIRE(stats.f_misses == 1);
+
+        // the forward statistics are separate
+        //
+        CATCH_REQUIRE(addr::lookup_cache::get_statistics().f_size == forward_size);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache_names: negative names")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addr::addr const a(make_addr("10.1.2.3"));
+        addr::lookup_cache::insert_name(a, "ignored", EAI_NONAME);
+
+        std::string name("not empty");
+        int error(0);
+        CATCH_REQUIRE(addr::lookup_cache::find_name(a, name, error));
+        CATCH_REQUIRE(error == EAI_NONAME);
+        CATCH_REQUIRE(name.empty());
+        CATCH_REQUIRE(a.get_name().empty());
+
+        addr::lookup_cache::statistics_t const stats(addr::lookup_cache::get_name_statistics());
+        CATCH_REQUIRE(stats.f_negative_hits == 2);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache_names: batch with a deadline")
+    {
+        reset_cache();
+        addr::lookup_cache::set_enabled(true);
+
+        addr::addr const localhost(make_addr("127.0.0.1"));
+        addr::addr const cached(make_addr("10.9.8.7"));
+        addr::lookup_cache::insert_name(cached, "cached.example.com", 0);
+
+        addr::addr::vector_t const addresses{ localhost, cached, localhost };
+
+        // with no time to wait, the lookups are still pending
+        //
+        addr::lookup_cache::name_vector_t names(addr::lookup_cache::get_names(addresses, std::chrono::milliseconds(0)));
+        CATCH_REQUIRE(names.size() == 3);
+        CATCH_REQUIRE(names[0].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_PENDING);
+        CATCH_REQUIRE(names[0].f_name.empty());
+        CATCH_REQUIRE(names[1].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_FOUND);
+        CATCH_REQUIRE(names[1].f_name == "cached.example.com");
+        CATCH_REQUIRE(names[2].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_PENDING);
+
+        // give the workers time to finish
+        //
+        names = addr::lookup_cache::get_names(addresses, std::chrono::seconds(30));
+        CATCH_REQUIRE(names.size() == 3);
+        CATCH_REQUIRE(names[0].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_FOUND);
+        CATCH_REQUIRE_FALSE(names[0].f_name.empty());
+        CATCH_REQUIRE(names[1].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_FOUND);
+        CATCH_REQUIRE(names[2].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_FOUND);
+        CATCH_REQUIRE(names[2].f_name == names[0].f_name);
+
+        // the result was saved in the cache
+        //
+        std::string name;
+        int error(-1);
+        CATCH_REQUIRE(addr::lookup_cache::find_name(localhost, name, error));
+        CATCH_REQUIRE(error == 0);
+        CATCH_REQUIRE(name == names[0].f_name);
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lookup_cache_names: a full queue leaves addresses pending")
+    {
+        reset_cache();
+
+        // the queue gets filled while get_names() holds the resolver
+        // lock so the workers cannot empty it in the meantime
+        //
+        std::size_t const count(addr::lookup_cache::NAME_QUEUE_MAX_SIZE + 10);
+        addr::addr::vector_t addresses;
+        for(std::size_t idx(0); idx < count; ++idx)
+        {
+            std::string const ip(
+                      "127.1."
+                    + std::to_string(idx / 256)
+                    + "."
+                    + std::to_string(idx % 256));
+            addresses.push_back(make_addr(ip.c_str()));
+        }
+
+        addr::lookup_cache::name_vector_t const names(addr::lookup_cache::get_names(addresses, std::chrono::seconds(120)));
+        CATCH_REQUIRE(names.size() == count);
+        for(std::size_t idx(0); idx < count; ++idx)
+        {
+            if(idx < addr::lookup_cache::NAME_QUEUE_MAX_SIZE)
+            {
+                CATCH_REQUIRE(names[idx].f_status != addr::lookup_cache::name_status_t::NAME_STATUS_PENDING);
+            }
+            else
+            {
+                CATCH_REQUIRE(names[idx].f_status == addr::lookup_cache::name_status_t::NAME_STATUS_PENDING);
+                CATCH_REQUIRE(names[idx].f_name.empty());
+            }
+        }
+
+        reset_cache();
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,309 @@
+// Copyright (c) 2011-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+// contact@m2osw.com
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and
+// associated documentation files (the "Software"), to
+// deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify,
+// merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice
+// shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+// EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** \file
+ * \brief Check the addr_lpm_table class.
+ *
+ * This set of unit tests verifies that the longest prefix match table
+ * returns the most specific range and that it agrees with the linear
+ * address_match_ranges() function.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr_lpm_table.h>
+
+
+// self
+//
+#include    "catch_main.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+addr::addr_range::vector_t parse_ranges(std::string const & in)
+{
+    addr::addr_parser p;
+    p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+    p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+    p.set_allow(addr::allow_t::ALLOW_ADDRESS_RANGE, true);
+    p.set_allow(addr::allow_t::ALLOW_MASK, true);
+    p.set_allow(addr::allow_t::ALLOW_PORT, false);
+    addr::addr_range::vector_t const result(p.parse(in));
+    CATCH_REQUIRE_FALSE(p.has_errors());
+    return result;
+}
+
+
+addr::addr ipv4(std::uint32_t ip)
+{
+    sockaddr_in in = sockaddr_in();
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(ip);
+    return addr::addr(in);
+}
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("lpm_table", "[ipv4][ipv6][lpm]")
+{
+    CATCH_START_SECTION("lpm_table: empty table")
+    {
+        addr::addr_lpm_table table;
+
+        CATCH_REQUIRE(table.empty());
+        CATCH_REQUIRE(table.size() == 0);
+        CATCH_REQUIRE(table.prefix_count() == 0);
+        CATCH_REQUIRE(table.find(ipv4(0x0A000001)) == nullptr);
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A000001)) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE_FALSE(table.match(ipv4(0x0A000001)));
+        CATCH_REQUIRE_THROWS_MATCHES(
+                  table.get_range(0)
+                , addr::out_of_range
+                , Catch::Matchers::ExceptionMessage(
+                          "out_of_range: index 0 does not represent a range in this addr_lpm_table."));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: most specific range wins")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges(
+                  "10.0.0.0/8,10.1.0.0/16,10.1.2.0/24,10.1.2.3,192.168.0.0/16"));
+        CATCH_REQUIRE(ranges.size() == 5);
+
+        addr::addr_lpm_table table(ranges);
+        CATCH_REQUIRE(table.size() == 5);
+        CATCH_REQUIRE(table.prefix_count() == 5);
+
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A020304)) == 0);     // 10.2.3.4
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A010304)) == 1);     // 10.1.3.4
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A010204)) == 2);     // 10.1.2.4
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A010203)) == 3);     // 10.1.2.3
+        CATCH_REQUIRE(table.find_index(ipv4(0xC0A80A01)) == 4);     // 192.168.10.1
+        CATCH_REQUIRE(table.find_index(ipv4(0x0B000001)) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE(table.find(ipv4(0x0A010204)) == &table.get_range(2));
+        CATCH_REQUIRE(address_match_ranges(table, ipv4(0xC0A8FFFF)));
+        CATCH_REQUIRE_FALSE(address_match_ranges(table, ipv4(0xC0A90000)));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: non-CIDR range gets broken in prefixes")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges("10.0.0.5-10.0.3.77"));
+        CATCH_REQUIRE(ranges.size() == 1);
+
+        addr::addr_lpm_table table(ranges);
+        CATCH_REQUIRE(table.size() == 1);
+
+        // 10.0.0.5/32, .6/31, .8/29, .16/28, .32/27, .64/26, .128/25,
+        // 10.0.1.0/24, 10.0.2.0/24, 10.0.3.0/26, .64/29, .72/30, .76/31
+        //
+        CATCH_REQUIRE(table.prefix_count() == 13);
+
+        for(std::uint32_t ip(0x0A000000); ip < 0x0A000500; ++ip)
+        {
+            bool const expected(ip >= 0x0A000005 && ip <= 0x0A00034D);
+            CATCH_REQUIRE(table.match(ipv4(ip)) == expected);
+            CATCH_REQUIRE(address_match_ranges(ranges, ipv4(ip)) == expected);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: IPv6 ranges")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges(
+                  "[2001:db8::]/32,[2001:db8:1::]/48,[::1],fd00::1-fd00::ff"));
+        CATCH_REQUIRE(ranges.size() == 4);
+
+        addr::addr_lpm_table table(ranges);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[2001:db8:2::5]")) == 0);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[2001:db8:1::5]")) == 1);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[::1]")) == 2);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[::2]")) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[fd00::1]")) == 3);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[fd00::ff]")) == 3);
+        CATCH_REQUIRE(table.find_index(addr::string_to_addr("[fd00::100]")) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE(table.find_index(ipv4(0x7F000001)) == addr::addr_lpm_table::NO_RANGE);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: insert and remove")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges(
+                  "10.0.0.0/8,10.1.0.0/16,10.1.2.0/24"));
+
+        addr::addr_lpm_table table;
+        for(auto const & r : ranges)
+        {
+            table.insert(r);
+        }
+        CATCH_REQUIRE(table.size() == 3);
+
+        addr::addr const a(ipv4(0x0A010203));
+        CATCH_REQUIRE(table.find_index(a) == 2);
+
+        CATCH_REQUIRE(table.remove(ranges[2]));
+        CATCH_REQUIRE_FALSE(table.remove(ranges[2]));
+        CATCH_REQUIRE(table.size() == 2);
+        CATCH_REQUIRE(table.prefix_count() == 2);
+        CATCH_REQUIRE(table.find_index(a) == 1);
+
+        CATCH_REQUIRE(table.remove(ranges[1]));
+        CATCH_REQUIRE(table.find_index(a) == 0);
+
+        // the freed index gets reused
+        //
+        std::size_t const idx(table.insert(ranges[2]));
+        CATCH_REQUIRE(idx != 0);
+        CATCH_REQUIRE(table.find_index(a) == idx);
+
+        CATCH_REQUIRE(table.remove(ranges[0]));
+        CATCH_REQUIRE(table.find_index(ipv4(0x0A020304)) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE(table.find_index(a) == idx);
+
+        table.clear();
+        CATCH_REQUIRE(table.empty());
+        CATCH_REQUIRE_FALSE(table.match(a));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: same prefix inserted twice")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges("10.0.0.0/8,10.0.0.0/8"));
+
+        addr::addr_lpm_table table(ranges);
+        CATCH_REQUIRE(table.size() == 2);
+        CATCH_REQUIRE(table.prefix_count() == 1);
+
+        // the last one inserted wins
+        //
+        addr::addr const a(ipv4(0x0A010203));
+        CATCH_REQUIRE(table.find_index(a) == 1);
+
+        // removing the visible one makes the other one visible again
+        //
+        CATCH_REQUIRE(table.remove(ranges[1]));
+        CATCH_REQUIRE(table.find_index(a) == 0);
+        CATCH_REQUIRE(table.remove(ranges[1]));
+        CATCH_REQUIRE(table.find_index(a) == addr::addr_lpm_table::NO_RANGE);
+        CATCH_REQUIRE(table.empty());
+        CATCH_REQUIRE(table.prefix_count() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: random CIDRs agree with linear search")
+    {
+        addr::addr_range::vector_t ranges;
+        for(int count(0); count < 500; ++count)
+        {
+            addr::addr a(ipv4((rand() & 0x0F) << 24 | (rand() & 0xFFFFFF)));
+            a.set_mask_count(96 + 8 + rand() % 25);
+            a.apply_mask();
+            addr::addr_range r;
+            r.set_from(a);
+            ranges.push_back(r);
+        }
+        addr::addr_lpm_table table(ranges);
+
+        for(int count(0); count < 10'000; ++count)
+        {
+            addr::addr const a(ipv4((rand() & 0x0F) << 24 | (rand() & 0xFFFFFF)));
+            std::size_t const idx(table.find_index(a));
+            CATCH_REQUIRE((idx != addr::addr_lpm_table::NO_RANGE) == address_match_ranges(ranges, a));
+            if(idx != addr::addr_lpm_table::NO_RANGE)
+            {
+                // no other matching range can be more specific
+                //
+                CATCH_REQUIRE(ranges[idx].match(a));
+                int const size(ranges[idx].get_from().get_mask_size());
+                for(auto const & r : ranges)
+                {
+                    if(r.match(a))
+                    {
+                        CATCH_REQUIRE(r.get_from().get_mask_size() <= size);
+                    }
+                }
+            }
+        }
+
+        // remove all the even ranges and check again
+        //
+        for(std::size_t idx(0); idx < ranges.size(); idx += 2)
+        {
+            table.remove(ranges[idx]);
+        }
+        addr::addr_range::vector_t odd;
+        for(std::size_t idx(1); idx < ranges.size(); idx += 2)
+        {
+            odd.push_back(ranges[idx]);
+        }
+        for(int count(0); count < 10'000; ++count)
+        {
+            addr::addr const a(ipv4((rand() & 0x0F) << 24 | (rand() & 0xFFFFFF)));
+            CATCH_REQUIRE(table.match(a) == address_match_ranges(odd, a));
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lpm_table: invalid mask")
+    {
+        addr::addr a(ipv4(0x0A000000));
+        std::uint8_t const mask[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 255, 0 };
+        a.set_mask(mask);
+        addr::addr_range r;
+        r.set_from(a);
+
+        addr::addr_lpm_table table;
+        CATCH_REQUIRE_THROWS_MATCHES(
+                  table.insert(r)
+                , addr::addr_unsupported_as_range
+                , Catch::Matchers::ExceptionMessage(
+                          "addr_error: addr_lpm_table only supports CIDR masks"));
+        CATCH_REQUIRE(table.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -1452,6 +1452,81 @@ CATCH_TEST_CASE("ipv4::range", "[ipv4]")
         CATCH_END_SECTION()
     }
 
+    CATCH_GIVEN("addr_range() to_buffer()")
+    {
+        CATCH_START_SECTION("addr_range: to_buffer() of empty range")
+        {
+            addr::addr_range r;
+            char buf[64];
+            CATCH_REQUIRE(r.to_buffer(buf, sizeof(buf)) == 21);
+            CATCH_REQUIRE(std::string(buf) == "<empty address range>");
+            CATCH_REQUIRE(r.to_buffer(buf, 6) == 21);
+            CATCH_REQUIRE(std::string(buf) == "<empt");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: to_buffer() is the same as to_string()")
+        {
+            for(int count(0); count < 1'000; ++count)
+            {
+                struct sockaddr_in fin = sockaddr_in();
+                fin.sin_family = AF_INET;
+                fin.sin_port = htons(rand());
+                fin.sin_addr.s_addr = htonl(0x0A000000 | (rand() & 0xFFFF));
+                addr::addr f(fin);
+
+                struct sockaddr_in tin = fin;
+                tin.sin_addr.s_addr = htonl(ntohl(fin.sin_addr.s_addr) + (rand() & 0xFFFF));
+                addr::addr t(tin);
+
+                addr::addr_range r;
+                switch(count % 3)
+                {
+                case 0:
+                    r.set_from(f);
+                    break;
+
+                case 1:
+                    r.set_to(t);
+                    break;
+
+                case 2:
+                    r.set_from(f);
+                    r.set_to(t);
+                    break;
+
+                }
+
+                for(addr::string_ip_t mode(0); mode < 0x400; ++mode)
+                {
+                    if((mode & addr::STRING_IP_PORT_NAME) != 0)
+                    {
+                        continue;
+                    }
+                    std::string const expected(r.to_string(mode));
+                    char buf[addr::ADDR_STRING_BUFFER_SIZE * 2];
+                    CATCH_REQUIRE(r.to_buffer(buf, sizeof(buf), mode) == expected.length());
+                    CATCH_REQUIRE(expected == buf);
+
+                    // truncated output
+                    //
+                    std::size_t const size(rand() % (expected.length() + 1));
+                    memset(buf, '?', sizeof(buf));
+                    CATCH_REQUIRE(r.to_buffer(buf, size, mode) == expected.length());
+                    if(size == 0)
+                    {
+                        CATCH_REQUIRE(buf[0] == '?');
+                    }
+                    else
+                    {
+                        CATCH_REQUIRE(std::string(buf) == expected.substr(0, size - 1));
+                    }
+                }
+            }
+        }
+        CATCH_END_SECTION()
+    }
+
     CATCH_GIVEN("addr_range() create address with CIDR")
     {
         CATCH_START_SECTION("addr_range: to_cidr() without ranges")
@@ -1530,6 +1605,118 @@ CATCH_TEST_CASE("ipv4::range", "[ipv4]")
         }
         CATCH_END_SECTION()
 
+        CATCH_START_SECTION("addr_range: to_cidrs() of a small IPv4 range")
+        {
+            addr::addr_range range;
+            range.set_from(addr::string_to_addr("10.0.0.1", std::string(), 80, "tcp"));
+            range.set_to(addr::string_to_addr("10.0.0.6", std::string(), 80, "tcp"));
+
+            addr::addr::vector_t const cidrs(range.to_cidrs());
+            CATCH_REQUIRE(cidrs.size() == 4);
+            CATCH_REQUIRE(cidrs[0].to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.1:80/32");
+            CATCH_REQUIRE(cidrs[1].to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.2:80/31");
+            CATCH_REQUIRE(cidrs[2].to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.4:80/31");
+            CATCH_REQUIRE(cidrs[3].to_ipv4_string(addr::STRING_IP_ALL) == "10.0.0.6:80/32");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: to_cidrs() of full ranges")
+        {
+            addr::addr_range range;
+            range.set_from(addr::string_to_addr("0.0.0.0", std::string(), -1, std::string()));
+            range.set_to(addr::string_to_addr("255.255.255.255", std::string(), -1, std::string()));
+
+            addr::addr::vector_t cidrs(range.to_cidrs());
+            CATCH_REQUIRE(cidrs.size() == 1);
+            CATCH_REQUIRE(cidrs[0].is_ipv4());
+            CATCH_REQUIRE(cidrs[0].get_mask_size() == 96);
+
+            range.set_from(addr::string_to_addr("[::]", std::string(), -1, std::string()));
+            range.set_to(addr::string_to_addr("[ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff]", std::string(), -1, std::string()));
+            cidrs = range.to_cidrs();
+            CATCH_REQUIRE(cidrs.size() == 1);
+            CATCH_REQUIRE(cidrs[0].get_mask_size() == 0);
+
+            range.set_from(addr::string_to_addr("[::1]", std::string(), -1, std::string()));
+            cidrs = range.to_cidrs();
+            CATCH_REQUIRE(cidrs.size() == 128);
+            for(int idx(0); idx < 128; ++idx)
+            {
+                CATCH_REQUIRE(cidrs[idx].get_mask_size() == 128 - idx);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: to_cidrs() of a random range covers exactly that range")
+        {
+            for(int count(0); count < 1'000; ++count)
+            {
+                sockaddr_in6 in6 = sockaddr_in6();
+                in6.sin6_family = AF_INET6;
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    in6.sin6_addr.s6_addr16[idx] = rand();
+                }
+                addr::addr a(in6);
+                for(int idx(0); idx < 8; ++idx)
+                {
+                    in6.sin6_addr.s6_addr16[idx] = rand();
+                }
+                addr::addr b(in6);
+                if(b < a)
+                {
+                    std::swap(a, b);
+                }
+                addr::addr_range range;
+                range.set_from(a);
+                range.set_to(b);
+
+                addr::addr::vector_t const cidrs(range.to_cidrs());
+                CATCH_REQUIRE_FALSE(cidrs.empty());
+                CATCH_REQUIRE(cidrs.size() <= 256);
+
+                // the CIDRs follow each other without gaps
+                //
+                addr::addr expected(a);
+                for(std::size_t idx(0); idx < cidrs.size(); ++idx)
+                {
+                    CATCH_REQUIRE(cidrs[idx] == expected);
+                    addr::addr_range r;
+                    r.from_cidr(cidrs[idx]);
+                    CATCH_REQUIRE(r.get_from() == expected);
+                    expected = r.get_to();
+                    if(idx + 1 < cidrs.size())
+                    {
+                        ++expected;
+                    }
+                }
+                CATCH_REQUIRE(expected == b);
+
+                // and the list is minimal
+                //
+                addr::addr::vector_t const aggregated(addr::aggregate_cidrs(cidrs));
+                CATCH_REQUIRE(aggregated.size() == cidrs.size());
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: to_cidrs() of a single address or an empty range")
+        {
+            addr::addr_range range;
+            CATCH_REQUIRE(range.to_cidrs().empty());
+
+            addr::addr a(addr::string_to_addr("10.1.2.3/16", std::string(), -1, std::string(), true));
+            range.set_to(a);
+            addr::addr::vector_t cidrs(range.to_cidrs());
+            CATCH_REQUIRE(cidrs.size() == 1);
+            CATCH_REQUIRE(cidrs[0].to_ipv4_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "10.1.0.0/16");
+
+            range.set_from(addr::string_to_addr("10.1.2.4", std::string(), -1, std::string()));
+            CATCH_REQUIRE(range.is_empty());
+            CATCH_REQUIRE(range.to_cidrs().empty());
+        }
+        CATCH_END_SECTION()
+
         CATCH_START_SECTION("addr_range: valid network range but not for a cidr")
         {
             int const port(rand() & 0xFFFF);
@@ -1610,6 +1797,480 @@ CATCH_TEST_CASE("ipv4::range", "[ipv4]")
             CATCH_REQUIRE(list[0].get_mask_size() == 128 - final_mask_size);
         }
         CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: optimize_vector() with nothing to optimize")
+        {
+            addr::addr::vector_t list;
+            list.push_back(addr::string_to_addr("10.0.1.0/24", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.0.0/24", std::string(), -1, std::string(), true));
+            addr::addr::vector_t const copy(list);
+
+            CATCH_REQUIRE_FALSE(addr::optimize_vector(list));
+            CATCH_REQUIRE(list == copy);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: optimize_vector() keeps the order")
+        {
+            auto cidr = [](char const * a)
+            {
+                return addr::string_to_addr(a, std::string(), -1, std::string(), true);
+            };
+
+            addr::addr::vector_t list;
+            list.push_back(cidr("192.168.1.0/24"));
+            list.push_back(cidr("10.0.0.5/24"));
+            list.push_back(cidr("10.0.0.128/25"));
+            list.push_back(cidr("172.16.0.0/16"));
+            list.push_back(cidr("10.0.0.0/8"));
+            list.push_back(cidr("192.168.1.7"));
+            list.push_back(cidr("172.16.0.0/16"));
+
+            CATCH_REQUIRE(addr::optimize_vector(list));
+            CATCH_REQUIRE(list.size() == 3);
+            CATCH_REQUIRE(list[0].to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "192.168.1.0/24");
+            CATCH_REQUIRE(list[1].to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "10.0.0.0/8");
+            CATCH_REQUIRE(list[2].to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "172.16.0.0/16");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: aggregate_cidrs() merges siblings")
+        {
+            addr::addr::vector_t list;
+            list.push_back(addr::string_to_addr("10.0.0.128/26", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.0.0/25", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.0.192/26", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.1.0/24", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.1.7", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("10.0.3.0/24", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("[2001:db8::]/33", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("[2001:db8:8000::]/33", std::string(), -1, std::string(), true));
+
+            addr::addr::vector_t const all(addr::aggregate_cidrs(list));
+            CATCH_REQUIRE(all.size() == 3);
+            CATCH_REQUIRE(all[0].to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "10.0.0.0/23");
+            CATCH_REQUIRE(all[1].to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "10.0.3.0/24");
+            CATCH_REQUIRE(all[2].to_ipv6_string(addr::STRING_IP_ADDRESS) == "2001:db8::");
+            CATCH_REQUIRE(all[2].get_mask_size() == 32);
+
+            // without absorb, 10.0.1.7 remains
+            //
+            addr::addr::vector_t const merge(addr::aggregate_cidrs(list, addr::AGGREGATE_MERGE));
+            CATCH_REQUIRE(merge.size() == 4);
+            CATCH_REQUIRE(merge[0].get_mask_size() == 96 + 23);
+            CATCH_REQUIRE(merge[1].get_mask_size() == 128);
+            CATCH_REQUIRE(merge[2].get_mask_size() == 96 + 24);
+            CATCH_REQUIRE(merge[3].get_mask_size() == 32);
+
+            // without merge, only 10.0.1.7 goes away
+            //
+            addr::addr::vector_t const absorb(addr::aggregate_cidrs(list, addr::AGGREGATE_ABSORB));
+            CATCH_REQUIRE(absorb.size() == list.size() - 1);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: aggregate_cidrs() keeps IPv4 as IPv4")
+        {
+            addr::addr::vector_t list;
+            list.push_back(addr::string_to_addr("0.0.0.0/1", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("128.0.0.0/1", std::string(), -1, std::string(), true));
+            list.push_back(addr::string_to_addr("[::fffe:0:0]/96", std::string(), -1, std::string(), true));
+
+            addr::addr::vector_t const result(addr::aggregate_cidrs(list));
+            CATCH_REQUIRE(result.size() == 2);
+            CATCH_REQUIRE(result[0].get_mask_size() == 96);
+            CATCH_REQUIRE_FALSE(result[0].is_ipv4());
+            CATCH_REQUIRE(result[1].get_mask_size() == 96);
+            CATCH_REQUIRE(result[1].is_ipv4());
+            CATCH_REQUIRE(result[1].to_ipv4_string(addr::STRING_IP_ADDRESS) == "0.0.0.0");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: aggregate_cidrs() gives the minimal set of CIDRs")
+        {
+            for(int count(0); count < 100; ++count)
+            {
+                // work in 10.0.0.0/20 so we can use a bitmap to verify
+                //
+                std::vector<bool> expected(4096);
+                addr::addr::vector_t list;
+                int const max(rand() % 300);
+                for(int idx(0); idx < max; ++idx)
+                {
+                    int const size(20 + rand() % 13);
+                    std::uint32_t const block(1 << (32 - size));
+                    std::uint32_t const offset(rand() % 4096 & ~(block - 1));
+                    for(std::uint32_t b(0); b < block; ++b)
+                    {
+                        expected[offset + b] = true;
+                    }
+                    sockaddr_in in = sockaddr_in();
+                    in.sin_family = AF_INET;
+                    in.sin_addr.s_addr = htonl(0x0A000000 + offset + rand() % block);
+                    addr::addr a(in);
+                    a.set_mask_count(96 + size);
+                    list.push_back(a);
+                }
+
+                addr::addr::vector_t const result(addr::aggregate_cidrs(list));
+
+                std::vector<bool> found(4096);
+                for(std::size_t idx(0); idx < result.size(); ++idx)
+                {
+                    int const size(result[idx].get_mask_size() - 96);
+                    std::uint32_t const block(1 << (32 - size));
+                    std::uint32_t const offset(static_cast<std::uint32_t>(result[idx].ip_to_uint128()) - 0x0A000000);
+                    CATCH_REQUIRE((offset & (block - 1)) == 0);
+                    for(std::uint32_t b(0); b < block; ++b)
+                    {
+                        CATCH_REQUIRE_FALSE(found[offset + b]);     // no overlaps
+                        found[offset + b] = true;
+                    }
+
+                    // a block and its sibling cannot both be present
+                    //
+                    if(idx > 0)
+                    {
+                        bool const siblings(result[idx - 1].get_mask_size() == result[idx].get_mask_size()
+                                         && (offset & block) != 0
+                                         && static_cast<std::uint32_t>(result[idx - 1].ip_to_uint128()) - 0x0A000000 == (offset ^ block));
+                        CATCH_REQUIRE_FALSE(siblings);
+                    }
+                }
+                CATCH_REQUIRE(found == expected);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: aggregate_cidrs() with many addresses")
+        {
+            addr::addr::vector_t list;
+            for(std::uint32_t idx(0); idx < 1'000'000; ++idx)
+            {
+                sockaddr_in in = sockaddr_in();
+                in.sin_family = AF_INET;
+                in.sin_addr.s_addr = htonl(0x0A000000 + static_cast<std::uint32_t>(idx * 7'919ULL % 1'000'000));
+                list.push_back(addr::addr(in));
+            }
+
+            addr::addr::vector_t const result(addr::aggregate_cidrs(list));
+
+            // 1,000,000 = 0xF4240 -- one prefix per bit set
+            //
+            CATCH_REQUIRE(result.size() == 7);
+            CATCH_REQUIRE(result[0].to_ipv4_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_MASK) == "10.0.0.0/13");
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_GIVEN("addr_range() in unordered containers")
+    {
+        CATCH_START_SECTION("addr_range: operator == () and hash()")
+        {
+            addr::addr a(addr::string_to_addr("10.0.0.1", "0.0.0.0", 80, "tcp"));
+            addr::addr b(addr::string_to_addr("10.0.0.9", "0.0.0.0", 80, "tcp"));
+            addr::addr c(addr::string_to_addr("10.0.0.1", "0.0.0.0", 443, "tcp"));
+
+            addr::addr_range empty1;
+            addr::addr_range empty2;
+            CATCH_REQUIRE(empty1 == empty2);
+            CATCH_REQUIRE_FALSE(empty1 != empty2);
+            CATCH_REQUIRE(empty1.hash() == empty2.hash());
+
+            addr::addr_range from;
+            from.set_from(a);
+            addr::addr_range to;
+            to.set_to(a);
+            CATCH_REQUIRE(from != to);
+            CATCH_REQUIRE(from != empty1);
+
+            addr::addr_range r1;
+            r1.set_from(a);
+            r1.set_to(b);
+            addr::addr_range r2;
+            r2.set_from(c);         // different port, same address
+            r2.set_to(b);
+            CATCH_REQUIRE(r1 == r2);
+            CATCH_REQUIRE(r1.hash() == r2.hash());
+            CATCH_REQUIRE(std::hash<addr::addr_range>()(r1) == r1.hash());
+
+            r2.swap_from_to();
+            CATCH_REQUIRE(r1 != r2);
+
+            addr::addr_range::unordered_set_t set;
+            set.insert(r1);
+            set.insert(r2);
+            set.insert(from);
+            set.insert(to);
+            set.insert(empty1);
+            set.insert(empty2);
+            CATCH_REQUIRE(set.size() == 5);
+            CATCH_REQUIRE(set.count(r1) == 1);
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_GIVEN("addr_range::const_iterator")
+    {
+        CATCH_START_SECTION("addr_range: iterate a /24 like to_addresses()")
+        {
+            addr::addr_range range;
+            range.from_cidr(addr::string_to_addr("192.168.3.0/24", std::string(), 443, "tcp", true));
+
+            addr::addr::vector_t const expected(range.to_addresses(256));
+            CATCH_REQUIRE(expected.size() == 256);
+
+            std::size_t idx(0);
+            for(auto const & a : range)
+            {
+                CATCH_REQUIRE(idx < expected.size());
+                CATCH_REQUIRE(a == expected[idx]);
+                CATCH_REQUIRE(a.get_port() == 443);
+                ++idx;
+            }
+            CATCH_REQUIRE(idx == 256);
+            CATCH_REQUIRE(std::distance(range.begin(), range.end()) == 256);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: iterate with an offset and a step")
+        {
+            addr::addr_range range;
+            range.set_from(addr::string_to_addr("10.0.0.10", std::string(), -1, std::string()));
+            range.set_to(addr::string_to_addr("10.0.0.20", std::string(), -1, std::string()));
+
+            std::vector<std::string> found;
+            for(auto it(range.begin(1, 3)); it != range.end(); ++it)
+            {
+                found.push_back(it->to_ipv4_string(addr::STRING_IP_ADDRESS));
+            }
+            CATCH_REQUIRE(found == std::vector<std::string>{ "10.0.0.11", "10.0.0.14", "10.0.0.17", "10.0.0.20" });
+
+            CATCH_REQUIRE(range.begin(10) != range.end());
+            CATCH_REQUIRE(range.begin(10)->to_ipv4_string(addr::STRING_IP_ADDRESS) == "10.0.0.20");
+            CATCH_REQUIRE(range.begin(11) == range.end());
+
+            auto it(range.begin());
+            auto const previous(it++);
+            CATCH_REQUIRE(previous == range.begin());
+            CATCH_REQUIRE(it->to_ipv4_string(addr::STRING_IP_ADDRESS) == "10.0.0.11");
+            it += 100;
+            CATCH_REQUIRE(it == range.end());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: iterate the end of the IPv6 address space")
+        {
+            addr::addr_range range;
+            range.set_from(addr::string_to_addr("[::]", std::string(), -1, std::string()));
+            range.set_to(addr::string_to_addr("[ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff]", std::string(), -1, std::string()));
+
+            unsigned __int128 const offset(~static_cast<unsigned __int128>(0) - 2);
+            std::vector<std::string> found;
+            for(auto it(range.begin(offset)); it != range.end(); ++it)
+            {
+                found.push_back(it->to_ipv6_string(addr::STRING_IP_ADDRESS));
+            }
+            CATCH_REQUIRE(found == std::vector<std::string>{
+                      "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffd"
+                    , "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe"
+                    , "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" });
+
+            CATCH_REQUIRE(range.begin(offset, offset) != range.end());
+            CATCH_REQUIRE(++range.begin(offset, offset) == range.end());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: iterate single address and empty ranges")
+        {
+            addr::addr_range range;
+            CATCH_REQUIRE(range.begin() == range.end());
+
+            addr::addr const a(addr::string_to_addr("10.1.2.3", std::string(), -1, std::string()));
+            range.set_to(a);
+            CATCH_REQUIRE(std::distance(range.begin(), range.end()) == 1);
+            CATCH_REQUIRE(*range.begin() == a);
+
+            range.set_from(addr::string_to_addr("10.1.2.4", std::string(), -1, std::string()));
+            CATCH_REQUIRE(range.is_empty());
+            CATCH_REQUIRE(range.begin() == range.end());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: iterate a vector_view")
+        {
+            addr::addr_range::vector_t ranges;
+            ranges.push_back(addr::addr_range());               // undefined, skipped
+            addr::addr_range r;
+            r.from_cidr(addr::string_to_addr("10.0.0.0/30", std::string(), -1, std::string(), true));
+            ranges.push_back(r);
+            r.set_from(addr::string_to_addr("10.0.0.9", std::string(), -1, std::string()));
+            r.set_to(addr::string_to_addr("10.0.0.8", std::string(), -1, std::string()));
+            ranges.push_back(r);                                // empty, skipped
+            r = addr::addr_range();
+            r.set_from(addr::string_to_addr("[::1]", std::string(), -1, std::string()));
+            ranges.push_back(r);
+
+            std::vector<std::string> found;
+            for(auto const & a : addr::addr_range::vector_view(ranges))
+            {
+                found.push_back(a.to_ipv4or6_string(addr::STRING_IP_ADDRESS));
+            }
+            CATCH_REQUIRE(found == std::vector<std::string>{ "10.0.0.0", "10.0.0.1", "10.0.0.2", "10.0.0.3", "::1" });
+
+            addr::addr_range::vector_t const empty;
+            addr::addr_range::vector_view const view(empty);
+            CATCH_REQUIRE(view.begin() == view.end());
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_GIVEN("normalize_ranges()")
+    {
+        CATCH_START_SECTION("addr_range: normalize_ranges() gives the same result as a merge with erase()")
+        {
+            for(int count(0); count < 50; ++count)
+            {
+                addr::addr_range::vector_t ranges;
+                int const max(rand() % 200);
+                for(int idx(0); idx < max; ++idx)
+                {
+                    sockaddr_in in = sockaddr_in();
+                    in.sin_family = AF_INET;
+                    std::uint32_t const a(0x0A000000 + rand() % 1000);
+                    in.sin_addr.s_addr = htonl(a);
+                    addr::addr f(in);
+                    addr::addr_range r;
+                    switch(rand() % 4)
+                    {
+                    case 0:
+                        r.set_from(f);
+                        break;
+
+                    case 1:
+                        r.set_to(f);
+                        break;
+
+                    default:
+                        r.set_from(f);
+                        in.sin_addr.s_addr = htonl(a + rand() % 10);
+                        r.set_to(addr::addr(in));
+                        break;
+
+                    }
+                    ranges.push_back(r);
+                }
+
+                // the old algorithm, erase() in a loop
+                //
+                addr::addr_range::vector_t expected(ranges);
+                std::stable_sort(expected.begin(), expected.end());
+                for(std::size_t idx(0); idx + 1 < expected.size(); )
+                {
+                    addr::addr_range const r(expected[idx].union_if_possible(expected[idx + 1]));
+                    if(r.is_defined()
+                    && !r.is_empty())
+                    {
+                        expected[idx] = r;
+                        expected.erase(expected.begin() + idx + 1);
+                    }
+                    else
+                    {
+                        ++idx;
+                    }
+                }
+
+                addr::normalize_ranges(ranges);
+                CATCH_REQUIRE(ranges.size() == expected.size());
+                for(std::size_t idx(0); idx < ranges.size(); ++idx)
+                {
+                    CATCH_REQUIRE(ranges[idx].to_string() == expected[idx].to_string());
+                }
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: normalize_ranges() with many adjacent addresses")
+        {
+            addr::addr_range::vector_t ranges;
+            for(std::uint32_t idx(0); idx < 200'000; ++idx)
+            {
+                sockaddr_in in = sockaddr_in();
+                in.sin_family = AF_INET;
+                in.sin_addr.s_addr = htonl(0x0A000000 + idx * 7'919 % 200'000);  // 7,919 is prime so all values are used
+                addr::addr_range r;
+                r.set_from(addr::addr(in));
+                ranges.push_back(r);
+            }
+
+            addr::normalize_ranges(ranges);
+            CATCH_REQUIRE(ranges.size() == 1);
+            CATCH_REQUIRE(ranges[0].to_string(addr::STRING_IP_ADDRESS) == "10.0.0.0-10.3.13.63");
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: normalize_ranges() with an empty vector")
+        {
+            addr::addr_range::vector_t ranges;
+            addr::normalize_ranges(ranges);
+            CATCH_REQUIRE(ranges.empty());
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("addr_range: to_uint128_interval()")
+        {
+            unsigned __int128 from(1);
+            unsigned __int128 to(2);
+
+            // undefined ranges do not change the output
+            //
+            addr::addr_range undefined;
+            CATCH_REQUIRE_FALSE(undefined.to_uint128_interval(from, to));
+            CATCH_REQUIRE(from == 1);
+            CATCH_REQUIRE(to == 2);
+
+            // a range ignores the masks
+            //
+            addr::addr_range range;
+            range.set_from(addr::string_to_addr("10.0.0.5/8", std::string(), -1, std::string(), true));
+            range.set_to(addr::string_to_addr("10.0.3.77"));
+            CATCH_REQUIRE(range.to_uint128_interval(from, to));
+            CATCH_REQUIRE(from == 0xffff0a000005_uint128);
+            CATCH_REQUIRE(to == 0xffff0a00034d_uint128);
+
+            // empty ranges do not represent any address
+            //
+            range.swap_from_to();
+            CATCH_REQUIRE_FALSE(range.to_uint128_interval(from, to));
+
+            // a "from" or "to" only range is a CIDR
+            //
+            addr::addr_range cidr;
+            cidr.set_from(addr::string_to_addr("10.1.2.3/16", std::string(), -1, std::string(), true));
+            CATCH_REQUIRE(cidr.to_uint128_interval(from, to));
+            CATCH_REQUIRE(from == 0xffff0a010000_uint128);
+            CATCH_REQUIRE(to == 0xffff0a01ffff_uint128);
+
+            addr::addr_range cidr_to;
+            cidr_to.set_to(addr::string_to_addr("[::]/0", std::string(), -1, std::string(), true));
+            CATCH_REQUIRE(cidr_to.to_uint128_interval(from, to));
+            CATCH_REQUIRE(from == 0);
+            CATCH_REQUIRE(to == 0xffffffffffffffffffffffffffffffff_uint128);
+
+            // a non-CIDR mask is not supported
+            //
+            addr::addr a(addr::string_to_addr("10.1.2.3"));
+            std::uint8_t const invalid_mask[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 255, 0 };
+            a.set_mask(invalid_mask);
+            addr::addr_range invalid;
+            invalid.set_from(a);
+            CATCH_REQUIRE_THROWS_MATCHES(
+                      invalid.to_uint128_interval(from, to)
+                    , addr::addr_unsupported_as_range
+                    , Catch::Matchers::ExceptionMessage(
+                              "addr_error: addr_range only supports CIDR masks"));
+        }
+        CATCH_END_SECTION()
     }
 }
 
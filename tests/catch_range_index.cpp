@@ -0,0 +1,227 @@
+// Copyright (c) 2011-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+// contact@m2osw.com
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and
+// associated documentation files (the "Software"), to
+// deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify,
+// merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice
+// shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+// EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** \file
+ * \brief Check the addr_range_index class.
+ *
+ * This set of unit tests verifies that the addr_range_index class
+ * normalizes ranges and agrees with the linear address_match_ranges()
+ * function.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr_range_index.h>
+
+
+// self
+//
+#include    "catch_main.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+addr::addr_range::vector_t parse_ranges(std::string const & in)
+{
+    addr::addr_parser p;
+    p.set_allow(addr::allow_t::ALLOW_ADDRESS_LOOKUP, false);
+    p.set_allow(addr::allow_t::ALLOW_MULTI_ADDRESSES_COMMAS, true);
+    p.set_allow(addr::allow_t::ALLOW_ADDRESS_RANGE, true);
+    p.set_allow(addr::allow_t::ALLOW_MASK, true);
+    p.set_allow(addr::allow_t::ALLOW_PORT, false);
+    addr::addr_range::vector_t const result(p.parse(in));
+    CATCH_REQUIRE_FALSE(p.has_errors());
+    return result;
+}
+
+
+addr::addr ipv4(std::uint32_t ip)
+{
+    sockaddr_in in = sockaddr_in();
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(ip);
+    return addr::addr(in);
+}
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("range_index", "[ipv4][ipv6][range]")
+{
+    CATCH_START_SECTION("range_index: empty index")
+    {
+        addr::addr_range_index index;
+
+        CATCH_REQUIRE(index.empty());
+        CATCH_REQUIRE(index.size() == 0);
+        CATCH_REQUIRE(index.to_ranges().empty());
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0x0A000001)));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("range_index: ranges get sorted and merged")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges(
+                  "10.0.3.0-10.0.3.255,10.0.0.5-10.0.1.77,10.0.1.78-10.0.2.3,10.0.2.0/24,192.168.1.1,10.0.9.9-10.0.0.1"));
+        CATCH_REQUIRE(ranges.size() == 6);
+
+        addr::addr_range_index index(ranges);
+        CATCH_REQUIRE_FALSE(index.empty());
+        CATCH_REQUIRE(index.size() == 2);
+
+        addr::addr_range::vector_t const normalized(index.to_ranges());
+        CATCH_REQUIRE(normalized.size() == 2);
+        CATCH_REQUIRE(normalized[0].to_string(addr::STRING_IP_ADDRESS) == "10.0.0.5-10.0.3.255");
+        CATCH_REQUIRE(normalized[1].to_string(addr::STRING_IP_ADDRESS) == "192.168.1.1-192.168.1.1");
+
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0x0A000004)));
+        CATCH_REQUIRE(index.contains(ipv4(0x0A000005)));
+        CATCH_REQUIRE(index.contains(ipv4(0x0A0003FF)));
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0x0A000400)));
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0xC0A80100)));
+        CATCH_REQUIRE(index.contains(ipv4(0xC0A80101)));
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0xC0A80102)));
+
+        index.clear();
+        CATCH_REQUIRE(index.empty());
+        CATCH_REQUIRE_FALSE(index.contains(ipv4(0x0A000005)));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("range_index: IPv6 ranges")
+    {
+        addr::addr_range::vector_t const ranges(parse_ranges(
+                  "[2001:db8::]/32,fd00::1-fd00::ff,[::]/0"));
+
+        addr::addr_range_index index(ranges);
+        CATCH_REQUIRE(index.size() == 1);
+        CATCH_REQUIRE(index.contains(ipv4(0)));
+        CATCH_REQUIRE(index.contains(ipv4(0xFFFFFFFF)));
+
+        index.set_ranges(addr::addr_range::vector_t(ranges.begin(), ranges.begin() + 2));
+        CATCH_REQUIRE(index.size() == 2);
+        CATCH_REQUIRE(index.contains(addr::string_to_addr("[2001:db8:ffff::]")));
+        CATCH_REQUIRE_FALSE(index.contains(addr::string_to_addr("[2001:db9::]")));
+        CATCH_REQUIRE(index.contains(addr::string_to_addr("[fd00::80]")));
+        CATCH_REQUIRE_FALSE(index.contains(addr::string_to_addr("[fd00::100]")));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("range_index: random ranges agree with linear search")
+    {
+        addr::addr_range::vector_t ranges;
+        for(int count(0); count < 300; ++count)
+        {
+            addr::addr_range r;
+            std::uint32_t const from((rand() & 0x0F) << 24 | (rand() & 0xFFFFFF));
+            switch(rand() % 3)
+            {
+            case 0:
+                {
+                    addr::addr a(ipv4(from));
+                    a.set_mask_count(96 + 8 + rand() % 25);
+                    r.set_from(a);
+                }
+                break;
+
+            case 1:
+                {
+                    addr::addr a(ipv4(from));
+                    a.set_mask_count(96 + 8 + rand() % 25);
+                    r.set_to(a);
+                }
+                break;
+
+            case 2:
+                r.set_from(ipv4(from));
+                r.set_to(ipv4(from + (rand() & 0xFFFF)));
+                break;
+
+            }
+            ranges.push_back(r);
+        }
+        addr::addr_range_index index(ranges);
+
+        addr::addr::vector_t addresses;
+        for(int count(0); count < 10'000; ++count)
+        {
+            addresses.push_back(ipv4((rand() & 0x0F) << 24 | (rand() & 0xFFFFFF)));
+        }
+
+        std::vector<bool> result;
+        std::size_t const found(index.contains(addresses, result));
+        CATCH_REQUIRE(result.size() == addresses.size());
+
+        std::size_t expected_found(0);
+        for(std::size_t idx(0); idx < addresses.size(); ++idx)
+        {
+            bool const expected(address_match_ranges(ranges, addresses[idx]));
+            CATCH_REQUIRE(index.contains(addresses[idx]) == expected);
+            CATCH_REQUIRE(result[idx] == expected);
+            expected_found += expected;
+        }
+        CATCH_REQUIRE(found == expected_found);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("range_index: invalid mask")
+    {
+        addr::addr a(ipv4(0x0A000000));
+        std::uint8_t const mask[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 255, 0 };
+        a.set_mask(mask);
+        addr::addr_range r;
+        r.set_from(a);
+
+        addr::addr_range_index index;
+        CATCH_REQUIRE_THROWS_MATCHES(
+                  index.set_ranges({ r })
+                , addr::addr_unsupported_as_range
+                , Catch::Matchers::ExceptionMessage(
+                          "addr_error: addr_range_index only supports CIDR masks"));
+        CATCH_REQUIRE(index.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,298 @@
+// Copyright (c) 2011-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+// contact@m2osw.com
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and
+// associated documentation files (the "Software"), to
+// deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify,
+// merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice
+// shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+// EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** \file
+ * \brief Check the addr_range_set class.
+ *
+ * This set of unit tests verifies the set operations of the
+ * addr_range_set class against a bitmap of a small IPv4 network.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr_range_set.h>
+
+
+// self
+//
+#include    "catch_main.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+constexpr std::uint32_t const   BASE = 0x0A000000;      // 10.0.0.0
+constexpr std::uint32_t const   SPACE = 1024;           // 10.0.0.0/22
+
+
+typedef std::vector<bool>       bitmap_t;
+
+
+addr::addr ipv4(std::uint32_t ip)
+{
+    sockaddr_in in = sockaddr_in();
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(ip);
+    return addr::addr(in);
+}
+
+
+addr::addr_range::vector_t random_ranges(bitmap_t & bitmap)
+{
+    bitmap = bitmap_t(SPACE);
+    addr::addr_range::vector_t ranges;
+    int const max(rand() % 20);
+    for(int idx(0); idx < max; ++idx)
+    {
+        std::uint32_t const from(rand() % SPACE);
+        std::uint32_t const to(std::min(from + rand() % 100, SPACE - 1));
+        addr::addr_range r;
+        r.set_from(ipv4(BASE + from));
+        r.set_to(ipv4(BASE + to));
+        ranges.push_back(r);
+        for(std::uint32_t b(from); b <= to; ++b)
+        {
+            bitmap[b] = true;
+        }
+    }
+    return ranges;
+}
+
+
+void verify(addr::addr_range_set const & set, bitmap_t const & bitmap)
+{
+    std::size_t count(0);
+    for(std::uint32_t b(0); b < SPACE; ++b)
+    {
+        CATCH_REQUIRE(set.contains(ipv4(BASE + b)) == bitmap[b]);
+        count += bitmap[b];
+    }
+    CATCH_REQUIRE(set.cardinality() == count);
+
+    // the ranges are sorted, do not overlap and do not touch
+    //
+    addr::addr_range::vector_t const ranges(set.to_ranges());
+    CATCH_REQUIRE(ranges.size() == set.size());
+    for(std::size_t idx(1); idx < ranges.size(); ++idx)
+    {
+        addr::addr next(ranges[idx - 1].get_to());
+        ++next;
+        CATCH_REQUIRE(next < ranges[idx].get_from());
+    }
+
+    // the CIDRs cover the same addresses
+    //
+    std::size_t cidr_count(0);
+    for(auto const & a : set.to_cidrs())
+    {
+        addr::addr_range r;
+        r.from_cidr(a);
+        cidr_count += r.size();
+        CATCH_REQUIRE(set.contains(r.get_from()));
+        CATCH_REQUIRE(set.contains(r.get_to()));
+    }
+    CATCH_REQUIRE(cidr_count == count);
+}
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("range_set", "[range]")
+{
+    CATCH_GIVEN("addr_range_set()")
+    {
+        CATCH_START_SECTION("range_set: empty set")
+        {
+            addr::addr_range_set set;
+            CATCH_REQUIRE(set.empty());
+            CATCH_REQUIRE(set.size() == 0);
+            CATCH_REQUIRE(set.cardinality() == 0);
+            CATCH_REQUIRE(set.to_ranges().empty());
+            CATCH_REQUIRE(set.to_cidrs().empty());
+            CATCH_REQUIRE_FALSE(set.contains(ipv4(BASE)));
+            CATCH_REQUIRE(set.set_union(set) == set);
+            CATCH_REQUIRE(set.set_intersection(set).empty());
+            CATCH_REQUIRE(set.set_difference(set).empty());
+            CATCH_REQUIRE(set.complement_ipv4().cardinality() == 0x100000000);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("range_set: CIDRs, merges and invalid masks")
+        {
+            addr::addr_range::vector_t ranges;
+            addr::addr_range r;
+            r.set_from(addr::string_to_addr("10.0.0.0/25", std::string(), -1, std::string(), true));
+            ranges.push_back(r);
+            r = addr::addr_range();
+            r.set_to(addr::string_to_addr("10.0.0.128/25", std::string(), -1, std::string(), true));
+            ranges.push_back(r);
+            r.set_from(ipv4(BASE + 500));
+            r.set_to(ipv4(BASE + 400));
+            ranges.push_back(r);                // empty, ignored
+            ranges.push_back(addr::addr_range());
+
+            addr::addr_range_set set(ranges);
+            CATCH_REQUIRE(set.size() == 1);
+            CATCH_REQUIRE(set.cardinality() == 256);
+            CATCH_REQUIRE(set.to_ranges()[0].to_string(addr::STRING_IP_ADDRESS) == "10.0.0.0-10.0.0.255");
+            addr::addr::vector_t const cidrs(set.to_cidrs());
+            CATCH_REQUIRE(cidrs.size() == 1);
+            CATCH_REQUIRE(cidrs[0].get_mask_size() == 96 + 24);
+
+            set.clear();
+            CATCH_REQUIRE(set.empty());
+
+            addr::addr a(ipv4(BASE));
+            std::uint8_t const mask[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 255, 0 };
+            a.set_mask(mask);
+            r = addr::addr_range();
+            r.set_from(a);
+            CATCH_REQUIRE_THROWS_MATCHES(
+                      set.set_ranges(addr::addr_range::vector_t{ r })
+                    , addr::addr_unsupported_as_range
+                    , Catch::Matchers::ExceptionMessage(
+                              "addr_error: addr_range_set only supports CIDR masks"));
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("range_set: union, intersection and difference agree with a bitmap")
+        {
+            for(int count(0); count < 500; ++count)
+            {
+                bitmap_t ba;
+                bitmap_t bb;
+                addr::addr_range_set const a(random_ranges(ba));
+                addr::addr_range_set const b(random_ranges(bb));
+                verify(a, ba);
+                verify(b, bb);
+
+                bitmap_t expected(SPACE);
+                for(std::uint32_t idx(0); idx < SPACE; ++idx)
+                {
+                    expected[idx] = ba[idx] || bb[idx];
+                }
+                verify(a.set_union(b), expected);
+                CATCH_REQUIRE(a.set_union(b) == b.set_union(a));
+
+                for(std::uint32_t idx(0); idx < SPACE; ++idx)
+                {
+                    expected[idx] = ba[idx] && bb[idx];
+                }
+                verify(a.set_intersection(b), expected);
+                CATCH_REQUIRE(a.set_intersection(b) == b.set_intersection(a));
+
+                for(std::uint32_t idx(0); idx < SPACE; ++idx)
+                {
+                    expected[idx] = ba[idx] && !bb[idx];
+                }
+                verify(a.set_difference(b), expected);
+
+                CATCH_REQUIRE(a.set_difference(a).empty());
+                CATCH_REQUIRE(a.set_union(a) == a);
+                CATCH_REQUIRE(a.set_intersection(a) == a);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("range_set: complements")
+        {
+            for(int count(0); count < 100; ++count)
+            {
+                bitmap_t bitmap;
+                addr::addr_range_set const set(random_ranges(bitmap));
+
+                addr::addr_range_set const c4(set.complement_ipv4());
+                CATCH_REQUIRE(c4.set_intersection(set).empty());
+                CATCH_REQUIRE(c4.cardinality() + set.cardinality() == 0x100000000);
+                CATCH_REQUIRE(c4.complement_ipv4() == set);
+                for(std::uint32_t b(0); b < SPACE; ++b)
+                {
+                    CATCH_REQUIRE(c4.contains(ipv4(BASE + b)) != bitmap[b]);
+                }
+            }
+
+            addr::addr_range_set const none;
+            addr::addr_range_set const all_ipv6(none.complement_ipv6());
+            CATCH_REQUIRE(all_ipv6.size() == 2);
+            CATCH_REQUIRE(all_ipv6.cardinality() == ~static_cast<unsigned __int128>(0) - 0xFFFFFFFF);
+            CATCH_REQUIRE_FALSE(all_ipv6.contains(ipv4(BASE)));
+            CATCH_REQUIRE(all_ipv6.contains(addr::string_to_addr("[::1]", std::string(), -1, std::string())));
+            CATCH_REQUIRE(all_ipv6.complement_ipv6().empty());
+
+            // the whole address space saturates the cardinality
+            //
+            addr::addr_range_set const everything(all_ipv6.set_union(none.complement_ipv4()));
+            CATCH_REQUIRE(everything.size() == 1);
+            CATCH_REQUIRE(everything.cardinality() == ~static_cast<unsigned __int128>(0));
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("range_set: allowlist minus blocklist")
+        {
+            addr::addr_range::vector_t allow;
+            addr::addr_range::vector_t block;
+            for(std::uint32_t idx(0); idx < 50'000; ++idx)
+            {
+                addr::addr_range r;
+                r.set_from(ipv4(BASE + idx * 16));
+                r.set_to(ipv4(BASE + idx * 16 + 11));
+                allow.push_back(r);
+
+                r.set_from(ipv4(BASE + idx * 16 + 4));
+                r.set_to(ipv4(BASE + idx * 16 + 7));
+                block.push_back(r);
+            }
+
+            addr::addr_range_set const result(addr::addr_range_set(allow).set_difference(addr::addr_range_set(block)));
+            CATCH_REQUIRE(result.size() == 100'000);
+            CATCH_REQUIRE(result.cardinality() == 50'000 * 8);
+            CATCH_REQUIRE(result.contains(ipv4(BASE + 3)));
+            CATCH_REQUIRE_FALSE(result.contains(ipv4(BASE + 4)));
+            CATCH_REQUIRE(result.contains(ipv4(BASE + 8)));
+            CATCH_REQUIRE_FALSE(result.contains(ipv4(BASE + 12)));
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+
+// vim: ts=4 sw=4 et
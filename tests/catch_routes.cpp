@@ -37,6 +37,7 @@
 
 // libaddr
 //
+#include    <libaddr/addr_parser.h>
 #include    <libaddr/route.h>
 
 
@@ -45,6 +46,11 @@
 #include    "catch_main.h"
 
 
+// C++
+//
+#include    <algorithm>
+#include    <iterator>
+
 
 // C
 //
@@ -151,4 +157,249 @@ std::cout << "Route: Dest: " << r->get_destination_address().to_ipv4or6_string(a
 }
 
 
+CATCH_TEST_CASE("ipv6::routes", "[ipv6]")
+{
+    CATCH_GIVEN("route::get_ipv6_routes()")
+    {
+        addr::route::vector_t routes(addr::route::get_ipv6_routes());
+
+        CATCH_START_SECTION("routes: verify IPv6 list")
+        {
+            for(auto r : routes)
+            {
+                CATCH_REQUIRE_FALSE(r->get_interface_name().empty());
+                CATCH_REQUIRE(r->get_interface_name().length() < IFNAMSIZ);
+                CATCH_REQUIRE_FALSE(r->get_destination_address().is_ipv4());
+                CATCH_REQUIRE_FALSE(r->get_gateway_address().is_ipv4());
+                CATCH_REQUIRE(r->get_destination_address().get_mask_size() >= 0);
+                CATCH_REQUIRE(r->get_destination_address().get_mask_size() <= 128);
+
+                if(!r->get_gateway_address().is_default())
+                {
+                    CATCH_REQUIRE((r->get_flags() & RTF_GATEWAY) != 0);
+                }
+                CATCH_REQUIRE(r->get_mtu() == 0);
+                CATCH_REQUIRE(r->get_window() == 0);
+                CATCH_REQUIRE(r->get_irtt() == 0);
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("routes::cache", "[ipv4][ipv6]")
+{
+    CATCH_GIVEN("route::get_routes()")
+    {
+        CATCH_START_SECTION("routes: netlink matches /proc/net/route")
+        {
+            addr::route::reset_routes_cache();
+            addr::route::pointer_vector_t routes(addr::route::get_routes());
+            CATCH_REQUIRE(routes != nullptr);
+            CATCH_REQUIRE_FALSE(routes->empty());
+
+            addr::route::vector_t ipv4;
+            for(auto r : *routes)
+            {
+                CATCH_REQUIRE_FALSE(r->get_interface_name().empty());
+                CATCH_REQUIRE(r->get_destination_address().is_ipv4() == r->get_gateway_address().is_ipv4());
+                if(r->get_destination_address().is_ipv4())
+                {
+                    ipv4.push_back(r);
+                }
+                if(!r->get_gateway_address().is_default())
+                {
+                    CATCH_REQUIRE((r->get_flags() & RTF_GATEWAY) != 0);
+                }
+            }
+
+            // both lists have the same IPv4 destinations and gateways
+            //
+            addr::route::vector_t const proc(addr::route::get_ipv4_routes());
+            CATCH_REQUIRE(ipv4.size() == proc.size());
+            for(auto p : proc)
+            {
+                auto it(std::find_if(
+                          ipv4.cbegin()
+                        , ipv4.cend()
+                        , [p](auto const & r)
+                        {
+                            return r->get_destination_address() == p->get_destination_address()
+                                && r->get_destination_address().get_mask_size() == p->get_destination_address().get_mask_size()
+                                && r->get_gateway_address() == p->get_gateway_address()
+                                && r->get_interface_name() == p->get_interface_name()
+                                && r->get_metric() == p->get_metric();
+                        }));
+                CATCH_REQUIRE(it != ipv4.cend());
+            }
+
+            addr::route::pointer_t const proc_default(find_default_route(proc));
+            addr::route::pointer_t const netlink_default(find_default_route(ipv4));
+            CATCH_REQUIRE((proc_default == nullptr) == (netlink_default == nullptr));
+            if(proc_default != nullptr)
+            {
+                CATCH_REQUIRE(netlink_default->get_gateway_address() == proc_default->get_gateway_address());
+                CATCH_REQUIRE(netlink_default->get_interface_name() == proc_default->get_interface_name());
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("routes: the cache returns the same list")
+        {
+            addr::route::pointer_vector_t routes(addr::route::get_routes());
+            CATCH_REQUIRE(addr::route::get_routes() == routes);
+
+            addr::route::reset_routes_cache();
+            addr::route::pointer_vector_t reloaded(addr::route::get_routes());
+            CATCH_REQUIRE(reloaded != routes);
+            CATCH_REQUIRE(reloaded->size() == routes->size());
+
+            addr::route::set_routes_cache_ttl(0);
+            CATCH_REQUIRE(addr::route::get_routes() != nullptr);
+            addr::route::set_routes_cache_ttl(5 * 60);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("routes: a rejecting default route is not the default")
+        {
+            addr::route::pointer_vector_t routes(addr::route::get_routes());
+            addr::route::vector_t rejects;
+            for(auto r : *routes)
+            {
+                if((r->get_flags() & RTF_UP) == 0)
+                {
+                    rejects.push_back(r);
+                }
+            }
+            CATCH_REQUIRE(find_default_route(rejects) == nullptr);
+
+            // /proc/net/ipv6_route often ends with an unreachable default
+            //
+            addr::route::pointer_t const d(find_default_route(addr::route::get_ipv6_routes()));
+            if(d != nullptr)
+            {
+                CATCH_REQUIRE((d->get_flags() & RTF_UP) != 0);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("routes: find_route() matches a linear search")
+        {
+            addr::route::pointer_vector_t routes(addr::route::get_routes());
+
+            // the reference: longest prefix first, then smallest metric
+            //
+            auto linear = [&routes](addr::addr const & a)
+            {
+                addr::route::pointer_t best;
+                for(auto r : *routes)
+                {
+                    addr::addr const & d(r->get_destination_address());
+                    if(d.is_ipv4() != a.is_ipv4()
+                    || !d.match(a))
+                    {
+                        continue;
+                    }
+                    if(best == nullptr
+                    || d.get_mask_size() > best->get_destination_address().get_mask_size()
+                    || (d.get_mask_size() == best->get_destination_address().get_mask_size()
+                        && static_cast<std::uint32_t>(r->get_metric()) < static_cast<std::uint32_t>(best->get_metric())))
+                    {
+                        best = r;
+                    }
+                }
+                if(best != nullptr
+                && (best->get_flags() & RTF_UP) == 0)
+                {
+                    return addr::route::pointer_t();
+                }
+                return best;
+            };
+
+            std::vector<addr::addr> destinations;
+            destinations.push_back(addr::string_to_addr("192.0.2.77"));
+            destinations.push_back(addr::string_to_addr("8.8.8.8"));
+            destinations.push_back(addr::string_to_addr("127.0.0.1"));
+            destinations.push_back(addr::string_to_addr("[2001:db8::1]"));
+            destinations.push_back(addr::string_to_addr("[::1]"));
+            for(auto r : *routes)
+            {
+                addr::addr a(r->get_destination_address());
+                destinations.push_back(a);
+                ++a;
+                destinations.push_back(a);
+                if(!r->get_gateway_address().is_default())
+                {
+                    destinations.push_back(r->get_gateway_address());
+                }
+            }
+
+            for(auto const & a : destinations)
+            {
+                CATCH_REQUIRE(addr::route::find_route(a) == linear(a));
+            }
+
+            // the default route is used for a remote address
+            //
+            addr::route::vector_t ipv4;
+            std::copy_if(
+                      routes->cbegin()
+                    , routes->cend()
+                    , std::back_inserter(ipv4)
+                    , [](auto const & r)
+                    {
+                        return r->get_destination_address().is_ipv4();
+                    });
+            addr::route::pointer_t const default_route(find_default_route(ipv4));
+            if(default_route != nullptr)
+            {
+                CATCH_REQUIRE(addr::route::find_route(addr::string_to_addr("8.8.8.8")) != nullptr);
+            }
+
+            // after a refresh the table gets updated
+            //
+            addr::route::reset_routes_cache();
+            addr::route::pointer_vector_t const reloaded(addr::route::get_routes());
+            CATCH_REQUIRE(reloaded != routes);
+            routes = reloaded;
+            for(auto const & a : destinations)
+            {
+                addr::route::pointer_t const r(addr::route::find_route(a));
+                addr::route::pointer_t const expected(linear(a));
+                CATCH_REQUIRE(r == expected);
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("routes: an IPv6 default route does not match IPv4")
+        {
+            addr::route::pointer_vector_t routes(addr::route::get_routes());
+            addr::route::vector_t ipv6;
+            std::copy_if(
+                      routes->cbegin()
+                    , routes->cend()
+                    , std::back_inserter(ipv6)
+                    , [](auto const & r)
+                    {
+                        return !r->get_destination_address().is_ipv4();
+                    });
+
+            // without any IPv4 route, no IPv4 destination has a route
+            //
+            CATCH_REQUIRE(addr::find_route(ipv6, addr::string_to_addr("8.8.8.8")) == nullptr);
+            CATCH_REQUIRE(addr::find_route(ipv6, addr::string_to_addr("127.0.0.1")) == nullptr);
+
+            addr::route::pointer_t const default_route(find_default_route(ipv6));
+            if(default_route != nullptr)
+            {
+                CATCH_REQUIRE(default_route->get_destination_address().get_mask_size() == 0);
+                CATCH_REQUIRE(addr::find_route(ipv6, addr::string_to_addr("[2001:db8::1]")) != nullptr);
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
 // vim: ts=4 sw=4 et
@@ -0,0 +1,258 @@
+// Copyright (c) 2011-2024  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/libaddr
+// contact@m2osw.com
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and
+// associated documentation files (the "Software"), to
+// deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify,
+// merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice
+// shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO
+// EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+/** \file
+ * \brief Check the service_registry class.
+ *
+ * This set of unit tests verifies that the service_registry loads the
+ * services, protocols, and drop-in files and reloads them when they
+ * change.
+ */
+
+// libaddr
+//
+#include    <libaddr/addr.h>
+#include    <libaddr/service_registry.h>
+
+
+// self
+//
+#include    "catch_main.h"
+
+
+// C++
+//
+#include    <fstream>
+
+
+// C
+//
+#include    <sys/stat.h>
+#include    <unistd.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+void write_file(std::string const & filename, std::string const & content)
+{
+    std::ofstream out(filename);
+    out << content;
+}
+
+
+void reset_registry()
+{
+    addr::service_registry::set_services_filename(addr::service_registry::DEFAULT_SERVICES_FILENAME);
+    addr::service_registry::set_protocols_filename(addr::service_registry::DEFAULT_PROTOCOLS_FILENAME);
+    addr::service_registry::set_drop_in_directory(addr::service_registry::DEFAULT_DROP_IN_DIRECTORY);
+    addr::service_registry::set_check_interval(addr::service_registry::DEFAULT_CHECK_INTERVAL);
+    addr::service_registry::reload();
+}
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("service_registry", "[service_registry]")
+{
+    CATCH_START_SECTION("service_registry: system files")
+    {
+        reset_registry();
+        CATCH_REQUIRE(addr::service_registry::get_services_filename() == "/etc/services");
+        CATCH_REQUIRE(addr::service_registry::get_protocols_filename() == "/etc/protocols");
+        CATCH_REQUIRE(addr::service_registry::get_check_interval() == addr::service_registry::DEFAULT_CHECK_INTERVAL);
+
+        CATCH_REQUIRE(addr::service_registry::get_protocol("tcp") == IPPROTO_TCP);
+        CATCH_REQUIRE(addr::service_registry::get_protocol("udp") == IPPROTO_UDP);
+        CATCH_REQUIRE(addr::service_registry::get_protocol_name(IPPROTO_TCP) == "tcp");
+        CATCH_REQUIRE(addr::service_registry::get_port("http", IPPROTO_TCP) == 80);
+        CATCH_REQUIRE(addr::service_registry::get_port_name(443, IPPROTO_TCP) == "https");
+
+        addr::addr a;
+        CATCH_REQUIRE(a.set_port("http"));
+        CATCH_REQUIRE(a.get_port() == 80);
+        CATCH_REQUIRE(a.get_port_name() == "http");
+        CATCH_REQUIRE(a.get_service() == "http");
+        a.set_protocol("udp");
+        CATCH_REQUIRE(a.get_protocol() == IPPROTO_UDP);
+        CATCH_REQUIRE(a.get_protocol_name() == "udp");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("service_registry: custom files and drop-ins")
+    {
+        std::string const dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/service_registry");
+        std::string const drop_in(dir + "/services.d");
+        mkdir(dir.c_str(), 0700);
+        mkdir(drop_in.c_str(), 0700);
+
+        write_file(dir + "/protocols",
+                  "# test protocols\n"
+                  "tcp\t6\tTCP\t# transmission control protocol\n"
+                  "udp 17 UDP\n"
+                  "bad\n"
+                  "sctp 132 SCTP\n");
+        write_file(dir + "/services",
+                  "http\t\t80/tcp\t\twww\t# WorldWideWeb HTTP\n"
+                  "\n"
+                  "domain\t\t53/tcp\n"
+                  "domain\t\t53/udp\n"
+                  "broken\t\t99999/tcp\n"
+                  "broken\t\t12/unknown\n");
+        write_file(drop_in + "/10-cd.conf",
+                  "cd\t\t4040/tcp\t\tcommunicatord\n"
+                  "http\t\t8080/tcp\t# name already defined\n");
+        write_file(drop_in + "/20-other.conf",
+                  "cd-alt\t\t4040/tcp\n"
+                  "cd\t\t4041/udp\n"
+                  "a-service-with-a-really-long-name-which-does-not-fit-in-the-buffer\t4242/tcp\n");
+        write_file(drop_in + "/ignored.txt",
+                  "ignored\t\t5050/tcp\n");
+
+        addr::service_registry::set_protocols_filename(dir + "/protocols");
+        addr::service_registry::set_services_filename(dir + "/services");
+        addr::service_registry::set_drop_in_directory(drop_in);
+        addr::service_registry::set_check_interval(0);
+        CATCH_REQUIRE(addr::service_registry::get_drop_in_directory() == drop_in);
+        CATCH_REQUIRE(addr::service_registry::get_check_interval() == 0);
+        addr::service_registry::reload();
+
+        CATCH_REQUIRE(addr::service_registry::get_protocol("sctp") == 132);
+        CATCH_REQUIRE(addr::service_registry::get_protocol("SCTP") == 132);
+        CATCH_REQUIRE(addr::service_registry::get_protocol("bad") == -1);
+        CATCH_REQUIRE(addr::service_registry::get_protocol_name(132) == "sctp");
+        CATCH_REQUIRE(addr::service_registry::get_protocol_name(250).empty());
+
+        // "ip" is always defined
+        //
+        CATCH_REQUIRE(addr::service_registry::get_protocol("ip") == IPPROTO_IP);
+
+        CATCH_REQUIRE(addr::service_registry::get_port("http", IPPROTO_TCP) == 80);
+        CATCH_REQUIRE(addr::service_registry::get_port("www", IPPROTO_TCP) == 80);
+        CATCH_REQUIRE(addr::service_registry::get_port("http", IPPROTO_UDP) == -1);
+        CATCH_REQUIRE(addr::service_registry::get_port("domain", IPPROTO_UDP) == 53);
+        CATCH_REQUIRE(addr::service_registry::get_port("broken", IPPROTO_TCP) == -1);
+        CATCH_REQUIRE(addr::service_registry::get_port("cd", IPPROTO_TCP) == 4040);
+        CATCH_REQUIRE(addr::service_registry::get_port("cd", IPPROTO_UDP) == 4041);
+        CATCH_REQUIRE(addr::service_registry::get_port("communicatord", IPPROTO_TCP) == 4040);
+        CATCH_REQUIRE(addr::service_registry::get_port("cd-alt", IPPROTO_TCP) == 4040);
+        CATCH_REQUIRE(addr::service_registry::get_port("ignored", IPPROTO_TCP) == -1);
+        CATCH_REQUIRE(addr::service_registry::get_port("https", IPPROTO_TCP) == -1);
+
+        CATCH_REQUIRE(addr::service_registry::get_port_name(80, IPPROTO_TCP) == "http");
+        CATCH_REQUIRE(addr::service_registry::get_port("http", IPPROTO_TCP) == 80);
+
+        // the name was already defined, not the port
+        //
+        CATCH_REQUIRE(addr::service_registry::get_port_name(8080, IPPROTO_TCP) == "http");
+        CATCH_REQUIRE(addr::service_registry::get_port_name(4040, IPPROTO_TCP) == "cd");
+        CATCH_REQUIRE(addr::service_registry::get_port_name(4040, IPPROTO_UDP).empty());
+
+        addr::addr a;
+        a.set_port(4040);
+        CATCH_REQUIRE(a.get_port_name() == "cd");
+        CATCH_REQUIRE(a.to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_PORT_NAME) == "[::]:cd");
+
+        char name[8] = { 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' };
+        CATCH_REQUIRE(addr::service_registry::get_port_name(4040, IPPROTO_TCP, name, sizeof(name)) == 2);
+        CATCH_REQUIRE(std::string(name, 3) == "cdx");
+        CATCH_REQUIRE(addr::service_registry::get_port_name(4040, IPPROTO_UDP, name, sizeof(name)) == 0);
+
+        // too long for the buffer, nothing gets copied
+        //
+        std::string const long_name("a-service-with-a-really-long-name-which-does-not-fit-in-the-buffer");
+        CATCH_REQUIRE(addr::service_registry::get_port_name(4242, IPPROTO_TCP, name, sizeof(name)) == long_name.length());
+        CATCH_REQUIRE(std::string(name, 3) == "cdx");
+        a.set_port(4242);
+        CATCH_REQUIRE(a.to_ipv4or6_string(addr::STRING_IP_ADDRESS | addr::STRING_IP_PORT_NAME) == "[::]:" + long_name);
+        a.set_port(4040);
+        a.set_port(4444);
+        CATCH_REQUIRE(a.get_service() == "4444");
+        CATCH_REQUIRE(a.set_port("cd"));
+        CATCH_REQUIRE(a.get_port() == 4040);
+
+        // nothing changed
+        //
+        CATCH_REQUIRE_FALSE(addr::service_registry::reload_if_changed());
+
+        // a new drop-in file is detected
+        //
+        write_file(drop_in + "/30-new.conf",
+                  "new-service\t5000/tcp\n");
+        CATCH_REQUIRE(addr::service_registry::get_port("new-service", IPPROTO_TCP) == -1);
+        CATCH_REQUIRE(addr::service_registry::reload_if_changed());
+        CATCH_REQUIRE(addr::service_registry::get_port("new-service", IPPROTO_TCP) == 5000);
+
+        // an edited file is detected
+        //
+        write_file(dir + "/services",
+                  "http\t\t80/tcp\t\twww\n"
+                  "https\t\t443/tcp\n");
+        CATCH_REQUIRE(addr::service_registry::reload_if_changed());
+        CATCH_REQUIRE(addr::service_registry::get_port("https", IPPROTO_TCP) == 443);
+        CATCH_REQUIRE(addr::service_registry::get_port("domain", IPPROTO_UDP) == -1);
+
+        // a removed file is detected
+        //
+        unlink((drop_in + "/20-other.conf").c_str());
+        CATCH_REQUIRE(addr::service_registry::reload_if_changed());
+        CATCH_REQUIRE(addr::service_registry::get_port("cd-alt", IPPROTO_TCP) == -1);
+        CATCH_REQUIRE(addr::service_registry::get_port("cd", IPPROTO_TCP) == 4040);
+
+        unlink((drop_in + "/10-cd.conf").c_str());
+        unlink((drop_in + "/30-new.conf").c_str());
+        unlink((drop_in + "/ignored.txt").c_str());
+        rmdir(drop_in.c_str());
+        unlink((dir + "/services").c_str());
+        unlink((dir + "/protocols").c_str());
+        rmdir(dir.c_str());
+
+        reset_registry();
+        CATCH_REQUIRE(addr::service_registry::get_port("https", IPPROTO_TCP) == 443);
+        CATCH_REQUIRE(addr::service_registry::get_port("cd", IPPROTO_TCP) == -1);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -759,6 +759,31 @@ CATCH_TEST_CASE("addr_unix::compare", "[addr_unix]")
         CATCH_REQUIRE(a >= b);
     }
     CATCH_END_SECTION()
+
+    CATCH_START_SECTION("addr_unix in an unordered_set_t")
+    {
+        addr::addr_unix a;
+        addr::addr_unix b;
+        CATCH_REQUIRE(a.hash() == b.hash());
+
+        a.set_uri("unix:flowers");
+        b.set_uri("unix:oranges");
+        CATCH_REQUIRE(a.hash() != b.hash());
+        CATCH_REQUIRE(std::hash<addr::addr_unix>()(a) == a.hash());
+
+        addr::addr_unix c;
+        c.set_uri("unix:flowers");
+        CATCH_REQUIRE(a.hash() == c.hash());
+
+        addr::addr_unix::unordered_set_t set;
+        set.insert(a);
+        set.insert(b);
+        set.insert(c);
+        CATCH_REQUIRE(set.size() == 2);
+        CATCH_REQUIRE(set.count(a) == 1);
+        CATCH_REQUIRE(set.count(addr::addr_unix()) == 0);
+    }
+    CATCH_END_SECTION()
 }
 
 